@@ -0,0 +1,76 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Caches serialized query results by key.
+// - Within `ttl` an entry is served as is.
+// - Within the following `stale_while_revalidate` window the old value is
+//   served while one background refresh runs.
+// - Concurrent misses for the same key share a single loader call.
+class ResultCache {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    struct Policy {
+        std::chrono::milliseconds ttl;
+        std::chrono::milliseconds stale_while_revalidate;
+    };
+    
+    // Fills `value`; returns false when the result must not be cached
+    // (e.g. the query failed). Waiters still receive the value.
+    using Loader = std::function<bool(std::string& value)>;
+    
+    std::string get(const std::string& key, const Policy& policy, const Loader& loader);
+    void invalidate(const std::string& key);
+    void clear();
+    // Marks every entry stale: the next read still gets the old value but
+    // starts a refresh, instead of everyone missing at once as after clear()
+    void expireAll();
+    
+    json getStats() const;
+
+private:
+    struct Entry {
+        std::string value;
+        bool has_value = false;
+        Clock::time_point fresh_until{};
+        Clock::time_point stale_until{};
+        bool loading = false;
+        std::shared_future<std::string> inflight;
+        // Changes when the entry is invalidated; a load started under an
+        // older generation read data from before the write and is dropped
+        unsigned long long generation = 0;
+    };
+    
+    Entry& entryFor(const std::string& key);
+    // The entry a load started under `generation` may store into, or null
+    Entry* currentEntry(const std::string& key, unsigned long long generation);
+    void reset(Entry& entry);
+    std::string load(const std::string& key, const Policy& policy, const Loader& loader,
+                     std::promise<std::string>& promise, unsigned long long generation);
+    void refreshInBackground(const std::string& key, const Policy& policy, const Loader& loader,
+                             unsigned long long generation);
+    
+    mutable std::mutex lock;
+    std::unordered_map<std::string, Entry> entries;
+    unsigned long long generations = 0;
+    
+    std::atomic<unsigned long long> hits{0};
+    std::atomic<unsigned long long> stale_hits{0};
+    std::atomic<unsigned long long> misses{0};
+    std::atomic<unsigned long long> coalesced{0};
+    std::atomic<unsigned long long> refreshes{0};
+    std::atomic<unsigned long long> load_failures{0};
+};
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,91 @@
+#ifndef BINLOG_CONSUMER_H
+#define BINLOG_CONSUMER_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "database/db_connection.h"
+#include "cdc/binlog_parser.h"
+
+// Change-data capture from the MySQL binlog.
+//
+// Registers with a branch's primary as a replica and tails its row events
+// for books, members, borrow_records and settings. This includes writes
+// made by other server instances and by SQL run directly against the
+// database. Once a transaction commits, the rows it touched are re-read
+// from the primary into the loan counters, facet bitmaps and autocomplete
+// index. Re-reading keeps this idempotent when it also sees the server's
+// own writes. DDL on those tables triggers a full rebuild. Listeners are
+// then told which tables changed, e.g. to expire cached reports.
+//
+// Needs log_bin with binlog_format=ROW, a server_id that no replica or
+// other instance uses, and the REPLICATION SLAVE and REPLICATION CLIENT
+// privileges.
+class BinlogConsumer {
+public:
+    using Listener = std::function<void(const std::set<std::string>& tables)>;
+
+    static BinlogConsumer& of(const Database& db);
+
+    // Stats of every started consumer, by branch
+    static json allStats();
+
+    // Tails from the current end of the binlog on a detached thread,
+    // reconnecting after errors. `reload_settings` is for the branch that
+    // holds the library-wide settings.
+    void start(Database& db, int branch_id, unsigned int server_id, bool reload_settings);
+
+    void addListener(Listener listener);
+
+    json getStats() const;
+
+private:
+    // Everything one transaction touched
+    struct Batch {
+        std::set<int> books;
+        std::set<int> deleted_books;
+        std::set<int> members;
+        std::set<int> member_rows;          // written in members itself, not only via a loan
+        std::set<int> deleted_members;
+        std::set<int> loan_books;
+        std::set<std::string> tables;
+        bool settings = false;
+        bool reload = false;
+        size_t rows = 0;
+
+        bool empty() const { return tables.empty() && !reload; }
+    };
+
+    BinlogConsumer() = default;
+
+    bool currentPosition(MYSQL* connection, std::string& file, uint64_t& position);
+    bool stream(Database& db);
+    void collect(const std::string& schema, const BinlogParser::Event& event, Batch& batch);
+    void apply(Database& db, const Batch& batch);
+
+    int branch_id = 0;
+    unsigned int server_id = 0;
+    bool reload_settings = false;
+    bool started = false;
+
+    mutable std::mutex lock;
+    std::vector<Listener> listeners;
+    std::string file;                 // resume point: after the last applied commit
+    uint64_t position = 0;
+    std::string last_error;
+    bool resync = false;              // events were missed; rebuild on the next commit
+
+    std::atomic<bool> connected{false};
+    std::atomic<unsigned long long> events{0};
+    std::atomic<unsigned long long> rows{0};
+    std::atomic<unsigned long long> transactions{0};
+    std::atomic<unsigned long long> reloads{0};
+    std::atomic<unsigned long long> reconnects{0};
+    std::atomic<long long> lag_ms{0};
+    std::atomic<long long> last_event_epoch{0};
+};
+
+#endif // BINLOG_CONSUMER_H
@@ -0,0 +1,68 @@
+#ifndef BINLOG_PARSER_H
+#define BINLOG_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Decodes the MySQL binlog events a change-data-capture consumer needs:
+// rotations, table maps, row events (v1 and v2), transaction ends and DDL.
+//
+// Row images are decoded far enough to pull out integer columns; other
+// values are skipped by their encoded size. Everything else is reported as
+// Other and ignored. Events must be fed in stream order, because row events
+// refer to the table map that came before them and the format description
+// says whether events carry a CRC32 trailer.
+class BinlogParser {
+public:
+    enum class EventKind { Other, Rotate, FormatDescription, TableMap, Rows, Commit, Query, Heartbeat };
+    enum class RowAction { Insert, Update, Delete };
+
+    // One row image; integer columns by position, nullopt for NULL and for
+    // non-integer columns
+    struct Row {
+        RowAction action;
+        std::vector<std::optional<long long>> columns;
+    };
+
+    struct Event {
+        EventKind kind = EventKind::Other;
+        uint32_t timestamp = 0;        // seconds; 0 for artificial events
+        uint64_t next_position = 0;    // end of this event in its file; 0 for artificial events
+        std::string schema;            // Rows, Query
+        std::string table;             // Rows
+        std::vector<Row> rows;         // updates yield the after image
+        std::string rotate_file;       // Rotate
+        uint64_t rotate_position = 0;
+        std::string query;             // Query
+    };
+
+    // False for an event too short or malformed to decode
+    bool parse(const unsigned char* data, size_t size, Event& event);
+
+    bool checksums() const { return checksum_bytes != 0; }
+
+private:
+    struct TableMap {
+        std::string schema;
+        std::string table;
+        std::vector<uint8_t> types;
+        std::vector<uint16_t> metadata;
+    };
+
+    bool parseFormatDescription(const unsigned char* body, size_t size);
+    bool parseTableMap(const unsigned char* body, size_t size);
+    bool parseRows(uint8_t type, const unsigned char* body, size_t size, Event& event);
+    bool parseQuery(const unsigned char* body, size_t size, Event& event);
+    static bool readImage(const TableMap& map, const std::vector<bool>& present, const unsigned char*& cursor,
+                          const unsigned char* end, std::vector<std::optional<long long>>& columns);
+    static std::optional<size_t> valueSize(uint8_t type, uint16_t metadata, const unsigned char* value, size_t available);
+
+    size_t checksum_bytes = 0;
+    std::unordered_map<uint64_t, TableMap> tables;
+};
+
+#endif // BINLOG_PARSER_H
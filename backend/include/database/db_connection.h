@@ -6,41 +6,307 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <cstdint>
 #include <nlohmann/json.hpp>
+#include "database/row_schema.h"
 
 using json = nlohmann::json;
 
 class Database {
 private:
-    MYSQL* connection;
+    // Connections of one pool to one server; at most `capacity` are open
+    struct ConnectionPool {
+        const char* name = "";
+        std::vector<MYSQL*> idle;
+        int open = 0;
+        int capacity = 1;
+    };
+    
+    struct Endpoint {
+        std::string host;
+        unsigned int port = 3306;
+        std::mutex lock;
+        std::condition_variable released;
+        std::map<int, ConnectionPool> pools;   // by ConnectionScope pool id
+        std::atomic<bool> healthy{false};
+        std::chrono::steady_clock::time_point retry_after{};
+    };
+    
+    // A connection checked out of a pool, returned when the lease ends. A
+    // lease on the connection of this thread's open transaction borrows it.
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Endpoint* endpoint, int pool, MYSQL* connection);
+        explicit Lease(MYSQL* borrowed) : connection(borrowed) {}
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+        
+        MYSQL* get() const { return connection; }
+        explicit operator bool() const { return connection != nullptr; }
+        // Empty because the request's deadline passed while waiting
+        bool timedOut() const { return timed_out; }
+        // The connection is broken: close it instead of returning it
+        void discard() { broken = true; }
+        
+    private:
+        friend class Database;
+        void release();
+        
+        Endpoint* endpoint = nullptr;
+        int pool = 0;
+        MYSQL* connection = nullptr;
+        bool broken = false;
+        bool timed_out = false;
+    };
+    
     std::string host;
     std::string user;
     std::string password;
     std::string database;
     unsigned int port;
+    // Branch this database serves (see ShardRouter)
+    int branch_id = 0;
+    
+    Endpoint primary;
+    std::vector<std::unique_ptr<Endpoint>> replicas;
+    std::atomic<size_t> next_replica{0};
+    
+    std::function<void(const std::string&)> statement_observer;
+    
+    // Read-your-writes: how long a replica wait may take before falling back
+    // to the primary, and the pinning window when GTIDs are not available
+    int replica_wait_ms = 50;
+    int replica_lag_window_ms = 2000;
+    
+    // Statements taking at least this long are logged; 0 disables it
+    int slow_statement_ms = 1000;
+    
+    MYSQL* openConnection(Endpoint& endpoint);
+    bool probe(Endpoint& endpoint);
+    Endpoint* pickReplica();
+    bool replicaCaughtUp(Endpoint& replica, const std::string& gtid_set);
+    bool readsRequirePrimary(Endpoint*& replica);
+    Endpoint* readEndpoint();
+    void markLost(Endpoint& replica);
+    // Waits no longer than the thread's deadline; `query` is what the
+    // connection is for, counted as timed out if the wait runs out
+    Lease checkout(Endpoint& endpoint, const std::string& query);
+    json runQuery(Endpoint& endpoint, const std::string& query, bool& connection_lost);
+    bool streamRows(Endpoint& endpoint, const std::string& query, unsigned int expected_columns,
+                    const std::function<void(char**, unsigned long*)>& on_row, bool& connection_lost);
+    bool readRows(const std::string& query, unsigned int expected_columns,
+                  const std::function<void(char**, unsigned long*)>& on_row);
+    bool runStatement(const std::string& query, const char* label);
+    void noteLatency(const std::string& query, long long latency_ms);
+    void noteWrite();
+    void killQuery(const std::string& target_host, unsigned int target_port, unsigned long thread_id);
 
 public:
+    // Per-request consistency scope. Construct one at the start of a handler
+    // with the client's X-Session-Token; after writes, token() yields the
+    // value to hand back so the client's next reads see its own changes.
+    class Session {
+    public:
+        Session(Database& database, const std::string& token);
+        ~Session();
+        std::string token();
+    private:
+        Database& db;
+    };
+    
+    // Runs the statements this thread issues against the primary as one
+    // transaction. It holds one of the pool's primary connections until it
+    // ends, so keep it short; it rolls back unless commit() succeeded.
+    class Transaction {
+    public:
+        explicit Transaction(Database& database);
+        ~Transaction();
+        bool active() const { return started; }
+        bool commit();
+    private:
+        Database& db;
+        Lease connection;
+        bool started = false;
+    };
+    
+    // Connection pool for the statements this thread issues, including on
+    // the branch threads it scatters to. Each pool has its own connections
+    // to every endpoint, at most `capacity` of them, so requests in one pool
+    // never wait for connections held by another. Threads outside a scope
+    // share the small background pool.
+    class ConnectionScope {
+    public:
+        struct Pool {
+            int id;
+            const char* name;   // static storage; shown in getPoolStatus()
+            int capacity;
+        };
+        
+        ConnectionScope(int pool_id, const char* name, int capacity);
+        // Joins a scope taken with current() on another thread
+        explicit ConnectionScope(const Pool& pool);
+        ~ConnectionScope();
+        ConnectionScope(const ConnectionScope&) = delete;
+        ConnectionScope& operator=(const ConnectionScope&) = delete;
+        
+        static Pool current();
+        
+    private:
+        Pool previous;
+    };
+    
+    // Time limit for the request running on this thread, including the
+    // branch threads it scatters to. Each statement gets the time that is
+    // left: SELECTs carry a MAX_EXECUTION_TIME hint, dedicated connections a
+    // read timeout, and a statement still running shortly after the deadline
+    // is stopped with KILL QUERY from a side connection. Once the deadline
+    // has passed, statements fail without being sent, and a statement still
+    // waiting for a pooled connection gives up.
+    class Deadline {
+    public:
+        struct State {
+            std::chrono::steady_clock::time_point at;
+            std::atomic<bool> exceeded{false};
+        };
+        
+        explicit Deadline(std::chrono::steady_clock::time_point at);
+        // Joins a deadline taken with current() on another thread; null is none
+        explicit Deadline(std::shared_ptr<State> shared);
+        ~Deadline();
+        Deadline(const Deadline&) = delete;
+        Deadline& operator=(const Deadline&) = delete;
+        
+        // Whether a statement failed for lack of time
+        bool exceeded() const { return state && state->exceeded; }
+        
+        static std::shared_ptr<State> current();
+        
+    private:
+        std::shared_ptr<State> state;
+        std::shared_ptr<State> previous;
+    };
+    
     Database(const std::string& h, const std::string& u, 
              const std::string& p, const std::string& db, 
              unsigned int pt = 3306);
     ~Database();
     
+    // Replicas must be added before connect()
+    void addReplica(const std::string& h, unsigned int pt = 3306);
+    void setReplicaWaitMs(int ms) { replica_wait_ms = ms; }
+    void setReplicaLagWindowMs(int ms) { replica_lag_window_ms = ms; }
+    void setSlowStatementMs(int ms) { slow_statement_ms = ms; }
+    
+    // Sees every statement before it runs (used by the query plan tests)
+    void setStatementObserver(std::function<void(const std::string&)> observer) {
+        statement_observer = std::move(observer);
+    }
+    
     bool connect();
     bool disconnect();
     bool isConnected() const;
     
-    // Query execution
+    // Query execution (primary)
     json executeQuery(const std::string& query);
     bool executeUpdate(const std::string& query);
     bool executeInsert(const std::string& query);
     bool executeDelete(const std::string& query);
     
+    // Query execution routed to a read replica when one is usable
+    json executeRead(const std::string& query);
+    
+    // Typed rows: columns bind by index to Schema<Entity>::fields, so the
+    // query must select row_schema::columnList<Entity>() in order. Empty when
+    // the query failed, so callers can tell an error from no rows.
+    template <typename Entity>
+    std::optional<std::vector<Entity>> queryRows(const std::string& query) {
+        std::vector<Entity> rows;
+        bool ok = readRows(query, row_schema::columnCount<Entity>(), [&rows](char** row, unsigned long* lengths) {
+            Entity entity(nullptr);
+            row_schema::decodeRow(row, lengths, entity);
+            rows.push_back(std::move(entity));
+        });
+        if (!ok) return std::nullopt;
+        return rows;
+    }
+    
+    // Unbuffered read on a dedicated connection (replica when available):
+    // rows are handed over one at a time as they arrive, so memory stays
+    // constant however large the result, and shared connections are not held
+    template <typename Entity, typename F>
+    bool forEachRow(const std::string& query, F&& on_entity) {
+        return streamUnbuffered(query, row_schema::columnCount<Entity>(),
+            [&on_entity](char** row, unsigned long* lengths) {
+                Entity entity(nullptr);
+                row_schema::decodeRow(row, lengths, entity);
+                on_entity(entity);
+            });
+    }
+    bool streamUnbuffered(const std::string& query, unsigned int expected_columns,
+                          const std::function<void(char**, unsigned long*)>& on_row);
+    
     // Helper methods
     json getQueryResult(const std::string& query);
     int getLastInsertId();
+    long long getAffectedRows();
     bool ping();
+    json getReplicaStatus();
+    
+    const std::string& getDatabaseName() const { return database; }
+    int getBranchId() const { return branch_id; }
+    void setBranchId(int id) { branch_id = id; }
+    // Open and idle connections per pool and endpoint
+    json getPoolStatus();
+    
+    // New connection to the primary for the caller's exclusive use (e.g. a
+    // binlog stream); the caller closes it. Null on failure.
+    MYSQL* openPrimaryConnection();
     
-    MYSQL* getConnection() { return connection; }
+    // Statements that ran out of time under a Deadline, by fingerprint
+    static json getTimeoutStats();
+
+private:
+    // One statement on `connection`, run within this thread's deadline
+    class Statement {
+    public:
+        Statement(Database& database, MYSQL* connection, const std::string& host, unsigned int port,
+                  const std::string& query);
+        ~Statement();
+        Statement(const Statement&) = delete;
+        Statement& operator=(const Statement&) = delete;
+        
+        // mysql_query with the time that is left; false on an error or when
+        // there is none left
+        bool send();
+        // Stops the watchdog; call once the result has been read
+        void finish();
+        // After a failure: whether it was the deadline (counted once)
+        bool timedOut();
+        // Counts a statement that got no pooled connection before the deadline
+        void poolWaitTimedOut();
+        
+    private:
+        
+        Database& db;
+        MYSQL* connection;
+        const std::string& host;
+        unsigned int port;
+        const std::string& query;
+        std::shared_ptr<Deadline::State> deadline;
+        std::chrono::steady_clock::time_point started;
+        std::uint64_t watch = 0;
+        bool killed = false;
+        bool counted = false;
+        const char* cause = nullptr;
+    };
 };
 
 #endif // DB_CONNECTION_H
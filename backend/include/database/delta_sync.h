@@ -0,0 +1,50 @@
+#ifndef DELTA_SYNC_H
+#define DELTA_SYNC_H
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+#include "database/db_connection.h"
+
+// Incremental sync for clients that keep a local copy of a table.
+//
+// Changed rows are found by updated_at. Deleted rows are recorded by triggers
+// in `deleted_rows` (tombstones) and purged once they are older than the
+// retention period. A client passes the `next_since` token from its previous
+// response, and gets every row changed since then. Rows near the boundary can
+// be sent twice, which is harmless because the client applies them as upserts.
+namespace delta_sync {
+
+// The next token is this far behind the database clock, so rows in
+// transactions that commit late or reach a replica late are not skipped
+constexpr int overlapSeconds = 30;
+
+// SQL expression for `since`: a token from an earlier response (epoch
+// seconds), or a "YYYY-MM-DD[ HH:MM:SS]" / "YYYY-MM-DDTHH:MM:SS" time.
+// nullopt when the value is neither.
+std::optional<std::string> sinceExpression(const std::string& since);
+
+struct Window {
+    bool ok = false;
+    bool expired = false;       // older than the tombstone retention; resync
+    std::string next_since;
+};
+
+// Taken before the changed rows are read
+Window open(Database& db, const std::string& since_expression);
+
+// Ids of rows deleted from `table` at or after `since_expression`
+std::optional<std::vector<int>> deletedIds(Database& db, const std::string& table,
+                                           const std::string& since_expression);
+
+void setRetentionDays(int days);
+int retentionDays();
+
+// Deletes tombstones older than the retention period
+bool purge(Database& db);
+void startPurgeJob(Database& db, std::chrono::hours interval);
+
+} // namespace delta_sync
+
+#endif // DELTA_SYNC_H
@@ -0,0 +1,240 @@
+#ifndef ROW_SCHEMA_H
+#define ROW_SCHEMA_H
+
+#include <string>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <charconv>
+#include <cstdlib>
+#include <cstdio>
+#include <nlohmann/json.hpp>
+#include "tracing/tracer.h"
+
+using json = nlohmann::json;
+
+// Compile-time column descriptor: result/JSON name, SQL select expression
+// and the entity member it binds to. Nullable string columns decode NULL
+// to "" and encode "" back as null. A derived field has no expression: it is
+// not selected or decoded, the model fills it in after the read, and it is
+// encoded like the others.
+template <typename Entity, typename T>
+struct Field {
+    const char* name;
+    const char* expr;
+    T Entity::*member;
+    bool nullable;
+};
+
+template <typename Entity, typename T>
+constexpr Field<Entity, T> field(const char* name, T Entity::*member, bool nullable = false) {
+    return Field<Entity, T>{name, name, member, nullable};
+}
+
+template <typename Entity, typename T>
+constexpr Field<Entity, T> field(const char* name, const char* expr, T Entity::*member,
+                                 bool nullable = false) {
+    return Field<Entity, T>{name, expr, member, nullable};
+}
+
+template <typename Entity, typename T>
+constexpr Field<Entity, T> derived(const char* name, T Entity::*member, bool nullable = false) {
+    return Field<Entity, T>{name, nullptr, member, nullable};
+}
+
+// Specialized per entity with `table` and a `fields` tuple
+template <typename Entity>
+struct Schema;
+
+namespace row_schema {
+
+template <typename Entity, typename F>
+void forEachField(F&& f) {
+    std::apply([&](const auto&... descriptors) { (f(descriptors), ...); }, Schema<Entity>::fields);
+}
+
+// Fields read from the result, i.e. all but the derived ones
+template <typename Entity>
+size_t columnCount() {
+    size_t count = 0;
+    forEachField<Entity>([&](const auto& descriptor) { count += descriptor.expr != nullptr; });
+    return count;
+}
+
+// "expr AS name, ..." in field order, so decoded columns bind by index
+template <typename Entity>
+std::string columnList() {
+    std::string columns;
+    forEachField<Entity>([&](const auto& descriptor) {
+        if (!descriptor.expr) return;
+        if (!columns.empty()) columns += ", ";
+        columns += descriptor.expr;
+        if (std::string(descriptor.expr) != descriptor.name) {
+            columns += " AS ";
+            columns += descriptor.name;
+        }
+    });
+    return columns;
+}
+
+inline void decodeValue(const char* text, unsigned long length, int& out) {
+    out = 0;
+    if (text) std::from_chars(text, text + length, out);
+}
+
+inline void decodeValue(const char* text, unsigned long, double& out) {
+    out = text ? std::strtod(text, nullptr) : 0.0;
+}
+
+inline void decodeValue(const char* text, unsigned long length, std::string& out) {
+    if (text) out.assign(text, length);
+    else out.clear();
+}
+
+template <typename Entity>
+void decodeRow(char** row, const unsigned long* lengths, Entity& entity) {
+    size_t index = 0;
+    forEachField<Entity>([&](const auto& descriptor) {
+        if (!descriptor.expr) return;
+        decodeValue(row[index], lengths[index], entity.*(descriptor.member));
+        index++;
+    });
+}
+
+inline void appendEscaped(std::string& out, const std::string& value) {
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out += buffer;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+inline void encodeValue(std::string& out, int value, bool) {
+    char buffer[16];
+    auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+    out.append(buffer, end);
+}
+
+inline void encodeValue(std::string& out, double value, bool) {
+    char buffer[32];
+    auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+    out.append(buffer, end);
+}
+
+inline void encodeValue(std::string& out, const std::string& value, bool nullable) {
+    if (nullable && value.empty()) {
+        out += "null";
+    } else {
+        appendEscaped(out, value);
+    }
+}
+
+template <typename Entity>
+void encodeJson(std::string& out, const Entity& entity) {
+    out += '{';
+    bool first = true;
+    forEachField<Entity>([&](const auto& descriptor) {
+        if (!first) out += ',';
+        first = false;
+        appendEscaped(out, descriptor.name);
+        out += ':';
+        encodeValue(out, entity.*(descriptor.member), descriptor.nullable);
+    });
+    out += '}';
+}
+
+template <typename Entity>
+std::string encodeJson(const Entity& entity) {
+    std::string out;
+    encodeJson(out, entity);
+    return out;
+}
+
+template <typename Entity>
+std::string encodeJsonArray(const std::vector<Entity>& rows) {
+    Tracer::Span span("json.serialize", "json");
+    std::string out;
+    out.reserve(rows.size() * 160 + 2);
+    out += '[';
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (i > 0) out += ',';
+        encodeJson(out, rows[i]);
+    }
+    out += ']';
+    return out;
+}
+
+inline void appendCsvField(std::string& out, const std::string& value) {
+    if (value.find_first_of(",\"\r\n") == std::string::npos) {
+        out += value;
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+inline void encodeCsvValue(std::string& out, int value) { encodeValue(out, value, false); }
+inline void encodeCsvValue(std::string& out, double value) { encodeValue(out, value, false); }
+inline void encodeCsvValue(std::string& out, const std::string& value) { appendCsvField(out, value); }
+
+template <typename Entity>
+std::string csvHeader() {
+    std::string out;
+    forEachField<Entity>([&](const auto& descriptor) {
+        if (!out.empty()) out += ',';
+        out += descriptor.name;
+    });
+    out += "\r\n";
+    return out;
+}
+
+// One RFC 4180 record; NULL and empty strings are both written as empty
+template <typename Entity>
+void encodeCsv(std::string& out, const Entity& entity) {
+    bool first = true;
+    forEachField<Entity>([&](const auto& descriptor) {
+        if (!first) out += ',';
+        first = false;
+        encodeCsvValue(out, entity.*(descriptor.member));
+    });
+    out += "\r\n";
+}
+
+template <typename Entity>
+json toJson(const Entity& entity) {
+    json object = json::object();
+    forEachField<Entity>([&](const auto& descriptor) {
+        const auto& value = entity.*(descriptor.member);
+        using Value = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same<Value, std::string>::value) {
+            if (descriptor.nullable && value.empty()) {
+                object[descriptor.name] = nullptr;
+                return;
+            }
+        }
+        object[descriptor.name] = value;
+    });
+    return object;
+}
+
+} // namespace row_schema
+
+#endif // ROW_SCHEMA_H
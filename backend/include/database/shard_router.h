@@ -0,0 +1,65 @@
+#ifndef SHARD_ROUTER_H
+#define SHARD_ROUTER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <future>
+#include <utility>
+#include "database/db_connection.h"
+
+// Maps library branches to their database instances. Each branch's books,
+// members and loans live in its own library_db on its own MySQL server;
+// requests are routed to one branch, and cross-branch reads fan out to all
+// of them in parallel and merge the results.
+class ShardRouter {
+public:
+    // Registers a branch; the first one added is the home branch, which also
+    // holds the library-wide settings
+    Database& addShard(int branch_id, const std::string& host, const std::string& user,
+                       const std::string& password, const std::string& database,
+                       unsigned int port = 3306);
+
+    bool connect();
+
+    Database* find(int branch_id);
+    Database& home();
+    int homeBranch() const { return home_branch; }
+    std::vector<int> branches() const;
+    size_t size() const { return shards.size(); }
+
+    // Runs `fn(branch_id, db)` on every branch concurrently, under the
+    // caller's deadline and connection pool, and returns the results in branch order
+    template <typename F>
+    auto scatter(F&& fn) -> std::vector<std::pair<int, decltype(fn(0, std::declval<Database&>()))>> {
+        using Result = decltype(fn(0, std::declval<Database&>()));
+        std::vector<std::pair<int, std::future<Result>>> pending;
+        auto deadline = Database::Deadline::current();
+        auto pool = Database::ConnectionScope::current();
+        for (auto& [branch_id, db] : shards) {
+            Database* shard = db.get();
+            int branch = branch_id;
+            pending.emplace_back(branch, std::async(std::launch::async, [&fn, branch, shard, deadline, pool] {
+                Database::Deadline scope(deadline);
+                Database::ConnectionScope connections(pool);
+                return fn(branch, *shard);
+            }));
+        }
+
+        std::vector<std::pair<int, Result>> results;
+        results.reserve(pending.size());
+        for (auto& [branch_id, future] : pending) {
+            results.emplace_back(branch_id, future.get());
+        }
+        return results;
+    }
+
+    json getStatus();
+
+private:
+    std::map<int, std::unique_ptr<Database>> shards;
+    int home_branch = 0;
+};
+
+#endif // SHARD_ROUTER_H
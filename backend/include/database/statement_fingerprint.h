@@ -0,0 +1,24 @@
+#ifndef STATEMENT_FINGERPRINT_H
+#define STATEMENT_FINGERPRINT_H
+
+#include <string>
+
+// Identifies a statement by its shape rather than its values, so the log
+// lines of one query can be grouped however its literals vary.
+namespace statement_fingerprint {
+
+// Lower-cased SQL with string and number literals replaced by `?`, runs of
+// whitespace collapsed and value lists folded to `?+`:
+//   SELECT * FROM books WHERE id IN (1, 2, 3) AND title = 'x'
+//   -> select * from books where id in (?+) and title = ?
+std::string normalize(const std::string& sql);
+
+// 16 hex digits hashing normalize(sql)
+std::string of(const std::string& sql);
+
+// The same for text that is already normalized
+std::string hash(const std::string& normalized);
+
+} // namespace statement_fingerprint
+
+#endif // STATEMENT_FINGERPRINT_H
@@ -0,0 +1,91 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <string>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Change notification emitted by the model write paths.
+// `delta` only carries the fields that changed; keys ending in "_delta"
+// are relative adjustments (e.g. available_copies_delta) and are summed
+// when events for the same row are coalesced.
+struct ChangeEvent {
+    int branch_id;          // ids are only unique within a branch
+    std::string entity;     // "book", "member", "borrow"
+    std::string action;     // "created", "updated", "deleted", "checkout", "return"
+    int id;
+    json delta;
+};
+
+// Fans change events out to live subscribers (WebSocket clients).
+// publish() never blocks on a subscriber: each one has a bounded queue in
+// which pending events for the same row are merged, and a dispatcher thread
+// does the actual sends. A subscriber whose queue overflows is sent a single
+// "resync" frame instead of the lost events.
+class EventBus {
+public:
+    using SubscriberId = unsigned long long;
+    using Sink = std::function<void(const std::string&)>;
+
+    static EventBus& instance();
+
+    ~EventBus();
+
+    SubscriberId subscribe(Sink sink);
+    void unsubscribe(SubscriberId subscriber_id);
+
+    void publish(int branch_id, const std::string& entity, const std::string& action,
+                 int id, json delta = json::object());
+
+    void setQueueCapacity(size_t capacity) { queue_capacity = capacity; }
+    void setFlushIntervalMs(int ms) { flush_interval_ms = ms; }
+
+    json getStats() const;
+
+private:
+    struct Subscriber {
+        Sink sink;
+        std::mutex queue_lock;
+        std::vector<ChangeEvent> pending;
+        std::unordered_map<std::string, size_t> pending_index;  // branch:entity:id -> slot
+        bool overflowed = false;
+        std::mutex send_lock;    // held while the sink runs, so unsubscribe can wait it out
+        unsigned long long dropped = 0;
+    };
+
+    EventBus() = default;
+
+    void ensureDispatcher();
+    void dispatchLoop();
+    void flush(Subscriber& subscriber);
+    static void merge(ChangeEvent& into, const ChangeEvent& from);
+
+    mutable std::shared_mutex subscribers_lock;
+    std::unordered_map<SubscriberId, std::shared_ptr<Subscriber>> subscribers;
+    SubscriberId next_id = 1;
+
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    bool dirty = false;
+    bool stopping = false;
+    std::thread dispatcher;
+
+    std::atomic<size_t> queue_capacity{256};
+    std::atomic<int> flush_interval_ms{50};
+    std::atomic<unsigned long long> sequence{0};
+    std::atomic<unsigned long long> published{0};
+    std::atomic<unsigned long long> coalesced{0};
+    std::atomic<unsigned long long> overflows{0};
+};
+
+#endif // EVENT_BUS_H
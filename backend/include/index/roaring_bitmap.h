@@ -0,0 +1,80 @@
+#ifndef ROARING_BITMAP_H
+#define ROARING_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed set of 32-bit integers in the style of Roaring bitmaps.
+//
+// Values are grouped by their high 16 bits into containers. A container keeps
+// its low 16 bits as a sorted array while it is sparse (up to `arrayLimit`
+// values) and switches to a 65536-bit bitmap once it is dense, so a set costs
+// at most ~2 bytes per value and intersections of dense ranges run a word at
+// a time.
+class RoaringBitmap {
+public:
+    void add(uint32_t value);
+    void remove(uint32_t value);
+    bool contains(uint32_t value) const;
+    bool empty() const { return containers.empty(); }
+    uint64_t cardinality() const;
+    size_t memoryBytes() const;
+
+    RoaringBitmap operator&(const RoaringBitmap& other) const;
+    RoaringBitmap operator|(const RoaringBitmap& other) const;
+    RoaringBitmap& operator&=(const RoaringBitmap& other) { return *this = *this & other; }
+    RoaringBitmap& operator|=(const RoaringBitmap& other) { return *this = *this | other; }
+
+    // |a & b| without building the intersection
+    static uint64_t andCardinality(const RoaringBitmap& a, const RoaringBitmap& b);
+
+    // Visits values in ascending order until `visit` returns false
+    template <typename F>
+    void forEach(F&& visit) const {
+        for (const auto& container : containers) {
+            uint32_t high = uint32_t(container.key) << 16;
+            if (container.isBitmap()) {
+                for (size_t word = 0; word < bitmapWords; ++word) {
+                    uint64_t bits = container.bits[word];
+                    while (bits) {
+                        if (!visit(high | uint32_t(word * 64 + __builtin_ctzll(bits)))) return;
+                        bits &= bits - 1;
+                    }
+                }
+            } else {
+                for (uint16_t low : container.values) {
+                    if (!visit(high | low)) return;
+                }
+            }
+        }
+    }
+
+    static constexpr size_t arrayLimit = 4096;
+    static constexpr size_t bitmapWords = 65536 / 64;
+
+private:
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> values;   // sorted, while cardinality <= arrayLimit
+        std::vector<uint64_t> bits;     // bitmapWords words, once denser
+
+        bool isBitmap() const { return !bits.empty(); }
+        bool contains(uint16_t low) const;
+        void add(uint16_t low);
+        void remove(uint16_t low);
+        void toBitmap();
+        void toArray();
+    };
+
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+    static uint32_t intersectCount(const Container& a, const Container& b);
+
+    const Container* find(uint16_t key) const;
+
+    std::vector<Container> containers;   // sorted by key
+};
+
+#endif // ROARING_BITMAP_H
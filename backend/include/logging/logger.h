@@ -0,0 +1,159 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+enum class LogLevel { Debug, Info, Warn, Error };
+
+// Asynchronous structured logging.
+//
+// A log call formats its fields into a fixed-size record on the calling
+// thread and pushes it onto that thread's ring buffer; it never takes a lock
+// or touches the output. A background writer drains every ring a few times a
+// second and appends the records as JSON lines to LOG_FILE (stderr by
+// default), one write and flush per batch. When a ring is full the record is
+// dropped and counted rather than blocking the request.
+//
+//     Logger::error("db", "Query failed")
+//         .field("error", mysql_error(connection))
+//         .field("fingerprint", fingerprint);
+//
+// The message is a constant and details go into fields, so each call site
+// is also the key for rate limiting: beyond a burst of warnings or errors
+// from one site per window, the rest are counted, and the next line that
+// gets through carries "suppressed". Lines written inside a
+// Tracer::Request scope carry its request_id.
+class Logger {
+    // Bytes of fields per line
+    static constexpr size_t line_capacity = 480;
+
+public:
+    // One line under construction; submitted when it goes out of scope.
+    // Long strings are cut and fields that no longer fit are left out, and
+    // the line is then marked "truncated".
+    class Entry {
+    public:
+        Entry(LogLevel level, const char* component, const char* message);
+        ~Entry();
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        // False when the line is filtered or rate limited, so costly
+        // fields can be skipped
+        explicit operator bool() const { return active; }
+
+        Entry& field(const char* key, const std::string& value);
+        Entry& field(const char* key, const char* value);
+        Entry& field(const char* key, long long value);
+        Entry& field(const char* key, int value) { return field(key, static_cast<long long>(value)); }
+        Entry& field(const char* key, unsigned int value) { return field(key, static_cast<long long>(value)); }
+        Entry& field(const char* key, unsigned long long value);
+        Entry& field(const char* key, unsigned long value) {
+            return field(key, static_cast<unsigned long long>(value));
+        }
+        Entry& field(const char* key, long value) { return field(key, static_cast<long long>(value)); }
+        Entry& field(const char* key, double value);
+        Entry& field(const char* key, bool value);
+
+    private:
+        void key(const char* name);
+        void raw(const char* value, size_t size);
+        void quoted(const char* value, size_t size);
+        Entry& commit(size_t mark);
+
+        bool active = false;
+        bool truncated = false;
+        bool overflow = false;
+        LogLevel level;
+        std::int64_t timestamp_us = 0;
+        size_t length = 0;
+        char text[line_capacity];
+    };
+
+    static Entry debug(const char* component, const char* message) { return {LogLevel::Debug, component, message}; }
+    static Entry info(const char* component, const char* message) { return {LogLevel::Info, component, message}; }
+    static Entry warn(const char* component, const char* message) { return {LogLevel::Warn, component, message}; }
+    static Entry error(const char* component, const char* message) { return {LogLevel::Error, component, message}; }
+
+    static Logger& instance();
+
+    // Lines below `level` are discarded on the calling thread
+    void setLevel(LogLevel level) { min_level = static_cast<int>(level); }
+    LogLevel getLevel() const { return static_cast<LogLevel>(min_level.load(std::memory_order_relaxed)); }
+    bool enabled(LogLevel level) const {
+        return static_cast<int>(level) >= min_level.load(std::memory_order_relaxed);
+    }
+
+    // Appends to `path` from the next batch on; empty means stderr
+    bool setOutput(const std::string& path);
+
+    // Writes everything queued so far; also runs at exit
+    void flush();
+
+    json getStats() const;
+
+    static bool parseLevel(const std::string& name, LogLevel& level);
+    static const char* levelName(LogLevel level);
+
+private:
+    struct Record {
+        std::int64_t timestamp_us;
+        LogLevel level;
+        bool truncated;
+        std::uint16_t length;
+        char text[line_capacity];
+    };
+
+    // Single producer (the owning thread), single consumer (the writer)
+    struct Ring {
+        static constexpr size_t slots = 256;
+        Record records[slots];
+        std::atomic<size_t> head{0};   // next slot to write; producer only
+        std::atomic<size_t> tail{0};   // next slot to read; writer only
+        std::atomic<bool> closed{false};
+    };
+
+    // Rate limit state of one call site (sites may share a bucket)
+    struct Bucket {
+        std::atomic<std::int64_t> window{0};
+        std::atomic<unsigned int> count{0};
+        std::atomic<unsigned int> suppressed{0};
+    };
+
+    static constexpr size_t bucket_count = 256;
+    static constexpr unsigned int burst = 10;
+    static constexpr std::int64_t window_seconds = 10;
+
+    Logger();
+    Ring* threadRing();
+    bool admit(const char* component, const char* message, std::int64_t now_us, unsigned int& suppressed_before);
+    void submit(LogLevel level, std::int64_t timestamp_us, bool truncated, const char* text, size_t length);
+    void writerLoop();
+    void drain();
+
+    std::atomic<int> min_level{static_cast<int>(LogLevel::Info)};
+    std::atomic<unsigned long long> written{0};
+    std::atomic<unsigned long long> dropped{0};
+    std::atomic<unsigned long long> suppressed{0};
+    std::atomic<unsigned long long> batches{0};
+    Bucket buckets[bucket_count];
+
+    mutable std::mutex rings_lock;
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    // Held while draining, so the writer thread and flush() take turns
+    mutable std::mutex output_lock;
+    std::FILE* output = stderr;
+    std::string output_path;
+};
+
+#endif // LOGGER_H
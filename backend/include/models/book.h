@@ -2,8 +2,12 @@
 #define BOOK_H
 
 #include <string>
+#include <vector>
+#include <optional>
 #include <nlohmann/json.hpp>
 #include "database/db_connection.h"
+#include "database/row_schema.h"
+#include "models/request_body.h"
 
 using json = nlohmann::json;
 
@@ -17,10 +21,35 @@ private:
     int total_copies;
     int available_copies;
     int publication_year;
+    std::string created_at;
+    std::string updated_at;
     
     Database* db;
+    
+    friend struct Schema<Book>;
 
 public:
+    // POST /api/books body
+    struct CreateRequest {
+        std::string title;
+        std::string author;
+        std::string isbn;
+        std::string category;
+        int copies = 0;
+        int year = 0;
+    };
+    
+    // PUT /api/books/<id> body; only the fields present are changed
+    struct UpdateRequest {
+        std::optional<std::string> title;
+        std::optional<std::string> author;
+        std::optional<std::string> category;
+        std::optional<int> total_copies;
+        std::optional<int> available_copies;
+        
+        bool empty() const { return !title && !author && !category && !total_copies && !available_copies; }
+    };
+    
     Book(Database* database);
     
     // Getters
@@ -32,6 +61,7 @@ public:
     int getTotalCopies() const { return total_copies; }
     int getAvailableCopies() const { return available_copies; }
     int getPublicationYear() const { return publication_year; }
+    std::string getUpdatedAt() const { return updated_at; }
     
     // Setters
     void setTitle(const std::string& t) { title = t; }
@@ -42,19 +72,63 @@ public:
     void setAvailableCopies(int a) { available_copies = a; }
     void setPublicationYear(int y) { publication_year = y; }
     
-    // Database operations
-    json getAll();
-    json getById(int book_id);
-    json search(const std::string& query, const std::string& category = "");
-    bool create(const json& data);
-    bool update(int book_id, const json& data);
+    // Database operations; reads are empty (or false) when the query failed
+    std::optional<std::vector<Book>> getAll();
+    // Sets `book` when the row exists
+    bool getById(int book_id, std::optional<Book>& book);
+    std::optional<std::vector<Book>> search(const std::string& query, const std::string& category = "");
+    std::optional<std::vector<Book>> getByIds(const std::vector<int>& book_ids);
+    std::optional<std::vector<Book>> getChangedSince(const std::string& since_expression);
+    bool create(const CreateRequest& request);
+    bool update(int book_id, const UpdateRequest& request);
     bool deleteBook(int book_id);
     
     // Status
     std::string getStatus() const;
+    static std::string statusFor(int available_copies, int total_copies);
     
     // JSON conversion
     json toJson() const;
 };
 
+template <>
+struct Schema<Book> {
+    static constexpr const char* table = "books";
+    static constexpr auto fields = std::make_tuple(
+        field("id", &Book::id),
+        field("title", &Book::title),
+        field("author", &Book::author),
+        field("isbn", &Book::isbn),
+        field("category", &Book::category),
+        field("total_copies", &Book::total_copies),
+        field("available_copies", &Book::available_copies),
+        field("publication_year", &Book::publication_year),
+        field("created_at", &Book::created_at),
+        field("updated_at", &Book::updated_at)
+    );
+};
+
+template <>
+struct RequestSchema<Book::CreateRequest> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::required("title", &Book::CreateRequest::title),
+        request_body::required("author", &Book::CreateRequest::author),
+        request_body::required("isbn", &Book::CreateRequest::isbn),
+        request_body::required("category", &Book::CreateRequest::category),
+        request_body::required("copies", &Book::CreateRequest::copies),
+        request_body::optional("year", &Book::CreateRequest::year)
+    );
+};
+
+template <>
+struct RequestSchema<Book::UpdateRequest> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::optional("title", &Book::UpdateRequest::title),
+        request_body::optional("author", &Book::UpdateRequest::author),
+        request_body::optional("category", &Book::UpdateRequest::category),
+        request_body::optional("total_copies", &Book::UpdateRequest::total_copies),
+        request_body::optional("available_copies", &Book::UpdateRequest::available_copies)
+    );
+};
+
 #endif // BOOK_H
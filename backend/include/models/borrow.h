@@ -2,8 +2,13 @@
 #define BORROW_H
 
 #include <string>
+#include <vector>
+#include <optional>
+#include <functional>
 #include <nlohmann/json.hpp>
 #include "database/db_connection.h"
+#include "database/row_schema.h"
+#include "models/request_body.h"
 
 using json = nlohmann::json;
 
@@ -12,6 +17,8 @@ private:
     int id;
     int member_id;
     int book_id;
+    std::string member_name;
+    std::string book_title;
     std::string borrow_date;
     std::string due_date;
     std::string return_date;
@@ -19,14 +26,59 @@ private:
     double fine_amount;
     
     Database* db;
+    
+    friend struct Schema<Borrow>;
+    
+    // Sets member_name and book_title from the NameDirectory
+    void fillNames(std::vector<Borrow>& rows) const;
 
 public:
+    enum class CheckoutStatus { Created, LimitReached, MemberNotActive, UnknownMember, Failed };
+    
+    // Per-item result of a batch: `id` is the scanned book id (checkout) or
+    // borrow id (return); `borrow_id` is 0 when no loan is involved
+    struct BatchItem {
+        int id;
+        std::string outcome;
+        int borrow_id;
+    };
+    
+    // POST /api/borrowing body
+    struct CheckoutRequest {
+        int member_id = 0;
+        int book_id = 0;
+        std::string borrow_date;
+        std::string due_date;
+    };
+    
+    // PUT /api/borrowing/<id> body; only the fields present are changed
+    struct UpdateRequest {
+        std::optional<std::string> status;
+        std::optional<double> fine_amount;
+        
+        bool empty() const { return !status && !fine_amount; }
+    };
+    
+    // POST /api/borrowing/batch/checkout and /batch/return bodies
+    struct BatchCheckoutRequest {
+        int member_id = 0;
+        std::string borrow_date;
+        std::string due_date;
+        std::vector<int> book_ids;
+    };
+    
+    struct BatchReturnRequest {
+        std::vector<int> borrow_ids;
+    };
+    
     Borrow(Database* database);
     
     // Getters
     int getId() const { return id; }
     int getMemberId() const { return member_id; }
     int getBookId() const { return book_id; }
+    std::string getMemberName() const { return member_name; }
+    std::string getBookTitle() const { return book_title; }
     std::string getBorrowDate() const { return borrow_date; }
     std::string getDueDate() const { return due_date; }
     std::string getReturnDate() const { return return_date; }
@@ -34,14 +86,31 @@ public:
     double getFineAmount() const { return fine_amount; }
     
     // Database operations
-    json getAll();
-    json getById(int borrow_id);
-    json getByMember(int member_id);
-    json getByStatus(const std::string& status);
+    // Reads are empty (or false) when the query failed
+    std::optional<std::vector<Borrow>> getAll();
+    // Sets `borrow` when the row exists
+    bool getById(int borrow_id, std::optional<Borrow>& borrow);
+    std::optional<std::vector<Borrow>> getChangedSince(const std::string& since_expression);
+    std::optional<std::vector<Borrow>> getByMember(int member_id);
+    std::optional<std::vector<Borrow>> getByStatus(const std::string& status);
     json getOverdue();
-    bool create(const json& data);
-    bool update(int borrow_id, const json& data);
+    
+    // Streams matching history rows in id order at constant memory.
+    // Empty filters are ignored; callers validate the values.
+    bool exportHistory(const std::string& from_date, const std::string& to_date,
+                       const std::string& status, const std::function<void(const Borrow&)>& on_row);
+    bool create(const CheckoutRequest& request);
+    CheckoutStatus checkout(const CheckoutRequest& request);
+    bool update(int borrow_id, const UpdateRequest& request);
     bool recordReturn(int borrow_id);
+    
+    // Scanner sessions: every item in one transaction with set-based SQL.
+    // Rescanned items are reported (already_borrowed / already_returned)
+    // rather than applied twice. False if the transaction failed, in which
+    // case nothing was written.
+    bool checkoutBatch(int member_id, const std::vector<int>& book_ids, const std::string& borrow_date,
+                       const std::string& due_date, std::vector<BatchItem>& items);
+    bool returnBatch(const std::vector<int>& borrow_ids, std::vector<BatchItem>& items);
     bool deleteBorrow(int borrow_id);
     
     // Statistics
@@ -53,4 +122,58 @@ public:
     json toJson() const;
 };
 
+// Borrow rows are read from borrow_records alone; the display names come
+// from the NameDirectory
+template <>
+struct Schema<Borrow> {
+    static constexpr const char* table = "borrow_records";
+    static constexpr auto fields = std::make_tuple(
+        field("id", "br.id", &Borrow::id),
+        field("member_id", "br.member_id", &Borrow::member_id),
+        field("book_id", "br.book_id", &Borrow::book_id),
+        derived("member_name", &Borrow::member_name),
+        derived("book_title", &Borrow::book_title),
+        field("borrow_date", "br.borrow_date", &Borrow::borrow_date),
+        field("due_date", "br.due_date", &Borrow::due_date),
+        field("return_date", "br.return_date", &Borrow::return_date, true),
+        field("status", "br.status", &Borrow::status),
+        field("fine_amount", "br.fine_amount", &Borrow::fine_amount)
+    );
+};
+
+template <>
+struct RequestSchema<Borrow::CheckoutRequest> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::required("member_id", &Borrow::CheckoutRequest::member_id),
+        request_body::required("book_id", &Borrow::CheckoutRequest::book_id),
+        request_body::required("borrow_date", &Borrow::CheckoutRequest::borrow_date),
+        request_body::required("due_date", &Borrow::CheckoutRequest::due_date)
+    );
+};
+
+template <>
+struct RequestSchema<Borrow::UpdateRequest> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::optional("status", &Borrow::UpdateRequest::status),
+        request_body::optional("fine_amount", &Borrow::UpdateRequest::fine_amount)
+    );
+};
+
+template <>
+struct RequestSchema<Borrow::BatchCheckoutRequest> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::required("member_id", &Borrow::BatchCheckoutRequest::member_id),
+        request_body::required("borrow_date", &Borrow::BatchCheckoutRequest::borrow_date),
+        request_body::required("due_date", &Borrow::BatchCheckoutRequest::due_date),
+        request_body::required("book_ids", &Borrow::BatchCheckoutRequest::book_ids)
+    );
+};
+
+template <>
+struct RequestSchema<Borrow::BatchReturnRequest> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::required("borrow_ids", &Borrow::BatchReturnRequest::borrow_ids)
+    );
+};
+
 #endif // BORROW_H
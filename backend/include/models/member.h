@@ -2,8 +2,12 @@
 #define MEMBER_H
 
 #include <string>
+#include <vector>
+#include <optional>
 #include <nlohmann/json.hpp>
 #include "database/db_connection.h"
+#include "database/row_schema.h"
+#include "models/request_body.h"
 
 using json = nlohmann::json;
 
@@ -19,8 +23,31 @@ private:
     std::string join_date;
     
     Database* db;
+    
+    friend struct Schema<Member>;
 
 public:
+    // POST /api/members body; join_date defaults to today
+    struct CreateRequest {
+        std::string member_id;
+        std::string name;
+        std::string email;
+        std::string phone;
+        std::string address;
+        std::optional<std::string> join_date;
+    };
+    
+    // PUT /api/members/<id> body; only the fields present are changed
+    struct UpdateRequest {
+        std::optional<std::string> name;
+        std::optional<std::string> email;
+        std::optional<std::string> phone;
+        std::optional<std::string> address;
+        std::optional<std::string> status;
+        
+        bool empty() const { return !name && !email && !phone && !address && !status; }
+    };
+    
     Member(Database* database);
     
     // Getters
@@ -41,12 +68,15 @@ public:
     void setStatus(const std::string& s) { status = s; }
     
     // Database operations
-    json getAll();
-    json getById(int member_id);
-    json search(const std::string& query);
-    json filterByStatus(const std::string& status);
-    bool create(const json& data);
-    bool update(int member_id, const json& data);
+    // Reads are empty (or false) when the query failed
+    std::optional<std::vector<Member>> getAll();
+    // Sets `member` when the row exists
+    bool getById(int member_id, std::optional<Member>& member);
+    std::optional<std::vector<Member>> getChangedSince(const std::string& since_expression);
+    std::optional<std::vector<Member>> search(const std::string& query);
+    std::optional<std::vector<Member>> filterByStatus(const std::string& status);
+    bool create(const CreateRequest& request);
+    bool update(int member_id, const UpdateRequest& request);
     bool deleteMember(int member_id);
     
     // Member stats
@@ -56,4 +86,42 @@ public:
     json toJson() const;
 };
 
+template <>
+struct Schema<Member> {
+    static constexpr const char* table = "members";
+    static constexpr auto fields = std::make_tuple(
+        field("id", &Member::id),
+        field("member_id", &Member::member_id),
+        field("name", &Member::name),
+        field("email", &Member::email),
+        field("phone", &Member::phone, true),
+        field("address", &Member::address, true),
+        field("status", &Member::status),
+        field("join_date", &Member::join_date)
+    );
+};
+
+template <>
+struct RequestSchema<Member::CreateRequest> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::required("member_id", &Member::CreateRequest::member_id),
+        request_body::required("name", &Member::CreateRequest::name),
+        request_body::required("email", &Member::CreateRequest::email),
+        request_body::optional("phone", &Member::CreateRequest::phone),
+        request_body::optional("address", &Member::CreateRequest::address),
+        request_body::optional("join_date", &Member::CreateRequest::join_date)
+    );
+};
+
+template <>
+struct RequestSchema<Member::UpdateRequest> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::optional("name", &Member::UpdateRequest::name),
+        request_body::optional("email", &Member::UpdateRequest::email),
+        request_body::optional("phone", &Member::UpdateRequest::phone),
+        request_body::optional("address", &Member::UpdateRequest::address),
+        request_body::optional("status", &Member::UpdateRequest::status)
+    );
+};
+
 #endif // MEMBER_H
@@ -0,0 +1,300 @@
+#ifndef REQUEST_BODY_H
+#define REQUEST_BODY_H
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Compile-time descriptor of one request body field: its JSON key, the
+// member it fills and whether a body without it is rejected. Members are
+// std::string, int, double, bool, std::vector<int>, std::vector<std::string>,
+// or std::optional of a scalar for fields that may be left out (PUT bodies).
+template <typename Request, typename T>
+struct BodyField {
+    const char* name;
+    T Request::*member;
+    bool required;
+};
+
+// Specialized per request type with a `fields` tuple
+template <typename Request>
+struct RequestSchema;
+
+namespace request_body {
+
+template <typename Request, typename T>
+constexpr BodyField<Request, T> required(const char* name, T Request::*member) {
+    return BodyField<Request, T>{name, member, true};
+}
+
+template <typename Request, typename T>
+constexpr BodyField<Request, T> optional(const char* name, T Request::*member) {
+    return BodyField<Request, T>{name, member, false};
+}
+
+// One scalar as the SAX parser hands it over
+struct Scalar {
+    enum Kind { Null, Boolean, Integer, Unsigned, Float, String } kind;
+    bool boolean = false;
+    long long integer = 0;
+    unsigned long long unsigned_integer = 0;
+    double number = 0;
+    std::string* text = nullptr;
+};
+
+// Each returns false when the value has the wrong type, leaving `error` set
+inline bool assign(std::string& out, const Scalar& value, const char* name, std::string& error) {
+    if (value.kind != Scalar::String) {
+        error = std::string(name) + " must be a string";
+        return false;
+    }
+    out = std::move(*value.text);
+    return true;
+}
+
+inline bool assign(int& out, const Scalar& value, const char* name, std::string& error) {
+    bool fits = (value.kind == Scalar::Integer && value.integer >= std::numeric_limits<int>::min()
+                 && value.integer <= std::numeric_limits<int>::max())
+        || (value.kind == Scalar::Unsigned && value.unsigned_integer <= unsigned(std::numeric_limits<int>::max()));
+    if (!fits) {
+        error = std::string(name) + " must be an integer";
+        return false;
+    }
+    out = value.kind == Scalar::Integer ? int(value.integer) : int(value.unsigned_integer);
+    return true;
+}
+
+inline bool assign(double& out, const Scalar& value, const char* name, std::string& error) {
+    switch (value.kind) {
+        case Scalar::Integer: out = double(value.integer); return true;
+        case Scalar::Unsigned: out = double(value.unsigned_integer); return true;
+        case Scalar::Float: out = value.number; return true;
+        default:
+            error = std::string(name) + " must be a number";
+            return false;
+    }
+}
+
+inline bool assign(bool& out, const Scalar& value, const char* name, std::string& error) {
+    if (value.kind != Scalar::Boolean) {
+        error = std::string(name) + " must be true or false";
+        return false;
+    }
+    out = value.boolean;
+    return true;
+}
+
+template <typename T>
+bool assign(std::optional<T>& out, const Scalar& value, const char* name, std::string& error) {
+    T parsed{};
+    if (!assign(parsed, value, name, error)) return false;
+    out = std::move(parsed);
+    return true;
+}
+
+inline const char* elementKind(const std::vector<int>*) { return "integers"; }
+inline const char* elementKind(const std::vector<std::string>*) { return "strings"; }
+
+template <typename T>
+bool assign(std::vector<T>& out, const Scalar&, const char* name, std::string& error) {
+    error = std::string(name) + " must be an array of " + elementKind(&out);
+    return false;
+}
+
+template <typename T>
+constexpr bool isList = std::is_same_v<T, std::vector<int>> || std::is_same_v<T, std::vector<std::string>>;
+
+// Fills a Request straight from parser events, without building a DOM.
+// Unknown keys and their values are skipped, so clients may send whole
+// records back; duplicate keys are rejected.
+template <typename Request>
+class Reader : public nlohmann::json_sax<json> {
+public:
+    static constexpr size_t fieldCount = std::tuple_size<decltype(RequestSchema<Request>::fields)>::value;
+    static_assert(fieldCount <= 64, "seen fields are tracked in a 64-bit mask");
+
+    explicit Reader(Request& target) : request(target) {}
+
+    bool null() override { return scalar(Scalar{Scalar::Null}); }
+    bool boolean(bool value) override {
+        Scalar s{Scalar::Boolean};
+        s.boolean = value;
+        return scalar(s);
+    }
+    bool number_integer(number_integer_t value) override {
+        Scalar s{Scalar::Integer};
+        s.integer = value;
+        return scalar(s);
+    }
+    bool number_unsigned(number_unsigned_t value) override {
+        Scalar s{Scalar::Unsigned};
+        s.unsigned_integer = value;
+        return scalar(s);
+    }
+    bool number_float(number_float_t value, const string_t&) override {
+        Scalar s{Scalar::Float};
+        s.number = value;
+        return scalar(s);
+    }
+    bool string(string_t& value) override {
+        Scalar s{Scalar::String};
+        s.text = &value;
+        return scalar(s);
+    }
+    bool binary(binary_t&) override { return fail("Unexpected binary value"); }
+
+    bool start_object(std::size_t) override {
+        if (depth == 0) {
+            depth = 1;
+            return true;
+        }
+        if (skipping()) return ++skip_depth, true;
+        if (current >= 0) return fail(std::string(nameOf(current)) + " must not be an object");
+        return ++skip_depth, true;
+    }
+    bool end_object() override {
+        if (skipping()) return endSkipped();
+        depth = 0;
+        return true;
+    }
+
+    bool key(string_t& name) override {
+        if (skipping()) return true;
+        current = -1;
+        size_t index = 0;
+        forEachField([&](const auto& descriptor) {
+            if (current < 0 && name == descriptor.name) current = int(index);
+            index++;
+        });
+        if (current < 0) return true;
+        if (seen & (uint64_t(1) << current)) return fail("Duplicate field " + name);
+        seen |= uint64_t(1) << current;
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        if (depth == 0) return fail("Expected a JSON object");
+        if (skipping() || current < 0) return ++skip_depth, true;
+        bool list = false;
+        std::string nested;
+        withField(current, [&](const auto& descriptor) {
+            auto& member = request.*(descriptor.member);
+            if constexpr (isList<std::decay_t<decltype(member)>>) {
+                nested = std::string(descriptor.name) + " must be an array of " + elementKind(&member);
+                if (!in_list) member.clear();
+                list = true;
+            }
+        });
+        if (in_list) return fail(nested);
+        if (!list) return fail(std::string(nameOf(current)) + " must not be an array");
+        in_list = true;
+        return true;
+    }
+    bool end_array() override {
+        if (skipping()) return endSkipped();
+        in_list = false;
+        current = -1;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception&) override {
+        if (error.empty()) error = "Invalid JSON at byte " + std::to_string(position);
+        return false;
+    }
+
+    // Required fields the body did not have
+    bool complete() {
+        size_t index = 0;
+        forEachField([&](const auto& descriptor) {
+            if (error.empty() && descriptor.required && !(seen & (uint64_t(1) << index))) {
+                error = std::string(descriptor.name) + " is required";
+            }
+            index++;
+        });
+        return error.empty();
+    }
+
+    std::string error;
+
+private:
+    template <typename F>
+    static void forEachField(F&& f) {
+        std::apply([&](const auto&... descriptors) { (f(descriptors), ...); }, RequestSchema<Request>::fields);
+    }
+
+    template <typename F>
+    static void withField(int wanted, F&& f) {
+        int index = 0;
+        forEachField([&](const auto& descriptor) {
+            if (index++ == wanted) f(descriptor);
+        });
+    }
+
+    static const char* nameOf(int wanted) {
+        const char* name = "";
+        withField(wanted, [&](const auto& descriptor) { name = descriptor.name; });
+        return name;
+    }
+
+    bool skipping() const { return skip_depth > 0; }
+
+    bool endSkipped() {
+        if (--skip_depth == 0 && !in_list) current = -1;
+        return true;
+    }
+
+    bool fail(const std::string& message) {
+        error = message;
+        return false;
+    }
+
+    bool scalar(const Scalar& value) {
+        if (depth == 0) return fail("Expected a JSON object");
+        if (skipping() || current < 0) return true;
+        bool ok = true;
+        withField(current, [&](const auto& descriptor) {
+            auto& member = request.*(descriptor.member);
+            if (in_list) {
+                if constexpr (isList<std::decay_t<decltype(member)>>) {
+                    typename std::decay_t<decltype(member)>::value_type element{};
+                    ok = assign(element, value, descriptor.name, error);
+                    if (ok) member.push_back(std::move(element));
+                    else error = std::string(descriptor.name) + " must be an array of " + elementKind(&member);
+                }
+            } else {
+                ok = assign(member, value, descriptor.name, error);
+            }
+        });
+        if (!in_list) current = -1;
+        return ok;
+    }
+
+    Request& request;
+    int depth = 0;
+    int current = -1;         // field whose value comes next; -1 when unknown
+    int skip_depth = 0;       // nesting inside a skipped value
+    bool in_list = false;
+    uint64_t seen = 0;
+};
+
+// Parses `body` into `request` in one pass. False, with `error` set to a
+// message for the client, on malformed JSON, a missing required field or a
+// value of the wrong type.
+template <typename Request>
+bool parse(const std::string& body, Request& request, std::string& error) {
+    Reader<Request> reader(request);
+    bool ok = json::sax_parse(body, &reader) && reader.complete();
+    error = ok ? "" : reader.error.empty() ? "Invalid JSON" : reader.error;
+    return ok;
+}
+
+} // namespace request_body
+
+#endif // REQUEST_BODY_H
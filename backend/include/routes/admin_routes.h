@@ -0,0 +1,9 @@
+#ifndef ADMIN_ROUTES_H
+#define ADMIN_ROUTES_H
+
+#include "crow_all.h"
+#include "tracing/tracer.h"
+
+void registerAdminRoutes(crow::SimpleApp& app);
+
+#endif // ADMIN_ROUTES_H
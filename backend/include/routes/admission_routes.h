@@ -0,0 +1,79 @@
+#ifndef ADMISSION_ROUTES_H
+#define ADMISSION_ROUTES_H
+
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <string>
+#include "crow_all.h"
+#include "database/db_connection.h"
+#include "logging/logger.h"
+#include "services/admission_controller.h"
+#include "tracing/tracer.h"
+
+void registerAdmissionRoutes(crow::SimpleApp& app);
+
+// 503 with Retry-After for a request the admission controller turned away
+crow::response admissionRejected(int retry_after);
+
+// 504 for a request whose statements ran out of time
+crow::response deadlineExceeded();
+
+// Hands the client its read-your-writes token (see Database::Session). The
+// SPA is served from another origin, so the header must be exposed to it.
+void setSessionToken(crow::response& response, const std::string& token);
+
+// Runs `cleanup` once the response of the request handled on this thread has
+// been sent, e.g. to remove a file given to set_static_file_info (Crow reads
+// it from within res.end())
+void afterResponse(std::function<void()> cleanup);
+
+// res.end(), then the cleanups the handler registered
+void endResponse(crow::response& res);
+
+// Runs `handler` on the route class's worker pool, traced as `name`, and
+// completes `res` with the response it returns (or a 503 when the class is
+// saturated). Its statements use the class's own database connections, as
+// many per endpoint as the class has workers, and share a deadline of
+// `budget` from now, or of the class's default when no budget is given
+// (zero there means none). If one of them ran out of time, a 504 replaces
+// the response unless it is a success, such as the 201 of a write that
+// committed before. Crow keeps the request alive until res.end(), so the
+// handler may capture it by reference.
+template <typename Handler>
+void dispatch(RouteClass route_class, const char* name, const crow::request& req, crow::response& res,
+              Handler handler, std::chrono::milliseconds budget = std::chrono::milliseconds(0)) {
+    auto& controller = AdmissionController::instance();
+    AdmissionLimits limits = controller.limits(route_class);
+    if (budget.count() <= 0) budget = limits.deadline;
+    bool limited = budget.count() > 0;
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    Database::ConnectionScope::Pool pool{static_cast<int>(route_class), routeClassName(route_class),
+                                         limits.max_concurrent};
+
+    controller.submit(route_class,
+        [name, &req, &res, handler, limited, deadline, pool](double queued_ms) mutable {
+            try {
+                Tracer::Request trace(name, req.get_header_value("X-Request-Id"));
+                Tracer::Span span("admission.run", "admission");
+                if (span) span.arg("queued_ms", queued_ms);
+                Database::ConnectionScope connections(pool);
+                std::optional<Database::Deadline> scope;
+                if (limited) scope.emplace(deadline);
+                res = handler();
+                bool succeeded = res.code >= 200 && res.code < 300;
+                if (scope && scope->exceeded() && !succeeded) res = deadlineExceeded();
+            } catch (const std::exception& e) {
+                Logger::error("admission", "Handler failed").field("route", name).field("error", e.what());
+                res = crow::response(500);
+            }
+            endResponse(res);
+        },
+        [&res](int retry_after) {
+            res = admissionRejected(retry_after);
+            res.end();
+        });
+}
+
+#endif // ADMISSION_ROUTES_H
@@ -2,9 +2,9 @@
 #define BOOKS_ROUTES_H
 
 #include "crow_all.h"
-#include "database/db_connection.h"
+#include "database/shard_router.h"
 #include "models/book.h"
 
-void registerBooksRoutes(crow::SimpleApp& app, Database& db);
+void registerBooksRoutes(crow::SimpleApp& app, ShardRouter& shards);
 
 #endif // BOOKS_ROUTES_H
@@ -2,9 +2,9 @@
 #define BORROWING_ROUTES_H
 
 #include "crow_all.h"
-#include "database/db_connection.h"
+#include "database/shard_router.h"
 #include "models/borrow.h"
 
-void registerBorrowingRoutes(crow::SimpleApp& app, Database& db);
+void registerBorrowingRoutes(crow::SimpleApp& app, ShardRouter& shards);
 
 #endif // BORROWING_ROUTES_H
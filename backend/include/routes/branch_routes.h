@@ -0,0 +1,21 @@
+#ifndef BRANCH_ROUTES_H
+#define BRANCH_ROUTES_H
+
+#include "crow_all.h"
+#include "database/shard_router.h"
+
+void registerBranchRoutes(crow::SimpleApp& app, ShardRouter& shards);
+
+// Branch named by the X-Branch-Id header or ?branch= parameter, the home
+// branch when neither is given, -1 when the value is not a branch id
+int requestedBranch(ShardRouter& shards, const crow::request& req);
+
+// Database of the requested branch, or null if there is no such branch
+Database* branchDatabase(ShardRouter& shards, const crow::request& req);
+
+// True for ?branch=all (or X-Branch-Id: all) on cross-branch reads
+bool isAllBranches(const crow::request& req);
+
+crow::response unknownBranch();
+
+#endif // BRANCH_ROUTES_H
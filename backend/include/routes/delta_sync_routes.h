@@ -0,0 +1,19 @@
+#ifndef DELTA_SYNC_ROUTES_H
+#define DELTA_SYNC_ROUTES_H
+
+#include <functional>
+#include <optional>
+#include <string>
+#include "crow_all.h"
+#include "database/db_connection.h"
+
+// Response for a list endpoint called with ?since=: `{"changed", "deleted",
+// "next_since"}`. `changed` gets the since expression and returns the rows
+// as a JSON array, or nothing when the read failed. 400 for a malformed
+// since, 410 when it is older than the tombstone retention and the client has
+// to download everything again, 500 (without a next_since, so the client
+// asks again from the same point) when a read failed.
+crow::response deltaSyncResponse(Database& db, const std::string& since, const std::string& table,
+                                 const std::function<std::optional<std::string>(const std::string&)>& changed);
+
+#endif // DELTA_SYNC_ROUTES_H
@@ -0,0 +1,9 @@
+#ifndef EVENTS_ROUTES_H
+#define EVENTS_ROUTES_H
+
+#include "crow_all.h"
+#include "events/event_bus.h"
+
+void registerEventsRoutes(crow::SimpleApp& app);
+
+#endif // EVENTS_ROUTES_H
@@ -2,9 +2,9 @@
 #define MEMBERS_ROUTES_H
 
 #include "crow_all.h"
-#include "database/db_connection.h"
+#include "database/shard_router.h"
 #include "models/member.h"
 
-void registerMembersRoutes(crow::SimpleApp& app, Database& db);
+void registerMembersRoutes(crow::SimpleApp& app, ShardRouter& shards);
 
 #endif // MEMBERS_ROUTES_H
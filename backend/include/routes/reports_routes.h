@@ -2,9 +2,12 @@
 #define REPORTS_ROUTES_H
 
 #include "crow_all.h"
-#include "database/db_connection.h"
+#include "database/shard_router.h"
 #include "models/borrow.h"
 
-void registerReportsRoutes(crow::SimpleApp& app, Database& db);
+void registerReportsRoutes(crow::SimpleApp& app, ShardRouter& shards);
+
+// Cached reports are served stale and refreshed on their next request
+void expireReportCache();
 
 #endif // REPORTS_ROUTES_H
@@ -0,0 +1,97 @@
+#ifndef ADMISSION_CONTROLLER_H
+#define ADMISSION_CONTROLLER_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Endpoint classes that get their own workers and budget, so a burst of
+// reports cannot starve checkouts and returns.
+enum class RouteClass { CirculationWrite, InteractiveRead, Reporting, Admin };
+
+struct AdmissionLimits {
+    // Worker threads, and the size of the class's own connection pool to
+    // each database endpoint (see Database::ConnectionScope)
+    int max_concurrent;
+    int max_queue;
+    std::chrono::milliseconds latency_budget;
+    // Scheduling priority of the workers as a nice value (higher yields the
+    // CPU to the other classes)
+    int nice = 0;
+    // Time a request has, from arrival, before its statements are cancelled
+    // and it gets a 504 (see Database::Deadline)
+    std::chrono::milliseconds deadline{0};
+};
+
+// Runs database-bound requests on a separate worker pool per route class.
+// HTTP threads only queue the work, so a class that is slow or saturated
+// holds its own workers and connections and nobody else's. A request runs
+// as soon as one of its class's workers is free, otherwise it waits in a
+// short FIFO queue. It is turned away immediately when the queue is full or
+// the expected wait (from a moving average of service time) exceeds the
+// class's latency budget, and dropped if it is still queued when the budget
+// runs out.
+class AdmissionController {
+public:
+    // Runs on a worker with the time the request spent queued; must not throw
+    using Job = std::function<void(double queued_ms)>;
+    // Gets the Retry-After seconds for the client
+    using Reject = std::function<void(int retry_after)>;
+
+    static AdmissionController& instance();
+
+    void configure(RouteClass route_class, const AdmissionLimits& limits);
+    AdmissionLimits limits(RouteClass route_class) const;
+
+    // Queues `job` on the class's pool. `reject` runs instead: on the calling
+    // thread when the class is saturated, or on a worker when the budget ran
+    // out in the queue.
+    void submit(RouteClass route_class, Job job, Reject reject);
+
+    json getStats() const;
+
+private:
+    struct Pending {
+        Job job;
+        Reject reject;
+        std::chrono::steady_clock::time_point queued_at;
+        std::chrono::steady_clock::time_point deadline;
+        double expected_wait_ms;
+    };
+
+    struct ClassState {
+        AdmissionLimits limits;
+        int workers = 0;
+        int running = 0;
+        std::deque<Pending> queue;
+        std::condition_variable work;
+        double avg_service_ms = 0;
+
+        unsigned long long admitted = 0;
+        unsigned long long queued = 0;
+        unsigned long long rejected_queue_full = 0;
+        unsigned long long rejected_over_budget = 0;
+        unsigned long long dropped_deadline = 0;
+    };
+
+    AdmissionController();
+    void runWorker(RouteClass route_class);
+    int retryAfter(const ClassState& state, double expected_wait_ms) const;
+
+    mutable std::mutex lock;
+    std::array<ClassState, 4> classes;
+};
+
+const char* routeClassName(RouteClass route_class);
+std::optional<RouteClass> parseRouteClass(const std::string& name);
+
+#endif // ADMISSION_CONTROLLER_H
@@ -0,0 +1,131 @@
+#ifndef CATALOG_FACETS_H
+#define CATALOG_FACETS_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "database/db_connection.h"
+#include "index/roaring_bitmap.h"
+#include "models/book.h"
+#include "snapshot/snapshot_file.h"
+
+// In-memory bitmap indexes over the catalog for faceted filtering.
+//
+// Every book gets a slot numbered in title order, and each facet value
+// (category, author, status bucket, publication year) holds a compressed
+// bitmap of its slots. A filter resolves to a bitmap intersection whose
+// iteration order is already title order, and each facet's counts are the
+// sizes of its value bitmaps intersected with the other facets' filters.
+//
+// The Book and Borrow write paths keep the bitmaps current. Books added after
+// the last rebuild sort after the rest until the next one. Book ids are per
+// branch, so each Database has its own index.
+class CatalogFacets {
+public:
+    struct Filter {
+        std::vector<std::string> categories;   // any of
+        std::vector<std::string> statuses;     // any of Book::getStatus() values
+        int year_from = 0;                     // inclusive; 0 leaves the range open
+        int year_to = 0;
+        std::string author;
+    };
+
+    struct Result {
+        uint64_t total = 0;
+        std::vector<int> book_ids;   // the requested page, in title order
+        json facets;
+    };
+
+    static CatalogFacets& of(const Database& db);
+
+    // Replaces the index with one built from the books table
+    bool rebuild(Database& db);
+
+    // Rebuilds every `interval` on a detached thread, picking up catalog
+    // changes made outside the API and restoring title order
+    void startRebuildJob(Database& db, std::chrono::minutes interval);
+
+    // Write-path maintenance, with the row as read back after the write
+    void upsert(const Book& book);
+    void remove(int book_id);
+    void adjustAvailable(int book_id, int delta);
+
+    // Warm restart: the live slots in title order and the value names
+    void save(SnapshotWriter& snapshot) const;
+    bool restore(const SnapshotReader& snapshot);
+    std::vector<int> bookIds() const;
+
+    Result query(const Filter& filter, size_t offset, size_t limit) const;
+
+    json getStats() const;
+
+    static constexpr size_t topAuthors = 10;
+
+private:
+    enum Dimension { CategoryDim, StatusDim, YearDim, AuthorDim, DimensionCount };
+
+    struct Slot {
+        int book_id = 0;
+        int available = 0;
+        int total = 0;
+        uint32_t category = 0;
+        uint32_t author = 0;
+        int year = 0;
+    };
+
+    struct SlotRecord {
+        int32_t book_id;
+        int32_t available;
+        int32_t total;
+        int32_t year;
+        uint32_t category;
+        uint32_t author;
+    };
+
+    // Interned facet values with one bitmap each
+    struct Dictionary {
+        std::vector<std::string> names;
+        std::unordered_map<std::string, uint32_t> ids;
+        std::vector<RoaringBitmap> slots;
+
+        uint32_t intern(const std::string& name);
+        const RoaringBitmap* find(const std::string& name) const;
+    };
+
+    struct Model {
+        std::vector<Slot> slots;
+        std::unordered_map<int, uint32_t> slot_of;   // book id -> slot
+        RoaringBitmap live;
+        Dictionary categories;
+        Dictionary authors;
+        RoaringBitmap statuses[3];
+        std::map<int, RoaringBitmap> years;
+    };
+
+    CatalogFacets() = default;
+
+    static size_t statusBucket(int available, int total);
+    static void place(Model& model, const Book& book);
+    static void index(Model& model, uint32_t slot);
+    static void unplace(Model& model, uint32_t slot);
+    static RoaringBitmap matching(const Model& model, const Filter& filter, Dimension dimension, bool& filtered);
+    static json facetCounts(const Model& model, const RoaringBitmap* bases[DimensionCount]);
+
+    mutable std::shared_mutex lock;
+    Model model;
+
+    // Books written while a rebuild is streaming, re-read before the swap
+    bool rebuilding = false;
+    std::unordered_set<int> pending;
+
+    mutable std::atomic<unsigned long long> queries{0};
+    std::atomic<unsigned long long> rebuilds{0};
+    std::atomic<long long> last_rebuild_ms{0};
+};
+
+#endif // CATALOG_FACETS_H
@@ -0,0 +1,186 @@
+#ifndef CIRCULATION_COLUMNS_H
+#define CIRCULATION_COLUMNS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "database/db_connection.h"
+
+// Column-oriented in-memory copy of the loan history for ad-hoc circulation
+// analytics (POST /api/reports/query).
+//
+// Each loan is one position in a set of parallel arrays sorted by loan id.
+// Status is a small fixed code, category is an index into a per-branch
+// dictionary, and the member is reduced to the month they joined (their
+// cohort). Dates are day numbers (days since 1970-01-01) and months are
+// year * 12 + month - 1, so filters and group keys are integer arithmetic.
+//
+// A query walks the arrays in blocks: a filter pass builds a keep mask, a key
+// pass turns the grouped columns into one dense group number, and an
+// aggregate pass adds each row into its group, with filtered rows sent to a
+// spare slot. The passes have no branches on row data, so the compiler
+// vectorizes them, and large tables are split across threads that each own
+// their accumulators.
+//
+// The store is built from a full scan in the background and then refreshed
+// from updated_at and the delete tombstones (see delta_sync), so loans
+// written by any instance or by plain SQL show up within one refresh
+// interval. Loan ids are per branch, so each Database has its own store.
+class CirculationColumns {
+public:
+    enum class Dimension { Status, Category, Year, Month, CohortYear, CohortMonth };
+
+    struct Query {
+        std::vector<Dimension> group_by;
+        std::vector<std::string> statuses;          // any of; empty matches all
+        std::vector<std::string> categories;        // any of; empty matches all
+        int32_t from_day = INT32_MIN;               // borrow date range, inclusive
+        int32_t to_day = INT32_MAX;
+        int32_t cohort_from = INT32_MIN;            // join month range, inclusive
+        int32_t cohort_to = INT32_MAX;
+    };
+
+    struct Totals {
+        long long loans = 0;
+        long long fine_cents = 0;
+        long long returned = 0;
+        long long loan_days = 0;        // summed over returned loans
+        long long late = 0;             // returned after, or still out past, the due date
+
+        void add(const Totals& other);
+    };
+
+    struct Result {
+        std::string error;              // set when the query is rejected
+        std::map<std::vector<std::string>, Totals> groups;   // labels in group_by order
+        uint64_t rows = 0;              // loans scanned
+        double elapsed_ms = 0;
+    };
+
+    static CirculationColumns& of(const Database& db);
+
+    static std::optional<Dimension> parseDimension(const std::string& name);
+    static const char* dimensionName(Dimension dimension);
+
+    // "YYYY-MM-DD" to a day number, "YYYY-MM" to a month number
+    static std::optional<int32_t> dayNumber(const std::string& date);
+    static std::optional<int32_t> monthNumber(const std::string& month);
+
+    // False until the first build has finished
+    bool ready() const;
+
+    Result run(const Query& query) const;
+
+    // Replaces the store with one built from the loan, book and member tables
+    bool rebuild(Database& db);
+
+    // Applies rows changed since the last build or refresh
+    bool refresh(Database& db);
+
+    // Builds now, then refreshes every `interval` and rebuilds daily to
+    // compact deleted loans, on a detached thread
+    void startRefreshJob(Database& db, std::chrono::seconds interval);
+
+    json getStats() const;
+
+    static constexpr size_t blockRows = 2048;
+    static constexpr size_t maxGroups = size_t(1) << 18;
+    // Tables smaller than this per thread are scanned on the calling thread
+    static constexpr size_t rowsPerThread = size_t(1) << 20;
+
+private:
+    static constexpr int32_t openDay = INT32_MAX;   // return_day of a loan still out
+    enum Status : uint8_t { Active, Returned, Overdue, Deleted };
+
+    // One loan row as read from MySQL
+    struct Loan {
+        int32_t id = 0;
+        int32_t member = 0;
+        int32_t book = 0;
+        int32_t borrow_day = 0;
+        int32_t due_day = 0;
+        int32_t return_day = openDay;
+        int32_t fine_cents = 0;
+        uint8_t status = Active;
+    };
+
+    struct Columns {
+        std::vector<int32_t> id;
+        std::vector<int32_t> member;
+        std::vector<int32_t> book;
+        std::vector<int32_t> borrow_day;
+        std::vector<int32_t> due_day;
+        std::vector<int32_t> return_day;
+        std::vector<int32_t> fine_cents;
+        std::vector<uint16_t> borrow_month;
+        std::vector<uint16_t> cohort;
+        std::vector<uint16_t> category;
+        std::vector<uint8_t> status;
+
+        size_t size() const { return id.size(); }
+        void insert(size_t row, const Loan& loan);
+        void set(size_t row, const Loan& loan);
+        void shrink();
+        size_t memoryBytes() const;
+    };
+
+    struct Model {
+        Columns loans;
+        std::vector<std::string> category_names;
+        std::unordered_map<std::string, uint16_t> category_codes;
+        std::vector<uint16_t> book_category;    // by book id
+        std::vector<uint16_t> member_cohort;    // by member id; 0 when unknown
+        uint16_t borrow_min = UINT16_MAX;       // month ranges, for dense group keys
+        uint16_t borrow_max = 0;
+        uint16_t cohort_min = UINT16_MAX;
+        uint16_t cohort_max = 0;
+        uint64_t deleted = 0;
+        std::string since;                      // delta_sync token of the last read
+        bool built = false;
+    };
+
+    // Validated query: bounds and dense group key layout
+    struct Plan {
+        struct Key {
+            Dimension dimension;
+            uint32_t base;
+            uint32_t cardinality;
+        };
+        std::vector<Key> keys;
+        uint32_t groups = 1;
+        uint32_t status_mask = 0;
+        std::vector<uint8_t> category_ok;       // empty when categories are not filtered
+        int32_t from_day, to_day;
+        int32_t cohort_from, cohort_to;
+        int32_t today;
+    };
+
+    CirculationColumns() = default;
+
+    static bool parseLoan(char** row, unsigned long* lengths, Loan& loan);
+    static uint16_t categoryCode(Model& model, const std::string& name);
+    static void setBookCategory(Model& model, int book_id, uint16_t code);
+    static void setMemberCohort(Model& model, int member_id, uint16_t month);
+    static void derive(Model& model, size_t row);
+    static void upsert(Model& model, const Loan& loan);
+    static bool plan(const Model& model, const Query& query, Plan& out, std::string& error);
+    static void scan(const Columns& loans, const Plan& plan, size_t begin, size_t end, std::vector<Totals>& groups);
+    static std::vector<std::string> labels(const Model& model, const Plan& plan, uint32_t group);
+
+    mutable std::shared_mutex lock;
+    Model model;
+
+    mutable std::atomic<unsigned long long> queries{0};
+    mutable std::atomic<long long> last_query_us{0};
+    std::atomic<unsigned long long> rebuilds{0};
+    std::atomic<unsigned long long> refreshes{0};
+    std::atomic<long long> last_rebuild_ms{0};
+};
+
+#endif // CIRCULATION_COLUMNS_H
@@ -0,0 +1,75 @@
+#ifndef CO_BORROW_INDEX_H
+#define CO_BORROW_INDEX_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "database/db_connection.h"
+
+// "Members who borrowed this also borrowed" model: a sparse book-to-book
+// co-borrow count matrix with a precomputed top-K list per book.
+//
+// Two books co-occur when the same member borrows them within a window of
+// consecutive loans. Checkouts update the matrix incrementally; a full
+// rebuild streams the loan history in the background and swaps the result
+// in. Memory is bounded: each book tracks at most `maxCandidates`
+// neighbours (a new one replaces the weakest and takes over its count) and
+// each member's recent window holds at most `windowSize` books. Book ids are per branch, so each Database has
+// its own index.
+class CoBorrowIndex {
+public:
+    struct Related {
+        int book_id;
+        int co_borrows;
+        double score;
+    };
+
+    static CoBorrowIndex& of(const Database& db);
+
+    void recordCheckout(int member_id, int book_id);
+
+    // Served from the precomputed list: no database access
+    std::vector<Related> related(int book_id, size_t limit) const;
+
+    // Replaces the model with one built from the full loan history
+    bool rebuild(Database& db);
+
+    // Rebuilds now and then every `interval` on a detached thread
+    void startRebuildJob(Database& db, std::chrono::minutes interval);
+
+    json getStats() const;
+
+    static constexpr size_t topK = 10;
+    static constexpr size_t maxCandidates = 32;
+    static constexpr size_t windowSize = 10;
+
+private:
+    struct Model {
+        std::unordered_map<int, std::unordered_map<int, int>> pairs;
+        std::unordered_map<int, int> loans_by_book;
+        std::unordered_map<int, std::vector<int>> recent_by_member;
+        std::unordered_map<int, std::shared_ptr<const std::vector<Related>>> top;
+    };
+
+    CoBorrowIndex() = default;
+    static void addLoan(Model& model, int member_id, int book_id, std::vector<int>& touched);
+    static void refreshTop(Model& model, int book_id);
+
+    mutable std::shared_mutex lock;
+    Model model;
+
+    // Checkouts that arrive while a rebuild is streaming, replayed before the swap
+    bool rebuilding = false;
+    std::vector<std::pair<int, int>> pending;
+
+    mutable std::atomic<unsigned long long> lookups{0};
+    std::atomic<unsigned long long> rebuilds{0};
+    std::atomic<long long> last_rebuild_ms{0};
+};
+
+#endif // CO_BORROW_INDEX_H
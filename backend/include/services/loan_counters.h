@@ -0,0 +1,86 @@
+#ifndef LOAN_COUNTERS_H
+#define LOAN_COUNTERS_H
+
+#include <string>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "database/db_connection.h"
+#include "snapshot/snapshot_file.h"
+
+// Per-member count of outstanding loans (status other than 'returned') and
+// member status, kept in memory so checkout can enforce the borrow limit
+// without a COUNT(*) per request. Rebuilt from borrow_records at startup and
+// maintained by the Borrow and Member write paths. Member ids are only
+// unique within one branch database, so each Database has its own counters.
+class LoanCounters {
+public:
+    enum class Admission { Granted, LimitReached, MemberNotActive, UnknownMember };
+    
+    static LoanCounters& of(const Database& db);
+    
+    bool rebuild(Database& db);
+    // Starts tracking a member that is not tracked yet; a tracked one is
+    // left alone. False if the member does not exist.
+    bool loadMember(Database& db, int member_id);
+    // Brings a member's count in line with the committed loans after a
+    // change made elsewhere, keeping the reservations still in flight
+    bool reconcile(Database& db, int member_id);
+    
+    // Warm restart
+    void save(SnapshotWriter& snapshot) const;
+    bool restore(const SnapshotReader& snapshot);
+    std::vector<int> memberIds() const;
+    
+    // Atomically checks status and limit and takes one slot on success.
+    // A granted slot must be confirmed once the loan is committed, or
+    // cancelled if the checkout is not recorded.
+    Admission tryReserve(int member_id, int limit);
+    void confirm(int member_id);
+    void cancel(int member_id);
+    // A committed loan ended
+    void release(int member_id);
+    void adjust(int member_id, int delta);
+    
+    // Only updates members already tracked
+    void setMemberStatus(int member_id, const std::string& status);
+    void removeMember(int member_id);
+    
+    int getActiveLoans(int member_id) const;
+    json getStats() const;
+
+private:
+    struct MemberState {
+        // Committed outstanding loans plus the pending reservations. Both
+        // change under `update`; readers only load them.
+        std::atomic<int> active{0};
+        std::atomic<int> pending{0};
+        std::atomic<bool> can_borrow{true};
+        std::mutex update;
+        // Bumped whenever a committed loan is counted in or out here, so a
+        // reconcile can tell its database count may already be out of date
+        unsigned settled = 0;
+    };
+    
+    struct MemberRecord {
+        int32_t member_id;
+        int32_t active;
+        int32_t can_borrow;
+    };
+    
+    LoanCounters() = default;
+    std::shared_ptr<MemberState> find(int member_id) const;
+    // Status and committed outstanding loans; false if the member does not
+    // exist or the read failed
+    static bool readMember(Database& db, int member_id, bool& can_borrow, int& active);
+    
+    mutable std::shared_mutex lock;
+    std::unordered_map<int, std::shared_ptr<MemberState>> members;
+    std::atomic<unsigned long long> granted{0};
+    std::atomic<unsigned long long> rejected{0};
+};
+
+#endif // LOAN_COUNTERS_H
@@ -0,0 +1,107 @@
+#ifndef NAME_DIRECTORY_H
+#define NAME_DIRECTORY_H
+
+#include <atomic>
+#include <chrono>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "database/db_connection.h"
+
+// Member names and book titles by id, so loan reads need not join the
+// members and books tables just to show them.
+//
+// Names are cached as they are first needed: the ids a read is missing are
+// fetched by primary key in one batch. The Member and Book write paths and
+// the binlog consumer overwrite entries. A fetched name only replaces an
+// entry set before the fetch started, so a read racing a rename cannot bring
+// the old name back. Entries older than the TTL are fetched again by the
+// next read that needs them, which bounds how long a rename made elsewhere
+// (another instance, plain SQL) stays unseen when the binlog is not
+// followed. Each table is split into shards with their own reader-writer
+// lock, so lookups from concurrent requests do not contend. Ids are per
+// branch, so each Database has its own directory.
+class NameDirectory {
+public:
+    static NameDirectory& of(const Database& db);
+
+    // Zero keeps names until a write or the binlog changes them
+    static void setTtl(std::chrono::seconds ttl);
+
+    // Write paths, after the change is committed
+    void setMember(int member_id, const std::string& name);
+    void setBook(int book_id, const std::string& title);
+    void removeMember(int member_id);
+    void removeBook(int book_id);
+
+    // Forgets everything; names are fetched again as reads need them
+    void clear();
+
+    // Caches whichever of these ids are not cached yet or have outlived the
+    // TTL; ids with no row are left out
+    void prefetch(Database& db, const std::vector<int>& member_ids, const std::vector<int>& book_ids);
+
+    // Re-reads these ids, replacing what is cached and dropping ids that no
+    // longer exist (changes made elsewhere)
+    void reloadMembers(Database& db, const std::vector<int>& member_ids);
+    void reloadBooks(Database& db, const std::vector<int>& book_ids);
+
+    // "" when the id is not cached
+    std::string memberName(int member_id) const;
+    std::string bookTitle(int book_id) const;
+
+    json getStats() const;
+
+    static constexpr size_t shardCount = 16;
+    // Ids per IN list when fetching
+    static constexpr size_t fetchBatch = 1000;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    class Table {
+    public:
+        // A name as of `as_of`; kept unless the entry was set later
+        void set(int id, const std::string& name, Clock::time_point as_of);
+        // Drops the entry unless it was set at or after `as_of`
+        void remove(int id, Clock::time_point as_of);
+        std::string find(int id) const;
+        // Distinct ids with no entry, or one set before `stale_before`
+        std::vector<int> missing(const std::vector<int>& ids, Clock::time_point stale_before) const;
+        void clear();
+        size_t size() const;
+
+    private:
+        struct Name {
+            std::string name;
+            Clock::time_point as_of;
+        };
+
+        struct Shard {
+            mutable std::shared_mutex lock;
+            std::unordered_map<int, Name> names;
+        };
+
+        Shard& shardOf(int id) { return shards[unsigned(id) % shardCount]; }
+        const Shard& shardOf(int id) const { return shards[unsigned(id) % shardCount]; }
+
+        Shard shards[shardCount];
+    };
+
+    NameDirectory() = default;
+
+    // SELECT id, <column> FROM <table> WHERE id IN (...) in batches. Ids
+    // with no row are dropped; so are all of them when `reload` and the
+    // read fails.
+    void fetch(Database& db, Table& table, const char* table_name, const char* column,
+               const std::vector<int>& ids, bool reload);
+
+    Table members;
+    Table books;
+
+    std::atomic<unsigned long long> fetched{0};
+    std::atomic<unsigned long long> fetches{0};
+};
+
+#endif // NAME_DIRECTORY_H
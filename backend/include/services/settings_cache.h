@@ -0,0 +1,53 @@
+#ifndef SETTINGS_CACHE_H
+#define SETTINGS_CACHE_H
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "database/db_connection.h"
+
+// Circulation policy fields of the settings row
+struct CirculationPolicy {
+    int borrow_limit = 5;
+    int borrow_duration_days = 14;
+    double late_fee_per_day = 0.5;
+    bool enable_fine = true;
+};
+
+// Immutable view of the settings row. `body` is the serialized row served
+// by GET /api/settings.
+struct SettingsSnapshot {
+    CirculationPolicy policy;
+    json row;
+    std::string body;
+    bool loaded = false;
+};
+
+// Settings snapshot loaded at startup and replaced after PUT /api/settings.
+// Readers take the current snapshot with a single atomic load; writers build
+// a new one and swap it in. Replaced snapshots are retained rather than
+// freed so a reader can never observe a dangling pointer; settings change
+// rarely, so this costs a few hundred bytes per update.
+class SettingsCache {
+private:
+    std::atomic<const SettingsSnapshot*> current;
+    std::mutex writer_lock;
+    std::vector<std::unique_ptr<const SettingsSnapshot>> snapshots;
+    
+    SettingsCache();
+
+public:
+    static SettingsCache& instance();
+    
+    bool load(Database& db);
+    
+    const SettingsSnapshot& snapshot() const {
+        return *current.load(std::memory_order_acquire);
+    }
+    const CirculationPolicy& getPolicy() const { return snapshot().policy; }
+    bool isLoaded() const { return snapshot().loaded; }
+};
+
+#endif // SETTINGS_CACHE_H
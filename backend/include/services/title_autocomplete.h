@@ -0,0 +1,116 @@
+#ifndef TITLE_AUTOCOMPLETE_H
+#define TITLE_AUTOCOMPLETE_H
+
+#include <shared_mutex>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "database/db_connection.h"
+#include "models/book.h"
+#include "snapshot/snapshot_file.h"
+
+// Prefix completion over book titles and authors, ranked by how often the
+// books have been borrowed.
+//
+// Titles and distinct authors are kept as one array sorted by lower-cased
+// text, so a prefix is a contiguous range. A max-popularity tree over the
+// array yields that range's top entries in O(limit log n) without a cache per
+// prefix. New and renamed entries go to a small unsorted tail that is scanned
+// on each lookup and merged into the array once it grows past `tailLimit`;
+// the merge also drops the entries of removed and renamed books.
+// Book ids are per branch, so each Database has its own index.
+class TitleAutocomplete {
+public:
+    struct Suggestion {
+        std::string text;
+        bool is_author;
+        int book_id;            // 0 for an author
+        long long borrow_count;
+    };
+
+    static TitleAutocomplete& of(const Database& db);
+
+    // Loads every title and author with its loan count
+    bool rebuild(Database& db);
+
+    void upsert(const Book& book);
+    void remove(int book_id);
+    void recordBorrow(int book_id);
+    void setLoans(int book_id, long long loans);
+
+    // Warm restart: live entries with their rank, and each book's entries
+    void save(SnapshotWriter& snapshot) const;
+    bool restore(const SnapshotReader& snapshot);
+
+    std::vector<Suggestion> complete(const std::string& prefix, size_t limit) const;
+
+    json getStats() const;
+
+    static constexpr size_t tailLimit = 1024;
+
+private:
+    static constexpr uint32_t unsorted = UINT32_MAX;
+
+    struct Entry {
+        std::string key;        // lower-cased text
+        std::string text;
+        int book_id;            // 0 for an author
+        long long popularity;   // loans; -1 once removed
+        uint32_t position;      // index in `sorted`, or `unsorted` while in the tail
+    };
+
+    struct BookRef {
+        uint32_t title_entry;
+        std::string author_key;
+        long long loans;
+    };
+
+    struct AuthorRef {
+        uint32_t entry;
+        int books;
+    };
+
+    struct EntryRecord {
+        int32_t book_id;
+        int32_t padding;
+        int64_t popularity;
+    };
+
+    struct BookRecord {
+        int32_t book_id;
+        uint32_t title_entry;
+        uint32_t author_entry;
+        int32_t padding;
+        int64_t loans;
+    };
+
+    struct Model {
+        std::vector<Entry> entries;        // removed entries stay as tombstones until the next merge
+        std::vector<uint32_t> sorted;      // live entry ids by key
+        std::vector<uint32_t> tree;        // entry id with the highest popularity per node
+        std::vector<uint32_t> tail;        // entries added since the last merge
+        std::unordered_map<int, BookRef> books;
+        std::unordered_map<std::string, AuthorRef> authors;
+    };
+
+    TitleAutocomplete() = default;
+
+    static std::string normalize(const std::string& text);
+    static uint32_t addEntry(Model& model, const std::string& text, int book_id, long long popularity);
+    static void setPopularity(Model& model, uint32_t entry, long long popularity);
+    static void addBook(Model& model, int book_id, const std::string& title, const std::string& author, long long loans);
+    static void removeBook(Model& model, int book_id);
+    static void mergeTail(Model& model);
+    static bool needsMerge(const Model& model);
+    static void buildTree(Model& model);
+    static uint32_t best(const Model& model, size_t begin, size_t end);
+
+    mutable std::shared_mutex lock;
+    Model model;
+
+    mutable std::atomic<unsigned long long> lookups{0};
+    std::atomic<unsigned long long> merges{0};
+};
+
+#endif // TITLE_AUTOCOMPLETE_H
@@ -0,0 +1,95 @@
+#ifndef SNAPSHOT_FILE_H
+#define SNAPSHOT_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Versioned snapshot of one branch's in-memory state.
+//
+// The file is a fixed header followed by named, 8-byte aligned sections of
+// raw records and a section table. Readers map it read-only and use the
+// records in place; nothing is parsed. A file from another format version,
+// another branch, or with a bad checksum is rejected, and the caller falls
+// back to loading from MySQL.
+//
+// `as_of` is the database clock when the snapshot was started. Rows with a
+// later updated_at may be missing from it.
+class SnapshotWriter {
+public:
+    SnapshotWriter(int branch_id, const std::string& as_of);
+
+    // Written to `path`.tmp and renamed over `path` by finish()
+    bool begin(const std::string& path);
+    bool finish();
+
+    void addSection(const std::string& name, const void* data, size_t bytes);
+
+    template <typename T>
+    void addArray(const std::string& name, const std::vector<T>& records) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot records are copied as bytes");
+        addSection(name, records.data(), records.size() * sizeof(T));
+    }
+
+    // Count, offsets, then the characters
+    void addStrings(const std::string& name, const std::vector<std::string_view>& strings);
+
+private:
+    struct Entry {
+        std::string name;
+        uint64_t offset;
+        uint64_t bytes;
+    };
+
+    void write(const void* data, size_t bytes);
+
+    int branch_id;
+    std::string as_of;
+    std::string path;
+    std::ofstream out;
+    std::vector<Entry> sections;
+    uint64_t position = 0;
+    uint64_t checksum;
+    bool failed = false;
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader() = default;
+    ~SnapshotReader();
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    bool open(const std::string& path, int branch_id);
+
+    const std::string& asOf() const { return as_of; }
+    long long createdAt() const { return created_at; }
+    size_t size() const { return length; }
+
+    // Empty when the section is missing
+    std::string_view section(const std::string& name) const;
+
+    template <typename T>
+    std::pair<const T*, size_t> array(const std::string& name) const {
+        std::string_view bytes = section(name);
+        return {reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T)};
+    }
+
+    std::vector<std::string_view> strings(const std::string& name) const;
+
+    static constexpr uint32_t version = 1;
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    std::string as_of;
+    long long created_at = 0;
+    std::vector<std::pair<std::string, std::string_view>> sections;
+};
+
+#endif // SNAPSHOT_FILE_H
@@ -0,0 +1,35 @@
+#ifndef WARM_RESTART_H
+#define WARM_RESTART_H
+
+#include <chrono>
+#include <string>
+#include "database/db_connection.h"
+
+// Warm restarts from snapshot files.
+//
+// A branch's loan counters, facet bitmaps and autocomplete index are saved
+// periodically to `<dir>/branch-<id>.snap`. At startup the file is mapped and
+// the indexes are filled from its records instead of from full table scans,
+// then rows whose updated_at is newer than the snapshot are re-read. When
+// there is no usable snapshot the caller rebuilds from MySQL as before.
+namespace warm_restart {
+
+// Rows changed this long before a snapshot was started are re-read as well,
+// covering writes that were committed but not yet applied in memory
+constexpr int catchUpSlackSeconds = 60;
+
+std::string pathFor(const std::string& dir, int branch_id);
+
+bool save(Database& db, int branch_id, const std::string& dir);
+void startSaveJob(Database& db, int branch_id, const std::string& dir, std::chrono::minutes interval);
+
+bool restore(Database& db, int branch_id, const std::string& dir);
+
+// Re-reads books, members and loans updated since a snapshot's as_of time
+// ("YYYY-MM-DD HH:MM:SS", less the slack) into the in-memory state, and drops
+// books and members that no longer exist
+bool catchUp(Database& db, const std::string& as_of);
+
+} // namespace warm_restart
+
+#endif // WARM_RESTART_H
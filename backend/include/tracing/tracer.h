@@ -0,0 +1,99 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Sampled per-request span tracing.
+//
+// A Tracer::Request scope in the route handler decides whether the request
+// is sampled and, if so, makes its trace current on the handling thread.
+// Tracer::Span scopes anywhere below it (database calls, JSON building) add
+// timed events to that trace; with no sampled request they cost one
+// thread-local load. Finished traces go into a ring buffer that exports as
+// Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+class Tracer {
+public:
+    struct Event {
+        const char* name;
+        const char* category;
+        std::int64_t start_us;
+        std::int64_t duration_us;
+        json args;
+    };
+
+    struct Trace {
+        unsigned long long sequence = 0;
+        std::string request_id;
+        std::string name;
+        std::vector<Event> events;
+    };
+
+    class Request {
+    public:
+        // `request_id` is the caller's X-Request-Id; one is generated if empty.
+        // It is kept for the log lines of the request whether or not it is
+        // sampled.
+        Request(const char* name, const std::string& request_id);
+        ~Request();
+        Request(const Request&) = delete;
+        Request& operator=(const Request&) = delete;
+
+        explicit operator bool() const { return trace != nullptr; }
+
+    private:
+        Trace* trace = nullptr;
+    };
+
+    class Span {
+    public:
+        Span(const char* name, const char* category);
+        ~Span();
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        explicit operator bool() const { return trace != nullptr; }
+        void arg(const char* key, json value);
+
+    private:
+        Trace* trace;
+        size_t index = 0;
+    };
+
+    static Tracer& instance();
+
+    // Id of the request running on this thread; empty outside a Request
+    static const std::string& currentRequestId();
+
+    void setSampleRate(double rate);
+    double getSampleRate() const { return sample_rate.load(std::memory_order_relaxed); }
+
+    json exportChromeTrace() const;
+    void clear();
+    json getStats() const;
+
+private:
+    static constexpr size_t capacity = 256;
+
+    Tracer() = default;
+    bool shouldSample();
+    void finish(Trace* trace);
+    static std::int64_t nowMicros();
+
+    std::atomic<double> sample_rate{0.0};
+    std::atomic<unsigned long long> next_sequence{1};
+    std::atomic<unsigned long long> next_request{1};
+    std::atomic<unsigned long long> sampled{0};
+
+    mutable std::mutex lock;
+    std::vector<Trace> ring;
+    size_t ring_next = 0;
+};
+
+#endif // TRACER_H
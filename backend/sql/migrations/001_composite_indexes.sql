@@ -0,0 +1,22 @@
+-- Composite indexes matching the query shapes emitted by the models.
+-- Apply to databases created from an earlier schema.sql.
+USE library_db;
+
+ALTER TABLE books
+    DROP INDEX idx_category,
+    ADD INDEX idx_category_title (category, title);
+
+ALTER TABLE members
+    DROP INDEX idx_status,
+    ADD INDEX idx_status_name (status, name);
+
+ALTER TABLE borrow_records
+    ADD INDEX idx_member_borrow_date (member_id, borrow_date, status),
+    ADD INDEX idx_status_due_date (status, due_date),
+    ADD INDEX idx_status_return_due (status, return_date, due_date),
+    ADD INDEX idx_borrow_date_status (borrow_date, status);
+
+ALTER TABLE borrow_records
+    DROP INDEX idx_member,
+    DROP INDEX idx_status,
+    DROP INDEX idx_due_date;
@@ -0,0 +1,13 @@
+-- updated_at indexes for the warm-restart catch-up, which re-reads the rows
+-- changed since a snapshot was taken.
+-- Apply to databases created from an earlier schema.sql.
+USE library_db;
+
+ALTER TABLE books
+    ADD INDEX idx_updated_at (updated_at);
+
+ALTER TABLE members
+    ADD INDEX idx_updated_at (updated_at);
+
+ALTER TABLE borrow_records
+    ADD INDEX idx_updated_at (updated_at);
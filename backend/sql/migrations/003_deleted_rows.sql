@@ -0,0 +1,31 @@
+-- Tombstones for ?since= delta sync on /api/books, /api/members and
+-- /api/borrowing. ON DELETE CASCADE does not fire triggers, so deleting a
+-- book or member records its loans first.
+-- Apply after 002_updated_at_indexes.sql.
+USE library_db;
+
+CREATE TABLE deleted_rows (
+    id BIGINT AUTO_INCREMENT PRIMARY KEY,
+    table_name ENUM('books', 'members', 'borrow_records') NOT NULL,
+    row_id INT NOT NULL,
+    deleted_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    INDEX idx_table_deleted (table_name, deleted_at),
+    INDEX idx_deleted_at (deleted_at)
+);
+
+CREATE TRIGGER books_deleted AFTER DELETE ON books FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id) VALUES ('books', OLD.id);
+
+CREATE TRIGGER books_loans_deleted BEFORE DELETE ON books FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id)
+    SELECT 'borrow_records', id FROM borrow_records WHERE book_id = OLD.id;
+
+CREATE TRIGGER members_deleted AFTER DELETE ON members FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id) VALUES ('members', OLD.id);
+
+CREATE TRIGGER members_loans_deleted BEFORE DELETE ON members FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id)
+    SELECT 'borrow_records', id FROM borrow_records WHERE member_id = OLD.id;
+
+CREATE TRIGGER borrow_records_deleted AFTER DELETE ON borrow_records FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id) VALUES ('borrow_records', OLD.id);
@@ -16,8 +16,9 @@ CREATE TABLE books (
     created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
     updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,
     INDEX idx_title (title),
-    INDEX idx_category (category),
-    INDEX idx_isbn (isbn)
+    INDEX idx_category_title (category, title),
+    INDEX idx_isbn (isbn),
+    INDEX idx_updated_at (updated_at)
 );
 
 -- Members Table
@@ -34,7 +35,8 @@ CREATE TABLE members (
     updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,
     INDEX idx_member_id (member_id),
     INDEX idx_email (email),
-    INDEX idx_status (status)
+    INDEX idx_status_name (status, name),
+    INDEX idx_updated_at (updated_at)
 );
 
 -- Borrowing Records Table
@@ -51,10 +53,18 @@ CREATE TABLE borrow_records (
     updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,
     FOREIGN KEY (member_id) REFERENCES members(id) ON DELETE CASCADE,
     FOREIGN KEY (book_id) REFERENCES books(id) ON DELETE CASCADE,
-    INDEX idx_member (member_id),
+    -- getByMember (ordered by borrow_date) and member stats (covers status)
+    INDEX idx_member_borrow_date (member_id, borrow_date, status),
+    -- getTopBooks grouping
     INDEX idx_book (book_id),
-    INDEX idx_status (status),
-    INDEX idx_due_date (due_date)
+    -- getByStatus ordered by due_date; status counts
+    INDEX idx_status_due_date (status, due_date),
+    -- getOverdue: status + return_date IS NULL, ordered by due_date
+    INDEX idx_status_return_due (status, return_date, due_date),
+    -- getAll ordering and monthly stats (covers status)
+    INDEX idx_borrow_date_status (borrow_date, status),
+    -- ?since= delta sync and warm-restart catch-up
+    INDEX idx_updated_at (updated_at)
 );
 
 -- Settings Table
@@ -73,6 +83,35 @@ CREATE TABLE settings (
     updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP
 );
 
+-- Tombstones for ?since= delta sync, written by the triggers below.
+-- ON DELETE CASCADE does not fire triggers, so deleting a book or member
+-- records its loans first.
+CREATE TABLE deleted_rows (
+    id BIGINT AUTO_INCREMENT PRIMARY KEY,
+    table_name ENUM('books', 'members', 'borrow_records') NOT NULL,
+    row_id INT NOT NULL,
+    deleted_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    INDEX idx_table_deleted (table_name, deleted_at),
+    INDEX idx_deleted_at (deleted_at)
+);
+
+CREATE TRIGGER books_deleted AFTER DELETE ON books FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id) VALUES ('books', OLD.id);
+
+CREATE TRIGGER books_loans_deleted BEFORE DELETE ON books FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id)
+    SELECT 'borrow_records', id FROM borrow_records WHERE book_id = OLD.id;
+
+CREATE TRIGGER members_deleted AFTER DELETE ON members FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id) VALUES ('members', OLD.id);
+
+CREATE TRIGGER members_loans_deleted BEFORE DELETE ON members FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id)
+    SELECT 'borrow_records', id FROM borrow_records WHERE member_id = OLD.id;
+
+CREATE TRIGGER borrow_records_deleted AFTER DELETE ON borrow_records FOR EACH ROW
+    INSERT INTO deleted_rows (table_name, row_id) VALUES ('borrow_records', OLD.id);
+
 -- Sample Data
 INSERT INTO settings (library_name, email, phone, address) VALUES 
 ('Central Library', 'admin@library.com', '+1-555-0100', '123 Library St, City, State 12345');
@@ -0,0 +1,181 @@
+#include "cache/result_cache.h"
+#include "logging/logger.h"
+#include <thread>
+
+ResultCache::Entry& ResultCache::entryFor(const std::string& key) {
+    auto [it, inserted] = entries.try_emplace(key);
+    // Generations are unique across the cache, so an entry erased and made
+    // again never matches a load that started before
+    if (inserted) it->second.generation = ++generations;
+    return it->second;
+}
+
+ResultCache::Entry* ResultCache::currentEntry(const std::string& key, unsigned long long generation) {
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.generation != generation) return nullptr;
+    return &it->second;
+}
+
+// Forgets the value and detaches any load in progress; callers hold `lock`
+void ResultCache::reset(Entry& entry) {
+    entry.value.clear();
+    entry.has_value = false;
+    entry.loading = false;
+    entry.inflight = std::shared_future<std::string>();
+    entry.generation = ++generations;
+}
+
+std::string ResultCache::get(const std::string& key, const Policy& policy, const Loader& loader) {
+    std::shared_future<std::string> pending;
+    std::promise<std::string> promise;
+    unsigned long long generation = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        Entry& entry = entryFor(key);
+        generation = entry.generation;
+        auto now = Clock::now();
+        
+        if (entry.has_value && now < entry.fresh_until) {
+            hits++;
+            return entry.value;
+        }
+        
+        if (entry.has_value && now < entry.stale_until) {
+            stale_hits++;
+            if (!entry.loading) {
+                entry.loading = true;
+                refreshInBackground(key, policy, loader, generation);
+            }
+            return entry.value;
+        }
+        
+        if (entry.loading && entry.inflight.valid()) {
+            coalesced++;
+            pending = entry.inflight;
+        } else {
+            misses++;
+            entry.loading = true;
+            entry.inflight = promise.get_future().share();
+        }
+    }
+    
+    if (pending.valid()) {
+        return pending.get();
+    }
+    return load(key, policy, loader, promise, generation);
+}
+
+std::string ResultCache::load(const std::string& key, const Policy& policy, const Loader& loader,
+                              std::promise<std::string>& promise, unsigned long long generation) {
+    std::string value;
+    bool cacheable = false;
+    try {
+        cacheable = loader(value);
+    } catch (...) {
+        load_failures++;
+        std::lock_guard<std::mutex> guard(lock);
+        if (Entry* entry = currentEntry(key, generation)) {
+            entry->loading = false;
+            entry->inflight = std::shared_future<std::string>();
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+    
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!cacheable) load_failures++;
+        if (Entry* entry = currentEntry(key, generation)) {
+            if (cacheable) {
+                auto now = Clock::now();
+                entry->value = value;
+                entry->has_value = true;
+                entry->fresh_until = now + policy.ttl;
+                entry->stale_until = entry->fresh_until + policy.stale_while_revalidate;
+            }
+            entry->loading = false;
+            entry->inflight = std::shared_future<std::string>();
+        }
+    }
+    // Requests that joined before an invalidation still get this value; later
+    // ones started a load of their own
+    promise.set_value(value);
+    return value;
+}
+
+void ResultCache::refreshInBackground(const std::string& key, const Policy& policy, const Loader& loader,
+                                      unsigned long long generation) {
+    refreshes++;
+    // The caller holds `lock` and has marked the entry as loading
+    std::thread([this, key, policy, loader, generation]() {
+        std::string value;
+        bool cacheable = false;
+        try {
+            cacheable = loader(value);
+        } catch (const std::exception& e) {
+            Logger::error("cache", "Cache refresh failed").field("key", key).field("error", e.what());
+        }
+        
+        std::lock_guard<std::mutex> guard(lock);
+        if (!cacheable) load_failures++;
+        Entry* entry = currentEntry(key, generation);
+        if (!entry) return;
+        if (cacheable) {
+            auto now = Clock::now();
+            entry->value = std::move(value);
+            entry->has_value = true;
+            entry->fresh_until = now + policy.ttl;
+            entry->stale_until = entry->fresh_until + policy.stale_while_revalidate;
+        }
+        entry->loading = false;
+    }).detach();
+}
+
+void ResultCache::invalidate(const std::string& key) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = entries.find(key);
+    if (it == entries.end()) return;
+    if (it->second.loading) {
+        // The load in progress may have read before the write
+        reset(it->second);
+    } else {
+        entries.erase(it);
+    }
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.loading) {
+            reset(it->second);
+            ++it;
+        } else {
+            it = entries.erase(it);
+        }
+    }
+}
+
+void ResultCache::expireAll() {
+    std::lock_guard<std::mutex> guard(lock);
+    auto now = Clock::now();
+    for (auto& [key, entry] : entries) {
+        if (entry.fresh_until > now) entry.fresh_until = now;
+    }
+}
+
+json ResultCache::getStats() const {
+    size_t size;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        size = entries.size();
+    }
+    return json{
+        {"entries", size},
+        {"hits", hits.load()},
+        {"stale_hits", stale_hits.load()},
+        {"misses", misses.load()},
+        {"coalesced", coalesced.load()},
+        {"background_refreshes", refreshes.load()},
+        {"load_failures", load_failures.load()}
+    };
+}
@@ -0,0 +1,371 @@
+#include "cdc/binlog_consumer.h"
+#include "logging/logger.h"
+#include "models/book.h"
+#include "services/catalog_facets.h"
+#include "services/co_borrow_index.h"
+#include "services/loan_counters.h"
+#include "services/name_directory.h"
+#include "services/settings_cache.h"
+#include "services/title_autocomplete.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+const char* const trackedTables[] = {"books", "members", "borrow_records", "settings"};
+
+std::mutex registry_lock;
+std::map<const Database*, std::unique_ptr<BinlogConsumer>>& registry() {
+    static std::map<const Database*, std::unique_ptr<BinlogConsumer>> consumers;
+    return consumers;
+}
+
+long long epochMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string lower(std::string text) {
+    for (char& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return text;
+}
+
+std::string idList(const std::set<int>& ids) {
+    std::stringstream ss;
+    for (auto it = ids.begin(); it != ids.end(); ++it) {
+        ss << (it == ids.begin() ? "" : ",") << *it;
+    }
+    return ss.str();
+}
+
+} // namespace
+
+BinlogConsumer& BinlogConsumer::of(const Database& db) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    auto& consumer = registry()[&db];
+    if (!consumer) consumer.reset(new BinlogConsumer());
+    return *consumer;
+}
+
+json BinlogConsumer::allStats() {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    json stats = json::array();
+    for (const auto& [db, consumer] : registry()) {
+        if (consumer->started) stats.push_back(consumer->getStats());
+    }
+    return stats;
+}
+
+void BinlogConsumer::addListener(Listener listener) {
+    std::lock_guard<std::mutex> guard(lock);
+    listeners.push_back(std::move(listener));
+}
+
+void BinlogConsumer::start(Database& db, int branch, unsigned int replica_server_id, bool settings) {
+    branch_id = branch;
+    server_id = replica_server_id;
+    reload_settings = settings;
+    started = true;
+    std::thread([this, &db] {
+        for (;;) {
+            stream(db);
+            connected = false;
+            reconnects++;
+            std::this_thread::sleep_for(std::chrono::seconds(5));
+        }
+    }).detach();
+}
+
+// End of the binlog; SHOW MASTER STATUS was renamed in MySQL 8.2
+bool BinlogConsumer::currentPosition(MYSQL* connection, std::string& current_file, uint64_t& current_position) {
+    for (const char* query : {"SHOW BINARY LOG STATUS", "SHOW MASTER STATUS"}) {
+        if (mysql_query(connection, query) != 0) continue;
+        MYSQL_RES* res = mysql_store_result(connection);
+        if (!res) continue;
+        MYSQL_ROW row = mysql_fetch_row(res);
+        bool ok = row && row[0] && row[1];
+        if (ok) {
+            current_file = row[0];
+            current_position = std::stoull(row[1]);
+        }
+        mysql_free_result(res);
+        if (ok) return true;
+    }
+    return false;
+}
+
+// One connection's lifetime: returns when the stream breaks
+bool BinlogConsumer::stream(Database& db) {
+    auto fail = [this](const std::string& message) {
+        Logger::error("cdc", "Binlog consumer stopped").field("branch_id", branch_id).field("error", message);
+        std::lock_guard<std::mutex> guard(lock);
+        last_error = message;
+        return false;
+    };
+
+    std::unique_ptr<MYSQL, void (*)(MYSQL*)> connection(db.openPrimaryConnection(), mysql_close);
+    if (!connection) return fail("cannot connect");
+
+    // Declare that checksummed events are understood, and ask for a
+    // heartbeat every second so lag reads 0 when idle
+    const char* setup[] = {
+        "SET @master_binlog_checksum = @@global.binlog_checksum, "
+        "@source_binlog_checksum = @@global.binlog_checksum",
+        "SET @master_heartbeat_period = 1000000000, @source_heartbeat_period = 1000000000"
+    };
+    for (const char* statement : setup) {
+        if (mysql_query(connection.get(), statement) != 0) return fail(mysql_error(connection.get()));
+    }
+
+    std::string resume_file;
+    uint64_t resume_position;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        resume_file = file;
+        resume_position = position;
+    }
+    if (resume_file.empty()) {
+        if (!currentPosition(connection.get(), resume_file, resume_position)) {
+            return fail("binary logging is not enabled or REPLICATION CLIENT is missing");
+        }
+    }
+
+    MYSQL_RPL rpl{};
+    rpl.file_name_length = resume_file.size();
+    rpl.file_name = resume_file.c_str();
+    rpl.start_position = resume_position;
+    rpl.server_id = server_id;
+    if (mysql_binlog_open(connection.get(), &rpl) != 0) {
+        // The resume point may have been purged; start from the end and
+        // rebuild, since changes in between are lost
+        std::string end_file;
+        uint64_t end_position;
+        if (!currentPosition(connection.get(), end_file, end_position) || end_file == resume_file) {
+            return fail(mysql_error(connection.get()));
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        file.clear();
+        resync = true;
+        last_error = "resume point unavailable; restarting from the end of the binlog";
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        file = resume_file;
+        position = resume_position;
+    }
+    connected = true;
+    Logger::info("cdc", "Binlog consumer reading")
+        .field("branch_id", branch_id)
+        .field("file", resume_file)
+        .field("position", resume_position);
+
+    BinlogParser parser;
+    Batch batch;
+    batch.reload = resync;
+    std::string schema = db.getDatabaseName();
+    std::string current_file = resume_file;
+    BinlogParser::Event event;
+    for (;;) {
+        if (mysql_binlog_fetch(connection.get(), &rpl) != 0) {
+            mysql_binlog_close(connection.get(), &rpl);
+            return fail(mysql_error(connection.get()));
+        }
+        if (rpl.size == 0) continue;
+        // The first byte is the packet's OK marker
+        if (!parser.parse(rpl.buffer + 1, rpl.size - 1, event)) {
+            mysql_binlog_close(connection.get(), &rpl);
+            return fail("undecodable event at " + current_file);
+        }
+        events++;
+        if (event.timestamp > 0) last_event_epoch = event.timestamp;
+
+        switch (event.kind) {
+            case BinlogParser::EventKind::Rotate:
+                current_file = event.rotate_file;
+                break;
+            case BinlogParser::EventKind::Rows:
+                collect(schema, event, batch);
+                break;
+            case BinlogParser::EventKind::Query:
+                collect(schema, event, batch);
+                // DDL commits implicitly, without an XID event
+                if (!batch.reload) break;
+                [[fallthrough]];
+            case BinlogParser::EventKind::Commit:
+                if (!batch.empty()) {
+                    apply(db, batch);
+                    resync = false;
+                    transactions++;
+                    rows += batch.rows;
+                }
+                batch = Batch{};
+                lag_ms = std::max(0LL, epochMs() - (long long)event.timestamp * 1000);
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    file = current_file;
+                    position = event.next_position;
+                    last_error.clear();
+                }
+                break;
+            case BinlogParser::EventKind::Heartbeat:
+                // Only sent when there is nothing left to read
+                if (batch.empty()) lag_ms = 0;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void BinlogConsumer::collect(const std::string& schema, const BinlogParser::Event& event, Batch& batch) {
+    if (event.schema != schema) return;
+
+    if (event.kind == BinlogParser::EventKind::Query) {
+        // DDL (or statement-based DML) on a tracked table: rebuild everything
+        std::string query = lower(event.query);
+        for (const char* table : trackedTables) {
+            if (query.find(table) != std::string::npos) {
+                batch.reload = true;
+                batch.tables.insert(table);
+            }
+        }
+        return;
+    }
+
+    batch.rows += event.rows.size();
+    for (const auto& row : event.rows) {
+        bool deleted = row.action == BinlogParser::RowAction::Delete;
+        auto column = [&row](size_t index) -> int {
+            return index < row.columns.size() && row.columns[index] ? int(*row.columns[index]) : 0;
+        };
+        if (event.table == "books") {
+            batch.tables.insert(event.table);
+            (deleted ? batch.deleted_books : batch.books).insert(column(0));
+        } else if (event.table == "members") {
+            batch.tables.insert(event.table);
+            (deleted ? batch.deleted_members : batch.members).insert(column(0));
+            if (!deleted) batch.member_rows.insert(column(0));
+        } else if (event.table == "borrow_records") {
+            // id, member_id, book_id
+            batch.tables.insert(event.table);
+            batch.members.insert(column(1));
+            batch.loan_books.insert(column(2));
+        } else if (event.table == "settings") {
+            batch.tables.insert(event.table);
+            batch.settings = true;
+        }
+    }
+}
+
+void BinlogConsumer::apply(Database& db, const Batch& batch) {
+    // Read back as if this thread had made the write, so replicas that have
+    // not caught up yet are skipped
+    Database::Session session(db, "ts:" + std::to_string(epochMs()));
+    CatalogFacets& facets = CatalogFacets::of(db);
+    TitleAutocomplete& autocomplete = TitleAutocomplete::of(db);
+    LoanCounters& counters = LoanCounters::of(db);
+    NameDirectory& names = NameDirectory::of(db);
+
+    if (batch.reload) {
+        reloads++;
+        Logger::warn("cdc", "Schema change, rebuilding indexes").field("branch_id", branch_id);
+        counters.rebuild(db);
+        facets.rebuild(db);
+        autocomplete.rebuild(db);
+        CoBorrowIndex::of(db).rebuild(db);
+        names.clear();
+    } else {
+        for (int book_id : batch.deleted_books) {
+            facets.remove(book_id);
+            autocomplete.remove(book_id);
+            names.removeBook(book_id);
+        }
+        std::set<int> books;
+        std::set_difference(batch.books.begin(), batch.books.end(), batch.deleted_books.begin(),
+                            batch.deleted_books.end(), std::inserter(books, books.end()));
+        if (!books.empty()) {
+            std::set<int> missing = books;
+            auto rows = Book(&db).getByIds(std::vector<int>(books.begin(), books.end()));
+            if (!rows) {
+                // Dropping the books would be worse than keeping them a bit stale
+                Logger::warn("cdc", "Could not read changed books").field("branch_id", branch_id);
+                missing.clear();
+            }
+            for (const auto& book : rows ? *rows : std::vector<Book>()) {
+                facets.upsert(book);
+                autocomplete.upsert(book);
+                names.setBook(book.getId(), book.getTitle());
+                missing.erase(book.getId());
+            }
+            for (int book_id : missing) {
+                facets.remove(book_id);
+                autocomplete.remove(book_id);
+                names.removeBook(book_id);
+            }
+        }
+
+        // Lifetime loan counts rank the autocomplete entries
+        if (!batch.loan_books.empty()) {
+            std::unordered_map<int, long long> loans;
+            for (int book_id : batch.loan_books) loans[book_id] = 0;
+            json counts = db.executeRead(
+                "SELECT book_id, COUNT(*) AS loans FROM borrow_records WHERE book_id IN ("
+                + idList(batch.loan_books) + ") GROUP BY book_id");
+            if (counts.is_array()) {
+                for (const auto& row : counts) loans[row["book_id"].get<int>()] = row["loans"].get<long long>();
+                for (const auto& [book_id, count] : loans) autocomplete.setLoans(book_id, count);
+            }
+        }
+
+        for (int member_id : batch.deleted_members) {
+            counters.removeMember(member_id);
+            names.removeMember(member_id);
+        }
+        std::vector<int> renamed;
+        std::set_difference(batch.member_rows.begin(), batch.member_rows.end(), batch.deleted_members.begin(),
+                            batch.deleted_members.end(), std::back_inserter(renamed));
+        if (!renamed.empty()) names.reloadMembers(db, renamed);
+        for (int member_id : batch.members) {
+            if (batch.deleted_members.count(member_id)) continue;
+            if (!counters.reconcile(db, member_id)) counters.removeMember(member_id);
+        }
+    }
+
+    if (batch.settings && reload_settings) {
+        SettingsCache::instance().load(db);
+    }
+
+    std::vector<Listener> notify;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        notify = listeners;
+    }
+    for (const auto& listener : notify) listener(batch.tables);
+}
+
+json BinlogConsumer::getStats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return {
+        {"branch_id", branch_id},
+        {"server_id", server_id},
+        {"connected", connected.load()},
+        {"file", file},
+        {"position", position},
+        {"lag_ms", lag_ms.load()},
+        {"last_event_epoch", last_event_epoch.load()},
+        {"events", events.load()},
+        {"rows", rows.load()},
+        {"transactions", transactions.load()},
+        {"reloads", reloads.load()},
+        {"reconnects", reconnects.load()},
+        {"last_error", last_error}
+    };
+}
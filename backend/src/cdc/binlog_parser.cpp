@@ -0,0 +1,336 @@
+#include "cdc/binlog_parser.h"
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+const size_t headerSize = 19;
+
+// Event types
+enum : uint8_t {
+    QueryEvent = 2,
+    RotateEvent = 4,
+    FormatDescriptionEvent = 15,
+    XidEvent = 16,
+    TableMapEvent = 19,
+    WriteRowsV1 = 23,
+    UpdateRowsV1 = 24,
+    DeleteRowsV1 = 25,
+    HeartbeatEvent = 27,
+    WriteRowsV2 = 30,
+    UpdateRowsV2 = 31,
+    DeleteRowsV2 = 32,
+    HeartbeatEventV2 = 41
+};
+
+// Column types as they appear in table maps
+enum : uint8_t {
+    TypeDecimal = 0, TypeTiny = 1, TypeShort = 2, TypeLong = 3, TypeFloat = 4, TypeDouble = 5,
+    TypeNull = 6, TypeTimestamp = 7, TypeLongLong = 8, TypeInt24 = 9, TypeDate = 10, TypeTime = 11,
+    TypeDateTime = 12, TypeYear = 13, TypeNewDate = 14, TypeVarchar = 15, TypeBit = 16,
+    TypeTimestamp2 = 17, TypeDateTime2 = 18, TypeTime2 = 19, TypeJson = 245, TypeNewDecimal = 246,
+    TypeEnum = 247, TypeSet = 248, TypeTinyBlob = 249, TypeMediumBlob = 250, TypeLongBlob = 251,
+    TypeBlob = 252, TypeVarString = 253, TypeString = 254, TypeGeometry = 255
+};
+
+uint64_t readLE(const unsigned char* bytes, size_t count) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < count; ++i) value |= uint64_t(bytes[i]) << (8 * i);
+    return value;
+}
+
+// Length-encoded integer; false when it runs past `end`
+bool readPacked(const unsigned char*& cursor, const unsigned char* end, uint64_t& value) {
+    if (cursor >= end) return false;
+    size_t width = *cursor < 0xfb ? 0 : *cursor == 0xfc ? 2 : *cursor == 0xfd ? 3 : *cursor == 0xfe ? 8 : 9;
+    if (width == 9 || cursor + 1 + width > end) return false;
+    value = width == 0 ? *cursor : readLE(cursor + 1, width);
+    cursor += 1 + width;
+    return true;
+}
+
+std::vector<bool> readBitmap(const unsigned char* bytes, size_t bits) {
+    std::vector<bool> bitmap(bits);
+    for (size_t i = 0; i < bits; ++i) bitmap[i] = (bytes[i / 8] >> (i % 8)) & 1;
+    return bitmap;
+}
+
+size_t integerWidth(uint8_t type) {
+    switch (type) {
+        case TypeTiny: case TypeYear: return 1;
+        case TypeShort: return 2;
+        case TypeInt24: return 3;
+        case TypeLong: return 4;
+        case TypeLongLong: return 8;
+        default: return 0;
+    }
+}
+
+size_t decimalBytes(unsigned digits) {
+    static const size_t bytes[] = {0, 1, 1, 2, 2, 3, 3, 4, 4, 4};
+    return digits / 9 * 4 + bytes[digits % 9];
+}
+
+bool ciEquals(const std::string& text, const char* word) {
+    size_t length = std::strlen(word);
+    if (text.size() != length) return false;
+    for (size_t i = 0; i < length; ++i) {
+        if (std::toupper(static_cast<unsigned char>(text[i])) != word[i]) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool BinlogParser::parse(const unsigned char* data, size_t size, Event& event) {
+    event = Event{};
+    if (size < headerSize) return false;
+
+    uint8_t type = data[4];
+    event.timestamp = uint32_t(readLE(data, 4));
+    event.next_position = readLE(data + 13, 4);
+
+    const unsigned char* body = data + headerSize;
+    size_t body_size = size - headerSize;
+    if (type == FormatDescriptionEvent) {
+        event.kind = EventKind::FormatDescription;
+        return parseFormatDescription(body, body_size);
+    }
+    if (body_size < checksum_bytes) return false;
+    body_size -= checksum_bytes;
+
+    switch (type) {
+        case RotateEvent:
+            if (body_size < 8) return false;
+            event.kind = EventKind::Rotate;
+            event.rotate_position = readLE(body, 8);
+            event.rotate_file.assign(reinterpret_cast<const char*>(body + 8), body_size - 8);
+            return true;
+        case TableMapEvent:
+            event.kind = EventKind::TableMap;
+            return parseTableMap(body, body_size);
+        case WriteRowsV1: case UpdateRowsV1: case DeleteRowsV1:
+        case WriteRowsV2: case UpdateRowsV2: case DeleteRowsV2:
+            event.kind = EventKind::Rows;
+            return parseRows(type, body, body_size, event);
+        case XidEvent:
+            event.kind = EventKind::Commit;
+            return true;
+        case QueryEvent:
+            return parseQuery(body, body_size, event);
+        case HeartbeatEvent: case HeartbeatEventV2:
+            event.kind = EventKind::Heartbeat;
+            return true;
+        default:
+            return true;
+    }
+}
+
+// Only the checksum algorithm matters here. It sits just before the
+// event's own 4-byte checksum (servers since 5.6.1).
+bool BinlogParser::parseFormatDescription(const unsigned char* body, size_t size) {
+    if (size < 57 + 5) {
+        checksum_bytes = 0;
+        return size >= 57;
+    }
+    checksum_bytes = body[size - 5] == 1 ? 4 : 0;
+    return true;
+}
+
+bool BinlogParser::parseTableMap(const unsigned char* body, size_t size) {
+    const unsigned char* end = body + size;
+    if (size < 10) return false;
+    uint64_t table_id = readLE(body, 6);
+    const unsigned char* cursor = body + 8;
+
+    TableMap map;
+    size_t schema_length = *cursor++;
+    if (cursor + schema_length + 2 > end) return false;
+    map.schema.assign(reinterpret_cast<const char*>(cursor), schema_length);
+    cursor += schema_length + 1;
+    size_t table_length = *cursor++;
+    if (cursor + table_length + 1 > end) return false;
+    map.table.assign(reinterpret_cast<const char*>(cursor), table_length);
+    cursor += table_length + 1;
+
+    uint64_t columns = 0;
+    if (!readPacked(cursor, end, columns) || cursor + columns > end) return false;
+    map.types.assign(cursor, cursor + columns);
+    cursor += columns;
+
+    uint64_t metadata_length = 0;
+    if (!readPacked(cursor, end, metadata_length) || cursor + metadata_length > end) return false;
+    const unsigned char* metadata_end = cursor + metadata_length;
+    map.metadata.assign(columns, 0);
+    for (size_t i = 0; i < columns; ++i) {
+        switch (map.types[i]) {
+            case TypeFloat: case TypeDouble: case TypeBlob: case TypeTinyBlob: case TypeMediumBlob:
+            case TypeLongBlob: case TypeGeometry: case TypeJson: case TypeTimestamp2: case TypeDateTime2:
+            case TypeTime2:
+                if (cursor + 1 > metadata_end) return false;
+                map.metadata[i] = *cursor++;
+                break;
+            case TypeVarchar: case TypeVarString: case TypeBit:
+                if (cursor + 2 > metadata_end) return false;
+                map.metadata[i] = uint16_t(readLE(cursor, 2));
+                cursor += 2;
+                break;
+            case TypeString: case TypeNewDecimal: case TypeEnum: case TypeSet:
+                if (cursor + 2 > metadata_end) return false;
+                map.metadata[i] = uint16_t(cursor[0] << 8 | cursor[1]);
+                cursor += 2;
+                break;
+            default:
+                break;
+        }
+    }
+
+    tables[table_id] = std::move(map);
+    return true;
+}
+
+// Bytes taken by one non-NULL value, or nullopt for a type this parser
+// cannot size
+std::optional<size_t> BinlogParser::valueSize(uint8_t type, uint16_t metadata, const unsigned char* value,
+                                              size_t available) {
+    auto prefixed = [value, available](size_t prefix) -> std::optional<size_t> {
+        if (available < prefix) return std::nullopt;
+        return prefix + readLE(value, prefix);
+    };
+
+    if (size_t width = integerWidth(type)) return width;
+    switch (type) {
+        case TypeFloat: case TypeTimestamp: return 4;
+        case TypeDouble: case TypeDateTime: return 8;
+        case TypeNull: return 0;
+        case TypeDate: case TypeTime: case TypeNewDate: return 3;
+        case TypeTimestamp2: return 4 + (metadata + 1) / 2;
+        case TypeDateTime2: return 5 + (metadata + 1) / 2;
+        case TypeTime2: return 3 + (metadata + 1) / 2;
+        case TypeVarchar: case TypeVarString:
+            return prefixed(metadata > 255 ? 2 : 1);
+        case TypeBit:
+            return (metadata >> 8) + ((metadata & 0xff) > 0 ? 1 : 0);
+        case TypeNewDecimal: {
+            unsigned precision = metadata >> 8, scale = metadata & 0xff;
+            if (scale > precision) return std::nullopt;
+            return decimalBytes(precision - scale) + decimalBytes(scale);
+        }
+        case TypeEnum: case TypeSet:
+            return metadata & 0xff;
+        case TypeString: {
+            // CHAR, ENUM and SET all map to STRING; the real type and the
+            // high bits of the length are packed into the first byte
+            unsigned real_type = metadata >> 8, length = metadata & 0xff;
+            if ((real_type & 0x30) != 0x30) {
+                length |= ((real_type & 0x30) ^ 0x30) << 4;
+                real_type |= 0x30;
+            }
+            if (real_type == TypeEnum || real_type == TypeSet) return length;
+            return prefixed(length > 255 ? 2 : 1);
+        }
+        case TypeBlob: case TypeTinyBlob: case TypeMediumBlob: case TypeLongBlob: case TypeGeometry: case TypeJson:
+            if (metadata < 1 || metadata > 4) return std::nullopt;
+            return prefixed(metadata);
+        default:
+            return std::nullopt;
+    }
+}
+
+bool BinlogParser::readImage(const TableMap& map, const std::vector<bool>& present, const unsigned char*& cursor,
+                             const unsigned char* end, std::vector<std::optional<long long>>& columns) {
+    size_t present_count = 0;
+    for (bool column : present) present_count += column;
+    size_t null_bytes = (present_count + 7) / 8;
+    if (cursor + null_bytes > end) return false;
+    std::vector<bool> nulls = readBitmap(cursor, present_count);
+    cursor += null_bytes;
+
+    size_t nth = 0;
+    for (size_t i = 0; i < present.size(); ++i) {
+        if (!present[i]) continue;
+        if (nulls[nth++]) {
+            columns[i] = std::nullopt;
+            continue;
+        }
+        auto size = valueSize(map.types[i], map.metadata[i], cursor, size_t(end - cursor));
+        if (!size || cursor + *size > end) return false;
+        if (size_t width = integerWidth(map.types[i])) {
+            uint64_t raw = readLE(cursor, width);
+            if (width < 8 && (raw >> (8 * width - 1)) & 1) raw |= ~uint64_t(0) << (8 * width);
+            columns[i] = static_cast<long long>(raw);
+        } else {
+            columns[i] = std::nullopt;
+        }
+        cursor += *size;
+    }
+    return true;
+}
+
+bool BinlogParser::parseRows(uint8_t type, const unsigned char* body, size_t size, Event& event) {
+    const unsigned char* end = body + size;
+    bool v2 = type >= WriteRowsV2;
+    size_t post_header = v2 ? 10 : 8;
+    if (size < post_header) return false;
+
+    auto map = tables.find(readLE(body, 6));
+    if (map == tables.end()) return false;
+    event.schema = map->second.schema;
+    event.table = map->second.table;
+
+    const unsigned char* cursor = body + post_header;
+    if (v2) {
+        size_t extra = readLE(body + 8, 2);
+        if (extra < 2 || body + 8 + extra > end) return false;
+        cursor = body + 8 + extra;
+    }
+
+    uint64_t columns = 0;
+    if (!readPacked(cursor, end, columns) || columns != map->second.types.size()) return false;
+    size_t bitmap_bytes = (columns + 7) / 8;
+    bool update = type == UpdateRowsV1 || type == UpdateRowsV2;
+    if (cursor + bitmap_bytes * (update ? 2 : 1) > end) return false;
+    std::vector<bool> before = readBitmap(cursor, columns);
+    cursor += bitmap_bytes;
+    std::vector<bool> after;
+    if (update) {
+        after = readBitmap(cursor, columns);
+        cursor += bitmap_bytes;
+    }
+
+    RowAction action = update ? RowAction::Update
+        : (type == WriteRowsV1 || type == WriteRowsV2) ? RowAction::Insert : RowAction::Delete;
+    while (cursor < end) {
+        Row row{action, std::vector<std::optional<long long>>(columns)};
+        if (!readImage(map->second, before, cursor, end, row.columns)) return false;
+        // With binlog_row_image=MINIMAL the after image only has the changed
+        // columns; the rest keep their before-image values
+        if (update) {
+            std::vector<std::optional<long long>> changed(columns);
+            if (!readImage(map->second, after, cursor, end, changed)) return false;
+            for (size_t i = 0; i < columns; ++i) {
+                if (after[i]) row.columns[i] = changed[i];
+            }
+        }
+        event.rows.push_back(std::move(row));
+    }
+    return true;
+}
+
+bool BinlogParser::parseQuery(const unsigned char* body, size_t size, Event& event) {
+    const size_t post_header = 13;
+    if (size < post_header) return false;
+    size_t schema_length = body[8];
+    size_t status_length = readLE(body + 11, 2);
+    size_t query_at = post_header + status_length + schema_length + 1;
+    if (query_at > size) return false;
+
+    event.schema.assign(reinterpret_cast<const char*>(body + post_header + status_length), schema_length);
+    event.query.assign(reinterpret_cast<const char*>(body + query_at), size - query_at);
+    if (ciEquals(event.query, "COMMIT")) {
+        event.kind = EventKind::Commit;
+    } else if (!ciEquals(event.query, "BEGIN")) {
+        event.kind = EventKind::Query;
+    }
+    return true;
+}
@@ -1,65 +1,704 @@
 #include "database/db_connection.h"
-#include <iostream>
+#include "database/statement_fingerprint.h"
+#include "logging/logger.h"
+#include "tracing/tracer.h"
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
 #include <sstream>
+#include <strings.h>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// Read-your-writes state of the request running on this thread
+struct SessionState {
+    bool active = false;
+    bool wrote = false;
+    std::string incoming_token;
+    std::string gtid_set;
+    long long write_epoch_ms = 0;
+};
+
+thread_local SessionState session;
+thread_local const void* transaction_owner = nullptr;
+thread_local MYSQL* transaction_connection = nullptr;
+thread_local int last_insert_id = -1;
+thread_local long long last_affected_rows = 0;
+thread_local std::shared_ptr<Database::Deadline::State> current_deadline;
+
+// Pool of threads outside a ConnectionScope: startup and the background jobs
+const int backgroundPool = -1;
+const int backgroundConnections = 2;
+thread_local Database::ConnectionScope::Pool connection_scope{backgroundPool, "background", backgroundConnections};
+
+// How long an endpoint that failed to connect is left alone
+const std::chrono::seconds reconnectDelay(5);
+
+// Statements past their deadline by this much are killed; SELECTs have
+// usually been stopped by their MAX_EXECUTION_TIME hint already
+const std::chrono::milliseconds killGrace(100);
+
+// Fingerprints kept in the timeout counts; later new ones are only totalled
+const size_t maxTimeoutFingerprints = 1000;
+
+long long epochMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool isGtidSet(const std::string& value) {
+    if (value.empty()) return false;
+    for (char c : value) {
+        bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')
+                  || c == ':' || c == '-' || c == ',';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+bool isConnectionLost(MYSQL* connection) {
+    unsigned int code = mysql_errno(connection);
+    return code == 2006 || code == 2013;  // CR_SERVER_GONE_ERROR, CR_SERVER_LOST
+}
+
+long long millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Statements are logged by shape: normalized text without the values, and
+// its fingerprint to group the lines of one query
+void logStatement(Logger::Entry& entry, const std::string& query, long long latency_ms) {
+    if (!entry) return;
+    std::string normalized = statement_fingerprint::normalize(query);
+    entry.field("fingerprint", statement_fingerprint::hash(normalized))
+         .field("latency_ms", latency_ms)
+         .field("statement", normalized);
+}
+
+void logStatement(Logger::Entry&& entry, const std::string& query, long long latency_ms) {
+    logStatement(entry, query, latency_ms);
+}
+
+// SELECT text with a MAX_EXECUTION_TIME optimizer hint. The server applies
+// the limit to read-only SELECTs only, so other statements are left alone
+// and rely on the watchdog.
+std::string withExecutionLimit(const std::string& query, long long limit_ms) {
+    size_t start = query.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos || query.size() - start < 6 || strncasecmp(query.c_str() + start, "SELECT", 6) != 0) {
+        return query;
+    }
+    size_t after = start + 6;
+    if (after < query.size() && (std::isalnum(static_cast<unsigned char>(query[after])) || query[after] == '_')) {
+        return query;
+    }
+    return query.substr(0, after) + " /*+ MAX_EXECUTION_TIME(" + std::to_string(limit_ms) + ") */" + query.substr(after);
+}
+
+// Kills statements that outlive their deadline. Each running statement under
+// a deadline is registered here; one thread sleeps until the earliest kill
+// time and runs that statement's kill, and release() waits for a kill in
+// progress so the connection is not reused until it has landed.
+class Watchdog {
+public:
+    static Watchdog& instance() {
+        // Never destroyed: its thread runs until exit
+        static Watchdog* watchdog = new Watchdog();
+        return *watchdog;
+    }
+
+    std::uint64_t watch(std::chrono::steady_clock::time_point kill_at, std::function<void()> kill) {
+        std::lock_guard<std::mutex> guard(lock);
+        std::uint64_t id = next_id++;
+        entries[id] = Entry{kill_at, std::move(kill)};
+        changed.notify_all();
+        return id;
+    }
+
+    // Stops watching; true when the statement was killed
+    bool release(std::uint64_t id) {
+        std::unique_lock<std::mutex> guard(lock);
+        auto it = entries.find(id);
+        changed.wait(guard, [&it] { return !it->second.killing; });
+        bool killed = it->second.killed;
+        entries.erase(it);
+        return killed;
+    }
+
+private:
+    struct Entry {
+        std::chrono::steady_clock::time_point kill_at;
+        std::function<void()> kill;
+        bool killing = false;
+        bool killed = false;
+    };
+
+    Watchdog() {
+        std::thread([this] { run(); }).detach();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;) {
+            auto due = entries.end();
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (!it->second.killed && (due == entries.end() || it->second.kill_at < due->second.kill_at)) due = it;
+            }
+            if (due == entries.end()) {
+                changed.wait(guard);
+                continue;
+            }
+            auto kill_at = due->second.kill_at;
+            if (std::chrono::steady_clock::now() < kill_at) {
+                changed.wait_until(guard, kill_at);
+                continue;
+            }
+
+            // Entries are only erased by release(), which waits for this
+            Entry& entry = due->second;
+            entry.killing = true;
+            guard.unlock();
+            entry.kill();
+            guard.lock();
+            entry.killing = false;
+            entry.killed = true;
+            changed.notify_all();
+        }
+    }
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::unordered_map<std::uint64_t, Entry> entries;
+    std::uint64_t next_id = 1;
+};
+
+struct TimeoutCount {
+    std::string statement;
+    unsigned long long count = 0;
+    std::map<std::string, unsigned long long> causes;
+};
+
+std::mutex timeout_lock;
+std::unordered_map<std::string, TimeoutCount> timeouts;   // by fingerprint
+std::map<std::string, unsigned long long> timeout_causes;
+unsigned long long timeout_total = 0;
+
+void countTimeout(const std::string& normalized, const std::string& fingerprint, const char* cause) {
+    std::lock_guard<std::mutex> guard(timeout_lock);
+    timeout_total++;
+    timeout_causes[cause]++;
+    auto it = timeouts.find(fingerprint);
+    if (it == timeouts.end()) {
+        if (timeouts.size() >= maxTimeoutFingerprints) return;
+        it = timeouts.emplace(fingerprint, TimeoutCount()).first;
+        it->second.statement = normalized;
+    }
+    it->second.count++;
+    it->second.causes[cause]++;
+}
+
+} // namespace
+
+Database::Session::Session(Database& database, const std::string& token) : db(database) {
+    session = SessionState{};
+    session.active = true;
+    session.incoming_token = token;
+    
+    if (token.rfind("gtid:", 0) == 0 && isGtidSet(token.substr(5))) {
+        session.gtid_set = token.substr(5);
+    } else if (token.rfind("ts:", 0) == 0) {
+        try {
+            // A time ahead of ours would pin the client to the primary for good
+            session.write_epoch_ms = std::min(std::stoll(token.substr(3)), epochMs());
+        } catch (...) {
+            session.write_epoch_ms = 0;
+        }
+    }
+}
+
+Database::Session::~Session() {
+    session = SessionState{};
+}
+
+std::string Database::Session::token() {
+    if (!session.wrote) {
+        return session.incoming_token;
+    }
+    // The writes are committed by now; a request out of time answers with
+    // the timestamp token rather than fail for want of the GTID set
+    bool out_of_time = current_deadline &&
+        (current_deadline->exceeded || std::chrono::steady_clock::now() >= current_deadline->at);
+    if (!db.replicas.empty() && !out_of_time) {
+        bool lost = false;
+        json result = db.runQuery(db.primary, "SELECT @@GLOBAL.gtid_executed AS gtid", lost);
+        if (result.is_array() && !result.empty() && result[0]["gtid"].is_string()) {
+            // With several source UUIDs the server breaks the set across
+            // lines, which must not reach the response header
+            std::string gtid = result[0]["gtid"];
+            gtid.erase(std::remove_if(gtid.begin(), gtid.end(),
+                                      [](unsigned char c) { return std::isspace(c); }), gtid.end());
+            if (isGtidSet(gtid)) {
+                return "gtid:" + gtid;
+            }
+        }
+    }
+    return "ts:" + std::to_string(epochMs());
+}
+
+Database::Transaction::Transaction(Database& database) : db(database) {
+    connection = db.checkout(db.primary, "START TRANSACTION");
+    if (!connection) {
+        if (!connection.timedOut()) Logger::error("db", "Database not connected");
+        return;
+    }
+    if (mysql_query(connection.get(), "START TRANSACTION")) {
+        Logger::error("db", "Transaction start failed").field("error", mysql_error(connection.get()));
+        if (isConnectionLost(connection.get())) connection.discard();
+        return;
+    }
+    started = true;
+    transaction_owner = &db;
+    transaction_connection = connection.get();
+}
+
+Database::Transaction::~Transaction() {
+    // A connection whose transaction state is unknown goes back closed
+    if (started && mysql_query(connection.get(), "ROLLBACK")) {
+        Logger::error("db", "Rollback failed").field("error", mysql_error(connection.get()));
+        connection.discard();
+    }
+    transaction_owner = nullptr;
+    transaction_connection = nullptr;
+}
+
+bool Database::Transaction::commit() {
+    if (!started) return false;
+    started = false;
+    transaction_owner = nullptr;
+    transaction_connection = nullptr;
+    if (mysql_query(connection.get(), "COMMIT")) {
+        Logger::error("db", "Commit failed").field("error", mysql_error(connection.get()));
+        connection.discard();
+        return false;
+    }
+    return true;
+}
+
+Database::ConnectionScope::ConnectionScope(int pool_id, const char* name, int capacity)
+    : previous(connection_scope) {
+    connection_scope = Pool{pool_id, name, std::max(1, capacity)};
+}
+
+Database::ConnectionScope::ConnectionScope(const Pool& pool) : previous(connection_scope) {
+    connection_scope = Pool{pool.id, pool.name, std::max(1, pool.capacity)};
+}
+
+Database::ConnectionScope::~ConnectionScope() {
+    connection_scope = previous;
+}
+
+Database::ConnectionScope::Pool Database::ConnectionScope::current() {
+    return connection_scope;
+}
+
+Database::Lease::Lease(Endpoint* pool_endpoint, int pool_id, MYSQL* conn)
+    : endpoint(pool_endpoint), pool(pool_id), connection(conn) {}
+
+Database::Lease::Lease(Lease&& other) noexcept
+    : endpoint(other.endpoint), pool(other.pool), connection(other.connection), broken(other.broken),
+      timed_out(other.timed_out) {
+    other.endpoint = nullptr;
+    other.connection = nullptr;
+}
+
+Database::Lease& Database::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        endpoint = other.endpoint;
+        pool = other.pool;
+        connection = other.connection;
+        broken = other.broken;
+        timed_out = other.timed_out;
+        other.endpoint = nullptr;
+        other.connection = nullptr;
+    }
+    return *this;
+}
+
+Database::Lease::~Lease() {
+    release();
+}
+
+void Database::Lease::release() {
+    if (endpoint && connection) {
+        bool close = broken;
+        {
+            std::lock_guard<std::mutex> guard(endpoint->lock);
+            ConnectionPool& slot = endpoint->pools[pool];
+            // Pools shrink as their connections come back
+            if (close || slot.open > slot.capacity) {
+                close = true;
+                slot.open--;
+            } else {
+                slot.idle.push_back(connection);
+            }
+        }
+        endpoint->released.notify_all();
+        if (close) mysql_close(connection);
+    }
+    endpoint = nullptr;
+    connection = nullptr;
+    broken = false;
+}
+
+Database::Deadline::Deadline(std::chrono::steady_clock::time_point at)
+    : state(std::make_shared<State>()), previous(current_deadline) {
+    state->at = at;
+    current_deadline = state;
+}
+
+Database::Deadline::Deadline(std::shared_ptr<State> shared)
+    : state(std::move(shared)), previous(current_deadline) {
+    current_deadline = state;
+}
+
+Database::Deadline::~Deadline() {
+    current_deadline = previous;
+}
+
+std::shared_ptr<Database::Deadline::State> Database::Deadline::current() {
+    return current_deadline;
+}
+
+Database::Statement::Statement(Database& database, MYSQL* conn, const std::string& target_host,
+                               unsigned int target_port, const std::string& sql)
+    : db(database), connection(conn), host(target_host), port(target_port), query(sql),
+      deadline(current_deadline), started(std::chrono::steady_clock::now()) {}
+
+Database::Statement::~Statement() {
+    finish();
+}
+
+bool Database::Statement::send() {
+    if (!deadline) {
+        return mysql_query(connection, query.c_str()) == 0;
+    }
+    
+    long long left_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline->at - std::chrono::steady_clock::now()).count();
+    if (left_ms <= 0) {
+        cause = "not_sent";
+        timedOut();
+        return false;
+    }
+    
+    Database* owner = &db;
+    std::string target_host = host;
+    unsigned int target_port = port;
+    unsigned long thread_id = mysql_thread_id(connection);
+    watch = Watchdog::instance().watch(deadline->at + killGrace, [owner, target_host, target_port, thread_id] {
+        owner->killQuery(target_host, target_port, thread_id);
+    });
+    
+    std::string limited = withExecutionLimit(query, left_ms);
+    return mysql_query(connection, limited.c_str()) == 0;
+}
+
+void Database::Statement::finish() {
+    if (watch == 0) return;
+    killed = Watchdog::instance().release(watch);
+    watch = 0;
+}
+
+void Database::Statement::poolWaitTimedOut() {
+    cause = "pool_wait";
+    timedOut();
+}
+
+bool Database::Statement::timedOut() {
+    if (!deadline) return false;
+    if (counted) return true;
+    
+    if (!cause) {
+        unsigned int code = mysql_errno(connection);
+        finish();
+        if (killed) {
+            cause = "killed";
+        } else if (code == 3024) {
+            cause = "execution_limit";    // ER_QUERY_TIMEOUT
+        } else if (code == 2013 && std::chrono::steady_clock::now() >= deadline->at) {
+            cause = "read_timeout";       // CR_SERVER_LOST on a dedicated connection
+        } else {
+            return false;
+        }
+    }
+    
+    counted = true;
+    deadline->exceeded = true;
+    std::string normalized = statement_fingerprint::normalize(query);
+    std::string fingerprint = statement_fingerprint::hash(normalized);
+    countTimeout(normalized, fingerprint, cause);
+    Logger::warn("db", "Statement timed out")
+        .field("cause", cause)
+        .field("host", host)
+        .field("fingerprint", fingerprint)
+        .field("latency_ms", millisSince(started))
+        .field("statement", normalized);
+    return true;
+}
+
+void Database::killQuery(const std::string& target_host, unsigned int target_port, unsigned long thread_id) {
+    MYSQL* connection = mysql_init(nullptr);
+    if (!connection) {
+        Logger::error("db", "MySQL initialization failed");
+        return;
+    }
+    unsigned int connect_timeout = 2;
+    mysql_options(connection, MYSQL_OPT_CONNECT_TIMEOUT, &connect_timeout);
+    if (!mysql_real_connect(connection, target_host.c_str(), user.c_str(), password.c_str(),
+                            database.c_str(), target_port, nullptr, 0)) {
+        Logger::error("db", "Connection failed")
+            .field("host", target_host)
+            .field("port", target_port)
+            .field("error", mysql_error(connection));
+        mysql_close(connection);
+        return;
+    }
+    
+    std::string kill = "KILL QUERY " + std::to_string(thread_id);
+    if (mysql_query(connection, kill.c_str())) {
+        Logger::error("db", "Kill failed")
+            .field("host", target_host)
+            .field("thread_id", thread_id)
+            .field("error", mysql_error(connection));
+    }
+    mysql_close(connection);
+}
+
+json Database::getTimeoutStats() {
+    std::lock_guard<std::mutex> guard(timeout_lock);
+    std::vector<std::pair<std::string, const TimeoutCount*>> sorted;
+    for (const auto& [fingerprint, counts] : timeouts) sorted.emplace_back(fingerprint, &counts);
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.second->count != b.second->count ? a.second->count > b.second->count : a.first < b.first;
+    });
+    
+    json statements = json::array();
+    for (const auto& [fingerprint, counts] : sorted) {
+        statements.push_back({
+            {"fingerprint", fingerprint},
+            {"statement", counts->statement},
+            {"count", counts->count},
+            {"causes", counts->causes}
+        });
+    }
+    return {
+        {"timed_out", timeout_total},
+        {"causes", timeout_causes},
+        {"statements", statements}
+    };
+}
 
 Database::Database(const std::string& h, const std::string& u, 
                    const std::string& p, const std::string& db, 
                    unsigned int pt)
-    : host(h), user(u), password(p), database(db), port(pt), connection(nullptr) {}
+    : host(h), user(u), password(p), database(db), port(pt) {
+    primary.host = h;
+    primary.port = pt;
+}
 
 Database::~Database() {
     disconnect();
 }
 
-bool Database::connect() {
-    connection = mysql_init(nullptr);
-    
+void Database::addReplica(const std::string& h, unsigned int pt) {
+    auto replica = std::make_unique<Endpoint>();
+    replica->host = h;
+    replica->port = pt;
+    replicas.push_back(std::move(replica));
+}
+
+MYSQL* Database::openConnection(Endpoint& endpoint) {
+    MYSQL* connection = mysql_init(nullptr);
     if (!connection) {
-        std::cerr << "MySQL initialization failed" << std::endl;
-        return false;
+        Logger::error("db", "MySQL initialization failed");
+        return nullptr;
     }
     
-    if (!mysql_real_connect(connection, host.c_str(), user.c_str(), 
-                           password.c_str(), database.c_str(), port, 
+    if (!mysql_real_connect(connection, endpoint.host.c_str(), user.c_str(), 
+                           password.c_str(), database.c_str(), endpoint.port, 
                            nullptr, 0)) {
-        std::cerr << "Connection Error: " << mysql_error(connection) << std::endl;
+        Logger::error("db", "Connection failed")
+            .field("host", endpoint.host)
+            .field("port", endpoint.port)
+            .field("error", mysql_error(connection));
+        mysql_close(connection);
+        std::lock_guard<std::mutex> guard(endpoint.lock);
+        endpoint.healthy = false;
+        endpoint.retry_after = std::chrono::steady_clock::now() + reconnectDelay;
+        return nullptr;
+    }
+    
+    endpoint.healthy = true;
+    return connection;
+}
+
+// Opens a connection to see whether the endpoint is up, and keeps it in this
+// thread's pool when there is room
+bool Database::probe(Endpoint& endpoint) {
+    MYSQL* connection = openConnection(endpoint);
+    if (!connection) return false;
+    {
+        std::lock_guard<std::mutex> guard(endpoint.lock);
+        ConnectionPool& pool = endpoint.pools[connection_scope.id];
+        pool.name = connection_scope.name;
+        pool.capacity = connection_scope.capacity;
+        if (pool.open < pool.capacity) {
+            pool.open++;
+            pool.idle.push_back(connection);
+            connection = nullptr;
+        }
+    }
+    endpoint.released.notify_all();
+    if (connection) mysql_close(connection);
+    return true;
+}
+
+bool Database::connect() {
+    if (!probe(primary)) {
         return false;
     }
+    Logger::info("db", "Connected to MySQL").field("host", host).field("port", port).field("database", database);
     
-    std::cout << "Connected to MySQL database successfully" << std::endl;
+    for (auto& replica : replicas) {
+        if (probe(*replica)) {
+            Logger::info("db", "Connected to read replica").field("host", replica->host).field("port", replica->port);
+        } else {
+            Logger::warn("db", "Read replica unavailable, reads will use the primary")
+                .field("host", replica->host)
+                .field("port", replica->port);
+        }
+    }
     return true;
 }
 
+// Closes the idle connections; ones still checked out close when returned
+// to a pool that no longer has room for them
 bool Database::disconnect() {
-    if (connection) {
-        mysql_close(connection);
-        connection = nullptr;
+    auto closeIdle = [](Endpoint& endpoint) {
+        std::vector<MYSQL*> closing;
+        {
+            std::lock_guard<std::mutex> guard(endpoint.lock);
+            for (auto& [id, pool] : endpoint.pools) {
+                pool.open -= static_cast<int>(pool.idle.size());
+                closing.insert(closing.end(), pool.idle.begin(), pool.idle.end());
+                pool.idle.clear();
+            }
+            endpoint.healthy = false;
+        }
+        endpoint.released.notify_all();
+        for (MYSQL* connection : closing) mysql_close(connection);
+    };
+    closeIdle(primary);
+    for (auto& replica : replicas) {
+        closeIdle(*replica);
     }
     return true;
 }
 
 bool Database::isConnected() const {
-    return connection != nullptr;
+    return primary.healthy;
 }
 
-json Database::executeQuery(const std::string& query) {
+Database::Lease Database::checkout(Endpoint& endpoint, const std::string& query) {
+    // This thread's open transaction already holds a primary connection
+    if (&endpoint == &primary && transaction_owner == this) {
+        return Lease(transaction_connection);
+    }
+    
+    ConnectionScope::Pool scope = connection_scope;
+    {
+        // Time spent waiting for a free connection in this thread's pool
+        Tracer::Span span("db.connection_wait", "db");
+        std::unique_lock<std::mutex> guard(endpoint.lock);
+        ConnectionPool& pool = endpoint.pools[scope.id];
+        pool.name = scope.name;
+        pool.capacity = scope.capacity;
+        auto available = [&pool] { return !pool.idle.empty() || pool.open < pool.capacity; };
+        if (!current_deadline) {
+            endpoint.released.wait(guard, available);
+        } else if (!endpoint.released.wait_until(guard, current_deadline->at, available)) {
+            guard.unlock();
+            Statement statement(*this, nullptr, endpoint.host, endpoint.port, query);
+            statement.poolWaitTimedOut();
+            Lease expired;
+            expired.timed_out = true;
+            return expired;
+        }
+        if (!pool.idle.empty()) {
+            MYSQL* connection = pool.idle.back();
+            pool.idle.pop_back();
+            return Lease(&endpoint, scope.id, connection);
+        }
+        pool.open++;
+    }
+    
+    MYSQL* connection = openConnection(endpoint);
+    if (!connection) {
+        {
+            std::lock_guard<std::mutex> guard(endpoint.lock);
+            endpoint.pools[scope.id].open--;
+        }
+        endpoint.released.notify_all();
+        return Lease();
+    }
+    return Lease(&endpoint, scope.id, connection);
+}
+
+json Database::runQuery(Endpoint& endpoint, const std::string& query, bool& connection_lost) {
     json result = json::array();
+    connection_lost = false;
+    if (statement_observer) statement_observer(query);
     
+    Tracer::Span span("db.query", "db");
+    if (span) span.arg("sql", query.substr(0, 300));
+    Lease connection = checkout(endpoint, query);
+    if (connection.timedOut()) {
+        return json{{"error", "Statement timed out"}};
+    }
     if (!connection) {
+        connection_lost = true;
         return json{{"error", "Database not connected"}};
     }
     
-    if (mysql_query(connection, query.c_str())) {
-        std::cerr << "Query Error: " << mysql_error(connection) << std::endl;
-        return json{{"error", mysql_error(connection)}};
+    auto started = std::chrono::steady_clock::now();
+    Statement statement(*this, connection.get(), endpoint.host, endpoint.port, query);
+    if (!statement.send()) {
+        if (statement.timedOut()) {
+            return json{{"error", "Statement timed out"}};
+        }
+        logStatement(Logger::error("db", "Query failed")
+                         .field("error", mysql_error(connection.get()))
+                         .field("host", endpoint.host),
+                     query, millisSince(started));
+        connection_lost = isConnectionLost(connection.get());
+        if (connection_lost) connection.discard();
+        return json{{"error", mysql_error(connection.get())}};
     }
+    noteLatency(query, millisSince(started));
     
-    MYSQL_RES* res = mysql_store_result(connection);
+    MYSQL_RES* res = mysql_store_result(connection.get());
     
     if (!res) {
+        if (statement.timedOut()) {
+            return json{{"error", "Statement timed out"}};
+        }
         return json{{"error", "No result returned"}};
     }
+    statement.finish();
     
+    Tracer::Span build("json.build", "json");
     MYSQL_FIELD* fields = mysql_fetch_fields(res);
     int num_fields = mysql_num_fields(res);
     
@@ -94,58 +733,379 @@ json Database::executeQuery(const std::string& query) {
     return result;
 }
 
-bool Database::executeUpdate(const std::string& query) {
+json Database::executeQuery(const std::string& query) {
+    bool lost = false;
+    return runQuery(primary, query, lost);
+}
+
+Database::Endpoint* Database::pickReplica() {
+    if (replicas.empty()) return nullptr;
+    
+    auto now = std::chrono::steady_clock::now();
+    size_t start = next_replica++;
+    for (size_t i = 0; i < replicas.size(); i++) {
+        Endpoint& replica = *replicas[(start + i) % replicas.size()];
+        if (replica.healthy) {
+            return &replica;
+        }
+        bool due = false;
+        {
+            // One request probes; the others keep using the primary meanwhile
+            std::lock_guard<std::mutex> guard(replica.lock);
+            if (now >= replica.retry_after) {
+                due = true;
+                replica.retry_after = now + reconnectDelay;
+            }
+        }
+        if (due && probe(replica)) {
+            Logger::info("db", "Read replica is back").field("host", replica.host).field("port", replica.port);
+            return &replica;
+        }
+    }
+    return nullptr;
+}
+
+bool Database::replicaCaughtUp(Endpoint& replica, const std::string& gtid_set) {
+    std::stringstream ss;
+    ss << "SELECT WAIT_FOR_EXECUTED_GTID_SET('" << gtid_set << "', "
+       << (replica_wait_ms / 1000.0) << ") AS timed_out";
+    
+    bool lost = false;
+    json result = runQuery(replica, ss.str(), lost);
+    return result.is_array() && !result.empty() && result[0]["timed_out"] == 0;
+}
+
+bool Database::readsRequirePrimary(Endpoint*& replica) {
+    replica = nullptr;
+    if (replicas.empty()) return true;
+    
+    if (session.active) {
+        if (session.wrote) return true;
+        if (session.write_epoch_ms > 0 &&
+            epochMs() - session.write_epoch_ms < replica_lag_window_ms) {
+            return true;
+        }
+    }
+    
+    replica = pickReplica();
+    if (!replica) return true;
+    
+    if (session.active && !session.gtid_set.empty()) {
+        if (!replicaCaughtUp(*replica, session.gtid_set)) {
+            return true;
+        }
+        // Later reads in this request need not wait again
+        session.gtid_set.clear();
+    }
+    return false;
+}
+
+Database::Endpoint* Database::readEndpoint() {
+    if (transaction_owner == this) {
+        return &primary;
+    }
+    Endpoint* replica = nullptr;
+    if (readsRequirePrimary(replica)) {
+        return &primary;
+    }
+    return replica;
+}
+
+void Database::markLost(Endpoint& replica) {
+    // Its idle connections are most likely gone too
+    std::vector<MYSQL*> closing;
+    {
+        std::lock_guard<std::mutex> guard(replica.lock);
+        replica.healthy = false;
+        replica.retry_after = std::chrono::steady_clock::now() + reconnectDelay;
+        for (auto& [id, pool] : replica.pools) {
+            pool.open -= static_cast<int>(pool.idle.size());
+            closing.insert(closing.end(), pool.idle.begin(), pool.idle.end());
+            pool.idle.clear();
+        }
+    }
+    replica.released.notify_all();
+    for (MYSQL* connection : closing) mysql_close(connection);
+    Logger::warn("db", "Read replica lost, falling back to primary")
+        .field("host", replica.host)
+        .field("port", replica.port);
+}
+
+json Database::executeRead(const std::string& query) {
+    Endpoint* endpoint = readEndpoint();
+    
+    bool lost = false;
+    json result = runQuery(*endpoint, query, lost);
+    if (lost && endpoint != &primary) {
+        markLost(*endpoint);
+        return executeQuery(query);
+    }
+    return result;
+}
+
+bool Database::streamRows(Endpoint& endpoint, const std::string& query, unsigned int expected_columns,
+                          const std::function<void(char**, unsigned long*)>& on_row,
+                          bool& connection_lost) {
+    connection_lost = false;
+    if (statement_observer) statement_observer(query);
+    
+    Tracer::Span span("db.query", "db");
+    if (span) span.arg("sql", query.substr(0, 300));
+    Lease connection = checkout(endpoint, query);
+    if (connection.timedOut()) return false;
     if (!connection) {
-        std::cerr << "Database not connected" << std::endl;
+        connection_lost = true;
+        return false;
+    }
+    
+    auto started = std::chrono::steady_clock::now();
+    Statement statement(*this, connection.get(), endpoint.host, endpoint.port, query);
+    if (!statement.send()) {
+        if (statement.timedOut()) return false;
+        logStatement(Logger::error("db", "Query failed")
+                         .field("error", mysql_error(connection.get()))
+                         .field("host", endpoint.host),
+                     query, millisSince(started));
+        connection_lost = isConnectionLost(connection.get());
+        if (connection_lost) connection.discard();
         return false;
     }
+    noteLatency(query, millisSince(started));
     
-    if (mysql_query(connection, query.c_str())) {
-        std::cerr << "Update Error: " << mysql_error(connection) << std::endl;
+    MYSQL_RES* res = mysql_store_result(connection.get());
+    if (!res) {
+        statement.timedOut();
         return false;
     }
+    statement.finish();
     
+    if (mysql_num_fields(res) != expected_columns) {
+        logStatement(Logger::error("db", "Row schema mismatch")
+                         .field("expected_columns", expected_columns)
+                         .field("columns", mysql_num_fields(res)),
+                     query, millisSince(started));
+        mysql_free_result(res);
+        return false;
+    }
+    
+    Tracer::Span decode("db.decode", "db");
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr) {
+        on_row(row, mysql_fetch_lengths(res));
+    }
+    
+    mysql_free_result(res);
     return true;
 }
 
-bool Database::executeInsert(const std::string& query) {
+bool Database::readRows(const std::string& query, unsigned int expected_columns,
+                        const std::function<void(char**, unsigned long*)>& on_row) {
+    Endpoint* endpoint = readEndpoint();
+    
+    bool lost = false;
+    bool ok = streamRows(*endpoint, query, expected_columns, on_row, lost);
+    if (lost && endpoint != &primary) {
+        markLost(*endpoint);
+        ok = streamRows(primary, query, expected_columns, on_row, lost);
+    }
+    return ok;
+}
+
+bool Database::streamUnbuffered(const std::string& query, unsigned int expected_columns,
+                                const std::function<void(char**, unsigned long*)>& on_row) {
+    if (statement_observer) statement_observer(query);
+    
+    Tracer::Span span("db.stream", "db");
+    if (span) span.arg("sql", query.substr(0, 300));
+    
+    std::string target_host = host;
+    unsigned int target_port = port;
+    if (Endpoint* replica = pickReplica()) {
+        target_host = replica->host;
+        target_port = replica->port;
+    }
+    
+    MYSQL* connection = mysql_init(nullptr);
     if (!connection) {
-        std::cerr << "Database not connected" << std::endl;
+        Logger::error("db", "MySQL initialization failed");
         return false;
     }
-    
-    if (mysql_query(connection, query.c_str())) {
-        std::cerr << "Insert Error: " << mysql_error(connection) << std::endl;
+    // Under a deadline, a stalled read gives up once the time is over
+    if (auto deadline = Deadline::current()) {
+        auto left = std::chrono::duration_cast<std::chrono::seconds>(
+            deadline->at - std::chrono::steady_clock::now() + std::chrono::milliseconds(999));
+        unsigned int read_timeout = static_cast<unsigned int>(std::max<long long>(1, left.count()));
+        mysql_options(connection, MYSQL_OPT_READ_TIMEOUT, &read_timeout);
+    }
+    if (!mysql_real_connect(connection, target_host.c_str(), user.c_str(), password.c_str(),
+                            database.c_str(), target_port, nullptr, 0)) {
+        Logger::error("db", "Connection failed")
+            .field("host", target_host)
+            .field("port", target_port)
+            .field("error", mysql_error(connection));
+        mysql_close(connection);
         return false;
     }
     
-    return true;
+    bool ok = false;
+    auto started = std::chrono::steady_clock::now();
+    Statement statement(*this, connection, target_host, target_port, query);
+    if (!statement.send()) {
+        if (!statement.timedOut()) {
+            logStatement(Logger::error("db", "Query failed")
+                             .field("error", mysql_error(connection))
+                             .field("host", target_host),
+                         query, millisSince(started));
+        }
+    } else if (MYSQL_RES* res = mysql_use_result(connection)) {
+        if (mysql_num_fields(res) != expected_columns) {
+            logStatement(Logger::error("db", "Row schema mismatch")
+                             .field("expected_columns", expected_columns)
+                             .field("columns", mysql_num_fields(res)),
+                         query, millisSince(started));
+        } else {
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr) {
+                on_row(row, mysql_fetch_lengths(res));
+            }
+            // fetch_row returns null both at the end and on a dropped connection
+            ok = mysql_errno(connection) == 0;
+            if (ok) {
+                noteLatency(query, millisSince(started));
+            } else if (!statement.timedOut()) {
+                logStatement(Logger::error("db", "Stream failed")
+                                 .field("error", mysql_error(connection))
+                                 .field("host", target_host),
+                             query, millisSince(started));
+            }
+        }
+        mysql_free_result(res);
+    }
+    statement.finish();
+    
+    mysql_close(connection);
+    return ok;
 }
 
-bool Database::executeDelete(const std::string& query) {
+MYSQL* Database::openPrimaryConnection() {
+    MYSQL* connection = mysql_init(nullptr);
     if (!connection) {
-        std::cerr << "Database not connected" << std::endl;
+        Logger::error("db", "MySQL initialization failed");
+        return nullptr;
+    }
+    if (!mysql_real_connect(connection, host.c_str(), user.c_str(), password.c_str(),
+                            database.c_str(), port, nullptr, 0)) {
+        Logger::error("db", "Connection failed").field("host", host).field("port", port).field("error", mysql_error(connection));
+        mysql_close(connection);
+        return nullptr;
+    }
+    return connection;
+}
+
+void Database::noteLatency(const std::string& query, long long latency_ms) {
+    if (slow_statement_ms > 0 && latency_ms >= slow_statement_ms) {
+        logStatement(Logger::warn("db", "Slow statement"), query, latency_ms);
+    }
+}
+
+void Database::noteWrite() {
+    if (session.active) {
+        session.wrote = true;
+    }
+}
+
+bool Database::runStatement(const std::string& query, const char* label) {
+    if (statement_observer) statement_observer(query);
+    
+    Tracer::Span span("db.execute", "db");
+    if (span) span.arg("sql", query.substr(0, 300));
+    Lease connection = checkout(primary, query);
+    if (!connection) {
+        if (!connection.timedOut()) Logger::error("db", "Database not connected");
         return false;
     }
     
-    if (mysql_query(connection, query.c_str())) {
-        std::cerr << "Delete Error: " << mysql_error(connection) << std::endl;
+    auto started = std::chrono::steady_clock::now();
+    Statement statement(*this, connection.get(), primary.host, primary.port, query);
+    if (!statement.send()) {
+        if (statement.timedOut()) return false;
+        logStatement(Logger::error("db", "Statement failed")
+                         .field("kind", label)
+                         .field("error", mysql_error(connection.get())),
+                     query, millisSince(started));
+        if (isConnectionLost(connection.get())) connection.discard();
         return false;
     }
+    statement.finish();
+    noteLatency(query, millisSince(started));
     
+    last_insert_id = static_cast<int>(mysql_insert_id(connection.get()));
+    last_affected_rows = static_cast<long long>(mysql_affected_rows(connection.get()));
+    noteWrite();
     return true;
 }
 
+bool Database::executeUpdate(const std::string& query) {
+    return runStatement(query, "Update");
+}
+
+bool Database::executeInsert(const std::string& query) {
+    return runStatement(query, "Insert");
+}
+
+bool Database::executeDelete(const std::string& query) {
+    return runStatement(query, "Delete");
+}
+
 int Database::getLastInsertId() {
-    if (!connection) return -1;
-    return static_cast<int>(mysql_insert_id(connection));
+    return last_insert_id;
+}
+
+long long Database::getAffectedRows() {
+    return last_affected_rows;
 }
 
 bool Database::ping() {
+    Lease connection = checkout(primary, "PING");
     if (!connection) return false;
-    return mysql_ping(connection) == 0;
+    if (mysql_ping(connection.get()) == 0) return true;
+    connection.discard();
+    return false;
 }
 
 json Database::getQueryResult(const std::string& query) {
     return executeQuery(query);
 }
+
+json Database::getReplicaStatus() {
+    json status = json::array();
+    for (auto& replica : replicas) {
+        status.push_back(json{
+            {"host", replica->host},
+            {"port", replica->port},
+            {"healthy", replica->healthy.load()}
+        });
+    }
+    return status;
+}
+
+json Database::getPoolStatus() {
+    auto describe = [](Endpoint& endpoint) {
+        json pools = json::object();
+        std::lock_guard<std::mutex> guard(endpoint.lock);
+        for (const auto& [id, pool] : endpoint.pools) {
+            pools[pool.name] = {
+                {"capacity", pool.capacity},
+                {"open", pool.open},
+                {"idle", pool.idle.size()}
+            };
+        }
+        return json{{"host", endpoint.host}, {"port", endpoint.port}, {"pools", pools}};
+    };
+    json status = json::array();
+    status.push_back(describe(primary));
+    for (auto& replica : replicas) {
+        status.push_back(describe(*replica));
+    }
+    return status;
+}
@@ -0,0 +1,101 @@
+#include "database/delta_sync.h"
+#include "logging/logger.h"
+#include <atomic>
+#include <cctype>
+#include <sstream>
+#include <thread>
+
+namespace delta_sync {
+
+namespace {
+
+std::atomic<int> retention_days{30};
+
+// Digits at every position except the separators
+bool matchesPattern(const std::string& value, const std::string& pattern) {
+    if (value.size() != pattern.size()) return false;
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (pattern[i] == '0' ? !std::isdigit(static_cast<unsigned char>(value[i])) : value[i] != pattern[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+std::optional<std::string> sinceExpression(const std::string& since) {
+    if (!since.empty() && since.size() <= 12 && matchesPattern(since, std::string(since.size(), '0'))) {
+        return "FROM_UNIXTIME(" + since + ")";
+    }
+    if (matchesPattern(since, "0000-00-00")) {
+        return "'" + since + " 00:00:00'";
+    }
+    if (matchesPattern(since, "0000-00-00 00:00:00")) {
+        return "'" + since + "'";
+    }
+    if (matchesPattern(since, "0000-00-00T00:00:00")) {
+        return "'" + since.substr(0, 10) + " " + since.substr(11) + "'";
+    }
+    return std::nullopt;
+}
+
+Window open(Database& db, const std::string& since_expression) {
+    std::stringstream ss;
+    ss << "SELECT UNIX_TIMESTAMP(NOW()) - " << overlapSeconds << " AS next_since, "
+       << "(" << since_expression << " < NOW() - INTERVAL " << retention_days.load() << " DAY) AS expired";
+
+    Window window;
+    json result = db.executeRead(ss.str());
+    if (!result.is_array() || result.empty()) return window;
+
+    const json& row = result[0];
+    window.ok = true;
+    window.next_since = row["next_since"].is_string() ? row["next_since"].get<std::string>()
+                                                      : row["next_since"].dump();
+    window.expired = row["expired"] == 1;
+    return window;
+}
+
+std::optional<std::vector<int>> deletedIds(Database& db, const std::string& table,
+                                           const std::string& since_expression) {
+    std::stringstream ss;
+    ss << "SELECT DISTINCT row_id FROM deleted_rows WHERE table_name = '" << table << "' "
+       << "AND deleted_at >= " << since_expression;
+
+    std::vector<int> ids;
+    bool ok = db.streamUnbuffered(ss.str(), 1, [&ids](char** row, unsigned long*) {
+        ids.push_back(std::atoi(row[0]));
+    });
+    if (!ok) return std::nullopt;
+    return ids;
+}
+
+void setRetentionDays(int days) {
+    retention_days = days;
+}
+
+int retentionDays() {
+    return retention_days;
+}
+
+bool purge(Database& db) {
+    std::stringstream ss;
+    ss << "DELETE FROM deleted_rows WHERE deleted_at < NOW() - INTERVAL " << retention_days.load() << " DAY";
+    if (!db.executeDelete(ss.str())) {
+        Logger::error("delta_sync", "Tombstone purge failed");
+        return false;
+    }
+    return true;
+}
+
+void startPurgeJob(Database& db, std::chrono::hours interval) {
+    std::thread([&db, interval] {
+        for (;;) {
+            std::this_thread::sleep_for(interval);
+            purge(db);
+        }
+    }).detach();
+}
+
+} // namespace delta_sync
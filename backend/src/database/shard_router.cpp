@@ -0,0 +1,56 @@
+#include "database/shard_router.h"
+#include "logging/logger.h"
+
+Database& ShardRouter::addShard(int branch_id, const std::string& host, const std::string& user,
+                                const std::string& password, const std::string& database,
+                                unsigned int port) {
+    if (shards.empty()) {
+        home_branch = branch_id;
+    }
+    auto& shard = shards[branch_id];
+    shard = std::make_unique<Database>(host, user, password, database, port);
+    shard->setBranchId(branch_id);
+    return *shard;
+}
+
+bool ShardRouter::connect() {
+    bool ok = true;
+    for (auto& [branch_id, db] : shards) {
+        if (!db->connect()) {
+            Logger::error("shards", "Failed to connect to branch").field("branch_id", branch_id);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+Database* ShardRouter::find(int branch_id) {
+    auto it = shards.find(branch_id);
+    return it == shards.end() ? nullptr : it->second.get();
+}
+
+Database& ShardRouter::home() {
+    return *shards.at(home_branch);
+}
+
+std::vector<int> ShardRouter::branches() const {
+    std::vector<int> ids;
+    for (const auto& [branch_id, db] : shards) {
+        ids.push_back(branch_id);
+    }
+    return ids;
+}
+
+json ShardRouter::getStatus() {
+    json status = json::array();
+    for (auto& [branch_id, db] : shards) {
+        status.push_back({
+            {"branch_id", branch_id},
+            {"home", branch_id == home_branch},
+            {"connected", db->isConnected()},
+            {"replicas", db->getReplicaStatus()},
+            {"pools", db->getPoolStatus()}
+        });
+    }
+    return status;
+}
@@ -0,0 +1,100 @@
+#include "database/statement_fingerprint.h"
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+
+namespace {
+
+bool isWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+// Appends a placeholder, folding "?, ?" into "?+"
+void placeholder(std::string& out) {
+    size_t end = out.size();
+    while (end > 0 && out[end - 1] == ' ') end--;
+    if (end > 0 && out[end - 1] == ',') {
+        size_t before = end - 1;
+        while (before > 0 && out[before - 1] == ' ') before--;
+        if (before > 0 && out[before - 1] == '+') before--;
+        if (before > 0 && out[before - 1] == '?') {
+            out.resize(before);
+            out += "+";
+            return;
+        }
+    }
+    out += '?';
+}
+
+} // namespace
+
+namespace statement_fingerprint {
+
+std::string normalize(const std::string& sql) {
+    std::string out;
+    out.reserve(sql.size());
+    size_t i = 0;
+    while (i < sql.size()) {
+        char c = sql[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            while (i < sql.size() && std::isspace(static_cast<unsigned char>(sql[i]))) i++;
+            if (!out.empty()) out += ' ';
+            continue;
+        }
+        if (c == '\'' || c == '"') {
+            // Quoted string; backslash escapes and doubled quotes stay inside
+            i++;
+            while (i < sql.size()) {
+                if (sql[i] == '\\') {
+                    i += 2;
+                } else if (sql[i] == c) {
+                    if (i + 1 < sql.size() && sql[i + 1] == c) {
+                        i += 2;
+                    } else {
+                        i++;
+                        break;
+                    }
+                } else {
+                    i++;
+                }
+            }
+            placeholder(out);
+            continue;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) && (out.empty() || !isWordChar(out.back()))) {
+            while (i < sql.size() && (isWordChar(sql[i]) || sql[i] == '.')) i++;
+            placeholder(out);
+            continue;
+        }
+        if (c == '`') {
+            // Quoted identifier, kept as is
+            size_t close = sql.find('`', i + 1);
+            close = close == std::string::npos ? sql.size() : close + 1;
+            out.append(sql, i, close - i);
+            i = close;
+            continue;
+        }
+        out += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        i++;
+    }
+    while (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+std::string of(const std::string& sql) {
+    return hash(normalize(sql));
+}
+
+std::string hash(const std::string& normalized) {
+    // FNV-1a
+    std::uint64_t value = 14695981039346656037ull;
+    for (char c : normalized) {
+        value ^= static_cast<unsigned char>(c);
+        value *= 1099511628211ull;
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(value));
+    return hex;
+}
+
+} // namespace statement_fingerprint
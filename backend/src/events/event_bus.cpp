@@ -0,0 +1,209 @@
+#include "events/event_bus.h"
+#include "logging/logger.h"
+#include <chrono>
+
+EventBus& EventBus::instance() {
+    static EventBus bus;
+    return bus;
+}
+
+EventBus::~EventBus() {
+    {
+        std::lock_guard<std::mutex> guard(wake_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (dispatcher.joinable()) {
+        dispatcher.join();
+    }
+}
+
+EventBus::SubscriberId EventBus::subscribe(Sink sink) {
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->sink = std::move(sink);
+
+    SubscriberId subscriber_id;
+    {
+        std::unique_lock<std::shared_mutex> guard(subscribers_lock);
+        subscriber_id = next_id++;
+        subscribers[subscriber_id] = subscriber;
+    }
+    ensureDispatcher();
+    return subscriber_id;
+}
+
+void EventBus::unsubscribe(SubscriberId subscriber_id) {
+    std::shared_ptr<Subscriber> subscriber;
+    {
+        std::unique_lock<std::shared_mutex> guard(subscribers_lock);
+        auto it = subscribers.find(subscriber_id);
+        if (it == subscribers.end()) return;
+        subscriber = it->second;
+        subscribers.erase(it);
+    }
+    // Wait for a send that may be in flight; the sink's target is about to go away
+    std::lock_guard<std::mutex> guard(subscriber->send_lock);
+    subscriber->sink = nullptr;
+}
+
+void EventBus::publish(int branch_id, const std::string& entity, const std::string& action,
+                       int id, json delta) {
+    published++;
+
+    ChangeEvent event{branch_id, entity, action, id, std::move(delta)};
+    std::string key = std::to_string(branch_id) + ":" + entity + ":" + std::to_string(id);
+    size_t capacity = queue_capacity.load();
+
+    {
+        std::shared_lock<std::shared_mutex> guard(subscribers_lock);
+        if (subscribers.empty()) return;
+
+        for (auto& entry : subscribers) {
+            Subscriber& subscriber = *entry.second;
+            std::lock_guard<std::mutex> queue_guard(subscriber.queue_lock);
+
+            if (subscriber.overflowed) {
+                subscriber.dropped++;
+                continue;
+            }
+
+            auto slot = subscriber.pending_index.find(key);
+            if (slot != subscriber.pending_index.end()) {
+                merge(subscriber.pending[slot->second], event);
+                coalesced++;
+                continue;
+            }
+
+            if (subscriber.pending.size() >= capacity) {
+                // Stalled consumer: drop its backlog and tell it to refetch
+                subscriber.dropped += subscriber.pending.size() + 1;
+                subscriber.pending.clear();
+                subscriber.pending_index.clear();
+                subscriber.overflowed = true;
+                overflows++;
+                continue;
+            }
+
+            subscriber.pending_index[key] = subscriber.pending.size();
+            subscriber.pending.push_back(event);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(wake_lock);
+        dirty = true;
+    }
+    wake.notify_one();
+}
+
+void EventBus::merge(ChangeEvent& into, const ChangeEvent& from) {
+    if (from.action == "deleted") {
+        into.action = "deleted";
+        into.delta = json::object();
+        return;
+    }
+    if (into.action == "deleted") {
+        into.action = from.action;
+    } else if (into.action != "created") {
+        into.action = from.action;
+    }
+
+    for (auto it = from.delta.begin(); it != from.delta.end(); ++it) {
+        const std::string& field = it.key();
+        bool relative = field.size() > 6 && field.compare(field.size() - 6, 6, "_delta") == 0;
+        if (relative && into.delta.contains(field) && into.delta[field].is_number()) {
+            into.delta[field] = into.delta[field].get<int>() + it.value().get<int>();
+        } else {
+            into.delta[field] = it.value();
+        }
+    }
+}
+
+void EventBus::ensureDispatcher() {
+    std::lock_guard<std::mutex> guard(wake_lock);
+    if (!dispatcher.joinable() && !stopping) {
+        dispatcher = std::thread(&EventBus::dispatchLoop, this);
+    }
+}
+
+void EventBus::dispatchLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(wake_lock);
+            wake.wait(guard, [this] { return dirty || stopping; });
+            if (stopping) return;
+            dirty = false;
+        }
+
+        std::vector<std::shared_ptr<Subscriber>> targets;
+        {
+            std::shared_lock<std::shared_mutex> guard(subscribers_lock);
+            targets.reserve(subscribers.size());
+            for (auto& entry : subscribers) {
+                targets.push_back(entry.second);
+            }
+        }
+
+        for (auto& subscriber : targets) {
+            flush(*subscriber);
+        }
+
+        // Batch whatever arrives during the interval into the next frame
+        std::this_thread::sleep_for(std::chrono::milliseconds(flush_interval_ms.load()));
+    }
+}
+
+void EventBus::flush(Subscriber& subscriber) {
+    std::vector<ChangeEvent> batch;
+    bool resync = false;
+    {
+        std::lock_guard<std::mutex> guard(subscriber.queue_lock);
+        batch.swap(subscriber.pending);
+        subscriber.pending_index.clear();
+        resync = subscriber.overflowed;
+        subscriber.overflowed = false;
+    }
+    if (batch.empty() && !resync) return;
+
+    json frame = json::object();
+    frame["seq"] = ++sequence;
+    if (resync) {
+        frame["type"] = "resync";
+    } else {
+        json events = json::array();
+        for (const auto& event : batch) {
+            events.push_back(json{
+                {"branch_id", event.branch_id},
+                {"entity", event.entity},
+                {"action", event.action},
+                {"id", event.id},
+                {"delta", event.delta}
+            });
+        }
+        frame["type"] = "changes";
+        frame["events"] = std::move(events);
+    }
+
+    std::lock_guard<std::mutex> guard(subscriber.send_lock);
+    if (!subscriber.sink) return;
+    try {
+        subscriber.sink(frame.dump());
+    } catch (const std::exception& e) {
+        Logger::error("events", "Event dispatch failed").field("error", e.what());
+    }
+}
+
+json EventBus::getStats() const {
+    size_t subscriber_count;
+    {
+        std::shared_lock<std::shared_mutex> guard(subscribers_lock);
+        subscriber_count = subscribers.size();
+    }
+    return json{
+        {"subscribers", subscriber_count},
+        {"published", published.load()},
+        {"coalesced", coalesced.load()},
+        {"overflows", overflows.load()},
+        {"frames_sent", sequence.load()}
+    };
+}
@@ -0,0 +1,243 @@
+#include "index/roaring_bitmap.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+inline bool testBit(const std::vector<uint64_t>& bits, uint16_t low) {
+    return (bits[low >> 6] >> (low & 63)) & 1;
+}
+
+} // namespace
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (isBitmap()) return testBit(bits, low);
+    return std::binary_search(values.begin(), values.end(), low);
+}
+
+void RoaringBitmap::Container::add(uint16_t low) {
+    if (isBitmap()) {
+        uint64_t& word = bits[low >> 6];
+        uint64_t mask = uint64_t(1) << (low & 63);
+        if (!(word & mask)) {
+            word |= mask;
+            cardinality++;
+        }
+        return;
+    }
+    auto it = std::lower_bound(values.begin(), values.end(), low);
+    if (it != values.end() && *it == low) return;
+    values.insert(it, low);
+    cardinality++;
+    if (cardinality > arrayLimit) toBitmap();
+}
+
+void RoaringBitmap::Container::remove(uint16_t low) {
+    if (isBitmap()) {
+        uint64_t& word = bits[low >> 6];
+        uint64_t mask = uint64_t(1) << (low & 63);
+        if (word & mask) {
+            word &= ~mask;
+            cardinality--;
+            if (cardinality <= arrayLimit) toArray();
+        }
+        return;
+    }
+    auto it = std::lower_bound(values.begin(), values.end(), low);
+    if (it == values.end() || *it != low) return;
+    values.erase(it);
+    cardinality--;
+}
+
+void RoaringBitmap::Container::toBitmap() {
+    bits.assign(bitmapWords, 0);
+    for (uint16_t low : values) {
+        bits[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    std::vector<uint16_t>().swap(values);
+}
+
+void RoaringBitmap::Container::toArray() {
+    values.clear();
+    values.reserve(cardinality);
+    for (size_t word = 0; word < bitmapWords; ++word) {
+        uint64_t w = bits[word];
+        while (w) {
+            values.push_back(uint16_t(word * 64 + __builtin_ctzll(w)));
+            w &= w - 1;
+        }
+    }
+    std::vector<uint64_t>().swap(bits);
+}
+
+const RoaringBitmap::Container* RoaringBitmap::find(uint16_t key) const {
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    return it != containers.end() && it->key == key ? &*it : nullptr;
+}
+
+void RoaringBitmap::add(uint32_t value) {
+    uint16_t key = uint16_t(value >> 16);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) {
+        it = containers.insert(it, Container{});
+        it->key = key;
+    }
+    it->add(uint16_t(value));
+}
+
+void RoaringBitmap::remove(uint32_t value) {
+    uint16_t key = uint16_t(value >> 16);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) return;
+    it->remove(uint16_t(value));
+    if (it->cardinality == 0) containers.erase(it);
+}
+
+bool RoaringBitmap::contains(uint32_t value) const {
+    const Container* container = find(uint16_t(value >> 16));
+    return container && container->contains(uint16_t(value));
+}
+
+uint64_t RoaringBitmap::cardinality() const {
+    uint64_t total = 0;
+    for (const auto& container : containers) total += container.cardinality;
+    return total;
+}
+
+size_t RoaringBitmap::memoryBytes() const {
+    size_t bytes = containers.capacity() * sizeof(Container);
+    for (const auto& container : containers) {
+        bytes += container.values.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container& a, const Container& b) {
+    Container out;
+    out.key = a.key;
+    if (a.isBitmap() && b.isBitmap()) {
+        out.bits.resize(bitmapWords);
+        for (size_t word = 0; word < bitmapWords; ++word) {
+            out.bits[word] = a.bits[word] & b.bits[word];
+            out.cardinality += __builtin_popcountll(out.bits[word]);
+        }
+        if (out.cardinality <= arrayLimit) out.toArray();
+        return out;
+    }
+    if (a.isBitmap() || b.isBitmap()) {
+        const Container& sparse = a.isBitmap() ? b : a;
+        const Container& dense = a.isBitmap() ? a : b;
+        for (uint16_t low : sparse.values) {
+            if (testBit(dense.bits, low)) out.values.push_back(low);
+        }
+    } else {
+        std::set_intersection(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                              std::back_inserter(out.values));
+    }
+    out.cardinality = uint32_t(out.values.size());
+    return out;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container& a, const Container& b) {
+    Container out;
+    out.key = a.key;
+    if (!a.isBitmap() && !b.isBitmap() && a.cardinality + b.cardinality <= arrayLimit) {
+        std::set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                       std::back_inserter(out.values));
+        out.cardinality = uint32_t(out.values.size());
+        return out;
+    }
+
+    out.bits.assign(bitmapWords, 0);
+    for (const Container* side : {&a, &b}) {
+        if (side->isBitmap()) {
+            for (size_t word = 0; word < bitmapWords; ++word) out.bits[word] |= side->bits[word];
+        } else {
+            for (uint16_t low : side->values) out.bits[low >> 6] |= uint64_t(1) << (low & 63);
+        }
+    }
+    for (uint64_t word : out.bits) out.cardinality += __builtin_popcountll(word);
+    if (out.cardinality <= arrayLimit) out.toArray();
+    return out;
+}
+
+uint32_t RoaringBitmap::intersectCount(const Container& a, const Container& b) {
+    uint32_t count = 0;
+    if (a.isBitmap() && b.isBitmap()) {
+        for (size_t word = 0; word < bitmapWords; ++word) {
+            count += __builtin_popcountll(a.bits[word] & b.bits[word]);
+        }
+    } else if (a.isBitmap() || b.isBitmap()) {
+        const Container& sparse = a.isBitmap() ? b : a;
+        const Container& dense = a.isBitmap() ? a : b;
+        for (uint16_t low : sparse.values) count += testBit(dense.bits, low);
+    } else {
+        auto i = a.values.begin();
+        auto j = b.values.begin();
+        while (i != a.values.end() && j != b.values.end()) {
+            if (*i < *j) ++i;
+            else if (*j < *i) ++j;
+            else { ++count; ++i; ++j; }
+        }
+    }
+    return count;
+}
+
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap& other) const {
+    RoaringBitmap out;
+    auto i = containers.begin();
+    auto j = other.containers.begin();
+    while (i != containers.end() && j != other.containers.end()) {
+        if (i->key < j->key) {
+            ++i;
+        } else if (j->key < i->key) {
+            ++j;
+        } else {
+            Container both = intersect(*i, *j);
+            if (both.cardinality > 0) out.containers.push_back(std::move(both));
+            ++i;
+            ++j;
+        }
+    }
+    return out;
+}
+
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap& other) const {
+    RoaringBitmap out;
+    out.containers.reserve(std::max(containers.size(), other.containers.size()));
+    auto i = containers.begin();
+    auto j = other.containers.begin();
+    while (i != containers.end() || j != other.containers.end()) {
+        if (j == other.containers.end() || (i != containers.end() && i->key < j->key)) {
+            out.containers.push_back(*i++);
+        } else if (i == containers.end() || j->key < i->key) {
+            out.containers.push_back(*j++);
+        } else {
+            out.containers.push_back(unite(*i, *j));
+            ++i;
+            ++j;
+        }
+    }
+    return out;
+}
+
+uint64_t RoaringBitmap::andCardinality(const RoaringBitmap& a, const RoaringBitmap& b) {
+    uint64_t count = 0;
+    auto i = a.containers.begin();
+    auto j = b.containers.begin();
+    while (i != a.containers.end() && j != b.containers.end()) {
+        if (i->key < j->key) {
+            ++i;
+        } else if (j->key < i->key) {
+            ++j;
+        } else {
+            count += intersectCount(*i, *j);
+            ++i;
+            ++j;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,379 @@
+#include "logging/logger.h"
+#include "tracing/tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <utility>
+
+namespace {
+
+std::int64_t epochMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 2026-10-18T09:30:00.123Z
+void appendTimestamp(std::string& out, std::int64_t timestamp_us) {
+    std::time_t seconds = static_cast<std::time_t>(timestamp_us / 1000000);
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    char buffer[32];
+    size_t size = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+    size += std::snprintf(buffer + size, sizeof(buffer) - size, ".%03dZ",
+                          static_cast<int>((timestamp_us / 1000) % 1000));
+    out.append(buffer, size);
+}
+
+} // namespace
+
+Logger::Entry::Entry(LogLevel entry_level, const char* component, const char* message) : level(entry_level) {
+    Logger& logger = Logger::instance();
+    if (!logger.enabled(level)) return;
+    timestamp_us = epochMicros();
+
+    unsigned int suppressed_before = 0;
+    if (level >= LogLevel::Warn && !logger.admit(component, message, timestamp_us, suppressed_before)) return;
+
+    active = true;
+    field("component", component);
+    field("msg", message);
+    const std::string& request_id = Tracer::currentRequestId();
+    if (!request_id.empty()) field("request_id", request_id);
+    if (suppressed_before > 0) field("suppressed", suppressed_before);
+}
+
+Logger::Entry::~Entry() {
+    if (!active) return;
+    Logger::instance().submit(level, timestamp_us, truncated, text, length);
+}
+
+void Logger::Entry::raw(const char* value, size_t size) {
+    if (overflow || length + size > line_capacity) {
+        overflow = true;
+        return;
+    }
+    std::memcpy(text + length, value, size);
+    length += size;
+}
+
+void Logger::Entry::key(const char* name) {
+    if (length > 0) raw(",", 1);
+    quoted(name, std::strlen(name));
+    raw(":", 1);
+}
+
+// JSON string; a value too long for the record is cut short, and bytes
+// that are not valid UTF-8 become U+FFFD
+void Logger::Entry::quoted(const char* value, size_t size) {
+    if (overflow || length + 2 > line_capacity) {
+        overflow = true;
+        return;
+    }
+    text[length++] = '"';
+    size_t room = line_capacity - 1;   // keep one byte for the closing quote
+    size_t i = 0;
+    while (i < size) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        const char* piece = value + i;
+        size_t piece_size = 1;
+        size_t consumed = 1;
+        char escaped[8];
+        if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t') {
+            escaped[0] = '\\';
+            escaped[1] = c == '\n' ? 'n' : c == '\r' ? 'r' : c == '\t' ? 't' : static_cast<char>(c);
+            piece = escaped;
+            piece_size = 2;
+        } else if (c < 0x20) {
+            piece_size = static_cast<size_t>(std::snprintf(escaped, sizeof(escaped), "\\u%04x", c));
+            piece = escaped;
+        } else if (c >= 0x80) {
+            size_t expected = 0;
+            unsigned char low = 0x80, high = 0xBF;   // allowed range of the second byte
+            if (c >= 0xC2 && c <= 0xDF) expected = 2;
+            else if (c >= 0xE0 && c <= 0xEF) expected = 3;
+            else if (c >= 0xF0 && c <= 0xF4) expected = 4;
+            if (c == 0xE0) low = 0xA0;
+            if (c == 0xED) high = 0x9F;
+            if (c == 0xF0) low = 0x90;
+            if (c == 0xF4) high = 0x8F;
+            size_t valid = 1;
+            while (valid < expected && i + valid < size) {
+                unsigned char next = static_cast<unsigned char>(value[i + valid]);
+                bool ok = valid == 1 ? next >= low && next <= high : (next & 0xC0) == 0x80;
+                if (!ok) break;
+                valid++;
+            }
+            if (expected > 0 && valid == expected) {
+                piece_size = consumed = expected;
+            } else {
+                piece = "\\ufffd";
+                piece_size = 6;
+                consumed = valid;
+            }
+        }
+        if (length + piece_size > room) {
+            truncated = true;
+            break;
+        }
+        std::memcpy(text + length, piece, piece_size);
+        length += piece_size;
+        i += consumed;
+    }
+    text[length++] = '"';
+}
+
+// Keeps the field just written, or rolls back to `mark` if it did not fit
+Logger::Entry& Logger::Entry::commit(size_t mark) {
+    if (overflow) {
+        length = mark;
+        overflow = false;
+        truncated = true;
+    }
+    return *this;
+}
+
+Logger::Entry& Logger::Entry::field(const char* name, const std::string& value) {
+    if (!active) return *this;
+    size_t mark = length;
+    key(name);
+    quoted(value.data(), value.size());
+    return commit(mark);
+}
+
+Logger::Entry& Logger::Entry::field(const char* name, const char* value) {
+    if (!active) return *this;
+    size_t mark = length;
+    key(name);
+    if (value) {
+        quoted(value, std::strlen(value));
+    } else {
+        raw("null", 4);
+    }
+    return commit(mark);
+}
+
+Logger::Entry& Logger::Entry::field(const char* name, long long value) {
+    if (!active) return *this;
+    char number[24];
+    int size = std::snprintf(number, sizeof(number), "%lld", value);
+    size_t mark = length;
+    key(name);
+    raw(number, static_cast<size_t>(size));
+    return commit(mark);
+}
+
+Logger::Entry& Logger::Entry::field(const char* name, unsigned long long value) {
+    if (!active) return *this;
+    char number[24];
+    int size = std::snprintf(number, sizeof(number), "%llu", value);
+    size_t mark = length;
+    key(name);
+    raw(number, static_cast<size_t>(size));
+    return commit(mark);
+}
+
+Logger::Entry& Logger::Entry::field(const char* name, double value) {
+    if (!active) return *this;
+    char number[32];
+    int size = std::isfinite(value) ? std::snprintf(number, sizeof(number), "%.6g", value)
+                                    : std::snprintf(number, sizeof(number), "null");
+    size_t mark = length;
+    key(name);
+    raw(number, static_cast<size_t>(size));
+    return commit(mark);
+}
+
+Logger::Entry& Logger::Entry::field(const char* name, bool value) {
+    if (!active) return *this;
+    size_t mark = length;
+    key(name);
+    raw(value ? "true" : "false", value ? 4 : 5);
+    return commit(mark);
+}
+
+Logger& Logger::instance() {
+    // Never destroyed: detached threads may still log during exit
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+Logger::Logger() {
+    std::thread([this] { writerLoop(); }).detach();
+    std::atexit([] { Logger::instance().flush(); });
+}
+
+Logger::Ring* Logger::threadRing() {
+    // Marks the ring closed when its thread exits; the writer frees it once
+    // it has been drained
+    struct Owner {
+        std::shared_ptr<Ring> ring;
+        ~Owner() {
+            if (ring) ring->closed = true;
+        }
+    };
+    thread_local Owner owner;
+    if (!owner.ring) {
+        owner.ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> guard(rings_lock);
+        rings.push_back(owner.ring);
+    }
+    return owner.ring.get();
+}
+
+bool Logger::admit(const char* component, const char* message, std::int64_t now_us,
+                   unsigned int& suppressed_before) {
+    // Both are string literals, so their addresses identify the call site
+    std::uint64_t site = reinterpret_cast<std::uintptr_t>(message) * 0x9E3779B97F4A7C15ull
+                         ^ reinterpret_cast<std::uintptr_t>(component);
+    Bucket& bucket = buckets[(site >> 32) % bucket_count];
+
+    std::int64_t window = now_us / 1000000 / window_seconds;
+    std::int64_t current = bucket.window.load(std::memory_order_relaxed);
+    if (current != window && bucket.window.compare_exchange_strong(current, window)) {
+        bucket.count = 0;
+    }
+    if (bucket.count.fetch_add(1, std::memory_order_relaxed) >= burst) {
+        bucket.suppressed.fetch_add(1, std::memory_order_relaxed);
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    suppressed_before = bucket.suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+void Logger::submit(LogLevel level, std::int64_t timestamp_us, bool truncated, const char* text, size_t length) {
+    Ring* ring = threadRing();
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= Ring::slots) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Record& record = ring->records[head % Ring::slots];
+    record.timestamp_us = timestamp_us;
+    record.level = level;
+    record.truncated = truncated;
+    record.length = static_cast<std::uint16_t>(length);
+    std::memcpy(record.text, text, length);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Logger::writerLoop() {
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        drain();
+    }
+}
+
+void Logger::flush() {
+    drain();
+}
+
+void Logger::drain() {
+    std::lock_guard<std::mutex> output_guard(output_lock);
+
+    std::vector<std::shared_ptr<Ring>> current;
+    {
+        std::lock_guard<std::mutex> guard(rings_lock);
+        current = rings;
+    }
+
+    // Merge the rings' records in time order
+    std::vector<std::pair<std::int64_t, std::string>> lines;
+    std::vector<Ring*> finished;
+    for (const auto& ring : current) {
+        bool closed = ring->closed.load(std::memory_order_acquire);
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            const Record& record = ring->records[tail % Ring::slots];
+            std::string line = "{\"ts\":\"";
+            line.reserve(record.length + 64);
+            appendTimestamp(line, record.timestamp_us);
+            line += "\",\"level\":\"";
+            line += levelName(record.level);
+            line += "\",";
+            line.append(record.text, record.length);
+            if (record.truncated) line += ",\"truncated\":true";
+            line += "}\n";
+            lines.emplace_back(record.timestamp_us, std::move(line));
+        }
+        ring->tail.store(tail, std::memory_order_release);
+        if (closed) finished.push_back(ring.get());
+    }
+
+    if (!finished.empty()) {
+        std::lock_guard<std::mutex> guard(rings_lock);
+        rings.erase(std::remove_if(rings.begin(), rings.end(), [&finished](const std::shared_ptr<Ring>& ring) {
+            return std::find(finished.begin(), finished.end(), ring.get()) != finished.end();
+        }), rings.end());
+    }
+
+    if (lines.empty()) return;
+    std::stable_sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::string batch;
+    for (const auto& line : lines) batch += line.second;
+    std::fwrite(batch.data(), 1, batch.size(), output);
+    std::fflush(output);
+    written.fetch_add(lines.size(), std::memory_order_relaxed);
+    batches++;
+}
+
+bool Logger::setOutput(const std::string& path) {
+    std::FILE* file = stderr;
+    if (!path.empty()) {
+        file = std::fopen(path.c_str(), "a");
+        if (!file) return false;
+    }
+    std::lock_guard<std::mutex> guard(output_lock);
+    if (output != stderr) std::fclose(output);
+    output = file;
+    output_path = path;
+    return true;
+}
+
+json Logger::getStats() const {
+    size_t threads = 0;
+    {
+        std::lock_guard<std::mutex> guard(rings_lock);
+        threads = rings.size();
+    }
+    std::string path;
+    {
+        std::lock_guard<std::mutex> guard(output_lock);
+        path = output_path;
+    }
+    return {
+        {"level", levelName(getLevel())},
+        {"output", path.empty() ? "stderr" : path},
+        {"written", written.load()},
+        {"dropped", dropped.load()},
+        {"suppressed", suppressed.load()},
+        {"batches", batches.load()},
+        {"threads", threads},
+        {"ring_slots", Ring::slots},
+        {"rate_limit", {{"burst", burst}, {"window_seconds", window_seconds}}}
+    };
+}
+
+bool Logger::parseLevel(const std::string& name, LogLevel& level) {
+    if (name == "debug") level = LogLevel::Debug;
+    else if (name == "info") level = LogLevel::Info;
+    else if (name == "warn" || name == "warning") level = LogLevel::Warn;
+    else if (name == "error") level = LogLevel::Error;
+    else return false;
+    return true;
+}
+
+const char* Logger::levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Info: return "info";
+        case LogLevel::Warn: return "warn";
+        case LogLevel::Error: return "error";
+    }
+    return "info";
+}
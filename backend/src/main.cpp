@@ -1,35 +1,262 @@
 #include "crow_all.h"
-#include "database/db_connection.h"
+#include "database/shard_router.h"
 #include "routes/books_routes.h"
 #include "routes/members_routes.h"
 #include "routes/borrowing_routes.h"
 #include "routes/reports_routes.h"
 #include "routes/settings_routes.h"
-#include <iostream>
+#include "routes/events_routes.h"
+#include "routes/admission_routes.h"
+#include "routes/admin_routes.h"
+#include "routes/branch_routes.h"
+#include "services/settings_cache.h"
+#include "services/loan_counters.h"
+#include "services/co_borrow_index.h"
+#include "services/catalog_facets.h"
+#include "services/title_autocomplete.h"
+#include "services/circulation_columns.h"
+#include "services/name_directory.h"
+#include "snapshot/warm_restart.h"
+#include "database/delta_sync.h"
+#include "cdc/binlog_consumer.h"
+#include "logging/logger.h"
+#include "tracing/tracer.h"
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
+namespace {
+
+// Crow's own messages, including its per-request lines, go through the
+// asynchronous logger too
+class CrowLogHandler : public crow::ILogHandler {
+public:
+    void log(std::string message, crow::LogLevel level) override {
+        LogLevel mapped = LogLevel::Error;
+        switch (level) {
+            case crow::LogLevel::DEBUG: mapped = LogLevel::Debug; break;
+            case crow::LogLevel::INFO: mapped = LogLevel::Info; break;
+            case crow::LogLevel::WARNING: mapped = LogLevel::Warn; break;
+            default: break;
+        }
+        Logger::Entry(mapped, "http", "Crow").field("detail", message);
+    }
+};
+
+// Applies a "class=value,..." list from the environment to the admission limits
+template <typename F>
+void configureRouteClasses(const char* variable, F&& apply) {
+    const char* value = std::getenv(variable);
+    if (!value) return;
+    std::stringstream list(value);
+    std::string entry;
+    while (std::getline(list, entry, ',')) {
+        auto equals = entry.find('=');
+        if (equals == std::string::npos) continue;
+        auto route_class = parseRouteClass(entry.substr(0, equals));
+        if (!route_class) {
+            Logger::warn("server", "Unknown route class").field("variable", variable).field("entry", entry);
+            continue;
+        }
+        AdmissionLimits limits = AdmissionController::instance().limits(*route_class);
+        apply(limits, std::atoi(entry.substr(equals + 1).c_str()));
+        AdmissionController::instance().configure(*route_class, limits);
+    }
+}
+
+} // namespace
+
 int main() {
+    // Structured log lines go to LOG_FILE (default stderr) from a background
+    // writer; LOG_LEVEL is debug, info, warn or error
+    if (const char* level_name = std::getenv("LOG_LEVEL")) {
+        LogLevel level;
+        if (Logger::parseLevel(level_name, level)) {
+            Logger::instance().setLevel(level);
+        }
+    }
+    if (const char* log_file = std::getenv("LOG_FILE")) {
+        if (!Logger::instance().setOutput(log_file)) {
+            Logger::error("server", "Cannot open log file, logging to stderr").field("path", log_file);
+        }
+    }
+    
+    static CrowLogHandler crow_log_handler;
+    crow::logger::setHandler(&crow_log_handler);
+    
     crow::SimpleApp app;
     
     // Database connection
     // Update these credentials to match your MySQL setup
-    Database db("localhost", "root", "password", "library_db", 3306);
+    ShardRouter shards;
+    Database& db = shards.addShard(1, "localhost", "root", "password", "library_db", 3306);
+    
+    // Read replicas, e.g. DB_REPLICAS="127.0.0.1:3307,127.0.0.1:3308"
+    if (const char* replicas = std::getenv("DB_REPLICAS")) {
+        std::stringstream list(replicas);
+        std::string entry;
+        while (std::getline(list, entry, ',')) {
+            if (entry.empty()) continue;
+            auto colon = entry.rfind(':');
+            if (colon == std::string::npos) {
+                db.addReplica(entry);
+            } else {
+                db.addReplica(entry.substr(0, colon), std::stoi(entry.substr(colon + 1)));
+            }
+        }
+    }
+    if (const char* wait_ms = std::getenv("DB_REPLICA_WAIT_MS")) {
+        db.setReplicaWaitMs(std::atoi(wait_ms));
+    }
+    
+    // Fraction of requests traced, e.g. TRACE_SAMPLE_RATE=0.01
+    if (const char* sample_rate = std::getenv("TRACE_SAMPLE_RATE")) {
+        Tracer::instance().setSampleRate(std::atof(sample_rate));
+    }
+    
+    // Other branches, each on its own server, e.g. DB_SHARDS="2=127.0.0.1:3310,3=127.0.0.1:3311".
+    // Branch 1 (above) is the home branch and also holds the library-wide settings.
+    if (const char* branches = std::getenv("DB_SHARDS")) {
+        std::stringstream list(branches);
+        std::string entry;
+        while (std::getline(list, entry, ',')) {
+            auto equals = entry.find('=');
+            if (equals == std::string::npos) continue;
+            int branch_id = std::stoi(entry.substr(0, equals));
+            std::string address = entry.substr(equals + 1);
+            auto colon = address.rfind(':');
+            if (colon == std::string::npos) {
+                shards.addShard(branch_id, address, "root", "password", "library_db");
+            } else {
+                shards.addShard(branch_id, address.substr(0, colon), "root", "password", "library_db",
+                                std::stoi(address.substr(colon + 1)));
+            }
+        }
+    }
+    
+    // Statements slower than this are logged with their fingerprint (0 disables it)
+    if (const char* slow_ms = std::getenv("DB_SLOW_STATEMENT_MS")) {
+        for (int branch_id : shards.branches()) {
+            shards.find(branch_id)->setSlowStatementMs(std::atoi(slow_ms));
+        }
+    }
+    
+    // Worker threads per route class, e.g. ROUTE_WORKERS="reporting=2,interactive_read=24".
+    // Each class also gets a pool of that many connections per database endpoint.
+    configureRouteClasses("ROUTE_WORKERS", [](AdmissionLimits& limits, int value) {
+        limits.max_concurrent = value;
+    });
+    // Request deadlines per route class, e.g. ROUTE_DEADLINES_MS="reporting=60000" (0 disables them)
+    configureRouteClasses("ROUTE_DEADLINES_MS", [](AdmissionLimits& limits, int value) {
+        limits.deadline = std::chrono::milliseconds(std::max(0, value));
+    });
     
-    if (!db.connect()) {
-        std::cerr << "Failed to connect to database" << std::endl;
+    if (!shards.connect()) {
+        Logger::error("server", "Failed to connect to database");
         return 1;
     }
     
-    std::cout << "Database connection successful" << std::endl;
+    Logger::info("server", "Database connection successful").field("branches", shards.size());
+    
+    // In-memory circulation state used by checkout, plus the facet bitmaps
+    // and autocomplete index. Each branch starts from its snapshot when there
+    // is a usable one and rebuilds from MySQL otherwise. Checkout enforces
+    // the settings' borrow limit, so there is no serving without them.
+    if (!SettingsCache::instance().load(db)) {
+        Logger::error("server", "Failed to load settings");
+        return 1;
+    }
+    std::string snapshot_dir = "snapshots";
+    if (const char* dir = std::getenv("SNAPSHOT_DIR")) {
+        snapshot_dir = dir;
+    }
+    int snapshot_minutes = 15;
+    if (const char* minutes = std::getenv("SNAPSHOT_MINUTES")) {
+        snapshot_minutes = std::max(1, std::atoi(minutes));
+    }
+    // Facets are rebuilt periodically to pick up changes made outside the API
+    int catalog_rebuild_minutes = 60;
+    if (const char* minutes = std::getenv("CATALOG_REBUILD_MINUTES")) {
+        catalog_rebuild_minutes = std::max(1, std::atoi(minutes));
+    }
+    for (int branch_id : shards.branches()) {
+        Database& branch_db = *shards.find(branch_id);
+        if (!warm_restart::restore(branch_db, branch_id, snapshot_dir)) {
+            if (!LoanCounters::of(branch_db).rebuild(branch_db)
+                || !CatalogFacets::of(branch_db).rebuild(branch_db)
+                || !TitleAutocomplete::of(branch_db).rebuild(branch_db)) {
+                return 1;
+            }
+        }
+        CatalogFacets::of(branch_db).startRebuildJob(branch_db, std::chrono::minutes(catalog_rebuild_minutes));
+        warm_restart::startSaveJob(branch_db, branch_id, snapshot_dir, std::chrono::minutes(snapshot_minutes));
+    }
+    
+    // Also-borrowed recommendations, rebuilt from history in the background
+    int related_rebuild_minutes = 360;
+    if (const char* minutes = std::getenv("RELATED_REBUILD_MINUTES")) {
+        related_rebuild_minutes = std::max(1, std::atoi(minutes));
+    }
+    for (int branch_id : shards.branches()) {
+        Database& branch_db = *shards.find(branch_id);
+        CoBorrowIndex::of(branch_db).startRebuildJob(branch_db, std::chrono::minutes(related_rebuild_minutes));
+    }
+    
+    // Columnar copy of the loan history for /api/reports/query, built in the
+    // background and refreshed from changed rows; 0 disables it
+    int analytics_refresh_seconds = 60;
+    if (const char* seconds = std::getenv("ANALYTICS_REFRESH_SECONDS")) {
+        analytics_refresh_seconds = std::max(0, std::atoi(seconds));
+    }
+    if (analytics_refresh_seconds > 0) {
+        for (int branch_id : shards.branches()) {
+            Database& branch_db = *shards.find(branch_id);
+            CirculationColumns::of(branch_db).startRefreshJob(branch_db, std::chrono::seconds(analytics_refresh_seconds));
+        }
+    }
+    
+    // Tombstones for ?since= delta sync; older clients must reload everything
+    if (const char* days = std::getenv("TOMBSTONE_RETENTION_DAYS")) {
+        delta_sync::setRetentionDays(std::max(1, std::atoi(days)));
+    }
+    for (int branch_id : shards.branches()) {
+        Database& branch_db = *shards.find(branch_id);
+        delta_sync::purge(branch_db);
+        delta_sync::startPurgeJob(branch_db, std::chrono::hours(24));
+    }
+    
+    // Names on loan reads are re-read after this long, which bounds how late
+    // a rename made elsewhere shows up without the binlog; 0 keeps them
+    if (const char* seconds = std::getenv("NAME_CACHE_TTL_SECONDS")) {
+        NameDirectory::setTtl(std::chrono::seconds(std::max(0, std::atoi(seconds))));
+    }
+    
+    // Follow each branch's binlog so writes from other instances (or plain
+    // SQL) reach the in-memory indexes. CDC_SERVER_ID must be unique among
+    // the instances and replicas of a primary; unset disables it.
+    if (const char* server_id = std::getenv("CDC_SERVER_ID")) {
+        unsigned int replica_server_id = unsigned(std::strtoul(server_id, nullptr, 10));
+        for (int branch_id : shards.branches()) {
+            Database& branch_db = *shards.find(branch_id);
+            BinlogConsumer& consumer = BinlogConsumer::of(branch_db);
+            consumer.addListener([](const std::set<std::string>&) { expireReportCache(); });
+            consumer.start(branch_db, branch_id, replica_server_id, &branch_db == &db);
+        }
+    }
     
     // Register all routes
-    registerBooksRoutes(app, db);
-    registerMembersRoutes(app, db);
-    registerBorrowingRoutes(app, db);
-    registerReportsRoutes(app, db);
+    registerBooksRoutes(app, shards);
+    registerMembersRoutes(app, shards);
+    registerBorrowingRoutes(app, shards);
+    registerReportsRoutes(app, shards);
     registerSettingsRoutes(app, db);
+    registerBranchRoutes(app, shards);
+    registerEventsRoutes(app);
+    registerAdmissionRoutes(app);
+    registerAdminRoutes(app);
     
     // Health check endpoint
     CROW_ROUTE(app, "/api/health")
@@ -52,14 +279,19 @@ int main() {
         auto response = crow::response(204);
         response.set_header("Access-Control-Allow-Origin", "*");
         response.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-        response.set_header("Access-Control-Allow-Headers", "Content-Type");
+        response.set_header("Access-Control-Allow-Headers", "Content-Type, X-Session-Token, X-Request-Id, X-Branch-Id");
         return response;
     });
     
-    std::cout << "Starting server on http://localhost:8080" << std::endl;
+    Logger::info("server", "Starting server").field("port", 8080);
     
     // Start server
     app.port(8080).multithreaded().run();
     
+    // Leave a fresh snapshot for the next start
+    for (int branch_id : shards.branches()) {
+        warm_restart::save(*shards.find(branch_id), branch_id, snapshot_dir);
+    }
+    
     return 0;
 }
@@ -1,29 +1,56 @@
 #include "models/book.h"
+#include "events/event_bus.h"
+#include "services/catalog_facets.h"
+#include "services/title_autocomplete.h"
+#include "services/name_directory.h"
 #include <sstream>
+#include <unordered_map>
 #include <iostream>
 
+namespace {
+
+// Hands the row as stored back to the in-memory catalog indexes after a write
+void reindexBook(Database& db, int book_id) {
+    std::optional<Book> book;
+    if (!Book(&db).getById(book_id, book) || !book) return;
+    CatalogFacets::of(db).upsert(*book);
+    TitleAutocomplete::of(db).upsert(*book);
+    NameDirectory::of(db).setBook(book_id, book->getTitle());
+}
+
+} // namespace
+
 Book::Book(Database* database) 
     : id(0), total_copies(0), available_copies(0), publication_year(0), db(database) {}
 
-json Book::getAll() {
-    std::string query = "SELECT * FROM books ORDER BY title";
-    return db->executeQuery(query);
+std::optional<std::vector<Book>> Book::getAll() {
+    std::string query = "SELECT " + row_schema::columnList<Book>() + " FROM books ORDER BY title";
+    return db->queryRows<Book>(query);
 }
 
-json Book::getById(int book_id) {
+// Rows updated at or after a delta_sync::sinceExpression()
+std::optional<std::vector<Book>> Book::getChangedSince(const std::string& since_expression) {
+    std::string query = "SELECT " + row_schema::columnList<Book>() + " FROM books WHERE updated_at >= "
+        + since_expression + " ORDER BY updated_at, id";
+    return db->queryRows<Book>(query);
+}
+
+bool Book::getById(int book_id, std::optional<Book>& book) {
     std::stringstream ss;
-    ss << "SELECT * FROM books WHERE id = " << book_id;
+    ss << "SELECT " << row_schema::columnList<Book>() << " FROM books WHERE id = " << book_id;
     
-    json result = db->executeQuery(ss.str());
-    if (!result.empty() && result.is_array()) {
-        return result[0];
+    auto result = db->queryRows<Book>(ss.str());
+    if (!result) return false;
+    book.reset();
+    if (!result->empty()) {
+        book = (*result)[0];
     }
-    return json{};
+    return true;
 }
 
-json Book::search(const std::string& query, const std::string& category) {
+std::optional<std::vector<Book>> Book::search(const std::string& query, const std::string& category) {
     std::stringstream ss;
-    ss << "SELECT * FROM books WHERE (title LIKE '%" << query 
+    ss << "SELECT " << row_schema::columnList<Book>() << " FROM books WHERE (title LIKE '%" << query 
        << "%' OR author LIKE '%" << query << "%')";
     
     if (!category.empty() && category != "all") {
@@ -31,77 +58,124 @@ json Book::search(const std::string& query, const std::string& category) {
     }
     
     ss << " ORDER BY title";
-    return db->executeQuery(ss.str());
+    return db->queryRows<Book>(ss.str());
+}
+
+// Rows for the given ids, in the order the ids are listed; missing ids are skipped
+std::optional<std::vector<Book>> Book::getByIds(const std::vector<int>& book_ids) {
+    if (book_ids.empty()) return std::vector<Book>();
+    
+    std::stringstream ss;
+    ss << "SELECT " << row_schema::columnList<Book>() << " FROM books WHERE id IN (";
+    for (size_t i = 0; i < book_ids.size(); ++i) {
+        if (i > 0) ss << ", ";
+        ss << book_ids[i];
+    }
+    ss << ")";
+    
+    auto result = db->queryRows<Book>(ss.str());
+    if (!result) return std::nullopt;
+    auto& rows = *result;
+    std::unordered_map<int, size_t> position;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        position[rows[i].getId()] = i;
+    }
+    
+    std::vector<Book> ordered;
+    ordered.reserve(rows.size());
+    for (int book_id : book_ids) {
+        auto it = position.find(book_id);
+        if (it != position.end()) ordered.push_back(std::move(rows[it->second]));
+    }
+    return ordered;
 }
 
-bool Book::create(const json& data) {
-    try {
-        std::string title = data["title"];
-        std::string author = data["author"];
-        std::string isbn = data["isbn"];
-        std::string category = data["category"];
-        int copies = data["copies"];
-        int year = data.value("year", 0);
-        
-        std::stringstream ss;
-        ss << "INSERT INTO books (title, author, isbn, category, total_copies, available_copies, publication_year) "
-           << "VALUES ('" << title << "', '" << author << "', '" << isbn << "', '" << category 
-           << "', " << copies << ", " << copies << ", " << year << ")";
-        
-        return db->executeInsert(ss.str());
-    } catch (const std::exception& e) {
-        std::cerr << "Error creating book: " << e.what() << std::endl;
-        return false;
+bool Book::create(const CreateRequest& request) {
+    std::stringstream ss;
+    ss << "INSERT INTO books (title, author, isbn, category, total_copies, available_copies, publication_year) "
+       << "VALUES ('" << request.title << "', '" << request.author << "', '" << request.isbn << "', '"
+       << request.category << "', " << request.copies << ", " << request.copies << ", " << request.year << ")";
+    
+    if (db->executeInsert(ss.str())) {
+        int book_id = db->getLastInsertId();
+        reindexBook(*db, book_id);
+        EventBus::instance().publish(db->getBranchId(), "book", "created", book_id, json{
+            {"title", request.title},
+            {"author", request.author},
+            {"category", request.category},
+            {"total_copies", request.copies},
+            {"available_copies", request.copies}
+        });
+        return true;
     }
+    return false;
 }
 
-bool Book::update(int book_id, const json& data) {
-    try {
-        std::stringstream ss;
-        ss << "UPDATE books SET ";
-        
-        bool first = true;
-        if (data.contains("title")) {
-            if (!first) ss << ", ";
-            ss << "title = '" << data["title"].get<std::string>() << "'";
-            first = false;
-        }
-        if (data.contains("author")) {
-            if (!first) ss << ", ";
-            ss << "author = '" << data["author"].get<std::string>() << "'";
-            first = false;
-        }
-        if (data.contains("category")) {
-            if (!first) ss << ", ";
-            ss << "category = '" << data["category"].get<std::string>() << "'";
-            first = false;
-        }
-        if (data.contains("total_copies")) {
-            if (!first) ss << ", ";
-            ss << "total_copies = " << data["total_copies"].get<int>();
-            first = false;
-        }
-        if (data.contains("available_copies")) {
-            if (!first) ss << ", ";
-            ss << "available_copies = " << data["available_copies"].get<int>();
-            first = false;
-        }
-        
-        ss << " WHERE id = " << book_id;
-        return db->executeUpdate(ss.str());
-    } catch (const std::exception& e) {
-        std::cerr << "Error updating book: " << e.what() << std::endl;
-        return false;
+bool Book::update(int book_id, const UpdateRequest& request) {
+    std::stringstream ss;
+    ss << "UPDATE books SET ";
+    
+    json delta = json::object();
+    bool first = true;
+    if (request.title) {
+        ss << "title = '" << *request.title << "'";
+        delta["title"] = *request.title;
+        first = false;
+    }
+    if (request.author) {
+        if (!first) ss << ", ";
+        ss << "author = '" << *request.author << "'";
+        delta["author"] = *request.author;
+        first = false;
+    }
+    if (request.category) {
+        if (!first) ss << ", ";
+        ss << "category = '" << *request.category << "'";
+        delta["category"] = *request.category;
+        first = false;
+    }
+    if (request.total_copies) {
+        if (!first) ss << ", ";
+        ss << "total_copies = " << *request.total_copies;
+        delta["total_copies"] = *request.total_copies;
+        first = false;
+    }
+    if (request.available_copies) {
+        if (!first) ss << ", ";
+        ss << "available_copies = " << *request.available_copies;
+        delta["available_copies"] = *request.available_copies;
+        first = false;
     }
+    
+    ss << " WHERE id = " << book_id;
+    
+    if (db->executeUpdate(ss.str())) {
+        reindexBook(*db, book_id);
+        EventBus::instance().publish(db->getBranchId(), "book", "updated", book_id, delta);
+        return true;
+    }
+    return false;
 }
 
 bool Book::deleteBook(int book_id) {
     std::stringstream ss;
     ss << "DELETE FROM books WHERE id = " << book_id;
-    return db->executeDelete(ss.str());
+    
+    if (db->executeDelete(ss.str())) {
+        CatalogFacets::of(*db).remove(book_id);
+        TitleAutocomplete::of(*db).remove(book_id);
+        NameDirectory::of(*db).removeBook(book_id);
+        EventBus::instance().publish(db->getBranchId(), "book", "deleted", book_id);
+        return true;
+    }
+    return false;
 }
 
 std::string Book::getStatus() const {
+    return statusFor(available_copies, total_copies);
+}
+
+std::string Book::statusFor(int available_copies, int total_copies) {
     if (available_copies == 0) {
         return "out-of-stock";
     } else if (available_copies < total_copies / 3) {
@@ -111,15 +185,7 @@ std::string Book::getStatus() const {
 }
 
 json Book::toJson() const {
-    return json{
-        {"id", id},
-        {"title", title},
-        {"author", author},
-        {"isbn", isbn},
-        {"category", category},
-        {"copies", total_copies},
-        {"available", available_copies},
-        {"year", publication_year},
-        {"status", getStatus()}
-    };
+    json result = row_schema::toJson(*this);
+    result["status"] = getStatus();
+    return result;
 }
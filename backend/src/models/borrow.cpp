@@ -1,84 +1,212 @@
 #include "models/borrow.h"
+#include "events/event_bus.h"
+#include "services/loan_counters.h"
+#include "services/co_borrow_index.h"
+#include "services/catalog_facets.h"
+#include "services/title_autocomplete.h"
+#include "services/settings_cache.h"
+#include "services/name_directory.h"
+#include "logging/logger.h"
 #include <sstream>
-#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Scanned ids without repeats, in first-scan order
+std::vector<int> uniqueIds(const std::vector<int>& ids) {
+    std::vector<int> unique;
+    std::unordered_set<int> seen;
+    for (int id : ids) {
+        if (seen.insert(id).second) unique.push_back(id);
+    }
+    return unique;
+}
+
+std::string idList(const std::vector<int>& ids) {
+    std::stringstream ss;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i > 0) ss << ", ";
+        ss << ids[i];
+    }
+    return ss.str();
+}
+
+// Results in scan order; a repeated scan of an item applied earlier in the
+// same batch reads as a rescan
+std::vector<Borrow::BatchItem> inScanOrder(const std::vector<int>& scanned,
+                                           const std::unordered_map<int, Borrow::BatchItem>& outcomes,
+                                           const std::string& applied, const std::string& rescanned) {
+    std::vector<Borrow::BatchItem> items;
+    std::unordered_set<int> reported;
+    for (int id : scanned) {
+        Borrow::BatchItem item = outcomes.at(id);
+        if (!reported.insert(id).second && item.outcome == applied) {
+            item.outcome = rescanned;
+        }
+        items.push_back(std::move(item));
+    }
+    return items;
+}
+
+} // namespace
 
 Borrow::Borrow(Database* database) 
     : id(0), member_id(0), book_id(0), fine_amount(0.0), db(database) {}
 
-json Borrow::getAll() {
+void Borrow::fillNames(std::vector<Borrow>& rows) const {
+    std::vector<int> member_ids, book_ids;
+    member_ids.reserve(rows.size());
+    book_ids.reserve(rows.size());
+    for (const auto& row : rows) {
+        member_ids.push_back(row.member_id);
+        book_ids.push_back(row.book_id);
+    }
+    
+    NameDirectory& names = NameDirectory::of(*db);
+    names.prefetch(*db, member_ids, book_ids);
+    for (auto& row : rows) {
+        row.member_name = names.memberName(row.member_id);
+        row.book_title = names.bookTitle(row.book_id);
+    }
+}
+
+std::optional<std::vector<Borrow>> Borrow::getAll() {
     std::string query = 
-        "SELECT br.id, br.member_id, br.book_id, m.name as member_name, "
-        "b.title as book_title, br.borrow_date, br.due_date, br.return_date, "
-        "br.status, br.fine_amount FROM borrow_records br "
-        "JOIN members m ON br.member_id = m.id "
-        "JOIN books b ON br.book_id = b.id "
+        "SELECT " + row_schema::columnList<Borrow>() + " FROM borrow_records br "
         "ORDER BY br.borrow_date DESC";
     
-    return db->executeQuery(query);
+    auto rows = db->queryRows<Borrow>(query);
+    if (rows) fillNames(*rows);
+    return rows;
 }
 
-json Borrow::getById(int borrow_id) {
+// Loans updated at or after a delta_sync::sinceExpression(). Renaming a
+// member or book does not touch its loans; clients take new names from the
+// members and books deltas.
+std::optional<std::vector<Borrow>> Borrow::getChangedSince(const std::string& since_expression) {
+    std::string query = 
+        "SELECT " + row_schema::columnList<Borrow>() + " FROM borrow_records br "
+        "WHERE br.updated_at >= " + since_expression + " ORDER BY br.updated_at, br.id";
+    
+    auto rows = db->queryRows<Borrow>(query);
+    if (rows) fillNames(*rows);
+    return rows;
+}
+
+bool Borrow::getById(int borrow_id, std::optional<Borrow>& borrow) {
     std::stringstream ss;
-    ss << "SELECT br.id, br.member_id, br.book_id, m.name as member_name, "
-       << "b.title as book_title, br.borrow_date, br.due_date, br.return_date, "
-       << "br.status, br.fine_amount FROM borrow_records br "
-       << "JOIN members m ON br.member_id = m.id "
-       << "JOIN books b ON br.book_id = b.id "
+    ss << "SELECT " << row_schema::columnList<Borrow>() << " FROM borrow_records br "
        << "WHERE br.id = " << borrow_id;
     
-    json result = db->executeQuery(ss.str());
-    if (!result.empty() && result.is_array()) {
-        return result[0];
+    auto result = db->queryRows<Borrow>(ss.str());
+    if (!result) return false;
+    fillNames(*result);
+    borrow.reset();
+    if (!result->empty()) {
+        borrow = (*result)[0];
     }
-    return json{};
+    return true;
 }
 
-json Borrow::getByMember(int member_id) {
+std::optional<std::vector<Borrow>> Borrow::getByMember(int member_id) {
     std::stringstream ss;
-    ss << "SELECT br.id, br.member_id, br.book_id, m.name as member_name, "
-       << "b.title as book_title, br.borrow_date, br.due_date, br.return_date, "
-       << "br.status, br.fine_amount FROM borrow_records br "
-       << "JOIN members m ON br.member_id = m.id "
-       << "JOIN books b ON br.book_id = b.id "
+    ss << "SELECT " << row_schema::columnList<Borrow>() << " FROM borrow_records br "
        << "WHERE br.member_id = " << member_id
        << " ORDER BY br.borrow_date DESC";
     
-    return db->executeQuery(ss.str());
+    auto rows = db->queryRows<Borrow>(ss.str());
+    if (rows) fillNames(*rows);
+    return rows;
 }
 
-json Borrow::getByStatus(const std::string& status) {
+std::optional<std::vector<Borrow>> Borrow::getByStatus(const std::string& status) {
     std::stringstream ss;
-    ss << "SELECT br.id, br.member_id, br.book_id, m.name as member_name, "
-       << "b.title as book_title, br.borrow_date, br.due_date, br.return_date, "
-       << "br.status, br.fine_amount FROM borrow_records br "
-       << "JOIN members m ON br.member_id = m.id "
-       << "JOIN books b ON br.book_id = b.id "
+    ss << "SELECT " << row_schema::columnList<Borrow>() << " FROM borrow_records br "
        << "WHERE br.status = '" << status << "' "
        << "ORDER BY br.due_date ASC";
     
-    return db->executeQuery(ss.str());
+    auto rows = db->queryRows<Borrow>(ss.str());
+    if (rows) fillNames(*rows);
+    return rows;
 }
 
 json Borrow::getOverdue() {
     std::string query = 
-        "SELECT br.id, br.member_id, br.book_id, m.name as member_name, "
-        "b.title as book_title, br.borrow_date, br.due_date, br.return_date, "
+        "SELECT br.id, br.member_id, br.book_id, br.borrow_date, br.due_date, br.return_date, "
         "br.status, br.fine_amount, DATEDIFF(CURDATE(), br.due_date) as days_overdue "
         "FROM borrow_records br "
-        "JOIN members m ON br.member_id = m.id "
-        "JOIN books b ON br.book_id = b.id "
         "WHERE br.status = 'overdue' AND br.return_date IS NULL "
         "ORDER BY br.due_date ASC";
     
-    return db->executeQuery(query);
+    json rows = db->executeRead(query);
+    if (!rows.is_array()) return rows;
+    
+    std::vector<int> member_ids, book_ids;
+    for (const auto& row : rows) {
+        member_ids.push_back(row.value("member_id", 0));
+        book_ids.push_back(row.value("book_id", 0));
+    }
+    NameDirectory& names = NameDirectory::of(*db);
+    names.prefetch(*db, member_ids, book_ids);
+    for (auto& row : rows) {
+        row["member_name"] = names.memberName(row.value("member_id", 0));
+        row["book_title"] = names.bookTitle(row.value("book_id", 0));
+    }
+    return rows;
 }
 
-bool Borrow::create(const json& data) {
+bool Borrow::exportHistory(const std::string& from_date, const std::string& to_date,
+                           const std::string& status, const std::function<void(const Borrow&)>& on_row) {
+    std::stringstream ss;
+    ss << "SELECT " << row_schema::columnList<Borrow>() << " FROM borrow_records br "
+       << "WHERE 1 = 1";
+    
+    if (!from_date.empty()) ss << " AND br.borrow_date >= '" << from_date << "'";
+    if (!to_date.empty()) ss << " AND br.borrow_date <= '" << to_date << "'";
+    if (!status.empty()) ss << " AND br.status = '" << status << "'";
+    ss << " ORDER BY br.id";
+    
+    // Names are looked up a batch of rows at a time, so memory stays bounded
+    std::vector<Borrow> batch;
+    auto flush = [this, &batch, &on_row] {
+        fillNames(batch);
+        for (const auto& row : batch) on_row(row);
+        batch.clear();
+    };
+    bool ok = db->forEachRow<Borrow>(ss.str(), [&batch, &flush](const Borrow& row) {
+        batch.push_back(row);
+        if (batch.size() >= NameDirectory::fetchBatch) flush();
+    });
+    flush();
+    return ok;
+}
+
+bool Borrow::create(const CheckoutRequest& request) {
+    return checkout(request) == CheckoutStatus::Created;
+}
+
+Borrow::CheckoutStatus Borrow::checkout(const CheckoutRequest& request) {
     try {
-        int member_id = data["member_id"];
-        int book_id = data["book_id"];
-        std::string borrow_date = data["borrow_date"];
-        std::string due_date = data["due_date"];
+        int member_id = request.member_id;
+        int book_id = request.book_id;
+        const std::string& borrow_date = request.borrow_date;
+        const std::string& due_date = request.due_date;
+        
+        // Enforce member status and borrow limit before touching the database
+        auto& counters = LoanCounters::of(*db);
+        int limit = SettingsCache::instance().getPolicy().borrow_limit;
+        auto admission = counters.tryReserve(member_id, limit);
+        if (admission == LoanCounters::Admission::UnknownMember && counters.loadMember(*db, member_id)) {
+            admission = counters.tryReserve(member_id, limit);
+        }
+        switch (admission) {
+            case LoanCounters::Admission::Granted: break;
+            case LoanCounters::Admission::LimitReached: return CheckoutStatus::LimitReached;
+            case LoanCounters::Admission::MemberNotActive: return CheckoutStatus::MemberNotActive;
+            case LoanCounters::Admission::UnknownMember: return CheckoutStatus::UnknownMember;
+        }
         
         std::stringstream ss;
         ss << "INSERT INTO borrow_records (member_id, book_id, borrow_date, due_date, status) "
@@ -86,78 +214,348 @@ bool Borrow::create(const json& data) {
            << "', '" << due_date << "', 'active')";
         
         if (db->executeInsert(ss.str())) {
+            int borrow_id = db->getLastInsertId();
+            counters.confirm(member_id);
+            
             // Update available copies
             std::stringstream update_ss;
             update_ss << "UPDATE books SET available_copies = available_copies - 1 WHERE id = " << book_id;
             db->executeUpdate(update_ss.str());
-            return true;
+            
+            CatalogFacets::of(*db).adjustAvailable(book_id, -1);
+            CoBorrowIndex::of(*db).recordCheckout(member_id, book_id);
+            TitleAutocomplete::of(*db).recordBorrow(book_id);
+            
+            EventBus::instance().publish(db->getBranchId(), "borrow", "checkout", borrow_id, json{
+                {"member_id", member_id},
+                {"book_id", book_id},
+                {"due_date", due_date}
+            });
+            EventBus::instance().publish(db->getBranchId(), "book", "updated", book_id, json{{"available_copies_delta", -1}});
+            return CheckoutStatus::Created;
         }
-        return false;
+        counters.cancel(member_id);
+        return CheckoutStatus::Failed;
     } catch (const std::exception& e) {
-        std::cerr << "Error creating borrow record: " << e.what() << std::endl;
-        return false;
+        Logger::error("borrow", "Checkout failed")
+            .field("member_id", request.member_id)
+            .field("book_id", request.book_id)
+            .field("error", e.what());
+        return CheckoutStatus::Failed;
     }
 }
 
-bool Borrow::update(int borrow_id, const json& data) {
+bool Borrow::update(int borrow_id, const UpdateRequest& request) {
     try {
+        // A status change moves the loan in or out of the member's outstanding count
+        int member_id = 0;
+        bool was_outstanding = false;
+        if (request.status) {
+            std::stringstream get_ss;
+            get_ss << "SELECT member_id, status FROM borrow_records WHERE id = " << borrow_id;
+            json result = db->executeQuery(get_ss.str());
+            if (!result.is_array() || result.empty()) return false;
+            member_id = result[0]["member_id"];
+            was_outstanding = result[0]["status"] != "returned";
+        }
+        
         std::stringstream ss;
         ss << "UPDATE borrow_records SET ";
         
+        json delta = json::object();
         bool first = true;
-        if (data.contains("status")) {
-            if (!first) ss << ", ";
-            ss << "status = '" << data["status"].get<std::string>() << "'";
+        if (request.status) {
+            ss << "status = '" << *request.status << "'";
+            delta["status"] = *request.status;
             first = false;
         }
-        if (data.contains("fine_amount")) {
+        if (request.fine_amount) {
             if (!first) ss << ", ";
-            ss << "fine_amount = " << data["fine_amount"].get<double>();
+            ss << "fine_amount = " << *request.fine_amount;
+            delta["fine_amount"] = *request.fine_amount;
             first = false;
         }
         
         ss << " WHERE id = " << borrow_id;
-        return db->executeUpdate(ss.str());
+        
+        if (db->executeUpdate(ss.str())) {
+            if (request.status) {
+                bool is_outstanding = *request.status != "returned";
+                if (is_outstanding != was_outstanding) {
+                    LoanCounters::of(*db).adjust(member_id, is_outstanding ? 1 : -1);
+                }
+            }
+            
+            EventBus::instance().publish(db->getBranchId(), "borrow", "updated", borrow_id, delta);
+            return true;
+        }
+        return false;
     } catch (const std::exception& e) {
-        std::cerr << "Error updating borrow record: " << e.what() << std::endl;
+        Logger::error("borrow", "Borrow record update failed").field("borrow_id", borrow_id).field("error", e.what());
         return false;
     }
 }
 
 bool Borrow::recordReturn(int borrow_id) {
     try {
-        // Get book_id first
+        // Get book_id and member_id first
         std::stringstream get_ss;
-        get_ss << "SELECT book_id FROM borrow_records WHERE id = " << borrow_id;
+        get_ss << "SELECT book_id, member_id FROM borrow_records WHERE id = " << borrow_id;
         json result = db->executeQuery(get_ss.str());
         
-        if (result.empty()) return false;
+        if (!result.is_array() || result.empty()) return false;
         
         int book_id = result[0]["book_id"];
+        int member_id = result[0]["member_id"];
         
-        // Update return date and status
+        // Update return date and status; a repeated return changes nothing
         std::stringstream ss;
         ss << "UPDATE borrow_records SET return_date = CURDATE(), status = 'returned' "
-           << "WHERE id = " << borrow_id;
+           << "WHERE id = " << borrow_id << " AND status <> 'returned'";
         
-        if (db->executeUpdate(ss.str())) {
-            // Update available copies
-            std::stringstream update_ss;
-            update_ss << "UPDATE books SET available_copies = available_copies + 1 WHERE id = " << book_id;
-            db->executeUpdate(update_ss.str());
+        if (!db->executeUpdate(ss.str())) {
+            return false;
+        }
+        if (db->getAffectedRows() == 0) {
             return true;
         }
+        
+        // Update available copies
+        std::stringstream update_ss;
+        update_ss << "UPDATE books SET available_copies = available_copies + 1 WHERE id = " << book_id;
+        db->executeUpdate(update_ss.str());
+        
+        CatalogFacets::of(*db).adjustAvailable(book_id, 1);
+        LoanCounters::of(*db).release(member_id);
+        EventBus::instance().publish(db->getBranchId(), "borrow", "return", borrow_id, json{{"book_id", book_id}});
+        EventBus::instance().publish(db->getBranchId(), "book", "updated", book_id, json{{"available_copies_delta", 1}});
+        return true;
+    } catch (const std::exception& e) {
+        Logger::error("borrow", "Return failed").field("borrow_id", borrow_id).field("error", e.what());
+        return false;
+    }
+}
+
+bool Borrow::checkoutBatch(int member_id, const std::vector<int>& book_ids, const std::string& borrow_date,
+                           const std::string& due_date, std::vector<BatchItem>& items) {
+    items.clear();
+    std::vector<int> books = uniqueIds(book_ids);
+    if (books.empty()) return true;
+    
+    auto& counters = LoanCounters::of(*db);
+    int limit = SettingsCache::instance().getPolicy().borrow_limit;
+    std::unordered_map<int, BatchItem> outcomes;
+    std::vector<int> reserved;
+    
+    try {
+        Database::Transaction transaction(*db);
+        if (!transaction.active()) return false;
+        
+        // Locks the book rows first, so available_copies cannot change
+        // underneath and a concurrent batch for the same books waits here
+        std::stringstream stock_ss;
+        stock_ss << "SELECT id, available_copies FROM books WHERE id IN (" << idList(books) << ") FOR UPDATE";
+        json stock = db->executeQuery(stock_ss.str());
+        
+        // Loans the member already has for these books: rescans. A locking
+        // read sees loans committed by the batch we waited for above, which
+        // the transaction's snapshot would not.
+        std::stringstream open_ss;
+        open_ss << "SELECT id, book_id FROM borrow_records WHERE member_id = " << member_id
+                << " AND book_id IN (" << idList(books) << ") AND status <> 'returned' FOR UPDATE";
+        json open_loans = db->executeQuery(open_ss.str());
+        if (!open_loans.is_array() || !stock.is_array()) return false;
+        
+        std::unordered_map<int, int> open_by_book;
+        std::unordered_map<int, int> available;
+        for (const auto& row : open_loans) open_by_book[row["book_id"].get<int>()] = row["id"].get<int>();
+        for (const auto& row : stock) available[row["id"].get<int>()] = row["available_copies"].get<int>();
+        
+        for (int book_id : books) {
+            BatchItem& item = outcomes[book_id] = BatchItem{book_id, "", 0};
+            if (open_by_book.count(book_id)) {
+                item.outcome = "already_borrowed";
+                item.borrow_id = open_by_book[book_id];
+                continue;
+            }
+            if (!available.count(book_id)) {
+                item.outcome = "not_found";
+                continue;
+            }
+            if (available[book_id] <= 0) {
+                item.outcome = "unavailable";
+                continue;
+            }
+            
+            auto admission = counters.tryReserve(member_id, limit);
+            if (admission == LoanCounters::Admission::UnknownMember && counters.loadMember(*db, member_id)) {
+                admission = counters.tryReserve(member_id, limit);
+            }
+            switch (admission) {
+                case LoanCounters::Admission::Granted:
+                    reserved.push_back(book_id);
+                    item.outcome = "borrowed";
+                    break;
+                case LoanCounters::Admission::LimitReached: item.outcome = "limit_reached"; break;
+                case LoanCounters::Admission::MemberNotActive: item.outcome = "member_not_active"; break;
+                case LoanCounters::Admission::UnknownMember: item.outcome = "unknown_member"; break;
+            }
+        }
+        
+        bool ok = true;
+        if (!reserved.empty()) {
+            std::stringstream insert_ss;
+            insert_ss << "INSERT INTO borrow_records (member_id, book_id, borrow_date, due_date, status) VALUES ";
+            for (size_t i = 0; i < reserved.size(); ++i) {
+                if (i > 0) insert_ss << ", ";
+                insert_ss << "(" << member_id << ", " << reserved[i] << ", '" << borrow_date
+                          << "', '" << due_date << "', 'active')";
+            }
+            ok = db->executeInsert(insert_ss.str());
+            
+            // Reads the new ids back rather than assuming a consecutive range
+            if (ok) {
+                std::stringstream ids_ss;
+                ids_ss << "SELECT id, book_id FROM borrow_records WHERE member_id = " << member_id
+                       << " AND book_id IN (" << idList(reserved) << ") AND id >= " << db->getLastInsertId();
+                json created = db->executeQuery(ids_ss.str());
+                ok = created.is_array() && created.size() == reserved.size();
+                if (ok) {
+                    for (const auto& row : created) outcomes[row["book_id"].get<int>()].borrow_id = row["id"].get<int>();
+                }
+            }
+            
+            std::stringstream update_ss;
+            update_ss << "UPDATE books SET available_copies = available_copies - 1 WHERE id IN (" << idList(reserved) << ")";
+            ok = ok && db->executeUpdate(update_ss.str());
+        }
+        
+        if (!ok || !transaction.commit()) {
+            for (size_t i = 0; i < reserved.size(); ++i) counters.cancel(member_id);
+            return false;
+        }
+    } catch (const std::exception& e) {
+        Logger::error("borrow", "Batch checkout failed")
+            .field("member_id", member_id)
+            .field("items", book_ids.size())
+            .field("error", e.what());
+        for (size_t i = 0; i < reserved.size(); ++i) counters.cancel(member_id);
         return false;
+    }
+    
+    for (int book_id : reserved) {
+        int borrow_id = outcomes[book_id].borrow_id;
+        counters.confirm(member_id);
+        CatalogFacets::of(*db).adjustAvailable(book_id, -1);
+        CoBorrowIndex::of(*db).recordCheckout(member_id, book_id);
+        TitleAutocomplete::of(*db).recordBorrow(book_id);
+        EventBus::instance().publish(db->getBranchId(), "borrow", "checkout", borrow_id, json{
+            {"member_id", member_id},
+            {"book_id", book_id},
+            {"due_date", due_date}
+        });
+        EventBus::instance().publish(db->getBranchId(), "book", "updated", book_id, json{{"available_copies_delta", -1}});
+    }
+    
+    items = inScanOrder(book_ids, outcomes, "borrowed", "already_borrowed");
+    return true;
+}
+
+bool Borrow::returnBatch(const std::vector<int>& borrow_ids, std::vector<BatchItem>& items) {
+    items.clear();
+    std::vector<int> loans = uniqueIds(borrow_ids);
+    if (loans.empty()) return true;
+    
+    std::unordered_map<int, BatchItem> outcomes;
+    std::vector<int> returning;
+    std::unordered_map<int, int> member_of;
+    std::unordered_map<int, int> book_of;
+    std::map<int, int> copies_back;
+    
+    try {
+        Database::Transaction transaction(*db);
+        if (!transaction.active()) return false;
+        
+        std::stringstream get_ss;
+        get_ss << "SELECT id, book_id, member_id, status FROM borrow_records WHERE id IN ("
+               << idList(loans) << ") FOR UPDATE";
+        json rows = db->executeQuery(get_ss.str());
+        if (!rows.is_array()) return false;
+        
+        std::unordered_map<int, const json*> by_id;
+        for (const auto& row : rows) by_id[row["id"].get<int>()] = &row;
+        
+        for (int borrow_id : loans) {
+            BatchItem& item = outcomes[borrow_id] = BatchItem{borrow_id, "", borrow_id};
+            auto it = by_id.find(borrow_id);
+            if (it == by_id.end()) {
+                item.outcome = "not_found";
+                item.borrow_id = 0;
+            } else if ((*it->second)["status"] == "returned") {
+                item.outcome = "already_returned";
+            } else {
+                item.outcome = "returned";
+                returning.push_back(borrow_id);
+                book_of[borrow_id] = (*it->second)["book_id"].get<int>();
+                member_of[borrow_id] = (*it->second)["member_id"].get<int>();
+                copies_back[book_of[borrow_id]]++;
+            }
+        }
+        
+        bool ok = true;
+        if (!returning.empty()) {
+            std::stringstream return_ss;
+            return_ss << "UPDATE borrow_records SET return_date = CURDATE(), status = 'returned' "
+                      << "WHERE id IN (" << idList(returning) << ") AND status <> 'returned'";
+            ok = db->executeUpdate(return_ss.str());
+            
+            // One statement for every book, however many copies came back
+            std::stringstream copies_ss;
+            std::vector<int> returned_books;
+            copies_ss << "UPDATE books SET available_copies = available_copies + CASE id";
+            for (const auto& [book_id, count] : copies_back) {
+                copies_ss << " WHEN " << book_id << " THEN " << count;
+                returned_books.push_back(book_id);
+            }
+            copies_ss << " END WHERE id IN (" << idList(returned_books) << ")";
+            ok = ok && db->executeUpdate(copies_ss.str());
+        }
+        
+        if (!ok || !transaction.commit()) return false;
     } catch (const std::exception& e) {
-        std::cerr << "Error recording return: " << e.what() << std::endl;
+        Logger::error("borrow", "Batch return failed").field("items", borrow_ids.size()).field("error", e.what());
         return false;
     }
+    
+    for (int borrow_id : returning) {
+        LoanCounters::of(*db).release(member_of[borrow_id]);
+        EventBus::instance().publish(db->getBranchId(), "borrow", "return", borrow_id, json{{"book_id", book_of[borrow_id]}});
+    }
+    for (const auto& [book_id, count] : copies_back) {
+        CatalogFacets::of(*db).adjustAvailable(book_id, count);
+        EventBus::instance().publish(db->getBranchId(), "book", "updated", book_id, json{{"available_copies_delta", count}});
+    }
+    
+    items = inScanOrder(borrow_ids, outcomes, "returned", "already_returned");
+    return true;
 }
 
 bool Borrow::deleteBorrow(int borrow_id) {
+    std::stringstream get_ss;
+    get_ss << "SELECT member_id, status FROM borrow_records WHERE id = " << borrow_id;
+    json existing = db->executeQuery(get_ss.str());
+    
     std::stringstream ss;
     ss << "DELETE FROM borrow_records WHERE id = " << borrow_id;
-    return db->executeDelete(ss.str());
+    
+    if (db->executeDelete(ss.str())) {
+        if (existing.is_array() && !existing.empty() && existing[0]["status"] != "returned") {
+            LoanCounters::of(*db).release(existing[0]["member_id"].get<int>());
+        }
+        EventBus::instance().publish(db->getBranchId(), "borrow", "deleted", borrow_id);
+        return true;
+    }
+    return false;
 }
 
 json Borrow::getStatistics() {
@@ -169,7 +567,7 @@ json Borrow::getStatistics() {
         "COUNT(*) as total_records "
         "FROM borrow_records";
     
-    json result = db->executeQuery(query);
+    json result = db->executeRead(query);
     if (!result.empty() && result.is_array()) {
         return result[0];
     }
@@ -185,7 +583,7 @@ json Borrow::getMonthlyStats() {
         "GROUP BY DATE_FORMAT(borrow_date, '%Y-%m') "
         "ORDER BY month DESC LIMIT 12";
     
-    return db->executeQuery(query);
+    return db->executeRead(query);
 }
 
 json Borrow::getTopBooks() {
@@ -196,18 +594,9 @@ json Borrow::getTopBooks() {
         "GROUP BY b.id, b.title, b.author "
         "ORDER BY borrow_count DESC LIMIT 5";
     
-    return db->executeQuery(query);
+    return db->executeRead(query);
 }
 
 json Borrow::toJson() const {
-    return json{
-        {"id", id},
-        {"member_id", member_id},
-        {"book_id", book_id},
-        {"borrow_date", borrow_date},
-        {"due_date", due_date},
-        {"return_date", return_date},
-        {"status", status},
-        {"fine_amount", fine_amount}
-    };
+    return row_schema::toJson(*this);
 }
@@ -1,109 +1,121 @@
 #include "models/member.h"
+#include "events/event_bus.h"
+#include "services/loan_counters.h"
+#include "services/name_directory.h"
 #include <sstream>
 #include <iostream>
 
 Member::Member(Database* database) 
     : id(0), db(database), status("active") {}
 
-json Member::getAll() {
-    std::string query = "SELECT id, member_id, name, email, phone, address, status, join_date FROM members ORDER BY name";
-    return db->executeQuery(query);
+std::optional<std::vector<Member>> Member::getAll() {
+    std::string query = "SELECT " + row_schema::columnList<Member>() + " FROM members ORDER BY name";
+    return db->queryRows<Member>(query);
 }
 
-json Member::getById(int member_id) {
+// Rows updated at or after a delta_sync::sinceExpression()
+std::optional<std::vector<Member>> Member::getChangedSince(const std::string& since_expression) {
+    std::string query = "SELECT " + row_schema::columnList<Member>() + " FROM members WHERE updated_at >= "
+        + since_expression + " ORDER BY updated_at, id";
+    return db->queryRows<Member>(query);
+}
+
+bool Member::getById(int member_id, std::optional<Member>& member) {
     std::stringstream ss;
-    ss << "SELECT id, member_id, name, email, phone, address, status, join_date FROM members WHERE id = " << member_id;
+    ss << "SELECT " << row_schema::columnList<Member>() << " FROM members WHERE id = " << member_id;
     
-    json result = db->executeQuery(ss.str());
-    if (!result.empty() && result.is_array()) {
-        return result[0];
+    auto result = db->queryRows<Member>(ss.str());
+    if (!result) return false;
+    member.reset();
+    if (!result->empty()) {
+        member = (*result)[0];
     }
-    return json{};
+    return true;
 }
 
-json Member::search(const std::string& query) {
+std::optional<std::vector<Member>> Member::search(const std::string& query) {
     std::stringstream ss;
-    ss << "SELECT id, member_id, name, email, phone, address, status, join_date FROM members "
+    ss << "SELECT " << row_schema::columnList<Member>() << " FROM members "
        << "WHERE name LIKE '%" << query << "%' OR email LIKE '%" << query 
        << "%' OR member_id LIKE '%" << query << "%' ORDER BY name";
     
-    return db->executeQuery(ss.str());
+    return db->queryRows<Member>(ss.str());
 }
 
-json Member::filterByStatus(const std::string& status) {
+std::optional<std::vector<Member>> Member::filterByStatus(const std::string& status) {
     std::stringstream ss;
-    ss << "SELECT id, member_id, name, email, phone, address, status, join_date FROM members "
+    ss << "SELECT " << row_schema::columnList<Member>() << " FROM members "
        << "WHERE status = '" << status << "' ORDER BY name";
     
-    return db->executeQuery(ss.str());
+    return db->queryRows<Member>(ss.str());
 }
 
-bool Member::create(const json& data) {
-    try {
-        std::string member_id = data["member_id"];
-        std::string name = data["name"];
-        std::string email = data["email"];
-        std::string phone = data.value("phone", "");
-        std::string address = data.value("address", "");
-        std::string join_date = data.value("join_date", "CURDATE()");
-        
-        std::stringstream ss;
-        ss << "INSERT INTO members (member_id, name, email, phone, address, status, join_date) "
-           << "VALUES ('" << member_id << "', '" << name << "', '" << email << "', '" << phone 
-           << "', '" << address << "', 'active', " 
-           << (join_date == "CURDATE()" ? "CURDATE()" : "'" + join_date + "'") << ")";
-        
-        return db->executeInsert(ss.str());
-    } catch (const std::exception& e) {
-        std::cerr << "Error creating member: " << e.what() << std::endl;
-        return false;
+bool Member::create(const CreateRequest& request) {
+    std::stringstream ss;
+    ss << "INSERT INTO members (member_id, name, email, phone, address, status, join_date) "
+       << "VALUES ('" << request.member_id << "', '" << request.name << "', '" << request.email << "', '"
+       << request.phone << "', '" << request.address << "', 'active', "
+       << (request.join_date ? "'" + *request.join_date + "'" : "CURDATE()") << ")";
+    
+    if (db->executeInsert(ss.str())) {
+        NameDirectory::of(*db).setMember(db->getLastInsertId(), request.name);
+        EventBus::instance().publish(db->getBranchId(), "member", "created", db->getLastInsertId(), json{
+            {"member_id", request.member_id},
+            {"name", request.name},
+            {"status", "active"}
+        });
+        return true;
     }
+    return false;
 }
 
-bool Member::update(int member_id, const json& data) {
-    try {
-        std::stringstream ss;
-        ss << "UPDATE members SET ";
-        
-        bool first = true;
-        if (data.contains("name")) {
-            if (!first) ss << ", ";
-            ss << "name = '" << data["name"].get<std::string>() << "'";
-            first = false;
-        }
-        if (data.contains("email")) {
-            if (!first) ss << ", ";
-            ss << "email = '" << data["email"].get<std::string>() << "'";
-            first = false;
-        }
-        if (data.contains("phone")) {
-            if (!first) ss << ", ";
-            ss << "phone = '" << data["phone"].get<std::string>() << "'";
-            first = false;
-        }
-        if (data.contains("address")) {
-            if (!first) ss << ", ";
-            ss << "address = '" << data["address"].get<std::string>() << "'";
-            first = false;
+bool Member::update(int member_id, const UpdateRequest& request) {
+    std::stringstream ss;
+    ss << "UPDATE members SET ";
+    
+    bool first = true;
+    auto set = [&ss, &first](const char* column, const std::optional<std::string>& value) {
+        if (!value) return;
+        if (!first) ss << ", ";
+        ss << column << " = '" << *value << "'";
+        first = false;
+    };
+    set("name", request.name);
+    set("email", request.email);
+    set("phone", request.phone);
+    set("address", request.address);
+    set("status", request.status);
+    
+    ss << " WHERE id = " << member_id;
+    
+    if (db->executeUpdate(ss.str())) {
+        if (request.status) {
+            LoanCounters::of(*db).setMemberStatus(member_id, *request.status);
         }
-        if (data.contains("status")) {
-            if (!first) ss << ", ";
-            ss << "status = '" << data["status"].get<std::string>() << "'";
-            first = false;
+        if (request.name) {
+            NameDirectory::of(*db).setMember(member_id, *request.name);
         }
         
-        ss << " WHERE id = " << member_id;
-        return db->executeUpdate(ss.str());
-    } catch (const std::exception& e) {
-        std::cerr << "Error updating member: " << e.what() << std::endl;
-        return false;
+        json delta = json::object();
+        if (request.name) delta["name"] = *request.name;
+        if (request.status) delta["status"] = *request.status;
+        EventBus::instance().publish(db->getBranchId(), "member", "updated", member_id, delta);
+        return true;
     }
+    return false;
 }
 
 bool Member::deleteMember(int member_id) {
     std::stringstream ss;
     ss << "DELETE FROM members WHERE id = " << member_id;
-    return db->executeDelete(ss.str());
+    
+    if (db->executeDelete(ss.str())) {
+        LoanCounters::of(*db).removeMember(member_id);
+        NameDirectory::of(*db).removeMember(member_id);
+        EventBus::instance().publish(db->getBranchId(), "member", "deleted", member_id);
+        return true;
+    }
+    return false;
 }
 
 json Member::getMemberStats(int member_id) {
@@ -113,7 +125,7 @@ json Member::getMemberStats(int member_id) {
        << "COUNT(*) as total_borrowed "
        << "FROM borrow_records WHERE member_id = " << member_id;
     
-    json result = db->executeQuery(ss.str());
+    json result = db->executeRead(ss.str());
     if (!result.empty() && result.is_array()) {
         return result[0];
     }
@@ -121,14 +133,5 @@ json Member::getMemberStats(int member_id) {
 }
 
 json Member::toJson() const {
-    return json{
-        {"id", id},
-        {"member_id", member_id},
-        {"name", name},
-        {"email", email},
-        {"phone", phone},
-        {"address", address},
-        {"status", status},
-        {"join_date", join_date}
-    };
+    return row_schema::toJson(*this);
 }
@@ -0,0 +1,137 @@
+#include "routes/admin_routes.h"
+#include "cdc/binlog_consumer.h"
+#include "database/db_connection.h"
+#include "logging/logger.h"
+#include "models/request_body.h"
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+// PUT /api/admin/tracing body; the rate is clamped to [0, 1]
+struct TracingUpdate {
+    double sample_rate = 0;
+};
+
+// PUT /api/admin/logging body: debug, info, warn or error
+struct LoggingUpdate {
+    std::string level;
+};
+
+} // namespace
+
+template <>
+struct RequestSchema<TracingUpdate> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::required("sample_rate", &TracingUpdate::sample_rate)
+    );
+};
+
+template <>
+struct RequestSchema<LoggingUpdate> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::required("level", &LoggingUpdate::level)
+    );
+};
+
+void registerAdminRoutes(crow::SimpleApp& app) {
+    // GET recent sampled traces in Chrome trace-event format
+    CROW_ROUTE(app, "/api/admin/traces")
+        .methods("GET"_method)
+    ([](const crow::request&) {
+        auto response = crow::response(Tracer::instance().exportChromeTrace().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Content-Disposition", "attachment; filename=\"library_traces.json\"");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+    
+    // DELETE stored traces
+    CROW_ROUTE(app, "/api/admin/traces")
+        .methods("DELETE"_method)
+    ([](const crow::request&) {
+        Tracer::instance().clear();
+        auto response = crow::response(200, json{{"message", "Traces cleared"}}.dump());
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+    
+    // GET tracing configuration and counters
+    CROW_ROUTE(app, "/api/admin/tracing")
+        .methods("GET"_method)
+    ([](const crow::request&) {
+        auto response = crow::response(Tracer::instance().getStats().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+    
+    // UPDATE sample rate
+    CROW_ROUTE(app, "/api/admin/tracing")
+        .methods("PUT"_method)
+    ([](const crow::request& req) {
+        TracingUpdate update;
+        std::string error;
+        if (!request_body::parse(req.body, update, error)) {
+            return crow::response(400, json{{"error", error}}.dump());
+        }
+        
+        Tracer::instance().setSampleRate(update.sample_rate);
+        auto response = crow::response(Tracer::instance().getStats().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+    
+    // GET log level and writer counters
+    CROW_ROUTE(app, "/api/admin/logging")
+        .methods("GET"_method)
+    ([](const crow::request&) {
+        auto response = crow::response(Logger::instance().getStats().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+    
+    // UPDATE log level
+    CROW_ROUTE(app, "/api/admin/logging")
+        .methods("PUT"_method)
+    ([](const crow::request& req) {
+        LoggingUpdate update;
+        std::string error;
+        if (!request_body::parse(req.body, update, error)) {
+            return crow::response(400, json{{"error", error}}.dump());
+        }
+        LogLevel level;
+        if (!Logger::parseLevel(update.level, level)) {
+            return crow::response(400, json{{"error", "level must be debug, info, warn or error"}}.dump());
+        }
+        
+        Logger::instance().setLevel(level);
+        auto response = crow::response(Logger::instance().getStats().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+    
+    // GET binlog consumer position, lag and counters per branch
+    CROW_ROUTE(app, "/api/admin/cdc")
+        .methods("GET"_method)
+    ([](const crow::request&) {
+        auto response = crow::response(BinlogConsumer::allStats().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+    
+    // GET statements cancelled by request deadlines, by fingerprint
+    CROW_ROUTE(app, "/api/admin/timeouts")
+        .methods("GET"_method)
+    ([](const crow::request&) {
+        auto response = crow::response(Database::getTimeoutStats().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+}
@@ -0,0 +1,55 @@
+#include "routes/admission_routes.h"
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+thread_local std::vector<std::function<void()>> after_response;
+
+} // namespace
+
+crow::response admissionRejected(int retry_after) {
+    auto response = crow::response(503, json{{"error", "Server busy, retry later"}}.dump());
+    response.set_header("Content-Type", "application/json");
+    response.set_header("Access-Control-Allow-Origin", "*");
+    response.set_header("Retry-After", std::to_string(retry_after));
+    return response;
+}
+
+crow::response deadlineExceeded() {
+    auto response = crow::response(504, json{{"error", "Request timed out"}}.dump());
+    response.set_header("Content-Type", "application/json");
+    response.set_header("Access-Control-Allow-Origin", "*");
+    return response;
+}
+
+void setSessionToken(crow::response& response, const std::string& token) {
+    response.set_header("X-Session-Token", token);
+    response.set_header("Access-Control-Allow-Origin", "*");
+    response.set_header("Access-Control-Expose-Headers", "X-Session-Token");
+}
+
+void afterResponse(std::function<void()> cleanup) {
+    after_response.push_back(std::move(cleanup));
+}
+
+void endResponse(crow::response& res) {
+    res.end();
+    std::vector<std::function<void()>> cleanups;
+    cleanups.swap(after_response);
+    for (auto& cleanup : cleanups) cleanup();
+}
+
+void registerAdmissionRoutes(crow::SimpleApp& app) {
+    // GET worker pool and queue statistics per route class
+    CROW_ROUTE(app, "/api/admission/stats")
+        .methods("GET"_method)
+    ([](const crow::request&) {
+        auto response = crow::response(AdmissionController::instance().getStats().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+}
@@ -1,41 +1,220 @@
 #include "routes/books_routes.h"
+#include "routes/admission_routes.h"
+#include "routes/branch_routes.h"
+#include "routes/delta_sync_routes.h"
+#include "tracing/tracer.h"
+#include "services/co_borrow_index.h"
+#include "services/catalog_facets.h"
+#include "services/title_autocomplete.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
 
 using json = nlohmann::json;
 
-void registerBooksRoutes(crow::SimpleApp& app, Database& db) {
-    Book bookModel(&db);
+namespace {
+
+// Searches every branch in parallel and merges the title-ordered results,
+// tagging each book with the branch that holds it; empty if a branch failed
+std::optional<std::string> searchAllBranches(ShardRouter& shards, const std::string& query,
+                                             const std::string& category) {
+    auto results = shards.scatter([&query, &category](int, Database& db) {
+        return Book(&db).search(query, category);
+    });
+    
+    std::vector<std::pair<int, const Book*>> merged;
+    for (const auto& [branch_id, books] : results) {
+        if (!books) return std::nullopt;
+        for (const auto& book : *books) {
+            merged.emplace_back(branch_id, &book);
+        }
+    }
+    std::stable_sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) {
+        return a.second->getTitle() < b.second->getTitle();
+    });
     
+    std::string out = "[";
+    for (const auto& [branch_id, book] : merged) {
+        if (out.size() > 1) out += ',';
+        out += "{\"branch_id\":" + std::to_string(branch_id) + ",";
+        size_t start = out.size();
+        row_schema::encodeJson(out, *book);
+        out.erase(start, 1);
+    }
+    out += ']';
+    return out;
+}
+
+std::vector<std::string> splitList(const char* value) {
+    std::vector<std::string> items;
+    if (!value) return items;
+    std::stringstream list(value);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        if (!item.empty() && item != "all") items.push_back(item);
+    }
+    return items;
+}
+
+} // namespace
+
+void registerBooksRoutes(crow::SimpleApp& app, ShardRouter& shards) {
     // GET all books
     CROW_ROUTE(app, "/api/books")
         .methods("GET"_method)
-    ([&bookModel](const crow::request&) {
-        auto result = bookModel.getAll();
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/books", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Book bookModel(db);
+            if (const char* since = req.url_params.get("since")) {
+                return deltaSyncResponse(*db, since, "books", [&bookModel](const std::string& since_expression) {
+                    auto rows = bookModel.getChangedSince(since_expression);
+                    return rows ? std::optional<std::string>(row_schema::encodeJsonArray(*rows)) : std::nullopt;
+                });
+            }
+            auto result = bookModel.getAll();
+            if (!result) return crow::response(500, json{{"error", "Failed to read books"}}.dump());
+            auto response = crow::response(row_schema::encodeJsonArray(*result));
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // GET book by ID
     CROW_ROUTE(app, "/api/books/<int>")
         .methods("GET"_method)
-    ([&bookModel](const crow::request&, int book_id) {
-        auto result = bookModel.getById(book_id);
+    ([&shards](const crow::request& req, crow::response& res, int book_id) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/books/<int>", req, res, [&shards, &req, book_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Book bookModel(db);
+            std::optional<Book> result;
+            if (!bookModel.getById(book_id, result)) {
+                return crow::response(500, json{{"error", "Failed to read book"}}.dump());
+            }
+            auto response = crow::response(result ? row_schema::encodeJson(*result) : "null");
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
+    });
+    
+    // Search books
+    CROW_ROUTE(app, "/api/books/search")
+        .methods("GET"_method)
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/books/search", req, res, [&shards, &req] {
+            const char* query = req.url_params.get("q");
+            const char* category = req.url_params.get("category");
+            
+            if (isAllBranches(req)) {
+                auto body = searchAllBranches(shards, query ? query : "", category ? category : "");
+                if (!body) return crow::response(500, json{{"error", "Failed to search books"}}.dump());
+                auto response = crow::response(*body);
+                response.set_header("Content-Type", "application/json");
+                response.set_header("Access-Control-Allow-Origin", "*");
+                return response;
+            }
+            
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Book bookModel(db);
+            auto result = bookModel.search(query ? query : "", category ? category : "");
+            if (!result) return crow::response(500, json{{"error", "Failed to search books"}}.dump());
+            auto response = crow::response(row_schema::encodeJsonArray(*result));
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
+    });
+    
+    // Title and author completions for the search box, most borrowed first
+    CROW_ROUTE(app, "/api/books/autocomplete")
+        .methods("GET"_method)
+    ([&shards](const crow::request& req) {
+        Database* db = branchDatabase(shards, req);
+        if (!db) return unknownBranch();
+        const char* query = req.url_params.get("q");
+        const char* limit_param = req.url_params.get("limit");
+        size_t limit = std::min<size_t>(limit_param ? std::strtoul(limit_param, nullptr, 10) : 8, 20);
+        
+        json result = json::array();
+        for (const auto& suggestion : TitleAutocomplete::of(*db).complete(query ? query : "", limit)) {
+            json item = {
+                {"text", suggestion.text},
+                {"type", suggestion.is_author ? "author" : "title"},
+                {"borrow_count", suggestion.borrow_count}
+            };
+            if (!suggestion.is_author) item["book_id"] = suggestion.book_id;
+            result.push_back(std::move(item));
+        }
         auto response = crow::response(result.dump());
         response.set_header("Content-Type", "application/json");
         response.set_header("Access-Control-Allow-Origin", "*");
         return response;
     });
     
-    // Search books
-    CROW_ROUTE(app, "/api/books/search")
+    // Faceted catalog filtering, served from the in-memory bitmap indexes
+    CROW_ROUTE(app, "/api/books/facets")
         .methods("GET"_method)
-    ([&bookModel](const crow::request& req) {
-        std::string query = req.url_params.get("q");
-        std::string category = req.url_params.get("category");
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/books/facets", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            
+            CatalogFacets::Filter filter;
+            filter.categories = splitList(req.url_params.get("category"));
+            filter.statuses = splitList(req.url_params.get("status"));
+            const char* year_from = req.url_params.get("year_from");
+            const char* year_to = req.url_params.get("year_to");
+            const char* author = req.url_params.get("author");
+            filter.year_from = year_from ? std::atoi(year_from) : 0;
+            filter.year_to = year_to ? std::atoi(year_to) : 0;
+            filter.author = author ? author : "";
+            
+            const char* offset_param = req.url_params.get("offset");
+            const char* limit_param = req.url_params.get("limit");
+            size_t offset = offset_param ? std::strtoul(offset_param, nullptr, 10) : 0;
+            size_t limit = std::min<size_t>(limit_param ? std::strtoul(limit_param, nullptr, 10) : 50, 200);
+            
+            auto result = CatalogFacets::of(*db).query(filter, offset, limit);
+            auto books = Book(db).getByIds(result.book_ids);
+            if (!books) return crow::response(500, json{{"error", "Failed to read books"}}.dump());
+            
+            std::string body = "{\"total\":" + std::to_string(result.total) +
+                               ",\"facets\":" + result.facets.dump() +
+                               ",\"books\":" + row_schema::encodeJsonArray(*books) + "}";
+            auto response = crow::response(body);
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
+    });
+    
+    // GET books often borrowed by members who borrowed this one
+    CROW_ROUTE(app, "/api/books/<int>/related")
+        .methods("GET"_method)
+    ([&shards](const crow::request& req, int book_id) {
+        Database* db = branchDatabase(shards, req);
+        if (!db) return unknownBranch();
+        const char* limit_param = req.url_params.get("limit");
+        size_t limit = limit_param ? std::strtoul(limit_param, nullptr, 10) : CoBorrowIndex::topK;
         
-        auto result = bookModel.search(query ? query : "", category ? category : "");
+        json result = json::array();
+        for (const auto& related : CoBorrowIndex::of(*db).related(book_id, limit)) {
+            result.push_back({
+                {"book_id", related.book_id},
+                {"co_borrows", related.co_borrows},
+                {"score", related.score}
+            });
+        }
         auto response = crow::response(result.dump());
         response.set_header("Content-Type", "application/json");
         response.set_header("Access-Control-Allow-Origin", "*");
@@ -45,38 +224,73 @@ void registerBooksRoutes(crow::SimpleApp& app, Database& db) {
     // CREATE book
     CROW_ROUTE(app, "/api/books")
         .methods("POST"_method)
-    ([&bookModel](const crow::request& req) {
-        auto body = crow::json::load(req.body);
-        if (!body) {
-            return crow::response(400, json{{"error", "Invalid JSON"}}.dump());
-        }
-        
-        json data = json::parse(req.body);
-        if (bookModel.create(data)) {
-            return crow::response(201, json{{"message", "Book created successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to create book"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Admin, "POST /api/books", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Book::CreateRequest book;
+            std::string error;
+            if (!request_body::parse(req.body, book, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            if (book.copies < 0) {
+                return crow::response(400, json{{"error", "copies must not be negative"}}.dump());
+            }
+            
+            Book bookModel(db);
+            if (bookModel.create(book)) {
+                auto response = crow::response(201, json{{"message", "Book created successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to create book"}}.dump());
+        });
     });
     
     // UPDATE book
     CROW_ROUTE(app, "/api/books/<int>")
         .methods("PUT"_method)
-    ([&bookModel](const crow::request& req, int book_id) {
-        json data = json::parse(req.body);
-        if (bookModel.update(book_id, data)) {
-            return crow::response(200, json{{"message", "Book updated successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to update book"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res, int book_id) {
+        dispatch(RouteClass::Admin, "PUT /api/books/<int>", req, res, [&shards, &req, book_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Book::UpdateRequest changes;
+            std::string error;
+            if (!request_body::parse(req.body, changes, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            if (changes.empty()) {
+                return crow::response(400, json{{"error", "No fields to update"}}.dump());
+            }
+            
+            Book bookModel(db);
+            if (bookModel.update(book_id, changes)) {
+                auto response = crow::response(200, json{{"message", "Book updated successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to update book"}}.dump());
+        });
     });
     
     // DELETE book
     CROW_ROUTE(app, "/api/books/<int>")
         .methods("DELETE"_method)
-    ([&bookModel](const crow::request&, int book_id) {
-        if (bookModel.deleteBook(book_id)) {
-            return crow::response(200, json{{"message", "Book deleted successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to delete book"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res, int book_id) {
+        dispatch(RouteClass::Admin, "DELETE /api/books/<int>", req, res, [&shards, &req, book_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Book bookModel(db);
+            if (bookModel.deleteBook(book_id)) {
+                auto response = crow::response(200, json{{"message", "Book deleted successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to delete book"}}.dump());
+        });
     });
     
     // OPTIONS for CORS preflight
@@ -86,7 +300,7 @@ void registerBooksRoutes(crow::SimpleApp& app, Database& db) {
         auto response = crow::response(204);
         response.set_header("Access-Control-Allow-Origin", "*");
         response.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-        response.set_header("Access-Control-Allow-Headers", "Content-Type");
+        response.set_header("Access-Control-Allow-Headers", "Content-Type, X-Session-Token, X-Request-Id, X-Branch-Id");
         return response;
     });
 }
@@ -1,108 +1,406 @@
 #include "crow_all.h"
-#include "database/db_connection.h"
+#include "routes/admission_routes.h"
+#include "routes/branch_routes.h"
+#include "routes/delta_sync_routes.h"
+#include "tracing/tracer.h"
+#include "database/shard_router.h"
 #include "models/borrow.h"
 #include <nlohmann/json.hpp>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
 
 using json = nlohmann::json;
 
-void registerBorrowingRoutes(crow::SimpleApp& app, Database& db) {
-    Borrow borrowModel(&db);
-    
+namespace {
+
+// Exports are spooled here and then sent by Crow's static file writer
+const char* exportDirectory = "/tmp/library_exports";
+const size_t exportChunkBytes = 64 * 1024;
+// Full-history exports stream far longer than the reporting default allows
+const std::chrono::minutes exportDeadline(5);
+
+bool isIsoDate(const std::string& value) {
+    if (value.size() != 10 || value[4] != '-' || value[7] != '-') return false;
+    for (size_t i = 0; i < value.size(); i++) {
+        if (i != 4 && i != 7 && (value[i] < '0' || value[i] > '9')) return false;
+    }
+    return true;
+}
+
+// Scanner sessions are capped so one request cannot hold the primary for long
+const size_t maxBatchItems = 200;
+
+
+crow::response batchResponse(const std::vector<Borrow::BatchItem>& items, const char* id_key,
+                             const std::string& session_token) {
+    json results = json::array();
+    json summary = json::object();
+    for (const auto& item : items) {
+        json result = {{id_key, item.id}, {"outcome", item.outcome}};
+        if (item.borrow_id != 0 && std::string(id_key) != "borrow_id") result["borrow_id"] = item.borrow_id;
+        results.push_back(std::move(result));
+        summary[item.outcome] = summary.value(item.outcome, 0) + 1;
+    }
+    auto response = crow::response(200, json{{"results", results}, {"summary", summary}}.dump());
+    response.set_header("Content-Type", "application/json");
+    setSessionToken(response, session_token);
+    return response;
+}
+
+// Spool files are removed once sent; this clears what a crashed or killed
+// process left behind
+void removeStaleExports() {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    auto cutoff = fs::file_time_type::clock::now() - std::chrono::minutes(15);
+    for (const auto& entry : fs::directory_iterator(exportDirectory, ec)) {
+        if (entry.last_write_time(ec) < cutoff) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+}
+
+} // namespace
+
+void registerBorrowingRoutes(crow::SimpleApp& app, ShardRouter& shards) {
     // GET all borrow records
     CROW_ROUTE(app, "/api/borrowing")
         .methods("GET"_method)
-    ([&borrowModel](const crow::request&) {
-        auto result = borrowModel.getAll();
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/borrowing", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            if (const char* since = req.url_params.get("since")) {
+                return deltaSyncResponse(*db, since, "borrow_records", [&borrowModel](const std::string& since_expression) {
+                    auto rows = borrowModel.getChangedSince(since_expression);
+                    return rows ? std::optional<std::string>(row_schema::encodeJsonArray(*rows)) : std::nullopt;
+                });
+            }
+            auto result = borrowModel.getAll();
+            if (!result) return crow::response(500, json{{"error", "Failed to read borrow records"}}.dump());
+            auto response = crow::response(row_schema::encodeJsonArray(*result));
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // GET borrow record by ID
     CROW_ROUTE(app, "/api/borrowing/<int>")
         .methods("GET"_method)
-    ([&borrowModel](const crow::request&, int borrow_id) {
-        auto result = borrowModel.getById(borrow_id);
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res, int borrow_id) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/borrowing/<int>", req, res, [&shards, &req, borrow_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            std::optional<Borrow> result;
+            if (!borrowModel.getById(borrow_id, result)) {
+                return crow::response(500, json{{"error", "Failed to read borrow record"}}.dump());
+            }
+            auto response = crow::response(result ? row_schema::encodeJson(*result) : "null");
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // GET borrows by member
     CROW_ROUTE(app, "/api/borrowing/member/<int>")
         .methods("GET"_method)
-    ([&borrowModel](const crow::request&, int member_id) {
-        auto result = borrowModel.getByMember(member_id);
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res, int member_id) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/borrowing/member/<int>", req, res, [&shards, &req, member_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            auto result = borrowModel.getByMember(member_id);
+            if (!result) return crow::response(500, json{{"error", "Failed to read borrow records"}}.dump());
+            auto response = crow::response(row_schema::encodeJsonArray(*result));
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // GET borrows by status
     CROW_ROUTE(app, "/api/borrowing/status/<string>")
         .methods("GET"_method)
-    ([&borrowModel](const crow::request&, std::string status) {
-        auto result = borrowModel.getByStatus(status);
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res, std::string status) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/borrowing/status/<string>", req, res, [&shards, &req, status] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            auto result = borrowModel.getByStatus(status);
+            if (!result) return crow::response(500, json{{"error", "Failed to read borrow records"}}.dump());
+            auto response = crow::response(row_schema::encodeJsonArray(*result));
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // GET overdue borrows
     CROW_ROUTE(app, "/api/borrowing/overdue")
         .methods("GET"_method)
-    ([&borrowModel](const crow::request&) {
-        auto result = borrowModel.getOverdue();
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/borrowing/overdue", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            auto result = borrowModel.getOverdue();
+            auto response = crow::response(result.dump());
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
+    });
+    
+    // Export borrow history as CSV or NDJSON
+    CROW_ROUTE(app, "/api/borrowing/export")
+        .methods("GET"_method)
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Reporting, "GET /api/borrowing/export", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Borrow borrowModel(db);
+            const char* format_param = req.url_params.get("format");
+            const char* from_param = req.url_params.get("from");
+            const char* to_param = req.url_params.get("to");
+            const char* status_param = req.url_params.get("status");
+            
+            std::string format = format_param ? format_param : "csv";
+            std::string from_date = from_param ? from_param : "";
+            std::string to_date = to_param ? to_param : "";
+            std::string status = status_param ? status_param : "";
+            
+            if (format != "csv" && format != "ndjson") {
+                return crow::response(400, json{{"error", "format must be csv or ndjson"}}.dump());
+            }
+            if ((!from_date.empty() && !isIsoDate(from_date)) || (!to_date.empty() && !isIsoDate(to_date))) {
+                return crow::response(400, json{{"error", "from and to must be YYYY-MM-DD"}}.dump());
+            }
+            if (!status.empty() && status != "active" && status != "returned" && status != "overdue") {
+                return crow::response(400, json{{"error", "Unknown status"}}.dump());
+            }
+            
+            std::error_code ec;
+            std::filesystem::create_directories(exportDirectory, ec);
+            removeStaleExports();
+            
+            // A fresh name per export, unique across processes sharing the directory
+            std::string suffix = "." + format;
+            std::string path = std::string(exportDirectory) + "/borrow_history_XXXXXX" + suffix;
+            int fd = mkstemps(path.data(), static_cast<int>(suffix.size()));
+            if (fd < 0) {
+                return crow::response(500, json{{"error", "Failed to open export file"}}.dump());
+            }
+            close(fd);
+            afterResponse([path] {
+                std::error_code remove_ec;
+                std::filesystem::remove(path, remove_ec);
+            });
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                return crow::response(500, json{{"error", "Failed to open export file"}}.dump());
+            }
+            
+            bool csv = format == "csv";
+            std::string chunk = csv ? row_schema::csvHeader<Borrow>() : "";
+            chunk.reserve(exportChunkBytes * 2);
+            
+            bool ok = borrowModel.exportHistory(from_date, to_date, status, [&](const Borrow& row) {
+                if (csv) {
+                    row_schema::encodeCsv(chunk, row);
+                } else {
+                    row_schema::encodeJson(chunk, row);
+                    chunk += '\n';
+                }
+                if (chunk.size() >= exportChunkBytes) {
+                    out.write(chunk.data(), chunk.size());
+                    chunk.clear();
+                }
+            });
+            out.write(chunk.data(), chunk.size());
+            out.close();
+            
+            if (!ok || !out) {
+                return crow::response(500, json{{"error", "Export failed"}}.dump());
+            }
+            
+            crow::response response;
+            response.set_static_file_info(path);
+            response.set_header("Content-Type", csv ? "text/csv" : "application/x-ndjson");
+            response.set_header("Content-Disposition",
+                                std::string("attachment; filename=\"borrow_history.") + format + "\"");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        }, exportDeadline);
     });
     
     // CREATE borrow record
     CROW_ROUTE(app, "/api/borrowing")
         .methods("POST"_method)
-    ([&borrowModel](const crow::request& req) {
-        json data = json::parse(req.body);
-        if (borrowModel.create(data)) {
-            return crow::response(201, json{{"message", "Borrow record created successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to create borrow record"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::CirculationWrite, "POST /api/borrowing", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow::CheckoutRequest checkout;
+            std::string error;
+            if (!request_body::parse(req.body, checkout, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            if (!isIsoDate(checkout.borrow_date) || !isIsoDate(checkout.due_date)) {
+                return crow::response(400, json{{"error", "borrow_date and due_date must be YYYY-MM-DD"}}.dump());
+            }
+            
+            Borrow borrowModel(db);
+            switch (borrowModel.checkout(checkout)) {
+                case Borrow::CheckoutStatus::Created: {
+                    auto response = crow::response(201, json{{"message", "Borrow record created successfully"}}.dump());
+                    setSessionToken(response, session.token());
+                    return response;
+                }
+                case Borrow::CheckoutStatus::LimitReached:
+                    return crow::response(409, json{{"error", "Member has reached the borrow limit"}}.dump());
+                case Borrow::CheckoutStatus::MemberNotActive:
+                    return crow::response(403, json{{"error", "Member is not active"}}.dump());
+                case Borrow::CheckoutStatus::UnknownMember:
+                    return crow::response(404, json{{"error", "Member not found"}}.dump());
+                default:
+                    return crow::response(500, json{{"error", "Failed to create borrow record"}}.dump());
+            }
+        });
+    });
+    
+    // Batch checkout: one member, many scanned books
+    CROW_ROUTE(app, "/api/borrowing/batch/checkout")
+        .methods("POST"_method)
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::CirculationWrite, "POST /api/borrowing/batch/checkout", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            
+            Borrow::BatchCheckoutRequest batch;
+            std::string error;
+            if (!request_body::parse(req.body, batch, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            if (!isIsoDate(batch.borrow_date) || !isIsoDate(batch.due_date) || batch.book_ids.empty() ||
+                batch.book_ids.size() > maxBatchItems) {
+                return crow::response(400, json{{"error", "Expected member_id, borrow_date, due_date and 1-200 book_ids"}}.dump());
+            }
+            
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            std::vector<Borrow::BatchItem> items;
+            if (!borrowModel.checkoutBatch(batch.member_id, batch.book_ids, batch.borrow_date, batch.due_date, items)) {
+                return crow::response(500, json{{"error", "Batch checkout failed; nothing was recorded"}}.dump());
+            }
+            return batchResponse(items, "book_id", session.token());
+        });
+    });
+    
+    // Batch return: a whole book drop in one request
+    CROW_ROUTE(app, "/api/borrowing/batch/return")
+        .methods("POST"_method)
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::CirculationWrite, "POST /api/borrowing/batch/return", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            
+            Borrow::BatchReturnRequest batch;
+            std::string error;
+            if (!request_body::parse(req.body, batch, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            if (batch.borrow_ids.empty() || batch.borrow_ids.size() > maxBatchItems) {
+                return crow::response(400, json{{"error", "Expected 1-200 borrow_ids"}}.dump());
+            }
+            
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            std::vector<Borrow::BatchItem> items;
+            if (!borrowModel.returnBatch(batch.borrow_ids, items)) {
+                return crow::response(500, json{{"error", "Batch return failed; nothing was recorded"}}.dump());
+            }
+            return batchResponse(items, "borrow_id", session.token());
+        });
     });
     
     // UPDATE borrow record
     CROW_ROUTE(app, "/api/borrowing/<int>")
         .methods("PUT"_method)
-    ([&borrowModel](const crow::request& req, int borrow_id) {
-        json data = json::parse(req.body);
-        if (borrowModel.update(borrow_id, data)) {
-            return crow::response(200, json{{"message", "Borrow record updated successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to update borrow record"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res, int borrow_id) {
+        dispatch(RouteClass::CirculationWrite, "PUT /api/borrowing/<int>", req, res, [&shards, &req, borrow_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow::UpdateRequest changes;
+            std::string error;
+            if (!request_body::parse(req.body, changes, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            if (changes.empty()) {
+                return crow::response(400, json{{"error", "No fields to update"}}.dump());
+            }
+            if (changes.status && *changes.status != "active" && *changes.status != "returned" &&
+                *changes.status != "overdue") {
+                return crow::response(400, json{{"error", "Unknown status"}}.dump());
+            }
+            
+            Borrow borrowModel(db);
+            if (borrowModel.update(borrow_id, changes)) {
+                auto response = crow::response(200, json{{"message", "Borrow record updated successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to update borrow record"}}.dump());
+        });
     });
     
     // Record return
     CROW_ROUTE(app, "/api/borrowing/<int>/return")
         .methods("POST"_method)
-    ([&borrowModel](const crow::request&, int borrow_id) {
-        if (borrowModel.recordReturn(borrow_id)) {
-            return crow::response(200, json{{"message", "Return recorded successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to record return"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res, int borrow_id) {
+        dispatch(RouteClass::CirculationWrite, "POST /api/borrowing/<int>/return", req, res, [&shards, &req, borrow_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            if (borrowModel.recordReturn(borrow_id)) {
+                auto response = crow::response(200, json{{"message", "Return recorded successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to record return"}}.dump());
+        });
     });
     
     // DELETE borrow record
     CROW_ROUTE(app, "/api/borrowing/<int>")
         .methods("DELETE"_method)
-    ([&borrowModel](const crow::request&, int borrow_id) {
-        if (borrowModel.deleteBorrow(borrow_id)) {
-            return crow::response(200, json{{"message", "Borrow record deleted successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to delete borrow record"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res, int borrow_id) {
+        dispatch(RouteClass::CirculationWrite, "DELETE /api/borrowing/<int>", req, res, [&shards, &req, borrow_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Borrow borrowModel(db);
+            if (borrowModel.deleteBorrow(borrow_id)) {
+                auto response = crow::response(200, json{{"message", "Borrow record deleted successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to delete borrow record"}}.dump());
+        });
     });
     
     // OPTIONS for CORS preflight
@@ -112,7 +410,7 @@ void registerBorrowingRoutes(crow::SimpleApp& app, Database& db) {
         auto response = crow::response(204);
         response.set_header("Access-Control-Allow-Origin", "*");
         response.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-        response.set_header("Access-Control-Allow-Headers", "Content-Type");
+        response.set_header("Access-Control-Allow-Headers", "Content-Type, X-Session-Token, X-Request-Id, X-Branch-Id");
         return response;
     });
 }
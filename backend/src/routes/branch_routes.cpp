@@ -0,0 +1,53 @@
+#include "routes/branch_routes.h"
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+std::string branchParameter(const crow::request& req) {
+    std::string header = req.get_header_value("X-Branch-Id");
+    if (!header.empty()) return header;
+    const char* param = req.url_params.get("branch");
+    return param ? param : "";
+}
+
+} // namespace
+
+int requestedBranch(ShardRouter& shards, const crow::request& req) {
+    std::string value = branchParameter(req);
+    if (value.empty()) return shards.homeBranch();
+    
+    char* end = nullptr;
+    long branch_id = std::strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || branch_id <= 0) return -1;
+    return static_cast<int>(branch_id);
+}
+
+Database* branchDatabase(ShardRouter& shards, const crow::request& req) {
+    return shards.find(requestedBranch(shards, req));
+}
+
+bool isAllBranches(const crow::request& req) {
+    return branchParameter(req) == "all";
+}
+
+crow::response unknownBranch() {
+    auto response = crow::response(404, json{{"error", "Unknown branch"}}.dump());
+    response.set_header("Content-Type", "application/json");
+    response.set_header("Access-Control-Allow-Origin", "*");
+    return response;
+}
+
+void registerBranchRoutes(crow::SimpleApp& app, ShardRouter& shards) {
+    // GET branches and the state of their databases
+    CROW_ROUTE(app, "/api/branches")
+        .methods("GET"_method)
+    ([&shards](const crow::request&) {
+        auto response = crow::response(shards.getStatus().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+}
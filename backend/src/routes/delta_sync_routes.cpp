@@ -0,0 +1,43 @@
+#include "routes/delta_sync_routes.h"
+#include "database/delta_sync.h"
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+crow::response deltaSyncResponse(Database& db, const std::string& since, const std::string& table,
+                                 const std::function<std::optional<std::string>(const std::string&)>& changed) {
+    auto since_expression = delta_sync::sinceExpression(since);
+    if (!since_expression) {
+        auto response = crow::response(400, json{{"error", "since must be a sync token or YYYY-MM-DD HH:MM:SS"}}.dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    }
+    
+    delta_sync::Window window = delta_sync::open(db, *since_expression);
+    if (window.expired) {
+        auto response = crow::response(410, json{
+            {"error", "since is older than the deletion history; reload without since"},
+            {"retention_days", delta_sync::retentionDays()}
+        }.dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    }
+    auto deleted = window.ok ? delta_sync::deletedIds(db, table, *since_expression) : std::nullopt;
+    auto rows = deleted ? changed(*since_expression) : std::nullopt;
+    if (!rows) {
+        auto response = crow::response(500, json{{"error", "Failed to read changes"}}.dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    }
+    
+    std::string body = "{\"changed\":" + *rows
+        + ",\"deleted\":" + json(*deleted).dump()
+        + ",\"next_since\":\"" + window.next_since + "\"}";
+    auto response = crow::response(body);
+    response.set_header("Content-Type", "application/json");
+    response.set_header("Access-Control-Allow-Origin", "*");
+    return response;
+}
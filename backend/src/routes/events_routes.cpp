@@ -0,0 +1,32 @@
+#include "routes/events_routes.h"
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+void registerEventsRoutes(crow::SimpleApp& app) {
+    // Live change feed: books, members and borrow records
+    CROW_WEBSOCKET_ROUTE(app, "/api/events")
+        .onopen([](crow::websocket::connection& conn) {
+            auto subscriber_id = EventBus::instance().subscribe(
+                [&conn](const std::string& frame) { conn.send_text(frame); });
+            conn.userdata(reinterpret_cast<void*>(static_cast<std::uintptr_t>(subscriber_id)));
+        })
+        .onclose([](crow::websocket::connection& conn, const std::string&) {
+            auto subscriber_id = reinterpret_cast<std::uintptr_t>(conn.userdata());
+            EventBus::instance().unsubscribe(subscriber_id);
+        })
+        .onmessage([](crow::websocket::connection&, const std::string&, bool) {
+            // The feed is one-way; client messages are ignored
+        });
+    
+    // GET event feed statistics
+    CROW_ROUTE(app, "/api/events/stats")
+        .methods("GET"_method)
+    ([](const crow::request&) {
+        auto response = crow::response(EventBus::instance().getStats().dump());
+        response.set_header("Content-Type", "application/json");
+        response.set_header("Access-Control-Allow-Origin", "*");
+        return response;
+    });
+}
@@ -1,100 +1,185 @@
 #include "crow_all.h"
-#include "database/db_connection.h"
+#include "routes/admission_routes.h"
+#include "routes/branch_routes.h"
+#include "routes/delta_sync_routes.h"
+#include "tracing/tracer.h"
+#include "database/shard_router.h"
 #include "models/member.h"
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
-void registerMembersRoutes(crow::SimpleApp& app, Database& db) {
-    Member memberModel(&db);
-    
+void registerMembersRoutes(crow::SimpleApp& app, ShardRouter& shards) {
     // GET all members
     CROW_ROUTE(app, "/api/members")
         .methods("GET"_method)
-    ([&memberModel](const crow::request&) {
-        auto result = memberModel.getAll();
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/members", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Member memberModel(db);
+            if (const char* since = req.url_params.get("since")) {
+                return deltaSyncResponse(*db, since, "members", [&memberModel](const std::string& since_expression) {
+                    auto rows = memberModel.getChangedSince(since_expression);
+                    return rows ? std::optional<std::string>(row_schema::encodeJsonArray(*rows)) : std::nullopt;
+                });
+            }
+            auto result = memberModel.getAll();
+            if (!result) return crow::response(500, json{{"error", "Failed to read members"}}.dump());
+            auto response = crow::response(row_schema::encodeJsonArray(*result));
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // GET member by ID
     CROW_ROUTE(app, "/api/members/<int>")
         .methods("GET"_method)
-    ([&memberModel](const crow::request&, int member_id) {
-        auto result = memberModel.getById(member_id);
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res, int member_id) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/members/<int>", req, res, [&shards, &req, member_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Member memberModel(db);
+            std::optional<Member> result;
+            if (!memberModel.getById(member_id, result)) {
+                return crow::response(500, json{{"error", "Failed to read member"}}.dump());
+            }
+            auto response = crow::response(result ? row_schema::encodeJson(*result) : "null");
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // Search members
     CROW_ROUTE(app, "/api/members/search")
         .methods("GET"_method)
-    ([&memberModel](const crow::request& req) {
-        std::string query = req.url_params.get("q");
-        
-        auto result = memberModel.search(query ? query : "");
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/members/search", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Member memberModel(db);
+            const char* query = req.url_params.get("q");
+            
+            auto result = memberModel.search(query ? query : "");
+            if (!result) return crow::response(500, json{{"error", "Failed to search members"}}.dump());
+            auto response = crow::response(row_schema::encodeJsonArray(*result));
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // Filter by status
     CROW_ROUTE(app, "/api/members/status/<string>")
         .methods("GET"_method)
-    ([&memberModel](const crow::request&, std::string status) {
-        auto result = memberModel.filterByStatus(status);
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res, std::string status) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/members/status/<string>", req, res, [&shards, &req, status] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Member memberModel(db);
+            auto result = memberModel.filterByStatus(status);
+            if (!result) return crow::response(500, json{{"error", "Failed to read members"}}.dump());
+            auto response = crow::response(row_schema::encodeJsonArray(*result));
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // Get member statistics
     CROW_ROUTE(app, "/api/members/<int>/stats")
         .methods("GET"_method)
-    ([&memberModel](const crow::request&, int member_id) {
-        auto result = memberModel.getMemberStats(member_id);
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res, int member_id) {
+        dispatch(RouteClass::InteractiveRead, "GET /api/members/<int>/stats", req, res, [&shards, &req, member_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Member memberModel(db);
+            auto result = memberModel.getMemberStats(member_id);
+            auto response = crow::response(result.dump());
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
     });
     
     // CREATE member
     CROW_ROUTE(app, "/api/members")
         .methods("POST"_method)
-    ([&memberModel](const crow::request& req) {
-        json data = json::parse(req.body);
-        if (memberModel.create(data)) {
-            return crow::response(201, json{{"message", "Member created successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to create member"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Admin, "POST /api/members", req, res, [&shards, &req] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Member::CreateRequest member;
+            std::string error;
+            if (!request_body::parse(req.body, member, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            
+            Member memberModel(db);
+            if (memberModel.create(member)) {
+                auto response = crow::response(201, json{{"message", "Member created successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to create member"}}.dump());
+        });
     });
     
     // UPDATE member
     CROW_ROUTE(app, "/api/members/<int>")
         .methods("PUT"_method)
-    ([&memberModel](const crow::request& req, int member_id) {
-        json data = json::parse(req.body);
-        if (memberModel.update(member_id, data)) {
-            return crow::response(200, json{{"message", "Member updated successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to update member"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res, int member_id) {
+        dispatch(RouteClass::Admin, "PUT /api/members/<int>", req, res, [&shards, &req, member_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Member::UpdateRequest changes;
+            std::string error;
+            if (!request_body::parse(req.body, changes, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            if (changes.empty()) {
+                return crow::response(400, json{{"error", "No fields to update"}}.dump());
+            }
+            if (changes.status && *changes.status != "active" && *changes.status != "inactive" &&
+                *changes.status != "suspended") {
+                return crow::response(400, json{{"error", "status must be active, inactive or suspended"}}.dump());
+            }
+            
+            Member memberModel(db);
+            if (memberModel.update(member_id, changes)) {
+                auto response = crow::response(200, json{{"message", "Member updated successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to update member"}}.dump());
+        });
     });
     
     // DELETE member
     CROW_ROUTE(app, "/api/members/<int>")
         .methods("DELETE"_method)
-    ([&memberModel](const crow::request&, int member_id) {
-        if (memberModel.deleteMember(member_id)) {
-            return crow::response(200, json{{"message", "Member deleted successfully"}}.dump());
-        }
-        return crow::response(500, json{{"error", "Failed to delete member"}}.dump());
+    ([&shards](const crow::request& req, crow::response& res, int member_id) {
+        dispatch(RouteClass::Admin, "DELETE /api/members/<int>", req, res, [&shards, &req, member_id] {
+            Database* db = branchDatabase(shards, req);
+            if (!db) return unknownBranch();
+            Database::Session session(*db, req.get_header_value("X-Session-Token"));
+            Member memberModel(db);
+            if (memberModel.deleteMember(member_id)) {
+                auto response = crow::response(200, json{{"message", "Member deleted successfully"}}.dump());
+                setSessionToken(response, session.token());
+                return response;
+            }
+            return crow::response(500, json{{"error", "Failed to delete member"}}.dump());
+        });
     });
     
     // OPTIONS for CORS preflight
@@ -104,7 +189,7 @@ void registerMembersRoutes(crow::SimpleApp& app, Database& db) {
         auto response = crow::response(204);
         response.set_header("Access-Control-Allow-Origin", "*");
         response.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-        response.set_header("Access-Control-Allow-Headers", "Content-Type");
+        response.set_header("Access-Control-Allow-Headers", "Content-Type, X-Session-Token, X-Request-Id, X-Branch-Id");
         return response;
     });
 }
@@ -1,77 +1,405 @@
 #include "crow_all.h"
-#include "database/db_connection.h"
+#include "routes/admission_routes.h"
+#include "routes/branch_routes.h"
+#include "tracing/tracer.h"
+#include "database/shard_router.h"
 #include "models/borrow.h"
+#include "models/request_body.h"
+#include "services/circulation_columns.h"
+#include "cache/result_cache.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <optional>
 
 using json = nlohmann::json;
+using namespace std::chrono_literals;
 
-void registerReportsRoutes(crow::SimpleApp& app, Database& db) {
-    Borrow borrowModel(&db);
-    
+namespace {
+
+ResultCache reportCache;
+
+using BranchResults = std::vector<std::pair<int, json>>;
+
+// A report computed per branch. `merge` combines every branch's result for
+// ?branch=all; `complete` decides whether a result may be cached.
+struct Report {
+    const char* name;
+    ResultCache::Policy policy;
+    std::function<json(Database&)> load;
+    std::function<json(const BranchResults&)> merge;
+    std::function<bool(const json&)> complete;
+};
+
+bool isCacheable(const json& result) {
+    return !(result.is_object() && result.contains("error"));
+}
+
+// Adds up the numeric fields of per-branch count objects
+json sumCounts(const BranchResults& results) {
+    json total = json::object();
+    for (const auto& [branch_id, result] : results) {
+        for (auto it = result.begin(); it != result.end(); ++it) {
+            if (!it.value().is_number()) continue;
+            total[it.key()] = total.value(it.key(), 0LL) + it.value().get<long long>();
+        }
+    }
+    return total;
+}
+
+json mergeMonthly(const BranchResults& results) {
+    std::map<std::string, std::pair<long long, long long>> months;
+    for (const auto& [branch_id, rows] : results) {
+        for (const auto& row : rows) {
+            auto& month = months[row["month"].get<std::string>()];
+            month.first += row.value("borrows", 0LL);
+            month.second += row.value("returns", 0LL);
+        }
+    }
+
+    json merged = json::array();
+    for (auto it = months.rbegin(); it != months.rend() && merged.size() < 12; ++it) {
+        merged.push_back({{"month", it->first}, {"borrows", it->second.first}, {"returns", it->second.second}});
+    }
+    return merged;
+}
+
+// Each branch returns its own top five, which always contains that branch's
+// share of the overall top five
+json mergeTopBooks(const BranchResults& results) {
+    json merged = json::array();
+    for (const auto& [branch_id, rows] : results) {
+        for (auto row : rows) {
+            row["branch_id"] = branch_id;
+            merged.push_back(std::move(row));
+        }
+    }
+    std::stable_sort(merged.begin(), merged.end(), [](const json& a, const json& b) {
+        return a.value("borrow_count", 0) > b.value("borrow_count", 0);
+    });
+    if (merged.size() > 5) {
+        merged.erase(merged.begin() + 5, merged.end());
+    }
+    return merged;
+}
+
+json loadDashboard(Database& db) {
+    json dashboard = json::object();
+
+    // Total books
+    auto books_result = db.executeRead("SELECT COUNT(*) as count FROM books");
+    if (books_result.is_array() && !books_result.empty()) {
+        dashboard["total_books"] = books_result[0]["count"];
+    }
+
+    // Active members
+    auto members_result = db.executeRead("SELECT COUNT(*) as count FROM members WHERE status = 'active'");
+    if (members_result.is_array() && !members_result.empty()) {
+        dashboard["active_members"] = members_result[0]["count"];
+    }
+
+    // Currently borrowed
+    auto borrowed_result = db.executeRead("SELECT COUNT(*) as count FROM borrow_records WHERE status = 'active'");
+    if (borrowed_result.is_array() && !borrowed_result.empty()) {
+        dashboard["books_borrowed"] = borrowed_result[0]["count"];
+    }
+
+    // Overdue books
+    auto overdue_result = db.executeRead("SELECT COUNT(*) as count FROM borrow_records WHERE status = 'overdue'");
+    if (overdue_result.is_array() && !overdue_result.empty()) {
+        dashboard["overdue_books"] = overdue_result[0]["count"];
+    }
+
+    return dashboard;
+}
+
+// Per-endpoint freshness: how long a result is served as is, then how long
+// it may still be served while a background refresh runs
+const Report statisticsReport{
+    "statistics", {30s, 60s},
+    [](Database& db) { return Borrow(&db).getStatistics(); },
+    sumCounts, isCacheable
+};
+const Report monthlyReport{
+    "monthly", {300s, 600s},
+    [](Database& db) { return Borrow(&db).getMonthlyStats(); },
+    mergeMonthly, isCacheable
+};
+const Report topBooksReport{
+    "top-books", {120s, 300s},
+    [](Database& db) { return Borrow(&db).getTopBooks(); },
+    mergeTopBooks, isCacheable
+};
+const Report dashboardReport{
+    "dashboard", {15s, 30s},
+    loadDashboard, sumCounts,
+    [](const json& dashboard) { return dashboard.size() == 4; }
+};
+
+// Serves one branch's report, or with ?branch=all gathers every branch's in
+// parallel and merges them. Empty if the requested branch does not exist.
+std::optional<std::string> runReport(ShardRouter& shards, const crow::request& req, const Report& report) {
+    if (isAllBranches(req)) {
+        return reportCache.get(std::string(report.name) + ":all", report.policy, [&shards, &report](std::string& value) {
+            auto results = shards.scatter([&report](int, Database& db) { return report.load(db); });
+            for (const auto& [branch_id, result] : results) {
+                if (!report.complete(result)) {
+                    value = json{{"error", "Report failed for branch " + std::to_string(branch_id)}}.dump();
+                    return false;
+                }
+            }
+            value = report.merge(results).dump();
+            return true;
+        });
+    }
+
+    int branch_id = requestedBranch(shards, req);
+    Database* db = shards.find(branch_id);
+    if (!db) return std::nullopt;
+
+    Database::Session session(*db, req.get_header_value("X-Session-Token"));
+    return reportCache.get(std::string(report.name) + ":" + std::to_string(branch_id), report.policy,
+                           [db, &report](std::string& value) {
+        auto result = report.load(*db);
+        value = result.dump();
+        return report.complete(result);
+    });
+}
+
+crow::response reportResponse(const std::optional<std::string>& body) {
+    if (!body) return unknownBranch();
+    auto response = crow::response(*body);
+    response.set_header("Content-Type", "application/json");
+    response.set_header("Access-Control-Allow-Origin", "*");
+    return response;
+}
+
+// POST /api/reports/query body. Dates are "YYYY-MM-DD" and cohorts (join
+// months) "YYYY-MM"; the ranges are inclusive and empty leaves them open.
+struct AnalyticsQuery {
+    std::vector<std::string> group_by;
+    std::vector<std::string> status;
+    std::vector<std::string> category;
+    std::string from;
+    std::string to;
+    std::string cohort_from;
+    std::string cohort_to;
+    std::string order_by;       // a metric, largest first; default is group order
+    int limit = 1000;
+};
+
+const char* const analyticsMetrics[] = {"loans", "fines", "avg_fine", "returned", "avg_loan_days", "late"};
+constexpr int maxAnalyticsGroups = 10000;
+
+double metricValue(const CirculationColumns::Totals& totals, const std::string& metric) {
+    if (metric == "loans") return double(totals.loans);
+    if (metric == "fines") return totals.fine_cents / 100.0;
+    if (metric == "avg_fine") return totals.loans ? totals.fine_cents / 100.0 / totals.loans : 0;
+    if (metric == "returned") return double(totals.returned);
+    if (metric == "avg_loan_days") return totals.returned ? double(totals.loan_days) / totals.returned : 0;
+    return double(totals.late);
+}
+
+bool compileQuery(const AnalyticsQuery& body, CirculationColumns::Query& query, std::string& error) {
+    for (const auto& name : body.group_by) {
+        auto dimension = CirculationColumns::parseDimension(name);
+        if (!dimension) {
+            error = "Unknown group_by dimension " + name
+                + "; use status, category, year, month, cohort_year or cohort_month";
+            return false;
+        }
+        query.group_by.push_back(*dimension);
+    }
+    query.statuses = body.status;
+    query.categories = body.category;
+
+    auto day = [&error](const std::string& value, const char* name, int32_t& out) {
+        if (value.empty()) return true;
+        auto parsed = CirculationColumns::dayNumber(value);
+        if (!parsed) error = std::string(name) + " must be YYYY-MM-DD";
+        else out = *parsed;
+        return bool(parsed);
+    };
+    auto month = [&error](const std::string& value, const char* name, int32_t& out) {
+        if (value.empty()) return true;
+        auto parsed = CirculationColumns::monthNumber(value);
+        if (!parsed) error = std::string(name) + " must be YYYY-MM";
+        else out = *parsed;
+        return bool(parsed);
+    };
+    if (!day(body.from, "from", query.from_day) || !day(body.to, "to", query.to_day)
+        || !month(body.cohort_from, "cohort_from", query.cohort_from)
+        || !month(body.cohort_to, "cohort_to", query.cohort_to)) {
+        return false;
+    }
+
+    if (!body.order_by.empty() && std::find(std::begin(analyticsMetrics), std::end(analyticsMetrics),
+                                            body.order_by) == std::end(analyticsMetrics)) {
+        error = "order_by must be one of loans, fines, avg_fine, returned, avg_loan_days, late";
+        return false;
+    }
+    if (body.limit < 1 || body.limit > maxAnalyticsGroups) {
+        error = "limit must be between 1 and " + std::to_string(maxAnalyticsGroups);
+        return false;
+    }
+    return true;
+}
+
+// One object per group: its labels under the dimension names, then the metrics
+json analyticsResponse(const AnalyticsQuery& body, const CirculationColumns::Result& result) {
+    std::vector<const std::pair<const std::vector<std::string>, CirculationColumns::Totals>*> groups;
+    for (const auto& group : result.groups) groups.push_back(&group);
+    if (!body.order_by.empty()) {
+        std::stable_sort(groups.begin(), groups.end(), [&body](const auto* a, const auto* b) {
+            return metricValue(a->second, body.order_by) > metricValue(b->second, body.order_by);
+        });
+    }
+
+    json rows = json::array();
+    for (const auto* group : groups) {
+        if (rows.size() >= size_t(body.limit)) break;
+        json row = json::object();
+        for (size_t i = 0; i < body.group_by.size(); ++i) row[body.group_by[i]] = group->first[i];
+        const auto& totals = group->second;
+        auto rounded = [&totals](const char* metric) { return std::round(metricValue(totals, metric) * 100) / 100; };
+        row["loans"] = totals.loans;
+        row["fines"] = rounded("fines");
+        row["avg_fine"] = rounded("avg_fine");
+        row["returned"] = totals.returned;
+        row["avg_loan_days"] = rounded("avg_loan_days");
+        row["late"] = totals.late;
+        rows.push_back(std::move(row));
+    }
+    return {
+        {"group_by", body.group_by},
+        {"groups", rows},
+        {"total_groups", result.groups.size()},
+        {"rows_scanned", result.rows},
+        {"elapsed_ms", result.elapsed_ms}
+    };
+}
+
+} // namespace
+
+template <>
+struct RequestSchema<AnalyticsQuery> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::optional("group_by", &AnalyticsQuery::group_by),
+        request_body::optional("status", &AnalyticsQuery::status),
+        request_body::optional("category", &AnalyticsQuery::category),
+        request_body::optional("from", &AnalyticsQuery::from),
+        request_body::optional("to", &AnalyticsQuery::to),
+        request_body::optional("cohort_from", &AnalyticsQuery::cohort_from),
+        request_body::optional("cohort_to", &AnalyticsQuery::cohort_to),
+        request_body::optional("order_by", &AnalyticsQuery::order_by),
+        request_body::optional("limit", &AnalyticsQuery::limit)
+    );
+};
+
+void expireReportCache() {
+    reportCache.expireAll();
+}
+
+void registerReportsRoutes(crow::SimpleApp& app, ShardRouter& shards) {
     // GET statistics
     CROW_ROUTE(app, "/api/reports/statistics")
         .methods("GET"_method)
-    ([&borrowModel](const crow::request&) {
-        auto result = borrowModel.getStatistics();
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Reporting, "GET /api/reports/statistics", req, res, [&shards, &req] {
+            return reportResponse(runReport(shards, req, statisticsReport));
+        });
     });
     
     // GET monthly statistics
     CROW_ROUTE(app, "/api/reports/monthly")
         .methods("GET"_method)
-    ([&borrowModel](const crow::request&) {
-        auto result = borrowModel.getMonthlyStats();
-        auto response = crow::response(result.dump());
-        response.set_header("Content-Type", "application/json");
-        response.set_header("Access-Control-Allow-Origin", "*");
-        return response;
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Reporting, "GET /api/reports/monthly", req, res, [&shards, &req] {
+            return reportResponse(runReport(shards, req, monthlyReport));
+        });
     });
     
     // GET top books
     CROW_ROUTE(app, "/api/reports/top-books")
         .methods("GET"_method)
-    ([&borrowModel](const crow::request&) {
-        auto result = borrowModel.getTopBooks();
-        auto response = crow::response(result.dump());
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Reporting, "GET /api/reports/top-books", req, res, [&shards, &req] {
+            return reportResponse(runReport(shards, req, topBooksReport));
+        });
+    });
+    
+    // GET dashboard data
+    CROW_ROUTE(app, "/api/reports/dashboard")
+        .methods("GET"_method)
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Reporting, "GET /api/reports/dashboard", req, res, [&shards, &req] {
+            return reportResponse(runReport(shards, req, dashboardReport));
+        });
+    });
+    
+    // GET report cache counters
+    CROW_ROUTE(app, "/api/reports/cache-stats")
+        .methods("GET"_method)
+    ([](const crow::request&) {
+        auto response = crow::response(reportCache.getStats().dump());
         response.set_header("Content-Type", "application/json");
         response.set_header("Access-Control-Allow-Origin", "*");
         return response;
     });
     
-    // GET dashboard data
-    CROW_ROUTE(app, "/api/reports/dashboard")
+    // POST ad-hoc circulation aggregate, served from the in-memory columnar
+    // store; ?branch=all adds up every branch's groups
+    CROW_ROUTE(app, "/api/reports/query")
+        .methods("POST"_method)
+    ([&shards](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Reporting, "POST /api/reports/query", req, res, [&shards, &req] {
+            AnalyticsQuery body;
+            CirculationColumns::Query query;
+            std::string error;
+            if (!request_body::parse(req.body, body, error) || !compileQuery(body, query, error)) {
+                return crow::response(400, json{{"error", error}}.dump());
+            }
+            
+            std::vector<Database*> stores;
+            if (isAllBranches(req)) {
+                for (int branch_id : shards.branches()) stores.push_back(shards.find(branch_id));
+            } else if (Database* db = branchDatabase(shards, req)) {
+                stores.push_back(db);
+            } else {
+                return unknownBranch();
+            }
+            
+            CirculationColumns::Result merged;
+            for (Database* db : stores) {
+                CirculationColumns& columns = CirculationColumns::of(*db);
+                if (!columns.ready()) {
+                    auto response = crow::response(503, json{{"error", "Analytics store is still loading"}}.dump());
+                    response.set_header("Retry-After", "5");
+                    return response;
+                }
+                auto result = columns.run(query);
+                if (!result.error.empty()) {
+                    return crow::response(400, json{{"error", result.error}}.dump());
+                }
+                for (const auto& [labels, totals] : result.groups) merged.groups[labels].add(totals);
+                merged.rows += result.rows;
+                merged.elapsed_ms += result.elapsed_ms;
+            }
+            
+            auto response = crow::response(analyticsResponse(body, merged).dump());
+            response.set_header("Content-Type", "application/json");
+            response.set_header("Access-Control-Allow-Origin", "*");
+            return response;
+        });
+    });
+    
+    // GET columnar store counters for the requested branch
+    CROW_ROUTE(app, "/api/reports/query/stats")
         .methods("GET"_method)
-    ([&db](const crow::request&) {
-        json dashboard = json::object();
-        
-        // Total books
-        auto books_result = db.executeQuery("SELECT COUNT(*) as count FROM books");
-        if (!books_result.empty()) {
-            dashboard["total_books"] = books_result[0]["count"];
-        }
-        
-        // Active members
-        auto members_result = db.executeQuery("SELECT COUNT(*) as count FROM members WHERE status = 'active'");
-        if (!members_result.empty()) {
-            dashboard["active_members"] = members_result[0]["count"];
-        }
-        
-        // Currently borrowed
-        auto borrowed_result = db.executeQuery("SELECT COUNT(*) as count FROM borrow_records WHERE status = 'active'");
-        if (!borrowed_result.empty()) {
-            dashboard["books_borrowed"] = borrowed_result[0]["count"];
-        }
-        
-        // Overdue books
-        auto overdue_result = db.executeQuery("SELECT COUNT(*) as count FROM borrow_records WHERE status = 'overdue'");
-        if (!overdue_result.empty()) {
-            dashboard["overdue_books"] = overdue_result[0]["count"];
-        }
-        
-        auto response = crow::response(dashboard.dump());
+    ([&shards](const crow::request& req) {
+        Database* db = branchDatabase(shards, req);
+        if (!db) return unknownBranch();
+        auto response = crow::response(CirculationColumns::of(*db).getStats().dump());
         response.set_header("Content-Type", "application/json");
         response.set_header("Access-Control-Allow-Origin", "*");
         return response;
@@ -84,7 +412,7 @@ void registerReportsRoutes(crow::SimpleApp& app, Database& db) {
         auto response = crow::response(204);
         response.set_header("Access-Control-Allow-Origin", "*");
         response.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-        response.set_header("Access-Control-Allow-Headers", "Content-Type");
+        response.set_header("Access-Control-Allow-Headers", "Content-Type, X-Session-Token, X-Request-Id, X-Branch-Id");
         return response;
     });
 }
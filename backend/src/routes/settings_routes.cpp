@@ -1,21 +1,58 @@
 #include "routes/settings_routes.h"
+#include "routes/admission_routes.h"
+#include "tracing/tracer.h"
+#include "services/settings_cache.h"
+#include "models/request_body.h"
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <sstream>
 
 using json = nlohmann::json;
 
+namespace {
+
+// PUT /api/settings body; only the fields present are changed
+struct SettingsUpdate {
+    std::optional<std::string> library_name;
+    std::optional<std::string> email;
+    std::optional<std::string> phone;
+    std::optional<std::string> address;
+    std::optional<int> borrow_limit;
+    std::optional<int> borrow_duration_days;
+    std::optional<double> late_fee_per_day;
+    std::optional<bool> enable_notifications;
+    std::optional<bool> enable_fine;
+    
+    bool empty() const {
+        return !library_name && !email && !phone && !address && !borrow_limit && !borrow_duration_days &&
+               !late_fee_per_day && !enable_notifications && !enable_fine;
+    }
+};
+
+} // namespace
+
+template <>
+struct RequestSchema<SettingsUpdate> {
+    static constexpr auto fields = std::make_tuple(
+        request_body::optional("library_name", &SettingsUpdate::library_name),
+        request_body::optional("email", &SettingsUpdate::email),
+        request_body::optional("phone", &SettingsUpdate::phone),
+        request_body::optional("address", &SettingsUpdate::address),
+        request_body::optional("borrow_limit", &SettingsUpdate::borrow_limit),
+        request_body::optional("borrow_duration_days", &SettingsUpdate::borrow_duration_days),
+        request_body::optional("late_fee_per_day", &SettingsUpdate::late_fee_per_day),
+        request_body::optional("enable_notifications", &SettingsUpdate::enable_notifications),
+        request_body::optional("enable_fine", &SettingsUpdate::enable_fine)
+    );
+};
+
 void registerSettingsRoutes(crow::SimpleApp& app, Database& db) {
     // GET library settings
     CROW_ROUTE(app, "/api/settings")
         .methods("GET"_method)
-    ([&db](const crow::request&) {
-        json result = db.executeQuery("SELECT * FROM settings LIMIT 1");
-        if (!result.empty() && result.is_array()) {
-            auto response = crow::response(result[0].dump());
-            response.set_header("Content-Type", "application/json");
-            response.set_header("Access-Control-Allow-Origin", "*");
-            return response;
-        }
-        auto response = crow::response(json{{"error", "Settings not found"}}.dump());
+    ([](const crow::request&) {
+        // Served from the in-memory snapshot; PUT below refreshes it
+        auto response = crow::response(SettingsCache::instance().snapshot().body);
         response.set_header("Content-Type", "application/json");
         response.set_header("Access-Control-Allow-Origin", "*");
         return response;
@@ -24,78 +61,52 @@ void registerSettingsRoutes(crow::SimpleApp& app, Database& db) {
     // UPDATE library settings
     CROW_ROUTE(app, "/api/settings")
         .methods("PUT"_method)
-    ([&db](const crow::request& req) {
-        try {
-            json data = json::parse(req.body);
+    ([&db](const crow::request& req, crow::response& res) {
+        dispatch(RouteClass::Admin, "PUT /api/settings", req, res, [&db, &req] {
+            Database::Session session(db, req.get_header_value("X-Session-Token"));
+            SettingsUpdate changes;
+            std::string error;
+            if (!request_body::parse(req.body, changes, error) || changes.empty()) {
+                auto response = crow::response(400, json{{"error", error.empty() ? "No fields to update" : error}}.dump());
+                response.set_header("Content-Type", "application/json");
+                response.set_header("Access-Control-Allow-Origin", "*");
+                return response;
+            }
             
             std::stringstream ss;
             ss << "UPDATE settings SET ";
             
             bool first = true;
-            if (data.contains("library_name")) {
-                if (!first) ss << ", ";
-                ss << "library_name = '" << data["library_name"].get<std::string>() << "'";
-                first = false;
-            }
-            if (data.contains("email")) {
-                if (!first) ss << ", ";
-                ss << "email = '" << data["email"].get<std::string>() << "'";
-                first = false;
-            }
-            if (data.contains("phone")) {
-                if (!first) ss << ", ";
-                ss << "phone = '" << data["phone"].get<std::string>() << "'";
-                first = false;
-            }
-            if (data.contains("address")) {
+            auto separate = [&ss, &first](const char* column) -> std::stringstream& {
                 if (!first) ss << ", ";
-                ss << "address = '" << data["address"].get<std::string>() << "'";
                 first = false;
-            }
-            if (data.contains("borrow_limit")) {
-                if (!first) ss << ", ";
-                ss << "borrow_limit = " << data["borrow_limit"].get<int>();
-                first = false;
-            }
-            if (data.contains("borrow_duration_days")) {
-                if (!first) ss << ", ";
-                ss << "borrow_duration_days = " << data["borrow_duration_days"].get<int>();
-                first = false;
-            }
-            if (data.contains("late_fee_per_day")) {
-                if (!first) ss << ", ";
-                ss << "late_fee_per_day = " << data["late_fee_per_day"].get<double>();
-                first = false;
-            }
-            if (data.contains("enable_notifications")) {
-                if (!first) ss << ", ";
-                ss << "enable_notifications = " << (data["enable_notifications"].get<bool>() ? 1 : 0);
-                first = false;
-            }
-            if (data.contains("enable_fine")) {
-                if (!first) ss << ", ";
-                ss << "enable_fine = " << (data["enable_fine"].get<bool>() ? 1 : 0);
-                first = false;
-            }
+                ss << column << " = ";
+                return ss;
+            };
+            if (changes.library_name) separate("library_name") << "'" << *changes.library_name << "'";
+            if (changes.email) separate("email") << "'" << *changes.email << "'";
+            if (changes.phone) separate("phone") << "'" << *changes.phone << "'";
+            if (changes.address) separate("address") << "'" << *changes.address << "'";
+            if (changes.borrow_limit) separate("borrow_limit") << *changes.borrow_limit;
+            if (changes.borrow_duration_days) separate("borrow_duration_days") << *changes.borrow_duration_days;
+            if (changes.late_fee_per_day) separate("late_fee_per_day") << *changes.late_fee_per_day;
+            if (changes.enable_notifications) separate("enable_notifications") << (*changes.enable_notifications ? 1 : 0);
+            if (changes.enable_fine) separate("enable_fine") << (*changes.enable_fine ? 1 : 0);
             
             ss << " WHERE id = 1";
             
             if (db.executeUpdate(ss.str())) {
+                SettingsCache::instance().load(db);
                 auto response = crow::response(json{{"message", "Settings updated successfully"}}.dump());
+                setSessionToken(response, session.token());
                 response.set_header("Content-Type", "application/json");
-                response.set_header("Access-Control-Allow-Origin", "*");
                 return response;
             }
             auto response = crow::response(500, json{{"error", "Failed to update settings"}}.dump());
             response.set_header("Content-Type", "application/json");
             response.set_header("Access-Control-Allow-Origin", "*");
             return response;
-        } catch (const std::exception& e) {
-            auto response = crow::response(400, json{{"error", e.what()}}.dump());
-            response.set_header("Content-Type", "application/json");
-            response.set_header("Access-Control-Allow-Origin", "*");
-            return response;
-        }
+        });
     });
     
     // OPTIONS for CORS preflight
@@ -105,7 +116,7 @@ void registerSettingsRoutes(crow::SimpleApp& app, Database& db) {
         auto response = crow::response(204);
         response.set_header("Access-Control-Allow-Origin", "*");
         response.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-        response.set_header("Access-Control-Allow-Headers", "Content-Type");
+        response.set_header("Access-Control-Allow-Headers", "Content-Type, X-Session-Token, X-Request-Id, X-Branch-Id");
         return response;
     });
 }
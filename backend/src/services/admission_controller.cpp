@@ -0,0 +1,203 @@
+#include "services/admission_controller.h"
+#include "logging/logger.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Weight of the newest sample in the service time average
+const double serviceTimeWeight = 0.2;
+
+const RouteClass allClasses[] = {RouteClass::CirculationWrite, RouteClass::InteractiveRead,
+                                 RouteClass::Reporting, RouteClass::Admin};
+
+size_t indexOf(RouteClass route_class) {
+    return static_cast<size_t>(route_class);
+}
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Linux schedules threads individually, so a nice value set on one worker
+// leaves the rest of the process alone
+void setWorkerNice(RouteClass route_class, int nice) {
+    if (nice == 0) return;
+#ifdef __linux__
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) != 0) {
+        Logger::warn("admission", "Could not set worker priority")
+            .field("class", routeClassName(route_class))
+            .field("nice", nice);
+    }
+#else
+    (void)route_class;
+#endif
+}
+
+} // namespace
+
+const char* routeClassName(RouteClass route_class) {
+    switch (route_class) {
+        case RouteClass::CirculationWrite: return "circulation_write";
+        case RouteClass::InteractiveRead: return "interactive_read";
+        case RouteClass::Reporting: return "reporting";
+        case RouteClass::Admin: return "admin";
+    }
+    return "unknown";
+}
+
+std::optional<RouteClass> parseRouteClass(const std::string& name) {
+    for (RouteClass route_class : allClasses) {
+        if (name == routeClassName(route_class)) return route_class;
+    }
+    return std::nullopt;
+}
+
+AdmissionController& AdmissionController::instance() {
+    // Never destroyed: the detached workers wait on it until exit
+    static AdmissionController* controller = new AdmissionController();
+    return *controller;
+}
+
+AdmissionController::AdmissionController() {
+    using std::chrono::milliseconds;
+    classes[indexOf(RouteClass::CirculationWrite)].limits = {8, 32, milliseconds(500), 0, milliseconds(5000)};
+    classes[indexOf(RouteClass::InteractiveRead)].limits = {16, 64, milliseconds(250), 0, milliseconds(5000)};
+    classes[indexOf(RouteClass::Reporting)].limits = {4, 16, milliseconds(2000), 10, milliseconds(30000)};
+    classes[indexOf(RouteClass::Admin)].limits = {2, 8, milliseconds(1000), 5, milliseconds(10000)};
+}
+
+void AdmissionController::configure(RouteClass route_class, const AdmissionLimits& limits) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto& state = classes[indexOf(route_class)];
+    state.limits = limits;
+    state.limits.max_concurrent = std::max(1, limits.max_concurrent);
+    state.limits.max_queue = std::max(0, limits.max_queue);
+    // Surplus workers exit once idle
+    state.work.notify_all();
+}
+
+AdmissionLimits AdmissionController::limits(RouteClass route_class) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return classes[indexOf(route_class)].limits;
+}
+
+int AdmissionController::retryAfter(const ClassState& state, double expected_wait_ms) const {
+    double budget_ms = static_cast<double>(state.limits.latency_budget.count());
+    return std::max(1, static_cast<int>(std::ceil(std::max(expected_wait_ms, budget_ms) / 1000.0)));
+}
+
+void AdmissionController::submit(RouteClass route_class, Job job, Reject reject) {
+    std::unique_lock<std::mutex> guard(lock);
+    auto& state = classes[indexOf(route_class)];
+
+    // Workers start with the first request of their class
+    while (state.workers < state.limits.max_concurrent) {
+        state.workers++;
+        std::thread([this, route_class] { runWorker(route_class); }).detach();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    int waiting = static_cast<int>(state.queue.size());
+    double expected_wait_ms = 0;
+
+    if (state.running + waiting >= state.limits.max_concurrent) {
+        // Each queued request ahead of us, plus the ones running, holds a
+        // worker for about one average service time
+        double rounds = std::ceil(static_cast<double>(waiting + 1) / state.limits.max_concurrent);
+        expected_wait_ms = rounds * state.avg_service_ms;
+
+        int retry_after = 0;
+        if (waiting >= state.limits.max_queue) {
+            state.rejected_queue_full++;
+            retry_after = retryAfter(state, expected_wait_ms);
+        } else if (expected_wait_ms > state.limits.latency_budget.count()) {
+            state.rejected_over_budget++;
+            retry_after = retryAfter(state, expected_wait_ms);
+        }
+        if (retry_after > 0) {
+            guard.unlock();
+            reject(retry_after);
+            return;
+        }
+        state.queued++;
+    }
+
+    state.queue.push_back(Pending{std::move(job), std::move(reject), now,
+                                  now + state.limits.latency_budget, expected_wait_ms});
+    state.work.notify_one();
+}
+
+void AdmissionController::runWorker(RouteClass route_class) {
+    std::unique_lock<std::mutex> guard(lock);
+    auto& state = classes[indexOf(route_class)];
+    setWorkerNice(route_class, state.limits.nice);
+
+    for (;;) {
+        state.work.wait(guard, [&state] {
+            return !state.queue.empty() || state.workers > state.limits.max_concurrent;
+        });
+        if (state.workers > state.limits.max_concurrent) {
+            state.workers--;
+            return;
+        }
+
+        Pending next = std::move(state.queue.front());
+        state.queue.pop_front();
+
+        if (std::chrono::steady_clock::now() > next.deadline) {
+            // The budget ran out in the queue
+            state.dropped_deadline++;
+            int retry_after = retryAfter(state, next.expected_wait_ms);
+            guard.unlock();
+            next.reject(retry_after);
+            guard.lock();
+            continue;
+        }
+
+        state.running++;
+        state.admitted++;
+        guard.unlock();
+
+        auto started = std::chrono::steady_clock::now();
+        next.job(std::chrono::duration<double, std::milli>(started - next.queued_at).count());
+        double elapsed_ms = millisSince(started);
+
+        guard.lock();
+        state.running--;
+        state.avg_service_ms = state.avg_service_ms == 0
+            ? elapsed_ms
+            : state.avg_service_ms + serviceTimeWeight * (elapsed_ms - state.avg_service_ms);
+    }
+}
+
+json AdmissionController::getStats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    json stats = json::object();
+    for (RouteClass route_class : allClasses) {
+        const auto& state = classes[indexOf(route_class)];
+        stats[routeClassName(route_class)] = {
+            {"max_concurrent", state.limits.max_concurrent},
+            {"max_queue", state.limits.max_queue},
+            {"latency_budget_ms", state.limits.latency_budget.count()},
+            {"nice", state.limits.nice},
+            {"deadline_ms", state.limits.deadline.count()},
+            {"workers", state.workers},
+            {"running", state.running},
+            {"queue_depth", state.queue.size()},
+            {"avg_service_ms", state.avg_service_ms},
+            {"admitted", state.admitted},
+            {"queued", state.queued},
+            {"rejected_queue_full", state.rejected_queue_full},
+            {"rejected_over_budget", state.rejected_over_budget},
+            {"dropped_deadline", state.dropped_deadline}
+        };
+    }
+    return stats;
+}
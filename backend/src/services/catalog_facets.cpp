@@ -0,0 +1,409 @@
+#include "services/catalog_facets.h"
+#include "logging/logger.h"
+#include "tracing/tracer.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+const char* const statusNames[] = {"available", "low-stock", "out-of-stock"};
+
+// Facet values ordered by count, largest first, then by name
+json rankedCounts(std::vector<std::pair<std::string, uint64_t>> counts, size_t limit) {
+    std::sort(counts.begin(), counts.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    json ranked = json::array();
+    for (const auto& [value, count] : counts) {
+        if (ranked.size() >= limit) break;
+        ranked.push_back({{"value", value}, {"count", count}});
+    }
+    return ranked;
+}
+
+} // namespace
+
+uint32_t CatalogFacets::Dictionary::intern(const std::string& name) {
+    auto [it, inserted] = ids.emplace(name, uint32_t(names.size()));
+    if (inserted) {
+        names.push_back(name);
+        slots.emplace_back();
+    }
+    return it->second;
+}
+
+const RoaringBitmap* CatalogFacets::Dictionary::find(const std::string& name) const {
+    auto it = ids.find(name);
+    return it == ids.end() ? nullptr : &slots[it->second];
+}
+
+CatalogFacets& CatalogFacets::of(const Database& db) {
+    static std::mutex registry_lock;
+    static std::unordered_map<const Database*, std::unique_ptr<CatalogFacets>> registry;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    auto& index = registry[&db];
+    if (!index) index.reset(new CatalogFacets());
+    return *index;
+}
+
+size_t CatalogFacets::statusBucket(int available, int total) {
+    std::string status = Book::statusFor(available, total);
+    for (size_t bucket = 0; bucket < 3; ++bucket) {
+        if (status == statusNames[bucket]) return bucket;
+    }
+    return 0;
+}
+
+// Adds a book, or moves an indexed one to its current facet values
+void CatalogFacets::place(Model& model, const Book& book) {
+    auto [it, inserted] = model.slot_of.emplace(book.getId(), uint32_t(model.slots.size()));
+    uint32_t slot = it->second;
+    if (inserted) {
+        model.slots.emplace_back();
+    } else {
+        unplace(model, slot);
+    }
+
+    Slot& entry = model.slots[slot];
+    entry.book_id = book.getId();
+    entry.available = book.getAvailableCopies();
+    entry.total = book.getTotalCopies();
+    entry.category = model.categories.intern(book.getCategory());
+    entry.author = model.authors.intern(book.getAuthor());
+    entry.year = book.getPublicationYear();
+    index(model, slot);
+}
+
+// Adds a filled-in slot to every bitmap
+void CatalogFacets::index(Model& model, uint32_t slot) {
+    const Slot& entry = model.slots[slot];
+    model.live.add(slot);
+    model.categories.slots[entry.category].add(slot);
+    model.authors.slots[entry.author].add(slot);
+    model.statuses[statusBucket(entry.available, entry.total)].add(slot);
+    model.years[entry.year].add(slot);
+}
+
+// Clears a slot from every bitmap; the slot itself is not reused
+void CatalogFacets::unplace(Model& model, uint32_t slot) {
+    const Slot& entry = model.slots[slot];
+    model.live.remove(slot);
+    model.categories.slots[entry.category].remove(slot);
+    model.authors.slots[entry.author].remove(slot);
+    model.statuses[statusBucket(entry.available, entry.total)].remove(slot);
+    auto year = model.years.find(entry.year);
+    if (year != model.years.end()) {
+        year->second.remove(slot);
+        if (year->second.empty()) model.years.erase(year);
+    }
+}
+
+bool CatalogFacets::rebuild(Database& db) {
+    {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (rebuilding) return false;
+        rebuilding = true;
+        pending.clear();
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    Model fresh;
+    bool ok = db.forEachRow<Book>(
+        "SELECT " + row_schema::columnList<Book>() + " FROM books ORDER BY title, id",
+        [&fresh](const Book& book) { place(fresh, book); });
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    // Writes that landed while streaming may be missing from the snapshot;
+    // re-read those books until none are left
+    while (ok && !pending.empty()) {
+        std::vector<int> touched(pending.begin(), pending.end());
+        pending.clear();
+        guard.unlock();
+        for (int book_id : touched) {
+            std::optional<Book> book;
+            if (!Book(&db).getById(book_id, book)) {
+                ok = false;
+                break;
+            }
+            if (book) {
+                place(fresh, *book);
+            } else if (fresh.slot_of.count(book_id)) {
+                unplace(fresh, fresh.slot_of[book_id]);
+                fresh.slot_of.erase(book_id);
+            }
+        }
+        guard.lock();
+    }
+
+    if (ok) {
+        model = std::move(fresh);
+        rebuilds++;
+        last_rebuild_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started).count();
+        Logger::info("facets", "Catalog facet index rebuilt")
+            .field("books", model.slot_of.size())
+            .field("latency_ms", last_rebuild_ms.load());
+    } else {
+        Logger::error("facets", "Catalog facet index rebuild failed");
+    }
+    rebuilding = false;
+    pending.clear();
+    return ok;
+}
+
+void CatalogFacets::save(SnapshotWriter& snapshot) const {
+    std::vector<SlotRecord> records;
+    std::vector<std::string_view> categories, authors;
+    {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        records.reserve(model.slot_of.size());
+        // Live slots only, still in title order
+        model.live.forEach([this, &records](uint32_t slot) {
+            const Slot& entry = model.slots[slot];
+            records.push_back({entry.book_id, entry.available, entry.total, entry.year, entry.category, entry.author});
+            return true;
+        });
+        snapshot.addArray("catalog.slots", records);
+        categories.assign(model.categories.names.begin(), model.categories.names.end());
+        authors.assign(model.authors.names.begin(), model.authors.names.end());
+        snapshot.addStrings("catalog.categories", categories);
+        snapshot.addStrings("catalog.authors", authors);
+    }
+}
+
+bool CatalogFacets::restore(const SnapshotReader& snapshot) {
+    auto [records, count] = snapshot.array<SlotRecord>("catalog.slots");
+    std::vector<std::string_view> categories = snapshot.strings("catalog.categories");
+    std::vector<std::string_view> authors = snapshot.strings("catalog.authors");
+
+    Model fresh;
+    for (auto name : categories) fresh.categories.intern(std::string(name));
+    for (auto name : authors) fresh.authors.intern(std::string(name));
+    fresh.slots.reserve(count);
+    fresh.slot_of.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const SlotRecord& record = records[i];
+        if (record.category >= fresh.categories.names.size() || record.author >= fresh.authors.names.size()
+            || !fresh.slot_of.emplace(record.book_id, uint32_t(i)).second) {
+            Logger::warn("facets", "Catalog snapshot is inconsistent").field("book_id", record.book_id);
+            return false;
+        }
+        fresh.slots.push_back({record.book_id, record.available, record.total, record.category, record.author,
+                               record.year});
+        index(fresh, uint32_t(i));
+    }
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    model = std::move(fresh);
+    Logger::info("facets", "Catalog facet index restored").field("books", model.slot_of.size());
+    return true;
+}
+
+std::vector<int> CatalogFacets::bookIds() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    std::vector<int> ids;
+    ids.reserve(model.slot_of.size());
+    for (const auto& [book_id, slot] : model.slot_of) ids.push_back(book_id);
+    return ids;
+}
+
+void CatalogFacets::startRebuildJob(Database& db, std::chrono::minutes interval) {
+    std::thread([this, &db, interval] {
+        for (;;) {
+            std::this_thread::sleep_for(interval);
+            rebuild(db);
+        }
+    }).detach();
+}
+
+void CatalogFacets::upsert(const Book& book) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (rebuilding) pending.insert(book.getId());
+    place(model, book);
+}
+
+void CatalogFacets::remove(int book_id) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (rebuilding) pending.insert(book_id);
+    auto it = model.slot_of.find(book_id);
+    if (it == model.slot_of.end()) return;
+    unplace(model, it->second);
+    model.slot_of.erase(it);
+}
+
+void CatalogFacets::adjustAvailable(int book_id, int delta) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (rebuilding) pending.insert(book_id);
+    auto it = model.slot_of.find(book_id);
+    if (it == model.slot_of.end()) return;
+
+    Slot& entry = model.slots[it->second];
+    size_t before = statusBucket(entry.available, entry.total);
+    entry.available += delta;
+    size_t after = statusBucket(entry.available, entry.total);
+    if (before != after) {
+        model.statuses[before].remove(it->second);
+        model.statuses[after].add(it->second);
+    }
+}
+
+// Slots matching the filter on one dimension; `filtered` is false when the
+// filter does not constrain that dimension
+RoaringBitmap CatalogFacets::matching(const Model& model, const Filter& filter, Dimension dimension, bool& filtered) {
+    RoaringBitmap slots;
+    filtered = false;
+    switch (dimension) {
+        case CategoryDim:
+            for (const auto& category : filter.categories) {
+                if (const RoaringBitmap* values = model.categories.find(category)) slots |= *values;
+                filtered = true;
+            }
+            break;
+        case StatusDim:
+            for (const auto& status : filter.statuses) {
+                for (size_t bucket = 0; bucket < 3; ++bucket) {
+                    if (status == statusNames[bucket]) slots |= model.statuses[bucket];
+                }
+                filtered = true;
+            }
+            break;
+        case YearDim:
+            if (filter.year_from > 0 || filter.year_to > 0) {
+                // Books without a publication year (0) never match a range
+                for (auto it = model.years.lower_bound(std::max(1, filter.year_from)); it != model.years.end(); ++it) {
+                    if (filter.year_to > 0 && it->first > filter.year_to) break;
+                    slots |= it->second;
+                }
+                filtered = true;
+            }
+            break;
+        case AuthorDim:
+            if (!filter.author.empty()) {
+                if (const RoaringBitmap* values = model.authors.find(filter.author)) slots = *values;
+                filtered = true;
+            }
+            break;
+        default:
+            break;
+    }
+    return slots;
+}
+
+// Each facet is counted against the books matching every other facet's
+// filter, so selecting a category still shows the other categories' counts
+json CatalogFacets::facetCounts(const Model& model, const RoaringBitmap* bases[DimensionCount]) {
+    json facets = json::object();
+
+    std::vector<std::pair<std::string, uint64_t>> categories;
+    for (uint32_t id = 0; id < model.categories.names.size(); ++id) {
+        uint64_t count = RoaringBitmap::andCardinality(*bases[CategoryDim], model.categories.slots[id]);
+        if (count > 0) categories.emplace_back(model.categories.names[id], count);
+    }
+    size_t category_count = categories.size();
+    facets["category"] = rankedCounts(std::move(categories), category_count);
+
+    facets["status"] = json::array();
+    for (size_t bucket = 0; bucket < 3; ++bucket) {
+        facets["status"].push_back({
+            {"value", statusNames[bucket]},
+            {"count", RoaringBitmap::andCardinality(*bases[StatusDim], model.statuses[bucket])}
+        });
+    }
+
+    std::map<int, uint64_t> decades;
+    for (const auto& [year, slots] : model.years) {
+        if (year <= 0) continue;
+        uint64_t count = RoaringBitmap::andCardinality(*bases[YearDim], slots);
+        if (count > 0) decades[year / 10 * 10] += count;
+    }
+    facets["decade"] = json::array();
+    for (const auto& [decade, count] : decades) {
+        facets["decade"].push_back({{"value", decade}, {"count", count}});
+    }
+
+    // Too many authors to count one bitmap each: tally the base set instead
+    std::vector<uint64_t> per_author(model.authors.names.size());
+    bases[AuthorDim]->forEach([&model, &per_author](uint32_t slot) {
+        per_author[model.slots[slot].author]++;
+        return true;
+    });
+    std::vector<std::pair<std::string, uint64_t>> authors;
+    for (uint32_t author = 0; author < per_author.size(); ++author) {
+        if (per_author[author] > 0) authors.emplace_back(model.authors.names[author], per_author[author]);
+    }
+    facets["author"] = rankedCounts(std::move(authors), topAuthors);
+
+    return facets;
+}
+
+CatalogFacets::Result CatalogFacets::query(const Filter& filter, size_t offset, size_t limit) const {
+    queries++;
+    Tracer::Span span("facets.query", "index");
+    std::shared_lock<std::shared_mutex> guard(lock);
+
+    bool filtered[DimensionCount];
+    RoaringBitmap selected[DimensionCount];
+    for (int dimension = 0; dimension < DimensionCount; ++dimension) {
+        selected[dimension] = matching(model, filter, Dimension(dimension), filtered[dimension]);
+    }
+
+    // The base of each facet leaves out its own filter
+    RoaringBitmap excluding[DimensionCount];
+    const RoaringBitmap* bases[DimensionCount];
+    RoaringBitmap all = model.live;
+    for (int dimension = 0; dimension < DimensionCount; ++dimension) {
+        if (filtered[dimension]) all &= selected[dimension];
+    }
+    for (int dimension = 0; dimension < DimensionCount; ++dimension) {
+        if (!filtered[dimension]) {
+            bases[dimension] = &all;
+            continue;
+        }
+        excluding[dimension] = model.live;
+        for (int other = 0; other < DimensionCount; ++other) {
+            if (other != dimension && filtered[other]) excluding[dimension] &= selected[other];
+        }
+        bases[dimension] = &excluding[dimension];
+    }
+
+    Result result;
+    result.total = all.cardinality();
+    result.facets = facetCounts(model, bases);
+
+    size_t skipped = 0;
+    all.forEach([this, &result, &skipped, offset, limit](uint32_t slot) {
+        if (skipped < offset) {
+            skipped++;
+            return true;
+        }
+        if (result.book_ids.size() >= limit) return false;
+        result.book_ids.push_back(model.slots[slot].book_id);
+        return true;
+    });
+
+    if (span) {
+        span.arg("matches", result.total);
+    }
+    return result;
+}
+
+json CatalogFacets::getStats() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    size_t bytes = model.live.memoryBytes();
+    for (const auto& bitmap : model.categories.slots) bytes += bitmap.memoryBytes();
+    for (const auto& bitmap : model.authors.slots) bytes += bitmap.memoryBytes();
+    for (const auto& bitmap : model.statuses) bytes += bitmap.memoryBytes();
+    for (const auto& [year, bitmap] : model.years) bytes += bitmap.memoryBytes();
+    return {
+        {"books", model.slot_of.size()},
+        {"categories", model.categories.names.size()},
+        {"authors", model.authors.names.size()},
+        {"years", model.years.size()},
+        {"bitmap_bytes", bytes},
+        {"queries", queries.load()},
+        {"rebuilds", rebuilds.load()},
+        {"last_rebuild_ms", last_rebuild_ms.load()},
+        {"rebuilding", rebuilding}
+    };
+}
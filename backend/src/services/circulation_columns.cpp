@@ -0,0 +1,638 @@
+#include "services/circulation_columns.h"
+#include "database/delta_sync.h"
+#include "logging/logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Indexed by CirculationColumns::Status; deleted loans never match
+const char* const statusNames[] = {"active", "returned", "overdue"};
+constexpr size_t statusCount = 3;
+
+constexpr const char* loanColumns =
+    "id, member_id, book_id, borrow_date, due_date, return_date, status, fine_amount";
+constexpr unsigned int loanColumnCount = 8;
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+int32_t daysFromCivil(int year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    unsigned year_of_era = unsigned(year - era * 400);
+    unsigned day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + int32_t(day_of_era) - 719468;
+}
+
+// Reads `count` digits; false on anything else
+bool digits(const char* text, size_t count, int& value) {
+    value = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (text[i] < '0' || text[i] > '9') return false;
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// "YYYY-MM-DD", optionally followed by a time
+bool parseDate(const char* text, size_t length, int32_t& day) {
+    int year, month, day_of_month;
+    if (!text || length < 10 || text[4] != '-' || text[7] != '-' || !digits(text, 4, year)
+        || !digits(text + 5, 2, month) || !digits(text + 8, 2, day_of_month)
+        || month < 1 || month > 12 || day_of_month < 1 || day_of_month > 31) {
+        return false;
+    }
+    day = daysFromCivil(year, unsigned(month), unsigned(day_of_month));
+    return true;
+}
+
+// Year * 12 + month - 1 of a day number
+uint16_t monthOfDay(int32_t day) {
+    day += 719468;
+    int era = (day >= 0 ? day : day - 146096) / 146097;
+    unsigned day_of_era = unsigned(day - era * 146097);
+    unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned shifted_month = (5 * day_of_year + 2) / 153;
+    unsigned month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+    int year = int(year_of_era) + era * 400 + (month <= 2);
+    return uint16_t(std::clamp(year * 12 + int(month) - 1, 0, int(UINT16_MAX)));
+}
+
+// DECIMAL(10, 2) text to cents
+int32_t parseCents(const char* text) {
+    if (!text) return 0;
+    bool negative = *text == '-';
+    if (negative) text++;
+    long long cents = 0;
+    for (; *text >= '0' && *text <= '9'; ++text) cents = cents * 10 + (*text - '0');
+    cents *= 100;
+    if (*text == '.') {
+        if (text[1] >= '0' && text[1] <= '9') cents += (text[1] - '0') * 10;
+        if (text[1] && text[2] >= '0' && text[2] <= '9') cents += text[2] - '0';
+    }
+    cents = std::min<long long>(cents, INT32_MAX);
+    return int32_t(negative ? -cents : cents);
+}
+
+int32_t localToday() {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+    localtime_r(&now, &local);
+    return daysFromCivil(local.tm_year + 1900, unsigned(local.tm_mon + 1), unsigned(local.tm_mday));
+}
+
+std::string monthLabel(uint32_t month) {
+    char label[16];
+    std::snprintf(label, sizeof(label), "%04u-%02u", month / 12, month % 12 + 1);
+    return label;
+}
+
+const char* const dimensionNames[] = {"status", "category", "year", "month", "cohort_year", "cohort_month"};
+
+} // namespace
+
+void CirculationColumns::Totals::add(const Totals& other) {
+    loans += other.loans;
+    fine_cents += other.fine_cents;
+    returned += other.returned;
+    loan_days += other.loan_days;
+    late += other.late;
+}
+
+void CirculationColumns::Columns::insert(size_t row, const Loan& loan) {
+    id.insert(id.begin() + row, loan.id);
+    member.insert(member.begin() + row, loan.member);
+    book.insert(book.begin() + row, loan.book);
+    borrow_day.insert(borrow_day.begin() + row, loan.borrow_day);
+    due_day.insert(due_day.begin() + row, loan.due_day);
+    return_day.insert(return_day.begin() + row, loan.return_day);
+    fine_cents.insert(fine_cents.begin() + row, loan.fine_cents);
+    borrow_month.insert(borrow_month.begin() + row, monthOfDay(loan.borrow_day));
+    cohort.insert(cohort.begin() + row, uint16_t(0));
+    category.insert(category.begin() + row, uint16_t(0));
+    status.insert(status.begin() + row, loan.status);
+}
+
+void CirculationColumns::Columns::set(size_t row, const Loan& loan) {
+    member[row] = loan.member;
+    book[row] = loan.book;
+    borrow_day[row] = loan.borrow_day;
+    due_day[row] = loan.due_day;
+    return_day[row] = loan.return_day;
+    fine_cents[row] = loan.fine_cents;
+    borrow_month[row] = monthOfDay(loan.borrow_day);
+    status[row] = loan.status;
+}
+
+void CirculationColumns::Columns::shrink() {
+    for (auto* column : {&id, &member, &book, &borrow_day, &due_day, &return_day, &fine_cents}) column->shrink_to_fit();
+    for (auto* column : {&borrow_month, &cohort, &category}) column->shrink_to_fit();
+    status.shrink_to_fit();
+}
+
+size_t CirculationColumns::Columns::memoryBytes() const {
+    return (id.capacity() + member.capacity() + book.capacity() + borrow_day.capacity() + due_day.capacity()
+            + return_day.capacity() + fine_cents.capacity()) * sizeof(int32_t)
+        + (borrow_month.capacity() + cohort.capacity() + category.capacity()) * sizeof(uint16_t)
+        + status.capacity();
+}
+
+CirculationColumns& CirculationColumns::of(const Database& db) {
+    static std::mutex registry_lock;
+    static std::unordered_map<const Database*, std::unique_ptr<CirculationColumns>> registry;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    auto& store = registry[&db];
+    if (!store) store.reset(new CirculationColumns());
+    return *store;
+}
+
+std::optional<CirculationColumns::Dimension> CirculationColumns::parseDimension(const std::string& name) {
+    for (size_t i = 0; i < std::size(dimensionNames); ++i) {
+        if (name == dimensionNames[i]) return Dimension(i);
+    }
+    return std::nullopt;
+}
+
+const char* CirculationColumns::dimensionName(Dimension dimension) {
+    return dimensionNames[size_t(dimension)];
+}
+
+std::optional<int32_t> CirculationColumns::dayNumber(const std::string& date) {
+    int32_t day;
+    if (date.size() != 10 || !parseDate(date.c_str(), date.size(), day)) return std::nullopt;
+    return day;
+}
+
+std::optional<int32_t> CirculationColumns::monthNumber(const std::string& month) {
+    int year, number;
+    if (month.size() != 7 || month[4] != '-' || !digits(month.c_str(), 4, year)
+        || !digits(month.c_str() + 5, 2, number) || number < 1 || number > 12) {
+        return std::nullopt;
+    }
+    return year * 12 + number - 1;
+}
+
+bool CirculationColumns::ready() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return model.built;
+}
+
+bool CirculationColumns::parseLoan(char** row, unsigned long* lengths, Loan& loan) {
+    loan = Loan{};
+    loan.id = std::atoi(row[0]);
+    loan.member = std::atoi(row[1]);
+    loan.book = std::atoi(row[2]);
+    if (!parseDate(row[3], lengths[3], loan.borrow_day) || !parseDate(row[4], lengths[4], loan.due_day)) {
+        return false;
+    }
+    if (row[5] && !parseDate(row[5], lengths[5], loan.return_day)) loan.return_day = openDay;
+    loan.status = Active;
+    for (size_t code = 0; row[6] && code < statusCount; ++code) {
+        if (std::strcmp(row[6], statusNames[code]) == 0) loan.status = uint8_t(code);
+    }
+    loan.fine_cents = parseCents(row[7]);
+    return true;
+}
+
+// Past 65535 distinct categories the rest share the last code
+uint16_t CirculationColumns::categoryCode(Model& model, const std::string& name) {
+    auto it = model.category_codes.find(name);
+    if (it != model.category_codes.end()) return it->second;
+    if (model.category_names.size() > UINT16_MAX) return UINT16_MAX;
+    uint16_t code = uint16_t(model.category_names.size());
+    model.category_names.push_back(name);
+    model.category_codes.emplace(name, code);
+    return code;
+}
+
+void CirculationColumns::setBookCategory(Model& model, int book_id, uint16_t code) {
+    if (book_id < 0) return;
+    if (size_t(book_id) >= model.book_category.size()) model.book_category.resize(size_t(book_id) + 1, 0);
+    model.book_category[book_id] = code;
+}
+
+void CirculationColumns::setMemberCohort(Model& model, int member_id, uint16_t month) {
+    if (member_id < 0) return;
+    if (size_t(member_id) >= model.member_cohort.size()) model.member_cohort.resize(size_t(member_id) + 1, 0);
+    model.member_cohort[member_id] = month;
+}
+
+// Fills a row's category and cohort from its book and member. A member not
+// read yet (joined after the scan started) counts in the loan's own month
+// until the next refresh brings them in.
+void CirculationColumns::derive(Model& model, size_t row) {
+    Columns& loans = model.loans;
+    int32_t book = loans.book[row];
+    int32_t member = loans.member[row];
+    loans.category[row] = book >= 0 && size_t(book) < model.book_category.size() ? model.book_category[book] : 0;
+    uint16_t cohort = member >= 0 && size_t(member) < model.member_cohort.size() ? model.member_cohort[member] : 0;
+    loans.cohort[row] = cohort ? cohort : loans.borrow_month[row];
+
+    model.borrow_min = std::min(model.borrow_min, loans.borrow_month[row]);
+    model.borrow_max = std::max(model.borrow_max, loans.borrow_month[row]);
+    model.cohort_min = std::min(model.cohort_min, loans.cohort[row]);
+    model.cohort_max = std::max(model.cohort_max, loans.cohort[row]);
+}
+
+// Loans arrive mostly in id order, so new ones are usually appended
+void CirculationColumns::upsert(Model& model, const Loan& loan) {
+    Columns& loans = model.loans;
+    auto it = std::lower_bound(loans.id.begin(), loans.id.end(), loan.id);
+    size_t row = size_t(it - loans.id.begin());
+    if (it != loans.id.end() && *it == loan.id) {
+        if (loans.status[row] == Deleted) model.deleted--;
+        loans.set(row, loan);
+    } else {
+        loans.insert(row, loan);
+    }
+    derive(model, row);
+}
+
+bool CirculationColumns::rebuild(Database& db) {
+    auto started = std::chrono::steady_clock::now();
+
+    // Changes from here on are picked up by the next refresh
+    delta_sync::Window window = delta_sync::open(db, "NOW()");
+    if (!window.ok) {
+        Logger::error("analytics", "Circulation store rebuild failed");
+        return false;
+    }
+
+    Model fresh;
+    fresh.since = window.next_since;
+
+    // Loans first: every member and book they reference exists by the time
+    // those tables are read, unless it was deleted along with its loans
+    Loan loan;
+    bool ok = db.streamUnbuffered(std::string("SELECT ") + loanColumns + " FROM borrow_records ORDER BY id",
+        loanColumnCount, [&fresh, &loan](char** row, unsigned long* lengths) {
+            if (!parseLoan(row, lengths, loan)) return;
+            Columns& loans = fresh.loans;
+            loans.id.push_back(loan.id);
+            loans.member.push_back(loan.member);
+            loans.book.push_back(loan.book);
+            loans.borrow_day.push_back(loan.borrow_day);
+            loans.due_day.push_back(loan.due_day);
+            loans.return_day.push_back(loan.return_day);
+            loans.fine_cents.push_back(loan.fine_cents);
+            loans.borrow_month.push_back(monthOfDay(loan.borrow_day));
+            loans.status.push_back(loan.status);
+        });
+
+    ok = ok && db.streamUnbuffered("SELECT id, category FROM books", 2, [&fresh](char** row, unsigned long*) {
+        setBookCategory(fresh, std::atoi(row[0]), categoryCode(fresh, row[1] ? row[1] : ""));
+    });
+
+    ok = ok && db.streamUnbuffered("SELECT id, join_date FROM members", 2, [&fresh](char** row, unsigned long* lengths) {
+        int32_t joined;
+        if (parseDate(row[1], lengths[1], joined)) setMemberCohort(fresh, std::atoi(row[0]), monthOfDay(joined));
+    });
+
+    if (!ok) {
+        Logger::error("analytics", "Circulation store rebuild failed");
+        return false;
+    }
+
+    fresh.loans.cohort.resize(fresh.loans.size());
+    fresh.loans.category.resize(fresh.loans.size());
+    for (size_t row = 0; row < fresh.loans.size(); ++row) derive(fresh, row);
+    fresh.loans.shrink();
+    fresh.built = true;
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    model = std::move(fresh);
+    rebuilds++;
+    last_rebuild_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    Logger::info("analytics", "Circulation store rebuilt")
+        .field("loans", model.loans.size())
+        .field("bytes", model.loans.memoryBytes())
+        .field("latency_ms", last_rebuild_ms.load());
+    return true;
+}
+
+bool CirculationColumns::refresh(Database& db) {
+    std::string since;
+    {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        if (!model.built) return false;
+        since = "FROM_UNIXTIME(" + model.since + ")";
+    }
+
+    delta_sync::Window window = delta_sync::open(db, since);
+    if (!window.ok) return false;
+    if (window.expired) return rebuild(db);
+
+    // Read everything before taking the lock, so queries are not held up
+    std::vector<Loan> changed;
+    Loan loan;
+    bool ok = db.streamUnbuffered(std::string("SELECT ") + loanColumns + " FROM borrow_records WHERE updated_at >= " + since,
+        loanColumnCount, [&changed, &loan](char** row, unsigned long* lengths) {
+            if (parseLoan(row, lengths, loan)) changed.push_back(loan);
+        });
+
+    std::vector<std::pair<int, std::string>> books;
+    ok = ok && db.streamUnbuffered("SELECT id, category FROM books WHERE updated_at >= " + since, 2,
+        [&books](char** row, unsigned long*) { books.emplace_back(std::atoi(row[0]), row[1] ? row[1] : ""); });
+
+    std::vector<std::pair<int, uint16_t>> members;
+    ok = ok && db.streamUnbuffered("SELECT id, join_date FROM members WHERE updated_at >= " + since, 2,
+        [&members](char** row, unsigned long* lengths) {
+            int32_t joined;
+            if (parseDate(row[1], lengths[1], joined)) members.emplace_back(std::atoi(row[0]), monthOfDay(joined));
+        });
+
+    auto deleted = delta_sync::deletedIds(db, "borrow_records", since);
+    if (!ok || !deleted) {
+        Logger::warn("analytics", "Circulation store refresh failed");
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    // A category or join date change moves every loan of that book or member
+    std::vector<uint8_t> moved_books, moved_members;
+    for (const auto& [book_id, category] : books) {
+        uint16_t code = categoryCode(model, category);
+        if (book_id < 0 || (size_t(book_id) < model.book_category.size() && model.book_category[book_id] == code)) {
+            continue;
+        }
+        setBookCategory(model, book_id, code);
+        if (size_t(book_id) >= moved_books.size()) moved_books.resize(size_t(book_id) + 1, 0);
+        moved_books[book_id] = 1;
+    }
+    for (const auto& [member_id, cohort] : members) {
+        if (member_id < 0 || (size_t(member_id) < model.member_cohort.size() && model.member_cohort[member_id] == cohort)) {
+            continue;
+        }
+        setMemberCohort(model, member_id, cohort);
+        if (size_t(member_id) >= moved_members.size()) moved_members.resize(size_t(member_id) + 1, 0);
+        moved_members[member_id] = 1;
+    }
+    if (!moved_books.empty() || !moved_members.empty()) {
+        const Columns& loans = model.loans;
+        for (size_t row = 0; row < loans.size(); ++row) {
+            size_t book = size_t(loans.book[row]), member = size_t(loans.member[row]);
+            if ((book < moved_books.size() && moved_books[book])
+                || (member < moved_members.size() && moved_members[member])) {
+                derive(model, row);
+            }
+        }
+    }
+
+    for (const Loan& update : changed) upsert(model, update);
+
+    for (int loan_id : *deleted) {
+        auto it = std::lower_bound(model.loans.id.begin(), model.loans.id.end(), loan_id);
+        size_t row = size_t(it - model.loans.id.begin());
+        if (it == model.loans.id.end() || *it != loan_id || model.loans.status[row] == Deleted) continue;
+        model.loans.status[row] = Deleted;
+        model.deleted++;
+    }
+
+    model.since = window.next_since;
+    refreshes++;
+    return true;
+}
+
+void CirculationColumns::startRefreshJob(Database& db, std::chrono::seconds interval) {
+    std::thread([this, &db, interval] {
+        auto rebuilt = std::chrono::steady_clock::now();
+        if (!rebuild(db)) rebuilt -= std::chrono::hours(24);
+        for (;;) {
+            std::this_thread::sleep_for(interval);
+            if (std::chrono::steady_clock::now() - rebuilt >= std::chrono::hours(24)) {
+                if (rebuild(db)) rebuilt = std::chrono::steady_clock::now();
+            } else {
+                refresh(db);
+            }
+        }
+    }).detach();
+}
+
+bool CirculationColumns::plan(const Model& model, const Query& query, Plan& out, std::string& error) {
+    out = Plan{};
+    if (query.group_by.size() > 3) {
+        error = "group_by takes at most 3 dimensions";
+        return false;
+    }
+    for (const std::string& status : query.statuses) {
+        size_t code = 0;
+        while (code < statusCount && status != statusNames[code]) code++;
+        if (code == statusCount) {
+            error = "Unknown status " + status;
+            return false;
+        }
+        out.status_mask |= 1u << code;
+    }
+    if (query.statuses.empty()) out.status_mask = (1u << statusCount) - 1;
+
+    // Categories this branch has never seen match nothing here
+    if (!query.categories.empty()) {
+        out.category_ok.assign(size_t(UINT16_MAX) + 1, 0);
+        for (const std::string& category : query.categories) {
+            auto it = model.category_codes.find(category);
+            if (it != model.category_codes.end()) out.category_ok[it->second] = 1;
+        }
+    }
+
+    uint64_t groups = 1;
+    for (Dimension dimension : query.group_by) {
+        Plan::Key key{dimension, 0, 1};
+        bool borrow = dimension == Dimension::Year || dimension == Dimension::Month;
+        uint32_t low = borrow ? model.borrow_min : model.cohort_min;
+        uint32_t high = borrow ? model.borrow_max : model.cohort_max;
+        switch (dimension) {
+            case Dimension::Status:
+                key.cardinality = statusCount + 1;
+                break;
+            case Dimension::Category:
+                key.cardinality = uint32_t(std::max<size_t>(model.category_names.size(), 1));
+                break;
+            case Dimension::Year:
+            case Dimension::CohortYear:
+                if (low <= high) key = {dimension, low / 12, high / 12 - low / 12 + 1};
+                break;
+            case Dimension::Month:
+            case Dimension::CohortMonth:
+                if (low <= high) key = {dimension, low, high - low + 1};
+                break;
+        }
+        for (const Plan::Key& other : out.keys) {
+            if (other.dimension == dimension) {
+                error = std::string("Duplicate group_by dimension ") + dimensionName(dimension);
+                return false;
+            }
+        }
+        groups *= key.cardinality;
+        if (groups > maxGroups) {
+            error = "group_by yields more than " + std::to_string(maxGroups) + " groups; narrow it";
+            return false;
+        }
+        out.keys.push_back(key);
+    }
+    out.groups = uint32_t(groups);
+    out.from_day = query.from_day;
+    out.to_day = query.to_day;
+    out.cohort_from = query.cohort_from;
+    out.cohort_to = query.cohort_to;
+    out.today = localToday();
+    return true;
+}
+
+// The three passes over one block at a time. Each inner loop has no
+// branches on row data, so the compiler turns it into vector code.
+void CirculationColumns::scan(const Columns& loans, const Plan& plan, size_t begin, size_t end,
+                              std::vector<Totals>& groups) {
+    uint32_t keep[blockRows];
+    uint32_t group[blockRows];
+    const uint32_t sink = plan.groups;
+
+    for (size_t start = begin; start < end; start += blockRows) {
+        const size_t n = std::min(blockRows, end - start);
+        const int32_t* borrow_day = loans.borrow_day.data() + start;
+        const int32_t* due_day = loans.due_day.data() + start;
+        const int32_t* return_day = loans.return_day.data() + start;
+        const int32_t* fine_cents = loans.fine_cents.data() + start;
+        const uint16_t* borrow_month = loans.borrow_month.data() + start;
+        const uint16_t* cohort = loans.cohort.data() + start;
+        const uint16_t* category = loans.category.data() + start;
+        const uint8_t* status = loans.status.data() + start;
+
+        // Filter
+        for (size_t i = 0; i < n; ++i) {
+            keep[i] = uint32_t(borrow_day[i] >= plan.from_day) & uint32_t(borrow_day[i] <= plan.to_day)
+                & uint32_t(int32_t(cohort[i]) >= plan.cohort_from) & uint32_t(int32_t(cohort[i]) <= plan.cohort_to)
+                & (plan.status_mask >> status[i]) & 1u;
+        }
+        if (!plan.category_ok.empty()) {
+            const uint8_t* category_ok = plan.category_ok.data();
+            for (size_t i = 0; i < n; ++i) keep[i] &= category_ok[category[i]];
+        }
+
+        // Group key, mixed radix over the grouped columns
+        std::fill(group, group + n, 0u);
+        for (const Plan::Key& key : plan.keys) {
+            const uint32_t radix = key.cardinality, base = key.base;
+            switch (key.dimension) {
+                case Dimension::Status:
+                    for (size_t i = 0; i < n; ++i) group[i] = group[i] * radix + status[i];
+                    break;
+                case Dimension::Category:
+                    for (size_t i = 0; i < n; ++i) group[i] = group[i] * radix + category[i];
+                    break;
+                case Dimension::Year:
+                    for (size_t i = 0; i < n; ++i) group[i] = group[i] * radix + (borrow_month[i] / 12u - base);
+                    break;
+                case Dimension::Month:
+                    for (size_t i = 0; i < n; ++i) group[i] = group[i] * radix + (borrow_month[i] - base);
+                    break;
+                case Dimension::CohortYear:
+                    for (size_t i = 0; i < n; ++i) group[i] = group[i] * radix + (cohort[i] / 12u - base);
+                    break;
+                case Dimension::CohortMonth:
+                    for (size_t i = 0; i < n; ++i) group[i] = group[i] * radix + (cohort[i] - base);
+                    break;
+            }
+        }
+        // Status radix covers Deleted, so a deleted row's key stays in range;
+        // it is filtered anyway
+        for (size_t i = 0; i < n; ++i) group[i] = keep[i] ? group[i] : sink;
+
+        // Aggregate
+        const int32_t today = plan.today;
+        for (size_t i = 0; i < n; ++i) {
+            Totals& totals = groups[group[i]];
+            const bool returned = return_day[i] != openDay;
+            totals.loans++;
+            totals.fine_cents += fine_cents[i];
+            totals.returned += returned;
+            totals.loan_days += returned ? (long long)return_day[i] - borrow_day[i] : 0;
+            totals.late += std::min(return_day[i], today) > due_day[i];
+        }
+    }
+}
+
+std::vector<std::string> CirculationColumns::labels(const Model& model, const Plan& plan, uint32_t group) {
+    std::vector<std::string> labels(plan.keys.size());
+    for (size_t k = plan.keys.size(); k-- > 0;) {
+        const Plan::Key& key = plan.keys[k];
+        uint32_t value = group % key.cardinality + key.base;
+        group /= key.cardinality;
+        switch (key.dimension) {
+            case Dimension::Status:
+                labels[k] = value < statusCount ? statusNames[value] : "deleted";
+                break;
+            case Dimension::Category:
+                labels[k] = value < model.category_names.size() ? model.category_names[value] : "";
+                break;
+            case Dimension::Year:
+            case Dimension::CohortYear:
+                labels[k] = std::to_string(value);
+                break;
+            case Dimension::Month:
+            case Dimension::CohortMonth:
+                labels[k] = monthLabel(value);
+                break;
+        }
+    }
+    return labels;
+}
+
+CirculationColumns::Result CirculationColumns::run(const Query& query) const {
+    auto started = std::chrono::steady_clock::now();
+    Result result;
+    queries++;
+
+    std::shared_lock<std::shared_mutex> guard(lock);
+    Plan query_plan;
+    if (!plan(model, query, query_plan, result.error)) return result;
+
+    // Each thread adds into its own groups, merged afterwards
+    const size_t rows = model.loans.size();
+    size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), rows / rowsPerThread + 1);
+    size_t slots = size_t(query_plan.groups) + 1;
+    std::vector<std::vector<Totals>> partials(threads, std::vector<Totals>(slots));
+    std::vector<std::thread> workers;
+    size_t chunk = (rows + threads - 1) / threads;
+    for (size_t t = 1; t < threads; ++t) {
+        size_t begin = std::min(rows, t * chunk), end = std::min(rows, begin + chunk);
+        workers.emplace_back([&, begin, end, t] { scan(model.loans, query_plan, begin, end, partials[t]); });
+    }
+    scan(model.loans, query_plan, 0, std::min(rows, chunk), partials[0]);
+    for (auto& worker : workers) worker.join();
+
+    for (size_t group = 0; group < query_plan.groups; ++group) {
+        Totals totals;
+        for (const auto& partial : partials) totals.add(partial[group]);
+        if (totals.loans > 0) result.groups[labels(model, query_plan, uint32_t(group))].add(totals);
+    }
+    result.rows = rows;
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    last_query_us = (long long)(result.elapsed_ms * 1000);
+    return result;
+}
+
+json CirculationColumns::getStats() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return {
+        {"ready", model.built},
+        {"loans", model.loans.size() - model.deleted},
+        {"deleted", model.deleted},
+        {"categories", model.category_names.size()},
+        {"bytes", model.loans.memoryBytes()},
+        {"queries", queries.load()},
+        {"last_query_us", last_query_us.load()},
+        {"rebuilds", rebuilds.load()},
+        {"refreshes", refreshes.load()},
+        {"last_rebuild_ms", last_rebuild_ms.load()}
+    };
+}
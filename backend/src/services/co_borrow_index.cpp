@@ -0,0 +1,184 @@
+#include "services/co_borrow_index.h"
+#include "logging/logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+// Counts one more co-borrow of `other`. A full list works like SpaceSaving:
+// the newcomer replaces the weakest neighbour and inherits its count, so a
+// new relationship can still rise, and no count is ever below the true one.
+void countPair(std::unordered_map<int, int>& candidates, int other) {
+    auto it = candidates.find(other);
+    if (it != candidates.end()) {
+        it->second++;
+        return;
+    }
+    if (candidates.size() < CoBorrowIndex::maxCandidates) {
+        candidates.emplace(other, 1);
+        return;
+    }
+    auto weakest = std::min_element(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second < b.second : a.first < b.first;
+    });
+    int count = weakest->second;
+    candidates.erase(weakest);
+    candidates.emplace(other, count + 1);
+}
+
+} // namespace
+
+CoBorrowIndex& CoBorrowIndex::of(const Database& db) {
+    static std::mutex registry_lock;
+    static std::unordered_map<const Database*, std::unique_ptr<CoBorrowIndex>> registry;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    auto& index = registry[&db];
+    if (!index) index.reset(new CoBorrowIndex());
+    return *index;
+}
+
+void CoBorrowIndex::addLoan(Model& model, int member_id, int book_id, std::vector<int>& touched) {
+    model.loans_by_book[book_id]++;
+    touched.push_back(book_id);
+
+    auto& recent = model.recent_by_member[member_id];
+    auto previous = std::find(recent.begin(), recent.end(), book_id);
+    if (previous != recent.end()) {
+        // Borrowing the same book again does not add pairs
+        recent.erase(previous);
+    } else {
+        for (int other : recent) {
+            countPair(model.pairs[book_id], other);
+            countPair(model.pairs[other], book_id);
+            touched.push_back(other);
+        }
+    }
+
+    recent.push_back(book_id);
+    if (recent.size() > windowSize) {
+        recent.erase(recent.begin());
+    }
+}
+
+void CoBorrowIndex::refreshTop(Model& model, int book_id) {
+    auto candidates = model.pairs.find(book_id);
+    if (candidates == model.pairs.end()) return;
+
+    // Co-borrows normalised by both books' popularity, so bestsellers do not
+    // show up as related to everything
+    double own_loans = model.loans_by_book[book_id];
+    std::vector<Related> ranked;
+    ranked.reserve(candidates->second.size());
+    for (const auto& [other, count] : candidates->second) {
+        double other_loans = model.loans_by_book[other];
+        ranked.push_back({other, count, count / std::sqrt(std::max(1.0, own_loans * other_loans))});
+    }
+
+    size_t size = std::min(topK, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + size, ranked.end(), [](const Related& a, const Related& b) {
+        return a.score != b.score ? a.score > b.score : a.book_id < b.book_id;
+    });
+    ranked.resize(size);
+    model.top[book_id] = std::make_shared<const std::vector<Related>>(std::move(ranked));
+}
+
+void CoBorrowIndex::recordCheckout(int member_id, int book_id) {
+    std::vector<int> touched;
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (rebuilding) {
+        pending.emplace_back(member_id, book_id);
+    }
+    addLoan(model, member_id, book_id, touched);
+    for (int touched_book : touched) {
+        refreshTop(model, touched_book);
+    }
+}
+
+std::vector<CoBorrowIndex::Related> CoBorrowIndex::related(int book_id, size_t limit) const {
+    lookups++;
+    std::shared_ptr<const std::vector<Related>> top;
+    {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        auto it = model.top.find(book_id);
+        if (it == model.top.end()) return {};
+        top = it->second;
+    }
+    return std::vector<Related>(top->begin(), top->begin() + std::min(limit, top->size()));
+}
+
+bool CoBorrowIndex::rebuild(Database& db) {
+    {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (rebuilding) return false;
+        rebuilding = true;
+        pending.clear();
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    Model fresh;
+    std::vector<int> touched;
+
+    // Walks each member's loans in order, using idx_member_borrow_date
+    bool ok = db.streamUnbuffered(
+        "SELECT member_id, book_id FROM borrow_records ORDER BY member_id, borrow_date, id", 2,
+        [&fresh, &touched](char** row, unsigned long*) {
+            touched.clear();
+            addLoan(fresh, std::atoi(row[0]), std::atoi(row[1]), touched);
+        });
+
+    if (ok) {
+        for (const auto& [book_id, candidates] : fresh.pairs) {
+            refreshTop(fresh, book_id);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (ok) {
+        for (const auto& [member_id, book_id] : pending) {
+            touched.clear();
+            addLoan(fresh, member_id, book_id, touched);
+            for (int touched_book : touched) refreshTop(fresh, touched_book);
+        }
+        model = std::move(fresh);
+        rebuilds++;
+        last_rebuild_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started).count();
+        Logger::info("co_borrow", "Also-borrowed index rebuilt")
+            .field("books", model.top.size())
+            .field("latency_ms", last_rebuild_ms.load());
+    } else {
+        Logger::error("co_borrow", "Also-borrowed index rebuild failed");
+    }
+    rebuilding = false;
+    pending.clear();
+    return ok;
+}
+
+void CoBorrowIndex::startRebuildJob(Database& db, std::chrono::minutes interval) {
+    std::thread([this, &db, interval] {
+        for (;;) {
+            rebuild(db);
+            std::this_thread::sleep_for(interval);
+        }
+    }).detach();
+}
+
+json CoBorrowIndex::getStats() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    size_t pair_count = 0;
+    for (const auto& [book_id, candidates] : model.pairs) {
+        pair_count += candidates.size();
+    }
+    return {
+        {"books", model.top.size()},
+        {"pairs", pair_count},
+        {"members", model.recent_by_member.size()},
+        {"lookups", lookups.load()},
+        {"rebuilds", rebuilds.load()},
+        {"last_rebuild_ms", last_rebuild_ms.load()},
+        {"rebuilding", rebuilding}
+    };
+}
@@ -0,0 +1,234 @@
+#include "services/loan_counters.h"
+#include "logging/logger.h"
+#include <algorithm>
+#include <sstream>
+
+LoanCounters& LoanCounters::of(const Database& db) {
+    static std::mutex registry_lock;
+    static std::unordered_map<const Database*, std::unique_ptr<LoanCounters>> registry;
+    
+    std::lock_guard<std::mutex> guard(registry_lock);
+    auto& counters = registry[&db];
+    if (!counters) counters.reset(new LoanCounters());
+    return *counters;
+}
+
+bool LoanCounters::rebuild(Database& db) {
+    json member_rows = db.executeQuery("SELECT id, status FROM members");
+    json loan_rows = db.executeQuery(
+        "SELECT member_id, COUNT(*) AS active FROM borrow_records "
+        "WHERE status <> 'returned' GROUP BY member_id");
+    
+    if (!member_rows.is_array() || !loan_rows.is_array()) {
+        Logger::error("loan_counters", "Failed to rebuild loan counters");
+        return false;
+    }
+    
+    std::unordered_map<int, std::shared_ptr<MemberState>> fresh;
+    for (const auto& row : member_rows) {
+        auto state = std::make_shared<MemberState>();
+        state->can_borrow = row["status"] == "active";
+        fresh[row["id"].get<int>()] = std::move(state);
+    }
+    for (const auto& row : loan_rows) {
+        auto it = fresh.find(row["member_id"].get<int>());
+        if (it != fresh.end()) {
+            it->second->active = row["active"].get<int>();
+        }
+    }
+    
+    std::unique_lock<std::shared_mutex> guard(lock);
+    // Checkouts still in flight were counted in the old state only
+    for (const auto& [member_id, state] : members) {
+        auto it = fresh.find(member_id);
+        int pending = state->pending.load();
+        if (it == fresh.end() || pending == 0) continue;
+        it->second->pending = pending;
+        it->second->active += pending;
+    }
+    members.swap(fresh);
+    Logger::info("loan_counters", "Loan counters rebuilt").field("members", members.size());
+    return true;
+}
+
+bool LoanCounters::readMember(Database& db, int member_id, bool& can_borrow, int& active) {
+    std::stringstream ss;
+    ss << "SELECT m.status, "
+       << "(SELECT COUNT(*) FROM borrow_records br WHERE br.member_id = m.id AND br.status <> 'returned') AS active "
+       << "FROM members m WHERE m.id = " << member_id;
+    
+    json result = db.executeQuery(ss.str());
+    if (!result.is_array() || result.empty()) return false;
+    can_borrow = result[0]["status"] == "active";
+    active = result[0]["active"].get<int>();
+    return true;
+}
+
+std::shared_ptr<LoanCounters::MemberState> LoanCounters::find(int member_id) const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    auto it = members.find(member_id);
+    return it == members.end() ? nullptr : it->second;
+}
+
+bool LoanCounters::loadMember(Database& db, int member_id) {
+    if (find(member_id)) return true;
+    bool can_borrow;
+    int active;
+    if (!readMember(db, member_id, can_borrow, active)) return false;
+    
+    auto state = std::make_shared<MemberState>();
+    state->can_borrow = can_borrow;
+    state->active = active;
+    // A concurrent first checkout may have loaded it meanwhile, and may
+    // already hold a reservation on it
+    std::unique_lock<std::shared_mutex> guard(lock);
+    members.try_emplace(member_id, std::move(state));
+    return true;
+}
+
+bool LoanCounters::reconcile(Database& db, int member_id) {
+    auto state = find(member_id);
+    if (!state) return loadMember(db, member_id);
+    unsigned settled;
+    {
+        std::lock_guard<std::mutex> guard(state->update);
+        settled = state->settled;
+    }
+    bool can_borrow;
+    int active;
+    if (!readMember(db, member_id, can_borrow, active)) return false;
+    
+    std::lock_guard<std::mutex> guard(state->update);
+    state->can_borrow = can_borrow;
+    // A loan this server committed or ended during the read may or may not
+    // be in the count; its own binlog event reconciles again later
+    if (state->settled == settled) {
+        state->active = active + state->pending;
+    }
+    return true;
+}
+
+void LoanCounters::save(SnapshotWriter& snapshot) const {
+    std::vector<MemberRecord> records;
+    {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        records.reserve(members.size());
+        for (const auto& [member_id, state] : members) {
+            // Reservations in flight are not loans yet
+            int active = state->active.load() - state->pending.load();
+            records.push_back({member_id, active, state->can_borrow.load() ? 1 : 0});
+        }
+    }
+    snapshot.addArray("loans.members", records);
+}
+
+bool LoanCounters::restore(const SnapshotReader& snapshot) {
+    auto [records, count] = snapshot.array<MemberRecord>("loans.members");
+    
+    std::unordered_map<int, std::shared_ptr<MemberState>> fresh;
+    fresh.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto state = std::make_shared<MemberState>();
+        state->active = records[i].active;
+        state->can_borrow = records[i].can_borrow != 0;
+        fresh[records[i].member_id] = std::move(state);
+    }
+    
+    std::unique_lock<std::shared_mutex> guard(lock);
+    members.swap(fresh);
+    Logger::info("loan_counters", "Loan counters restored").field("members", members.size());
+    return true;
+}
+
+std::vector<int> LoanCounters::memberIds() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    std::vector<int> ids;
+    ids.reserve(members.size());
+    for (const auto& [member_id, state] : members) ids.push_back(member_id);
+    return ids;
+}
+
+LoanCounters::Admission LoanCounters::tryReserve(int member_id, int limit) {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    auto it = members.find(member_id);
+    if (it == members.end()) {
+        return Admission::UnknownMember;
+    }
+    
+    MemberState& state = *it->second;
+    if (!state.can_borrow) {
+        rejected++;
+        return Admission::MemberNotActive;
+    }
+    
+    std::lock_guard<std::mutex> update(state.update);
+    if (state.active >= limit) {
+        rejected++;
+        return Admission::LimitReached;
+    }
+    state.active++;
+    state.pending++;
+    
+    granted++;
+    return Admission::Granted;
+}
+
+void LoanCounters::confirm(int member_id) {
+    auto state = find(member_id);
+    if (!state) return;
+    std::lock_guard<std::mutex> guard(state->update);
+    state->settled++;
+    if (state->pending > 0) state->pending--;
+}
+
+void LoanCounters::cancel(int member_id) {
+    auto state = find(member_id);
+    if (!state) return;
+    std::lock_guard<std::mutex> guard(state->update);
+    if (state->pending > 0) state->pending--;
+    if (state->active > 0) state->active--;
+}
+
+void LoanCounters::release(int member_id) {
+    adjust(member_id, -1);
+}
+
+void LoanCounters::adjust(int member_id, int delta) {
+    auto state = find(member_id);
+    if (!state) return;
+    std::lock_guard<std::mutex> guard(state->update);
+    state->settled++;
+    state->active = std::max(0, state->active + delta);
+}
+
+void LoanCounters::setMemberStatus(int member_id, const std::string& status) {
+    // A member not tracked yet is loaded with its real loan count on first
+    // checkout; an entry made here would start from zero
+    std::shared_lock<std::shared_mutex> guard(lock);
+    auto it = members.find(member_id);
+    if (it != members.end()) it->second->can_borrow = status == "active";
+}
+
+void LoanCounters::removeMember(int member_id) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    members.erase(member_id);
+}
+
+int LoanCounters::getActiveLoans(int member_id) const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    auto it = members.find(member_id);
+    return it == members.end() ? 0 : it->second->active.load();
+}
+
+json LoanCounters::getStats() const {
+    size_t tracked;
+    {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        tracked = members.size();
+    }
+    return json{
+        {"members", tracked},
+        {"granted", granted.load()},
+        {"rejected", rejected.load()}
+    };
+}
@@ -0,0 +1,183 @@
+#include "services/name_directory.h"
+#include "database/row_schema.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+namespace {
+
+std::atomic<long long> ttl_seconds{60};
+
+// One fetched (id, name) pair, from either table
+struct NameRow {
+    int id = 0;
+    std::string name;
+
+    explicit NameRow(Database*) {}
+};
+
+} // namespace
+
+template <>
+struct Schema<NameRow> {
+    static constexpr auto fields = std::make_tuple(
+        field("id", &NameRow::id),
+        field("name", &NameRow::name)
+    );
+};
+
+void NameDirectory::Table::set(int id, const std::string& name, Clock::time_point as_of) {
+    Shard& shard = shardOf(id);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    auto [it, inserted] = shard.names.try_emplace(id, Name{name, as_of});
+    if (!inserted && it->second.as_of <= as_of) it->second = Name{name, as_of};
+}
+
+void NameDirectory::Table::remove(int id, Clock::time_point as_of) {
+    Shard& shard = shardOf(id);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    auto it = shard.names.find(id);
+    if (it != shard.names.end() && it->second.as_of < as_of) shard.names.erase(it);
+}
+
+std::string NameDirectory::Table::find(int id) const {
+    const Shard& shard = shardOf(id);
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    auto it = shard.names.find(id);
+    return it == shard.names.end() ? std::string() : it->second.name;
+}
+
+std::vector<int> NameDirectory::Table::missing(const std::vector<int>& ids, Clock::time_point stale_before) const {
+    std::vector<int> unique = ids;
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    std::vector<int> absent;
+    for (int id : unique) {
+        const Shard& shard = shardOf(id);
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+        auto it = shard.names.find(id);
+        if (it == shard.names.end() || it->second.as_of < stale_before) absent.push_back(id);
+    }
+    return absent;
+}
+
+void NameDirectory::Table::clear() {
+    for (Shard& shard : shards) {
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        shard.names.clear();
+    }
+}
+
+size_t NameDirectory::Table::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards) {
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+        total += shard.names.size();
+    }
+    return total;
+}
+
+NameDirectory& NameDirectory::of(const Database& db) {
+    static std::mutex registry_lock;
+    static std::unordered_map<const Database*, std::unique_ptr<NameDirectory>> registry;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    auto& directory = registry[&db];
+    if (!directory) directory.reset(new NameDirectory());
+    return *directory;
+}
+
+void NameDirectory::setTtl(std::chrono::seconds ttl) {
+    ttl_seconds = ttl.count();
+}
+
+void NameDirectory::setMember(int member_id, const std::string& name) {
+    members.set(member_id, name, Clock::now());
+}
+
+void NameDirectory::setBook(int book_id, const std::string& title) {
+    books.set(book_id, title, Clock::now());
+}
+
+void NameDirectory::removeMember(int member_id) {
+    members.remove(member_id, Clock::time_point::max());
+}
+
+void NameDirectory::removeBook(int book_id) {
+    books.remove(book_id, Clock::time_point::max());
+}
+
+void NameDirectory::clear() {
+    members.clear();
+    books.clear();
+}
+
+std::string NameDirectory::memberName(int member_id) const {
+    return members.find(member_id);
+}
+
+std::string NameDirectory::bookTitle(int book_id) const {
+    return books.find(book_id);
+}
+
+void NameDirectory::prefetch(Database& db, const std::vector<int>& member_ids, const std::vector<int>& book_ids) {
+    long long ttl = ttl_seconds.load();
+    auto stale_before = ttl > 0 ? Clock::now() - std::chrono::seconds(ttl) : Clock::time_point::min();
+    fetch(db, members, "members", "name", members.missing(member_ids, stale_before), false);
+    fetch(db, books, "books", "title", books.missing(book_ids, stale_before), false);
+}
+
+void NameDirectory::reloadMembers(Database& db, const std::vector<int>& member_ids) {
+    fetch(db, members, "members", "name", member_ids, true);
+}
+
+void NameDirectory::reloadBooks(Database& db, const std::vector<int>& book_ids) {
+    fetch(db, books, "books", "title", book_ids, true);
+}
+
+void NameDirectory::fetch(Database& db, Table& table, const char* table_name, const char* column,
+                          const std::vector<int>& ids, bool reload) {
+    for (size_t start = 0; start < ids.size(); start += fetchBatch) {
+        size_t end = std::min(ids.size(), start + fetchBatch);
+        std::stringstream ss;
+        ss << "SELECT id, " << column << " AS name FROM " << table_name << " WHERE id IN (";
+        for (size_t i = start; i < end; ++i) {
+            ss << (i == start ? "" : ", ") << ids[i];
+        }
+        ss << ")";
+
+        // The rows are at least as new as the moment the read was sent
+        auto as_of = Clock::now();
+        auto rows = db.queryRows<NameRow>(ss.str());
+        if (!rows) {
+            // A failed read keeps what a read had cached, to be tried again
+            // next time; names the binlog reported as changed are dropped
+            if (reload) {
+                for (size_t i = start; i < end; ++i) table.remove(ids[i], as_of);
+            }
+            continue;
+        }
+        std::unordered_set<int> found;
+        for (const auto& row : *rows) {
+            table.set(row.id, row.name, as_of);
+            found.insert(row.id);
+        }
+        for (size_t i = start; i < end; ++i) {
+            if (!found.count(ids[i])) table.remove(ids[i], as_of);
+        }
+        fetches++;
+        fetched += rows->size();
+    }
+}
+
+json NameDirectory::getStats() const {
+    return {
+        {"members", members.size()},
+        {"books", books.size()},
+        {"fetches", fetches.load()},
+        {"fetched", fetched.load()}
+    };
+}
@@ -0,0 +1,39 @@
+#include "services/settings_cache.h"
+#include "logging/logger.h"
+
+SettingsCache::SettingsCache() {
+    auto defaults = std::make_unique<SettingsSnapshot>();
+    defaults->body = json{{"error", "Settings not found"}}.dump();
+    current.store(defaults.get(), std::memory_order_release);
+    snapshots.push_back(std::move(defaults));
+}
+
+SettingsCache& SettingsCache::instance() {
+    static SettingsCache cache;
+    return cache;
+}
+
+bool SettingsCache::load(Database& db) {
+    // Read from the primary so a reload right after an update sees it
+    json result = db.executeQuery("SELECT * FROM settings LIMIT 1");
+    
+    if (!result.is_array() || result.empty()) {
+        Logger::warn("settings", "Settings not found, using default circulation policy");
+        return false;
+    }
+    
+    auto fresh = std::make_unique<SettingsSnapshot>();
+    const json& row = result[0];
+    if (row["borrow_limit"].is_number()) fresh->policy.borrow_limit = row["borrow_limit"];
+    if (row["borrow_duration_days"].is_number()) fresh->policy.borrow_duration_days = row["borrow_duration_days"];
+    if (row["late_fee_per_day"].is_number()) fresh->policy.late_fee_per_day = row["late_fee_per_day"];
+    if (row["enable_fine"].is_number()) fresh->policy.enable_fine = row["enable_fine"].get<int>() != 0;
+    fresh->row = row;
+    fresh->body = row.dump();
+    fresh->loaded = true;
+    
+    std::lock_guard<std::mutex> guard(writer_lock);
+    current.store(fresh.get(), std::memory_order_release);
+    snapshots.push_back(std::move(fresh));
+    return true;
+}
@@ -0,0 +1,368 @@
+#include "services/title_autocomplete.h"
+#include "logging/logger.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <numeric>
+#include <queue>
+#include <tuple>
+
+TitleAutocomplete& TitleAutocomplete::of(const Database& db) {
+    static std::mutex registry_lock;
+    static std::unordered_map<const Database*, std::unique_ptr<TitleAutocomplete>> registry;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    auto& index = registry[&db];
+    if (!index) index.reset(new TitleAutocomplete());
+    return *index;
+}
+
+std::string TitleAutocomplete::normalize(const std::string& text) {
+    std::string key = text;
+    for (char& c : key) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return key;
+}
+
+uint32_t TitleAutocomplete::addEntry(Model& model, const std::string& text, int book_id, long long popularity) {
+    uint32_t entry = uint32_t(model.entries.size());
+    model.entries.push_back({normalize(text), text, book_id, popularity, unsorted});
+    model.tail.push_back(entry);
+    return entry;
+}
+
+// Changes an entry's rank; entries in the sorted array also update the tree
+void TitleAutocomplete::setPopularity(Model& model, uint32_t entry, long long popularity) {
+    model.entries[entry].popularity = popularity;
+    uint32_t position = model.entries[entry].position;
+    if (position == unsorted) return;
+
+    size_t leaves = model.sorted.size();
+    for (size_t node = (position + leaves) / 2; node >= 1; node /= 2) {
+        uint32_t left = model.tree[2 * node];
+        uint32_t right = model.tree[2 * node + 1];
+        model.tree[node] = model.entries[left].popularity >= model.entries[right].popularity ? left : right;
+    }
+}
+
+void TitleAutocomplete::addBook(Model& model, int book_id, const std::string& title, const std::string& author,
+                                long long loans) {
+    BookRef ref{addEntry(model, title, book_id, loans), normalize(author), loans};
+
+    auto existing = model.authors.find(ref.author_key);
+    if (existing == model.authors.end()) {
+        model.authors.emplace(ref.author_key, AuthorRef{addEntry(model, author, 0, loans), 1});
+    } else {
+        existing->second.books++;
+        setPopularity(model, existing->second.entry, model.entries[existing->second.entry].popularity + loans);
+    }
+    model.books[book_id] = std::move(ref);
+}
+
+void TitleAutocomplete::removeBook(Model& model, int book_id) {
+    auto book = model.books.find(book_id);
+    if (book == model.books.end()) return;
+
+    setPopularity(model, book->second.title_entry, -1);
+    auto author = model.authors.find(book->second.author_key);
+    if (author != model.authors.end()) {
+        if (--author->second.books == 0) {
+            setPopularity(model, author->second.entry, -1);
+            model.authors.erase(author);
+        } else {
+            setPopularity(model, author->second.entry,
+                          model.entries[author->second.entry].popularity - book->second.loans);
+        }
+    }
+    model.books.erase(book);
+}
+
+// Folds the tail into the sorted array, drops the tombstones for good and
+// rebuilds the tree: one merge pass, no full re-sort. Live entries are
+// renumbered in key order, so entry ids change here.
+void TitleAutocomplete::mergeTail(Model& model) {
+    auto by_key = [&model](uint32_t a, uint32_t b) {
+        return model.entries[a].key < model.entries[b].key;
+    };
+    auto removed = [&model](uint32_t entry) { return model.entries[entry].popularity < 0; };
+
+    std::vector<uint32_t> tail = std::move(model.tail);
+    model.tail.clear();
+    tail.erase(std::remove_if(tail.begin(), tail.end(), removed), tail.end());
+    std::sort(tail.begin(), tail.end(), by_key);
+    model.sorted.erase(std::remove_if(model.sorted.begin(), model.sorted.end(), removed), model.sorted.end());
+
+    std::vector<uint32_t> merged;
+    merged.reserve(model.sorted.size() + tail.size());
+    std::merge(model.sorted.begin(), model.sorted.end(), tail.begin(), tail.end(), std::back_inserter(merged), by_key);
+
+    std::vector<Entry> entries;
+    entries.reserve(merged.size());
+    std::vector<uint32_t> renumbered(model.entries.size(), unsorted);
+    for (uint32_t entry : merged) {
+        renumbered[entry] = uint32_t(entries.size());
+        entries.push_back(std::move(model.entries[entry]));
+    }
+    for (auto& [book_id, ref] : model.books) ref.title_entry = renumbered[ref.title_entry];
+    for (auto& [key, ref] : model.authors) ref.entry = renumbered[ref.entry];
+    model.entries = std::move(entries);
+    model.sorted.resize(model.entries.size());
+    std::iota(model.sorted.begin(), model.sorted.end(), 0);
+    buildTree(model);
+}
+
+// The tail is long enough to slow lookups, or removed entries take up more
+// room than it would
+bool TitleAutocomplete::needsMerge(const Model& model) {
+    size_t live = model.books.size() + model.authors.size();
+    return model.tail.size() > tailLimit || model.entries.size() > live + tailLimit;
+}
+
+void TitleAutocomplete::buildTree(Model& model) {
+    size_t leaves = model.sorted.size();
+    model.tree.assign(2 * std::max<size_t>(leaves, 1), 0);
+    for (size_t i = 0; i < leaves; ++i) {
+        model.entries[model.sorted[i]].position = uint32_t(i);
+        model.tree[leaves + i] = model.sorted[i];
+    }
+    for (size_t node = leaves - 1; node >= 1 && leaves > 1; --node) {
+        uint32_t left = model.tree[2 * node];
+        uint32_t right = model.tree[2 * node + 1];
+        model.tree[node] = model.entries[left].popularity >= model.entries[right].popularity ? left : right;
+    }
+}
+
+// Most borrowed entry among sorted[begin, end)
+uint32_t TitleAutocomplete::best(const Model& model, size_t begin, size_t end) {
+    size_t leaves = model.sorted.size();
+    uint32_t winner = model.sorted[begin];
+    for (size_t lo = begin + leaves, hi = end + leaves; lo < hi; lo /= 2, hi /= 2) {
+        if (lo & 1) {
+            uint32_t candidate = model.tree[lo++];
+            if (model.entries[candidate].popularity > model.entries[winner].popularity) winner = candidate;
+        }
+        if (hi & 1) {
+            uint32_t candidate = model.tree[--hi];
+            if (model.entries[candidate].popularity > model.entries[winner].popularity) winner = candidate;
+        }
+    }
+    return winner;
+}
+
+bool TitleAutocomplete::rebuild(Database& db) {
+    Model fresh;
+    // One row per book with its lifetime loan count, read through idx_book
+    bool ok = db.streamUnbuffered(
+        "SELECT b.id, b.title, b.author, COUNT(br.id) FROM books b "
+        "LEFT JOIN borrow_records br ON br.book_id = b.id GROUP BY b.id", 4,
+        [&fresh](char** row, unsigned long*) {
+            addBook(fresh, std::atoi(row[0]), row[1] ? row[1] : "", row[2] ? row[2] : "", std::atoll(row[3]));
+        });
+    if (!ok) {
+        Logger::error("autocomplete", "Autocomplete index rebuild failed");
+        return false;
+    }
+    mergeTail(fresh);
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    model = std::move(fresh);
+    Logger::info("autocomplete", "Autocomplete index built").field("entries", model.sorted.size());
+    return true;
+}
+
+void TitleAutocomplete::upsert(const Book& book) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    long long loans = 0;
+    auto existing = model.books.find(book.getId());
+    if (existing != model.books.end()) {
+        const Entry& title = model.entries[existing->second.title_entry];
+        if (title.text == book.getTitle() && existing->second.author_key == normalize(book.getAuthor())) {
+            return;
+        }
+        loans = existing->second.loans;
+        removeBook(model, book.getId());
+    }
+    addBook(model, book.getId(), book.getTitle(), book.getAuthor(), loans);
+    if (needsMerge(model)) {
+        mergeTail(model);
+        merges++;
+    }
+}
+
+void TitleAutocomplete::remove(int book_id) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    removeBook(model, book_id);
+    if (needsMerge(model)) {
+        mergeTail(model);
+        merges++;
+    }
+}
+
+void TitleAutocomplete::recordBorrow(int book_id) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    auto book = model.books.find(book_id);
+    if (book == model.books.end()) return;
+
+    book->second.loans++;
+    setPopularity(model, book->second.title_entry, model.entries[book->second.title_entry].popularity + 1);
+    auto author = model.authors.find(book->second.author_key);
+    if (author != model.authors.end()) {
+        setPopularity(model, author->second.entry, model.entries[author->second.entry].popularity + 1);
+    }
+}
+
+void TitleAutocomplete::setLoans(int book_id, long long loans) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    auto book = model.books.find(book_id);
+    if (book == model.books.end() || book->second.loans == loans) return;
+
+    long long delta = loans - book->second.loans;
+    book->second.loans = loans;
+    setPopularity(model, book->second.title_entry, loans);
+    auto author = model.authors.find(book->second.author_key);
+    if (author != model.authors.end()) {
+        setPopularity(model, author->second.entry, model.entries[author->second.entry].popularity + delta);
+    }
+}
+
+// Live entries are written sorted entries first, then the tail, so restoring
+// only has to sort the tail
+void TitleAutocomplete::save(SnapshotWriter& snapshot) const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    std::vector<uint32_t> renumbered(model.entries.size(), unsorted);
+    std::vector<EntryRecord> entries;
+    std::vector<std::string_view> texts;
+    uint64_t sorted_count = 0;
+    auto keep = [&](uint32_t entry) {
+        const Entry& live = model.entries[entry];
+        if (live.popularity < 0) return false;
+        renumbered[entry] = uint32_t(entries.size());
+        entries.push_back({live.book_id, 0, live.popularity});
+        texts.push_back(live.text);
+        return true;
+    };
+    for (uint32_t entry : model.sorted) {
+        if (keep(entry)) sorted_count++;
+    }
+    for (uint32_t entry : model.tail) keep(entry);
+
+    std::vector<BookRecord> books;
+    books.reserve(model.books.size());
+    for (const auto& [book_id, ref] : model.books) {
+        auto author = model.authors.find(ref.author_key);
+        if (author == model.authors.end()) continue;
+        books.push_back({book_id, renumbered[ref.title_entry], renumbered[author->second.entry], 0, ref.loans});
+    }
+
+    snapshot.addSection("autocomplete.sorted", &sorted_count, sizeof(sorted_count));
+    snapshot.addArray("autocomplete.entries", entries);
+    snapshot.addStrings("autocomplete.texts", texts);
+    snapshot.addArray("autocomplete.books", books);
+}
+
+bool TitleAutocomplete::restore(const SnapshotReader& snapshot) {
+    auto [sorted_count, sorted_sections] = snapshot.array<uint64_t>("autocomplete.sorted");
+    auto [entries, entry_count] = snapshot.array<EntryRecord>("autocomplete.entries");
+    auto [books, book_count] = snapshot.array<BookRecord>("autocomplete.books");
+    std::vector<std::string_view> texts = snapshot.strings("autocomplete.texts");
+    if (sorted_sections != 1 || texts.size() != entry_count || *sorted_count > entry_count) {
+        Logger::warn("autocomplete", "Autocomplete snapshot is inconsistent");
+        return false;
+    }
+
+    Model fresh;
+    fresh.entries.reserve(entry_count);
+    for (size_t i = 0; i < entry_count; ++i) {
+        std::string text(texts[i]);
+        fresh.entries.push_back({normalize(text), std::move(text), entries[i].book_id, entries[i].popularity, unsorted});
+        if (i < *sorted_count) {
+            fresh.sorted.push_back(uint32_t(i));
+        } else {
+            fresh.tail.push_back(uint32_t(i));
+        }
+    }
+    for (size_t i = 0; i < book_count; ++i) {
+        const BookRecord& record = books[i];
+        if (record.title_entry >= entry_count || record.author_entry >= entry_count) {
+            Logger::warn("autocomplete", "Autocomplete snapshot is inconsistent").field("book_id", record.book_id);
+            return false;
+        }
+        std::string author_key = fresh.entries[record.author_entry].key;
+        fresh.authors.emplace(author_key, AuthorRef{record.author_entry, 0}).first->second.books++;
+        fresh.books[record.book_id] = {record.title_entry, std::move(author_key), record.loans};
+    }
+    mergeTail(fresh);
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    model = std::move(fresh);
+    Logger::info("autocomplete", "Autocomplete index restored").field("entries", model.sorted.size());
+    return true;
+}
+
+std::vector<TitleAutocomplete::Suggestion> TitleAutocomplete::complete(const std::string& prefix, size_t limit) const {
+    lookups++;
+    std::string key = normalize(prefix);
+    if (key.empty() || limit == 0) return {};
+    std::vector<uint32_t> picked;
+
+    std::shared_lock<std::shared_mutex> guard(lock);
+    auto key_of = [this](uint32_t entry) -> const std::string& { return model.entries[entry].key; };
+    // UTF-8 never contains 0xFF, so this bounds every key with the prefix
+    auto first = std::lower_bound(model.sorted.begin(), model.sorted.end(), key,
+                                  [&key_of](uint32_t entry, const std::string& k) { return key_of(entry) < k; });
+    auto last = std::lower_bound(first, model.sorted.end(), key + '\xff',
+                                 [&key_of](uint32_t entry, const std::string& k) { return key_of(entry) < k; });
+
+    // Repeatedly take the best entry of a range and split the range around it
+    using Candidate = std::tuple<long long, uint32_t, size_t, size_t>;
+    std::priority_queue<Candidate> ranges;
+    auto push = [this, &ranges](size_t begin, size_t end) {
+        if (begin >= end) return;
+        uint32_t entry = best(model, begin, end);
+        ranges.emplace(model.entries[entry].popularity, entry, begin, end);
+    };
+    push(first - model.sorted.begin(), last - model.sorted.begin());
+    while (!ranges.empty() && picked.size() < limit) {
+        auto [popularity, entry, begin, end] = ranges.top();
+        ranges.pop();
+        if (popularity < 0) break;
+        picked.push_back(entry);
+        push(begin, model.entries[entry].position);
+        push(model.entries[entry].position + 1, end);
+    }
+
+    for (uint32_t entry : model.tail) {
+        const Entry& candidate = model.entries[entry];
+        if (candidate.popularity >= 0 && candidate.key.compare(0, key.size(), key) == 0) {
+            picked.push_back(entry);
+        }
+    }
+
+    std::sort(picked.begin(), picked.end(), [this](uint32_t a, uint32_t b) {
+        const Entry& x = model.entries[a];
+        const Entry& y = model.entries[b];
+        return x.popularity != y.popularity ? x.popularity > y.popularity : x.key < y.key;
+    });
+    if (picked.size() > limit) picked.resize(limit);
+
+    std::vector<Suggestion> suggestions;
+    suggestions.reserve(picked.size());
+    for (uint32_t entry : picked) {
+        const Entry& chosen = model.entries[entry];
+        suggestions.push_back({chosen.text, chosen.book_id == 0, chosen.book_id, chosen.popularity});
+    }
+    return suggestions;
+}
+
+json TitleAutocomplete::getStats() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return {
+        {"books", model.books.size()},
+        {"authors", model.authors.size()},
+        {"sorted_entries", model.sorted.size()},
+        {"tail_entries", model.tail.size()},
+        {"lookups", lookups.load()},
+        {"merges", merges.load()}
+    };
+}
@@ -0,0 +1,218 @@
+#include "snapshot/snapshot_file.h"
+#include "logging/logger.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char magic[8] = {'L', 'I', 'B', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t byteOrderMark = 0x01020304;
+const uint64_t fnvOffset = 1469598103934665603ULL;
+const uint64_t fnvPrime = 1099511628211ULL;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    int32_t branch_id;
+    uint32_t section_count;
+    int64_t created_at;
+    char as_of[24];
+    uint64_t table_offset;
+    uint64_t checksum;       // FNV-1a over everything between header and table
+};
+
+struct TableEntry {
+    char name[48];
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+uint64_t fnv(uint64_t hash, const char* bytes, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(bytes[i])) * fnvPrime;
+    }
+    return hash;
+}
+
+} // namespace
+
+SnapshotWriter::SnapshotWriter(int branch, const std::string& as_of_time)
+    : branch_id(branch), as_of(as_of_time), checksum(fnvOffset) {}
+
+bool SnapshotWriter::begin(const std::string& target) {
+    path = target;
+    out.open(path + ".tmp", std::ios::binary | std::ios::trunc);
+    if (!out) {
+        Logger::error("snapshot", "Cannot write snapshot").field("path", path + ".tmp");
+        return false;
+    }
+    // Placeholder, rewritten by finish() once the table offset is known
+    Header header{};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    position = sizeof(header);
+    return true;
+}
+
+void SnapshotWriter::write(const void* bytes, size_t count) {
+    out.write(static_cast<const char*>(bytes), count);
+    checksum = fnv(checksum, static_cast<const char*>(bytes), count);
+    position += count;
+}
+
+void SnapshotWriter::addSection(const std::string& name, const void* bytes, size_t count) {
+    if (name.size() >= sizeof(TableEntry::name)) {
+        failed = true;
+        return;
+    }
+    sections.push_back({name, position, count});
+    write(bytes, count);
+    static const char padding[8] = {};
+    write(padding, (8 - count % 8) % 8);
+}
+
+void SnapshotWriter::addStrings(const std::string& name, const std::vector<std::string_view>& strings) {
+    std::vector<uint64_t> offsets;
+    offsets.reserve(strings.size() + 2);
+    offsets.push_back(strings.size());
+    uint64_t offset = 0;
+    for (const auto& text : strings) {
+        offsets.push_back(offset);
+        offset += text.size();
+    }
+    offsets.push_back(offset);
+
+    std::string blob;
+    blob.reserve(offsets.size() * sizeof(uint64_t) + offset);
+    blob.append(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    for (const auto& text : strings) blob.append(text.data(), text.size());
+    addSection(name, blob.data(), blob.size());
+}
+
+bool SnapshotWriter::finish() {
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = SnapshotReader::version;
+    header.byte_order = byteOrderMark;
+    header.branch_id = branch_id;
+    header.section_count = uint32_t(sections.size());
+    header.created_at = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::strncpy(header.as_of, as_of.c_str(), sizeof(header.as_of) - 1);
+    header.table_offset = position;
+    header.checksum = checksum;
+
+    for (const auto& section : sections) {
+        TableEntry entry{};
+        std::strncpy(entry.name, section.name.c_str(), sizeof(entry.name) - 1);
+        entry.offset = section.offset;
+        entry.bytes = section.bytes;
+        out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+
+    if (failed || !out) {
+        Logger::error("snapshot", "Snapshot write failed").field("path", path);
+        std::remove((path + ".tmp").c_str());
+        return false;
+    }
+    // Readers only ever see a complete file
+    if (std::rename((path + ".tmp").c_str(), path.c_str()) != 0) {
+        Logger::error("snapshot", "Cannot replace snapshot").field("path", path);
+        return false;
+    }
+    return true;
+}
+
+SnapshotReader::~SnapshotReader() {
+    if (data) munmap(const_cast<char*>(data), length);
+}
+
+bool SnapshotReader::open(const std::string& path, int branch_id) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        Logger::warn("snapshot", "Cannot map snapshot").field("path", path);
+        return false;
+    }
+    data = static_cast<const char*>(mapped);
+    length = info.st_size;
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.byte_order != byteOrderMark) {
+        Logger::warn("snapshot", "Not a snapshot file").field("path", path);
+        return false;
+    }
+    if (header.version != version || header.branch_id != branch_id) {
+        Logger::warn("snapshot", "Snapshot is for another version or branch; ignoring it")
+            .field("path", path)
+            .field("version", header.version)
+            .field("branch_id", header.branch_id);
+        return false;
+    }
+    uint64_t table_bytes = uint64_t(header.section_count) * sizeof(TableEntry);
+    if (header.table_offset < sizeof(Header) || header.table_offset + table_bytes != length) {
+        Logger::warn("snapshot", "Snapshot is truncated").field("path", path);
+        return false;
+    }
+    if (fnv(fnvOffset, data + sizeof(Header), header.table_offset - sizeof(Header)) != header.checksum) {
+        Logger::warn("snapshot", "Snapshot fails its checksum").field("path", path);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.section_count; ++i) {
+        TableEntry entry;
+        std::memcpy(&entry, data + header.table_offset + i * sizeof(TableEntry), sizeof(entry));
+        entry.name[sizeof(entry.name) - 1] = '\0';
+        if (entry.offset + entry.bytes > header.table_offset) return false;
+        sections.emplace_back(entry.name, std::string_view(data + entry.offset, entry.bytes));
+    }
+    header.as_of[sizeof(header.as_of) - 1] = '\0';
+    as_of = header.as_of;
+    created_at = header.created_at;
+    return true;
+}
+
+std::string_view SnapshotReader::section(const std::string& name) const {
+    for (const auto& [section_name, bytes] : sections) {
+        if (section_name == name) return bytes;
+    }
+    return {};
+}
+
+std::vector<std::string_view> SnapshotReader::strings(const std::string& name) const {
+    std::string_view bytes = section(name);
+    std::vector<std::string_view> strings;
+    if (bytes.size() < sizeof(uint64_t)) return strings;
+
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(bytes.data());
+    uint64_t count = words[0];
+    size_t characters_at = (count + 2) * sizeof(uint64_t);
+    if (characters_at > bytes.size()) return strings;
+
+    const uint64_t* offsets = words + 1;
+    const char* characters = bytes.data() + characters_at;
+    size_t available = bytes.size() - characters_at;
+    strings.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > available) return {};
+        strings.emplace_back(characters + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
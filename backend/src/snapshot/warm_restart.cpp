@@ -0,0 +1,185 @@
+#include "snapshot/warm_restart.h"
+#include "snapshot/snapshot_file.h"
+#include "services/catalog_facets.h"
+#include "services/loan_counters.h"
+#include "services/title_autocomplete.h"
+#include "models/book.h"
+#include "database/delta_sync.h"
+#include "logging/logger.h"
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+namespace warm_restart {
+
+namespace {
+
+// The as_of string comes from a file on disk; only accept a plain DATETIME
+bool isDateTime(const std::string& value) {
+    if (value.size() != 19) return false;
+    for (size_t i = 0; i < value.size(); ++i) {
+        char expected = i == 4 || i == 7 ? '-' : i == 10 ? ' ' : i == 13 || i == 16 ? ':' : '0';
+        if (expected == '0' ? !std::isdigit(static_cast<unsigned char>(value[i])) : value[i] != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string idList(const std::set<int>& ids) {
+    std::stringstream ss;
+    for (auto it = ids.begin(); it != ids.end(); ++it) {
+        ss << (it == ids.begin() ? "" : ",") << *it;
+    }
+    return ss.str();
+}
+
+bool streamIds(Database& db, const std::string& query, std::unordered_set<int>& ids) {
+    return db.streamUnbuffered(query, 1, [&ids](char** row, unsigned long*) {
+        ids.insert(std::atoi(row[0]));
+    });
+}
+
+} // namespace
+
+std::string pathFor(const std::string& dir, int branch_id) {
+    return dir + "/branch-" + std::to_string(branch_id) + ".snap";
+}
+
+bool save(Database& db, int branch_id, const std::string& dir) {
+    auto started = std::chrono::steady_clock::now();
+    // Taken before any state is copied, so everything newer is caught up on
+    json now = db.executeQuery("SELECT DATE_FORMAT(NOW(), '%Y-%m-%d %H:%i:%s') AS as_of");
+    if (!now.is_array() || now.empty()) {
+        Logger::warn("snapshot", "Snapshot skipped: no database clock").field("branch_id", branch_id);
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    SnapshotWriter snapshot(branch_id, now[0]["as_of"].get<std::string>());
+    if (!snapshot.begin(pathFor(dir, branch_id))) return false;
+    LoanCounters::of(db).save(snapshot);
+    CatalogFacets::of(db).save(snapshot);
+    TitleAutocomplete::of(db).save(snapshot);
+    if (!snapshot.finish()) return false;
+
+    Logger::info("snapshot", "Snapshot saved")
+        .field("branch_id", branch_id)
+        .field("latency_ms", std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now() - started).count());
+    return true;
+}
+
+void startSaveJob(Database& db, int branch_id, const std::string& dir, std::chrono::minutes interval) {
+    std::thread([&db, branch_id, dir, interval] {
+        for (;;) {
+            std::this_thread::sleep_for(interval);
+            save(db, branch_id, dir);
+        }
+    }).detach();
+}
+
+bool restore(Database& db, int branch_id, const std::string& dir) {
+    auto started = std::chrono::steady_clock::now();
+    SnapshotReader snapshot;
+    if (!snapshot.open(pathFor(dir, branch_id), branch_id)) return false;
+    if (!LoanCounters::of(db).restore(snapshot)
+        || !CatalogFacets::of(db).restore(snapshot)
+        || !TitleAutocomplete::of(db).restore(snapshot)) {
+        return false;
+    }
+
+    if (!catchUp(db, snapshot.asOf())) {
+        Logger::error("snapshot", "Catch-up after snapshot failed").field("branch_id", branch_id);
+        return false;
+    }
+
+    Logger::info("snapshot", "Branch restored from snapshot")
+        .field("branch_id", branch_id)
+        .field("as_of", snapshot.asOf())
+        .field("latency_ms", std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now() - started).count());
+    return true;
+}
+
+bool catchUp(Database& db, const std::string& as_of) {
+    if (!isDateTime(as_of)) {
+        Logger::error("snapshot", "Invalid snapshot timestamp").field("as_of", as_of);
+        return false;
+    }
+    std::stringstream ss;
+    ss << "'" << as_of << "' - INTERVAL " << catchUpSlackSeconds << " SECOND";
+    std::string since = ss.str();
+
+    CatalogFacets& facets = CatalogFacets::of(db);
+    TitleAutocomplete& autocomplete = TitleAutocomplete::of(db);
+    LoanCounters& counters = LoanCounters::of(db);
+
+    size_t books_changed = 0;
+    bool ok = db.forEachRow<Book>(
+        "SELECT " + row_schema::columnList<Book>() + " FROM books WHERE updated_at >= " + since,
+        [&](const Book& book) {
+            facets.upsert(book);
+            autocomplete.upsert(book);
+            books_changed++;
+        });
+
+    // Loans touch a member's counter and a book's borrow count
+    std::set<int> loan_members, loan_books;
+    ok = ok && db.streamUnbuffered(
+        "SELECT DISTINCT member_id, book_id FROM borrow_records WHERE updated_at >= " + since, 2,
+        [&](char** row, unsigned long*) {
+            loan_members.insert(std::atoi(row[0]));
+            loan_books.insert(std::atoi(row[1]));
+        });
+    if (ok && !loan_books.empty()) {
+        ok = db.streamUnbuffered(
+            "SELECT book_id, COUNT(*) FROM borrow_records WHERE book_id IN (" + idList(loan_books) + ") "
+            "GROUP BY book_id", 2,
+            [&autocomplete](char** row, unsigned long*) {
+                autocomplete.setLoans(std::atoi(row[0]), std::atoll(row[1]));
+            });
+    }
+
+    std::unordered_set<int> changed_members;
+    ok = ok && streamIds(db, "SELECT id FROM members WHERE updated_at >= " + since, changed_members);
+    changed_members.insert(loan_members.begin(), loan_members.end());
+
+    // Deletes leave no updated_at behind; compare the id sets instead
+    std::unordered_set<int> book_ids, member_ids;
+    ok = ok && streamIds(db, "SELECT id FROM books", book_ids)
+            && streamIds(db, "SELECT id FROM members", member_ids);
+    // A deleted loan leaves only its tombstone, so recount every member
+    auto deleted_loans = ok ? delta_sync::deletedIds(db, "borrow_records", since) : std::nullopt;
+    if (!deleted_loans) return false;
+    if (!deleted_loans->empty() && !counters.rebuild(db)) return false;
+
+    size_t removed = 0;
+    for (int book_id : facets.bookIds()) {
+        if (book_ids.count(book_id)) continue;
+        facets.remove(book_id);
+        autocomplete.remove(book_id);
+        removed++;
+    }
+    for (int member_id : counters.memberIds()) {
+        if (member_ids.count(member_id)) continue;
+        counters.removeMember(member_id);
+        removed++;
+    }
+    for (int member_id : changed_members) {
+        if (member_ids.count(member_id)) counters.reconcile(db, member_id);
+    }
+
+    Logger::info("snapshot", "Caught up after snapshot")
+        .field("books", books_changed)
+        .field("members", changed_members.size())
+        .field("deletions", removed);
+    return true;
+}
+
+} // namespace warm_restart
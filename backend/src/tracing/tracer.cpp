@@ -0,0 +1,147 @@
+#include "tracing/tracer.h"
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+namespace {
+
+// The sampled trace of the request running on this thread, if any
+thread_local Tracer::Trace* currentTrace = nullptr;
+
+// Id of the outermost Request scope on this thread, sampled or not
+thread_local std::string currentRequest;
+thread_local int requestDepth = 0;
+
+const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+} // namespace
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+std::int64_t Tracer::nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void Tracer::setSampleRate(double rate) {
+    sample_rate = rate < 0 ? 0 : (rate > 1 ? 1 : rate);
+}
+
+bool Tracer::shouldSample() {
+    double rate = sample_rate.load(std::memory_order_relaxed);
+    if (rate <= 0) return false;
+    if (rate >= 1) return true;
+    thread_local std::minstd_rand rng(std::random_device{}());
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+}
+
+const std::string& Tracer::currentRequestId() {
+    return currentRequest;
+}
+
+Tracer::Request::Request(const char* name, const std::string& request_id) {
+    if (requestDepth++ == 0) {
+        if (request_id.empty()) {
+            char generated[40];
+            std::snprintf(generated, sizeof(generated), "req-%llx-%llx",
+                          static_cast<unsigned long long>(nowMicros()), Tracer::instance().next_request++);
+            currentRequest = generated;
+        } else {
+            currentRequest = request_id;
+        }
+    }
+
+    // Nested scopes (a handler calling another traced path) join the outer trace
+    if (currentTrace || !Tracer::instance().shouldSample()) return;
+
+    trace = new Trace();
+    trace->sequence = Tracer::instance().next_sequence++;
+    trace->name = name;
+    trace->request_id = currentRequest;
+    trace->events.reserve(32);
+    trace->events.push_back(Event{name, "request", nowMicros(), 0, json{{"request_id", trace->request_id}}});
+    currentTrace = trace;
+}
+
+Tracer::Request::~Request() {
+    if (--requestDepth == 0) currentRequest.clear();
+    if (!trace) return;
+    currentTrace = nullptr;
+    Event& root = trace->events.front();
+    root.duration_us = nowMicros() - root.start_us;
+    Tracer::instance().finish(trace);
+}
+
+Tracer::Span::Span(const char* name, const char* category) : trace(currentTrace) {
+    if (!trace) return;
+    index = trace->events.size();
+    trace->events.push_back(Event{name, category, nowMicros(), 0, json()});
+}
+
+Tracer::Span::~Span() {
+    if (!trace) return;
+    Event& event = trace->events[index];
+    event.duration_us = nowMicros() - event.start_us;
+}
+
+void Tracer::Span::arg(const char* key, json value) {
+    if (!trace) return;
+    Event& event = trace->events[index];
+    if (event.args.is_null()) event.args = json::object();
+    event.args[key] = std::move(value);
+}
+
+void Tracer::finish(Trace* trace) {
+    sampled++;
+    std::lock_guard<std::mutex> guard(lock);
+    if (ring.size() < capacity) {
+        ring.push_back(std::move(*trace));
+    } else {
+        ring[ring_next] = std::move(*trace);
+    }
+    ring_next = (ring_next + 1) % capacity;
+    delete trace;
+}
+
+json Tracer::exportChromeTrace() const {
+    json events = json::array();
+    std::lock_guard<std::mutex> guard(lock);
+
+    // One track per request, named after the route and request id
+    for (const auto& trace : ring) {
+        events.push_back({
+            {"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", trace.sequence},
+            {"args", {{"name", trace.name + " " + trace.request_id}}}
+        });
+        for (const auto& event : trace.events) {
+            json entry = {
+                {"name", event.name}, {"cat", event.category}, {"ph", "X"},
+                {"ts", event.start_us}, {"dur", event.duration_us},
+                {"pid", 1}, {"tid", trace.sequence}
+            };
+            if (!event.args.is_null()) entry["args"] = event.args;
+            events.push_back(std::move(entry));
+        }
+    }
+
+    return json{{"traceEvents", events}, {"displayTimeUnit", "ms"}};
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    ring.clear();
+    ring_next = 0;
+}
+
+json Tracer::getStats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return {
+        {"sample_rate", sample_rate.load()},
+        {"capacity", capacity},
+        {"stored", ring.size()},
+        {"sampled", sampled.load()}
+    };
+}
@@ -0,0 +1,222 @@
+// Binlog change-data-capture test.
+//
+// Loads sql/schema.sql into a scratch database and builds the in-memory
+// indexes. It then starts a BinlogConsumer and changes books, members and
+// loans through a second connection, like another server instance or a
+// manual fix would. Each change must reach the loan counters, facet bitmaps,
+// autocomplete index and name directory within a few seconds, without
+// rebuilding them.
+//
+// Needs a local mysqld started with --log-bin --binlog-format=ROW and a
+// user with REPLICATION SLAVE and REPLICATION CLIENT. Connection settings
+// come from CDC_TEST_DB_HOST, CDC_TEST_DB_PORT, CDC_TEST_DB_USER,
+// CDC_TEST_DB_PASSWORD and CDC_TEST_DB_NAME. Exits with 77 (skipped) when no
+// server is reachable or binary logging is off.
+
+#include "database/db_connection.h"
+#include "cdc/binlog_consumer.h"
+#include "services/catalog_facets.h"
+#include "services/loan_counters.h"
+#include "services/settings_cache.h"
+#include "models/borrow.h"
+#include "services/title_autocomplete.h"
+#include "test_database.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// Polls `done` until it holds or the consumer has had `seconds` to catch up
+bool eventually(const std::string& name, const std::function<bool()>& done, int seconds = 10) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (done()) {
+            std::cout << "ok   " << name << std::endl;
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    std::cerr << "FAIL " << name << std::endl;
+    return false;
+}
+
+bool suggests(Database& db, const std::string& prefix, int book_id) {
+    for (const auto& suggestion : TitleAutocomplete::of(db).complete(prefix, 10)) {
+        if (suggestion.book_id == book_id) return true;
+    }
+    return false;
+}
+
+long long loansOf(Database& db, const std::string& prefix, int book_id) {
+    for (const auto& suggestion : TitleAutocomplete::of(db).complete(prefix, 10)) {
+        if (suggestion.book_id == book_id) return suggestion.borrow_count;
+    }
+    return -1;
+}
+
+uint64_t booksBy(Database& db, const std::string& author) {
+    CatalogFacets::Filter filter;
+    filter.author = author;
+    return CatalogFacets::of(db).query(filter, 0, 10).total;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string schema_path = argc > 1 ? argv[1] : "sql/schema.sql";
+    std::string host = env("CDC_TEST_DB_HOST", "127.0.0.1");
+    std::string user = env("CDC_TEST_DB_USER", "root");
+    std::string password = env("CDC_TEST_DB_PASSWORD", "");
+    std::string name = env("CDC_TEST_DB_NAME", "library_cdc_test");
+    unsigned int port = std::stoi(env("CDC_TEST_DB_PORT", "3306"));
+
+    if (!recreateDatabase(host, user, password, port, name)) {
+        return 77;
+    }
+
+    Database db(host, user, password, name, port);
+    if (!db.connect() || !loadSchema(db, schema_path)) {
+        std::cerr << "Setup failed" << std::endl;
+        return 1;
+    }
+    json log_bin = db.executeQuery("SELECT @@global.log_bin AS log_bin, @@global.binlog_format AS format");
+    if (!log_bin.is_array() || log_bin.empty() || log_bin[0]["log_bin"] != 1
+        || log_bin[0].value("format", "") != "ROW") {
+        std::cerr << "Binary logging is off or not row-based" << std::endl;
+        return 77;
+    }
+
+    bool seeded = db.executeUpdate(
+        "INSERT INTO books (id, title, author, isbn, category, total_copies, available_copies, publication_year) "
+        "VALUES (1, 'Seed Title', 'Seed Author', 'CDC-1', 'Fiction', 2, 2, 2001)")
+        && db.executeUpdate(
+        "INSERT INTO members (id, member_id, name, email, status, join_date) "
+        "VALUES (1, 'CDC1', 'Seed Member', 'seed@example.com', 'active', '2020-01-01')");
+    if (!seeded || !LoanCounters::of(db).rebuild(db) || !CatalogFacets::of(db).rebuild(db)
+        || !TitleAutocomplete::of(db).rebuild(db)) {
+        std::cerr << "Setup failed" << std::endl;
+        return 1;
+    }
+
+    BinlogConsumer& consumer = BinlogConsumer::of(db);
+    std::atomic<int> notified{0};
+    consumer.addListener([&notified](const std::set<std::string>&) { notified++; });
+    consumer.start(db, 1, 4242 + unsigned(std::chrono::system_clock::now().time_since_epoch().count() % 1000), false);
+    if (!eventually("consumer connects", [&] { return consumer.getStats()["connected"].get<bool>(); })) {
+        std::cerr << consumer.getStats().dump() << std::endl;
+        return 77;
+    }
+
+    // Writes go through their own connection, bypassing the write paths
+    Database other(host, user, password, name, port);
+    if (!other.connect()) return 1;
+
+    int failures = 0;
+    auto check = [&failures](bool ok) { if (!ok) failures++; };
+
+    other.executeUpdate(
+        "INSERT INTO books (id, title, author, isbn, category, total_copies, available_copies, publication_year) "
+        "VALUES (2, 'Binlog Stories', 'New Author', 'CDC-2', 'Science', 1, 1, 2020)");
+    check(eventually("insert reaches autocomplete", [&] { return suggests(db, "binlog", 2); }));
+    check(eventually("insert reaches facets", [&] { return booksBy(db, "New Author") == 1; }));
+
+    other.executeUpdate("UPDATE books SET title = 'Renamed Stories', author = 'Seed Author' WHERE id = 2");
+    check(eventually("update moves the title", [&] { return suggests(db, "renamed", 2) && !suggests(db, "binlog", 2); }));
+    check(eventually("update moves the author", [&] { return booksBy(db, "Seed Author") == 2; }));
+
+    other.executeUpdate(
+        "INSERT INTO borrow_records (member_id, book_id, borrow_date, due_date, status) "
+        "VALUES (1, 1, CURDATE(), CURDATE() + INTERVAL 14 DAY, 'active')");
+    check(eventually("loan reaches the counters", [&] { return LoanCounters::of(db).getActiveLoans(1) == 1; }));
+    check(eventually("loan ranks the title", [&] { return loansOf(db, "seed", 1) == 1; }));
+
+    auto memberName = [&db] {
+        auto loans = Borrow(&db).getByMember(1);
+        return !loans || loans->empty() ? std::string() : (*loans)[0].getMemberName();
+    };
+    check(eventually("loan reads carry the name", [&] { return memberName() == "Seed Member"; }));
+    other.executeUpdate("UPDATE members SET name = 'Renamed Member' WHERE id = 1");
+    check(eventually("rename reaches loan reads", [&] { return memberName() == "Renamed Member"; }));
+
+    other.executeUpdate("UPDATE members SET status = 'suspended' WHERE id = 1");
+    check(eventually("member status", [&] {
+        auto admission = LoanCounters::of(db).tryReserve(1, 100);
+        if (admission == LoanCounters::Admission::Granted) LoanCounters::of(db).release(1);
+        return admission == LoanCounters::Admission::MemberNotActive;
+    }));
+
+    other.executeUpdate(
+        "INSERT INTO members (id, member_id, name, email, status, join_date) "
+        "VALUES (2, 'CDC2', 'New Member', 'new@example.com', 'active', '2024-01-01')");
+    check(eventually("member insert", [&] {
+        auto admission = LoanCounters::of(db).tryReserve(2, 100);
+        if (admission == LoanCounters::Admission::Granted) LoanCounters::of(db).release(2);
+        return admission == LoanCounters::Admission::Granted;
+    }));
+
+    other.executeUpdate("DELETE FROM books WHERE id = 2");
+    check(eventually("delete", [&] { return !suggests(db, "renamed", 2) && booksBy(db, "Seed Author") == 1; }));
+
+    // One transaction, several tables
+    {
+        Database::Transaction transaction(other);
+        other.executeUpdate(
+            "INSERT INTO books (id, title, author, isbn, category, total_copies, available_copies, publication_year) "
+            "VALUES (3, 'Atomic Tales', 'Third Author', 'CDC-3', 'Fiction', 1, 0, 2022)");
+        other.executeUpdate(
+            "INSERT INTO borrow_records (member_id, book_id, borrow_date, due_date, status) "
+            "VALUES (2, 3, CURDATE(), CURDATE() + INTERVAL 14 DAY, 'active')");
+        check(transaction.commit());
+    }
+    check(eventually("transaction", [&] {
+        return loansOf(db, "atomic", 3) == 1 && LoanCounters::of(db).getActiveLoans(2) == 1;
+    }));
+
+    // Checkouts in flight while loans made elsewhere are applied
+    auto& counters = LoanCounters::of(db);
+    auto outstanding = [&db](int member_id) {
+        json rows = db.executeQuery("SELECT COUNT(*) AS n FROM borrow_records WHERE status <> 'returned' "
+                                    "AND member_id = " + std::to_string(member_id));
+        return rows.is_array() && !rows.empty() ? rows[0]["n"].get<int>() : -1;
+    };
+    check(counters.tryReserve(2, 100) == LoanCounters::Admission::Granted);
+    other.executeUpdate(
+        "INSERT INTO borrow_records (member_id, book_id, borrow_date, due_date, status) "
+        "VALUES (2, 1, CURDATE(), CURDATE() + INTERVAL 14 DAY, 'active')");
+    check(eventually("event keeps the reservation", [&] { return counters.getActiveLoans(2) == 3; }));
+    counters.cancel(2);
+    check(eventually("cancelled reservation", [&] { return counters.getActiveLoans(2) == 2; }));
+
+    std::atomic<bool> writing{true};
+    std::thread checkouts([&] {
+        Borrow borrow(&db);
+        Borrow::CheckoutRequest request{2, 1, "2024-01-01", "2024-01-15"};
+        while (writing) {
+            borrow.checkout(request);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    for (int i = 0; i < 20; i++) {
+        other.executeUpdate("UPDATE borrow_records SET status = 'returned' WHERE member_id = 2 "
+                            "AND status <> 'returned' ORDER BY id LIMIT 1");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    writing = false;
+    checkouts.join();
+    check(eventually("counter matches the loans", [&] { return counters.getActiveLoans(2) == outstanding(2); }));
+    check(outstanding(2) <= SettingsCache::instance().getPolicy().borrow_limit);
+
+    check(eventually("listeners notified", [&] { return notified > 0; }));
+    json stats = consumer.getStats();
+    std::cout << stats.dump() << std::endl;
+    if (stats["reloads"].get<unsigned long long>() != 0) {
+        std::cerr << "FAIL row events caused a full reload" << std::endl;
+        failures++;
+    }
+
+    std::cout << failures << " failing checks" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
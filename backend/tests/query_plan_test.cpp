@@ -0,0 +1,192 @@
+// Query plan regression test.
+//
+// Loads sql/schema.sql into a scratch database, fills it with synthetic rows,
+// then runs every read statement the models and routes emit, captures its SQL
+// and EXPLAINs it. A statement fails when a table is read with a full scan
+// (type ALL) or needs a filesort, unless that case is explicitly allowed
+// below with a reason.
+//
+// Connection settings come from PLAN_TEST_DB_HOST, PLAN_TEST_DB_PORT,
+// PLAN_TEST_DB_USER, PLAN_TEST_DB_PASSWORD and PLAN_TEST_DB_NAME; the size of
+// the dataset from PLAN_TEST_LOANS. Exits with 77 (skipped) when no MySQL
+// server is reachable.
+
+#include "database/db_connection.h"
+#include "models/book.h"
+#include "models/member.h"
+#include "models/borrow.h"
+#include "services/settings_cache.h"
+#include "services/co_borrow_index.h"
+#include "services/catalog_facets.h"
+#include "services/title_autocomplete.h"
+#include "services/circulation_columns.h"
+#include "services/name_directory.h"
+#include "snapshot/warm_restart.h"
+#include "database/delta_sync.h"
+#include "test_database.h"
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <set>
+#include <cstdlib>
+
+namespace {
+
+struct PlanCase {
+    std::string name;
+    std::function<void()> run;
+    std::set<std::string> full_scan_ok;
+    bool filesort_ok;
+    std::string reason;
+};
+
+bool loadSyntheticData(Database& db, long loans) {
+    long books = loans / 10;
+    long members = loans / 20;
+
+    std::stringstream books_sql, members_sql, loans_sql;
+    books_sql << "INSERT INTO books (title, author, isbn, category, total_copies, available_copies, publication_year) "
+              << "WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM seq WHERE n < " << books << ") "
+              << "SELECT CONCAT('Title ', n), CONCAT('Author ', n % 5000), CONCAT('SYN-', n), "
+              << "CONCAT('Category ', n % 20), 5, n % 6, 1900 + n % 125 FROM seq";
+
+    members_sql << "INSERT INTO members (member_id, name, email, phone, address, status, join_date) "
+                << "WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM seq WHERE n < " << members << ") "
+                << "SELECT CONCAT('SYN', n), CONCAT('Member ', n), CONCAT('m', n, '@example.com'), NULL, NULL, "
+                << "CASE WHEN n % 20 = 0 THEN 'suspended' WHEN n % 10 = 0 THEN 'inactive' ELSE 'active' END, "
+                << "'2015-01-01' + INTERVAL n % 3650 DAY FROM seq";
+
+    // 85% returned, 10% active, 5% overdue
+    loans_sql << "INSERT INTO borrow_records (member_id, book_id, borrow_date, due_date, return_date, status) "
+              << "WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM seq WHERE n < " << loans << ") "
+              << "SELECT 1 + (n * 7919) % " << members << ", 1 + (n * 104729) % " << books << ", "
+              << "'2015-01-01' + INTERVAL n % 3650 DAY, '2015-01-15' + INTERVAL n % 3650 DAY, "
+              << "CASE WHEN n % 20 < 17 THEN '2015-01-10' + INTERVAL n % 3650 DAY END, "
+              << "CASE WHEN n % 20 < 17 THEN 'returned' WHEN n % 20 < 19 THEN 'active' ELSE 'overdue' END FROM seq";
+
+    return db.executeUpdate("SET SESSION cte_max_recursion_depth = 100000000")
+        && db.executeUpdate("SET FOREIGN_KEY_CHECKS = 0")
+        && db.executeUpdate(books_sql.str())
+        && db.executeUpdate(members_sql.str())
+        && db.executeUpdate(loans_sql.str())
+        && db.executeUpdate("SET FOREIGN_KEY_CHECKS = 1")
+        && !db.executeQuery("ANALYZE TABLE books, members, borrow_records").contains("error");
+}
+
+bool checkPlan(Database& db, const PlanCase& plan_case, const std::string& statement) {
+    json plan = db.executeQuery("EXPLAIN " + statement);
+    if (!plan.is_array()) {
+        std::cerr << "FAIL " << plan_case.name << ": EXPLAIN failed: " << plan.dump() << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    for (const auto& step : plan) {
+        std::string table = step.value("table", "");
+        std::string type = step["type"].is_string() ? step["type"].get<std::string>() : "";
+        std::string extra = step["Extra"].is_string() ? step["Extra"].get<std::string>() : "";
+
+        if (type == "ALL" && !plan_case.full_scan_ok.count(table)) {
+            std::cerr << "FAIL " << plan_case.name << ": full scan of " << table << std::endl;
+            ok = false;
+        }
+        if (extra.find("Using filesort") != std::string::npos && !plan_case.filesort_ok) {
+            std::cerr << "FAIL " << plan_case.name << ": filesort on " << table << std::endl;
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        std::cerr << "  " << statement << "\n  " << plan.dump() << std::endl;
+    } else {
+        std::cout << "ok   " << plan_case.name
+                  << (plan_case.reason.empty() ? "" : " (allowed: " + plan_case.reason + ")") << std::endl;
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string schema_path = argc > 1 ? argv[1] : "sql/schema.sql";
+    std::string host = env("PLAN_TEST_DB_HOST", "127.0.0.1");
+    std::string user = env("PLAN_TEST_DB_USER", "root");
+    std::string password = env("PLAN_TEST_DB_PASSWORD", "");
+    std::string name = env("PLAN_TEST_DB_NAME", "library_plan_test");
+    unsigned int port = std::stoi(env("PLAN_TEST_DB_PORT", "3306"));
+    long loans = std::stol(env("PLAN_TEST_LOANS", "200000"));
+
+    if (!recreateDatabase(host, user, password, port, name)) {
+        return 77;
+    }
+
+    Database db(host, user, password, name, port);
+    if (!db.connect() || !loadSchema(db, schema_path) || !loadSyntheticData(db, loans)) {
+        std::cerr << "Setup failed" << std::endl;
+        return 1;
+    }
+
+    Book book(&db);
+    Member member(&db);
+    Borrow borrow(&db);
+
+    // Delta-sync polls only see the last few changes; every synthetic row is
+    // older than this
+    const std::string recent = "NOW() + INTERVAL 1 MINUTE";
+
+    std::vector<PlanCase> cases = {
+        {"Book::getAll", [&] { book.getAll(); }, {"books"}, true, "lists the whole catalog"},
+        {"Book::getById", [&] { std::optional<Book> found; book.getById(42, found); }, {}, false, ""},
+        {"Book::search (text)", [&] { book.search("Title 12"); }, {"books"}, true, "leading-wildcard LIKE"},
+        {"Book::search (category)", [&] { book.search("", "Category 7"); }, {}, false, ""},
+        {"Book::getChangedSince", [&] { book.getChangedSince(recent); }, {}, false, ""},
+        {"Book::getByIds", [&] { book.getByIds({42, 7, 1000}); }, {}, false, ""},
+        {"CatalogFacets::rebuild", [&] { CatalogFacets::of(db).rebuild(db); }, {"books"}, true, "reads the whole catalog in title order"},
+        {"TitleAutocomplete::rebuild", [&] { TitleAutocomplete::of(db).rebuild(db); }, {"b"}, false, "counts loans for every book"},
+        {"warm_restart::catchUp", [&] { warm_restart::catchUp(db, "2038-01-01 00:00:00"); }, {}, false, ""},
+        {"Member::getAll", [&] { member.getAll(); }, {"members"}, true, "lists every member"},
+        {"Member::getChangedSince", [&] { member.getChangedSince(recent); }, {}, false, ""},
+        {"Member::getById", [&] { std::optional<Member> found; member.getById(42, found); }, {}, false, ""},
+        {"Member::search", [&] { member.search("Member 12"); }, {"members"}, true, "leading-wildcard LIKE"},
+        {"Member::filterByStatus", [&] { member.filterByStatus("suspended"); }, {}, false, ""},
+        {"Member::getMemberStats", [&] { member.getMemberStats(42); }, {}, false, ""},
+        {"Borrow::getAll", [&] { borrow.getAll(); }, {"br"}, true, "lists every loan"},
+        {"Borrow::getChangedSince", [&] { borrow.getChangedSince(recent); }, {}, false, ""},
+        {"delta_sync::deletedIds", [&] { delta_sync::deletedIds(db, "books", recent); }, {}, false, ""},
+        {"Borrow::getById", [&] { std::optional<Borrow> found; borrow.getById(42, found); }, {}, false, ""},
+        {"NameDirectory: members", [&] { NameDirectory::of(db).reloadMembers(db, {42, 7, 1000}); }, {}, false, ""},
+        {"NameDirectory: books", [&] { NameDirectory::of(db).reloadBooks(db, {42, 7, 1000}); }, {}, false, ""},
+        {"Borrow::getByMember", [&] { borrow.getByMember(42); }, {}, false, ""},
+        {"Borrow::getByStatus", [&] { borrow.getByStatus("active"); }, {}, false, ""},
+        {"Borrow::getOverdue", [&] { borrow.getOverdue(); }, {}, false, ""},
+        {"Borrow::getStatistics", [&] { borrow.getStatistics(); }, {}, false, ""},
+        {"Borrow::getMonthlyStats", [&] { borrow.getMonthlyStats(); }, {}, true, "groups by a date expression"},
+        {"Borrow::exportHistory", [&] { borrow.exportHistory("2020-01-01", "2020-03-31", "", [](const Borrow&) {}); }, {}, true, "orders a date range by id"},
+        {"CoBorrowIndex::rebuild", [&] { CoBorrowIndex::of(db).rebuild(db); }, {"borrow_records"}, false, "reads all history in index order"},
+        {"CirculationColumns::rebuild", [&] { CirculationColumns::of(db).rebuild(db); }, {"borrow_records", "books", "members"}, false, "loads every loan, book and member"},
+        {"CirculationColumns::refresh", [&] { CirculationColumns::of(db).refresh(db); }, {}, false, ""},
+        {"Borrow::returnBatch", [&] { std::vector<Borrow::BatchItem> items; borrow.returnBatch({3, 5, 11, 12}, items); }, {}, false, ""},
+        {"BinlogConsumer: loan recount", [&] { db.executeRead("SELECT book_id, COUNT(*) AS loans FROM borrow_records WHERE book_id IN (42,7,1000) GROUP BY book_id"); }, {}, false, ""},
+        {"Borrow::getTopBooks", [&] { borrow.getTopBooks(); }, {"b"}, true, "orders by an aggregate"},
+        {"dashboard: books", [&] { db.executeRead("SELECT COUNT(*) as count FROM books"); }, {}, false, ""},
+        {"dashboard: members", [&] { db.executeRead("SELECT COUNT(*) as count FROM members WHERE status = 'active'"); }, {}, false, ""},
+        {"dashboard: borrowed", [&] { db.executeRead("SELECT COUNT(*) as count FROM borrow_records WHERE status = 'active'"); }, {}, false, ""},
+        {"dashboard: overdue", [&] { db.executeRead("SELECT COUNT(*) as count FROM borrow_records WHERE status = 'overdue'"); }, {}, false, ""},
+        {"SettingsCache::load", [&] { SettingsCache::instance().load(db); }, {"settings"}, false, "single-row table"}
+    };
+
+    int failures = 0;
+    for (const auto& plan_case : cases) {
+        std::vector<std::string> statements;
+        db.setStatementObserver([&statements](const std::string& sql) { statements.push_back(sql); });
+        plan_case.run();
+        db.setStatementObserver(nullptr);
+
+        for (const auto& statement : statements) {
+            if (!checkPlan(db, plan_case, statement)) failures++;
+        }
+    }
+
+    std::cout << cases.size() << " cases, " << failures << " failing statements" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+// Scratch-database helpers shared by the tests that need a MySQL server.
+
+#ifndef TEST_DATABASE_H
+#define TEST_DATABASE_H
+
+#include "database/db_connection.h"
+#include <mysql/mysql.h>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::string env(const char* name, const std::string& fallback) {
+    const char* value = std::getenv(name);
+    return value ? value : fallback;
+}
+
+bool recreateDatabase(const std::string& host, const std::string& user, const std::string& password,
+                      unsigned int port, const std::string& name) {
+    MYSQL* connection = mysql_init(nullptr);
+    if (!mysql_real_connect(connection, host.c_str(), user.c_str(), password.c_str(),
+                            nullptr, port, nullptr, 0)) {
+        std::cerr << "MySQL not reachable: " << mysql_error(connection) << std::endl;
+        mysql_close(connection);
+        return false;
+    }
+    std::string drop = "DROP DATABASE IF EXISTS " + name;
+    std::string create = "CREATE DATABASE " + name;
+    bool ok = mysql_query(connection, drop.c_str()) == 0 && mysql_query(connection, create.c_str()) == 0;
+    if (!ok) {
+        std::cerr << "Could not create " << name << ": " << mysql_error(connection) << std::endl;
+    }
+    mysql_close(connection);
+    return ok;
+}
+
+bool loadSchema(Database& db, const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    std::stringstream script;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.rfind("--", 0) == 0) continue;
+        auto comment = line.find(" -- ");
+        script << (comment == std::string::npos ? line : line.substr(0, comment)) << "\n";
+    }
+
+    std::string statement;
+    while (std::getline(script, statement, ';')) {
+        auto start = statement.find_first_not_of(" \n\t");
+        if (start == std::string::npos) continue;
+        statement = statement.substr(start);
+        if (statement.rfind("CREATE DATABASE", 0) == 0 || statement.rfind("USE ", 0) == 0) continue;
+        if (!db.executeUpdate(statement)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+#endif // TEST_DATABASE_H
@@ -0,0 +1,514 @@
+// Synthetic dataset generator.
+//
+// Writes books, members and borrow_records as tab-separated files and, with
+// --load, bulk-loads them into the library database through
+// LOAD DATA LOCAL INFILE. The data is skewed the way a real library is:
+//
+//   - book popularity follows a Zipf distribution (a few titles account for
+//     most loans), with popularity ranks shuffled so they do not follow ids
+//   - member activity follows a flatter Zipf distribution
+//   - borrow dates follow a seasonal curve (summer reading, autumn term,
+//     quiet December, fewer loans on Sundays) on top of slow yearly growth
+//   - loans near the end of the period are still active or overdue, and
+//     available_copies, join_date and member status are consistent with them
+//
+// Loans are generated first and streamed straight to disk; books and members
+// are written afterwards so they can reflect the loans. Memory use is a few
+// bytes per book and member, independent of the number of loans.
+//
+// Usage:
+//   generate_dataset [--books N] [--members N] [--loans N] [--years N]
+//                    [--end-date YYYY-MM-DD] [--book-skew S] [--member-skew S]
+//                    [--seed N] [--out DIR]
+//                    [--load] [--truncate] [--host H] [--port P] [--user U]
+//                    [--password P] [--database D]
+
+#include <mysql/mysql.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    long books = 1000000;
+    long members = 500000;
+    long loans = 50000000;
+    int years = 10;
+    std::string end_date;
+    double book_skew = 1.0;
+    double member_skew = 0.6;
+    unsigned int seed = 42;
+    std::string out = "dataset";
+    bool load = false;
+    bool truncate = false;
+    std::string host = "localhost";
+    unsigned int port = 3306;
+    std::string user = "root";
+    std::string password;
+    std::string database = "library_db";
+};
+
+const int loanDays = 14;
+const double lateFeePerDay = 0.5;
+const long rowsPerProgress = 5000000;
+
+const std::array<const char*, 12> categories = {
+    "Fiction", "Non-Fiction", "Mystery", "Science Fiction", "Fantasy", "Romance",
+    "Biography", "History", "Science", "Children", "Poetry", "Dystopian"
+};
+
+// Relative loan volume by month (January first)
+const std::array<double, 12> monthWeights = {
+    1.10, 1.00, 0.95, 0.90, 0.95, 1.25, 1.40, 1.35, 1.15, 1.05, 1.00, 0.70
+};
+
+// Relative loan volume by weekday (Sunday first)
+const std::array<double, 7> weekdayWeights = {
+    0.45, 1.05, 1.00, 1.00, 1.05, 1.10, 1.20
+};
+
+// Days since 1970-01-01 for a civil date, and back
+long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yoe = year - era * 400;
+    long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void civilFromDays(long z, int& year, int& month, int& day) {
+    z += 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    year = static_cast<int>(yoe + era * 400 + (month <= 2));
+}
+
+void appendDate(std::string& out, long days) {
+    int year, month, day;
+    civilFromDays(days, year, month, day);
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+    out += buffer;
+}
+
+bool parseDate(const std::string& text, long& days) {
+    int year, month, day;
+    if (std::sscanf(text.c_str(), "%4d-%2d-%2d", &year, &month, &day) != 3) return false;
+    days = daysFromCivil(year, month, day);
+    return true;
+}
+
+long today() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::hours>(now).count() / 24);
+}
+
+// Samples an index from a fixed table of cumulative weights
+class CumulativeSampler {
+public:
+    explicit CumulativeSampler(const std::vector<double>& weights) : cumulative(weights.size()) {
+        double total = 0;
+        for (size_t i = 0; i < weights.size(); i++) {
+            total += weights[i];
+            cumulative[i] = total;
+        }
+        for (auto& value : cumulative) value /= total;
+    }
+
+    template<typename Rng>
+    size_t operator()(Rng& rng) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        auto it = std::lower_bound(cumulative.begin(), cumulative.end(), u);
+        return it == cumulative.end() ? cumulative.size() - 1 : it - cumulative.begin();
+    }
+
+private:
+    std::vector<double> cumulative;
+};
+
+std::vector<double> zipfWeights(long count, double skew) {
+    std::vector<double> weights(count);
+    for (long rank = 0; rank < count; rank++) {
+        weights[rank] = 1.0 / std::pow(static_cast<double>(rank + 1), skew);
+    }
+    return weights;
+}
+
+// Maps popularity ranks to ids so popular rows are spread over the table
+std::vector<int> shuffledIds(long count, std::mt19937_64& rng) {
+    std::vector<int> ids(count);
+    for (long i = 0; i < count; i++) ids[i] = static_cast<int>(i + 1);
+    std::shuffle(ids.begin(), ids.end(), rng);
+    return ids;
+}
+
+// Buffered writer for one tab-separated data file
+class TsvFile {
+public:
+    explicit TsvFile(const std::string& path) : file(std::fopen(path.c_str(), "wb")) {
+        line.reserve(1 << 20);
+    }
+
+    ~TsvFile() { close(); }
+
+    bool isOpen() const { return file != nullptr; }
+
+    std::string& buffer() { return line; }
+
+    void endRow() {
+        line.back() = '\n';
+        if (line.size() >= (1 << 20) - 1024) flush();
+    }
+
+    bool close() {
+        if (!file) return true;
+        flush();
+        bool ok = std::fclose(file) == 0 && !failed;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    void flush() {
+        if (!line.empty() && std::fwrite(line.data(), 1, line.size(), file) != line.size()) failed = true;
+        line.clear();
+    }
+
+    std::FILE* file;
+    std::string line;
+    bool failed = false;
+};
+
+void field(std::string& out, long value) {
+    out += std::to_string(value);
+    out += '\t';
+}
+
+void field(std::string& out, const std::string& value) {
+    out += value;
+    out += '\t';
+}
+
+void dateField(std::string& out, long days) {
+    appendDate(out, days);
+    out += '\t';
+}
+
+void nullField(std::string& out) {
+    out += "\\N\t";
+}
+
+bool generateLoans(const Options& options, long first_day, long last_day,
+                   std::vector<int>& outstanding_by_book, std::vector<int>& first_loan_by_member,
+                   std::vector<int>& overdue_by_member) {
+    std::mt19937_64 rng(options.seed);
+    std::vector<int> book_ids = shuffledIds(options.books, rng);
+    std::vector<int> member_ids = shuffledIds(options.members, rng);
+    CumulativeSampler pick_book(zipfWeights(options.books, options.book_skew));
+    CumulativeSampler pick_member(zipfWeights(options.members, options.member_skew));
+
+    // Seasonal calendar with about 4% growth a year
+    long day_count = last_day - first_day + 1;
+    std::vector<double> day_weights(day_count);
+    for (long i = 0; i < day_count; i++) {
+        long days = first_day + i;
+        int year, month, day;
+        civilFromDays(days, year, month, day);
+        int weekday = static_cast<int>(((days % 7) + 11) % 7);
+        day_weights[i] = monthWeights[month - 1] * weekdayWeights[weekday] * std::pow(1.04, i / 365.0);
+    }
+    CumulativeSampler pick_day(day_weights);
+
+    // Return delay: most loans come back within the loan period, some late, a few very late
+    std::gamma_distribution<double> return_delay(3.0, 4.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    TsvFile out(options.out + "/borrow_records.tsv");
+    if (!out.isOpen()) {
+        std::cerr << "Cannot write " << options.out << "/borrow_records.tsv" << std::endl;
+        return false;
+    }
+
+    for (long id = 1; id <= options.loans; id++) {
+        int book_id = book_ids[pick_book(rng)];
+        int member_id = member_ids[pick_member(rng)];
+        long borrow_day = first_day + static_cast<long>(pick_day(rng));
+        long due_day = borrow_day + loanDays;
+        long return_day = borrow_day + 1 + static_cast<long>(return_delay(rng));
+        if (unit(rng) < 0.01) return_day += 60 + static_cast<long>(unit(rng) * 300);
+
+        std::string& row = out.buffer();
+        field(row, id);
+        field(row, member_id);
+        field(row, book_id);
+        dateField(row, borrow_day);
+        dateField(row, due_day);
+
+        if (return_day <= last_day) {
+            long late_days = std::max(0L, return_day - due_day);
+            dateField(row, return_day);
+            field(row, "returned");
+            char fine[32];
+            std::snprintf(fine, sizeof(fine), "%.2f", late_days * lateFeePerDay);
+            field(row, fine);
+        } else {
+            bool overdue = due_day < last_day;
+            nullField(row);
+            field(row, overdue ? "overdue" : "active");
+            field(row, "0.00");
+            outstanding_by_book[book_id - 1]++;
+            if (overdue) overdue_by_member[member_id - 1]++;
+        }
+        out.endRow();
+
+        int& first_loan = first_loan_by_member[member_id - 1];
+        if (first_loan == 0 || borrow_day < first_loan) first_loan = static_cast<int>(borrow_day);
+
+        if (id % rowsPerProgress == 0) {
+            std::cout << "  " << id << " loans" << std::endl;
+        }
+    }
+    return out.close();
+}
+
+bool generateBooks(const Options& options, const std::vector<int>& outstanding_by_book) {
+    std::mt19937_64 rng(options.seed + 1);
+    std::uniform_int_distribution<int> copies(1, 6);
+    std::uniform_int_distribution<int> year(1850, 2024);
+    std::uniform_int_distribution<size_t> category(0, categories.size() - 1);
+    long authors = std::max(1L, options.books / 8);
+
+    TsvFile out(options.out + "/books.tsv");
+    if (!out.isOpen()) {
+        std::cerr << "Cannot write " << options.out << "/books.tsv" << std::endl;
+        return false;
+    }
+
+    for (long id = 1; id <= options.books; id++) {
+        int outstanding = outstanding_by_book[id - 1];
+        int total = std::max(copies(rng), outstanding);
+
+        std::string& row = out.buffer();
+        field(row, id);
+        field(row, "Title " + std::to_string(id));
+        field(row, "Author " + std::to_string(1 + (id * 2654435761L) % authors));
+        field(row, "SYN-" + std::to_string(id));
+        field(row, categories[category(rng)]);
+        field(row, total);
+        field(row, total - outstanding);
+        field(row, year(rng));
+        out.endRow();
+    }
+    return out.close();
+}
+
+bool generateMembers(const Options& options, long first_day, long last_day,
+                     const std::vector<int>& first_loan_by_member,
+                     const std::vector<int>& overdue_by_member) {
+    std::mt19937_64 rng(options.seed + 2);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<long> lead_days(0, 365);
+    std::uniform_int_distribution<long> any_day(first_day, last_day);
+
+    TsvFile out(options.out + "/members.tsv");
+    if (!out.isOpen()) {
+        std::cerr << "Cannot write " << options.out << "/members.tsv" << std::endl;
+        return false;
+    }
+
+    for (long id = 1; id <= options.members; id++) {
+        long first_loan = first_loan_by_member[id - 1];
+        long join_day = (first_loan ? first_loan : any_day(rng)) - lead_days(rng);
+
+        // Members with several overdue loans are suspended; some never borrow again
+        std::string status = "active";
+        if (overdue_by_member[id - 1] >= 3) {
+            status = "suspended";
+        } else if (overdue_by_member[id - 1] == 0 && unit(rng) < 0.08) {
+            status = "inactive";
+        }
+
+        std::string& row = out.buffer();
+        field(row, id);
+        field(row, "SYN" + std::to_string(id));
+        field(row, "Member " + std::to_string(id));
+        field(row, "member" + std::to_string(id) + "@example.com");
+        if (unit(rng) < 0.7) {
+            char phone[24];
+            std::snprintf(phone, sizeof(phone), "+1-555-%07ld", id % 10000000);
+            field(row, phone);
+        } else {
+            nullField(row);
+        }
+        if (unit(rng) < 0.6) {
+            field(row, std::to_string(1 + id % 9999) + " Synthetic St");
+        } else {
+            nullField(row);
+        }
+        field(row, status);
+        dateField(row, join_day);
+        out.endRow();
+    }
+    return out.close();
+}
+
+bool run(MYSQL* connection, const std::string& statement) {
+    if (mysql_query(connection, statement.c_str())) {
+        std::cerr << "Query failed: " << mysql_error(connection) << "\n  " << statement << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadFile(MYSQL* connection, const std::string& path, const std::string& table, const std::string& columns) {
+    std::string statement = "LOAD DATA LOCAL INFILE '" + path + "' INTO TABLE " + table +
+                            " FIELDS TERMINATED BY '\\t' LINES TERMINATED BY '\\n' (" + columns + ")";
+    auto start = std::chrono::steady_clock::now();
+    if (!run(connection, statement)) return false;
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded " << mysql_affected_rows(connection) << " rows into " << table
+              << " in " << seconds << "s" << std::endl;
+    return true;
+}
+
+bool loadDataset(const Options& options) {
+    MYSQL* connection = mysql_init(nullptr);
+    unsigned int local_infile = 1;
+    mysql_options(connection, MYSQL_OPT_LOCAL_INFILE, &local_infile);
+
+    if (!mysql_real_connect(connection, options.host.c_str(), options.user.c_str(), options.password.c_str(),
+                            options.database.c_str(), options.port, nullptr, 0)) {
+        std::cerr << "Connection failed: " << mysql_error(connection) << std::endl;
+        mysql_close(connection);
+        return false;
+    }
+
+    std::string dir = std::filesystem::absolute(options.out).string();
+    bool ok = run(connection, "SET FOREIGN_KEY_CHECKS = 0") && run(connection, "SET UNIQUE_CHECKS = 0");
+    if (ok && options.truncate) {
+        ok = run(connection, "TRUNCATE TABLE borrow_records")
+            && run(connection, "TRUNCATE TABLE members")
+            && run(connection, "TRUNCATE TABLE books");
+    }
+    ok = ok
+        && loadFile(connection, dir + "/books.tsv", "books",
+                    "id, title, author, isbn, category, total_copies, available_copies, publication_year")
+        && loadFile(connection, dir + "/members.tsv", "members",
+                    "id, member_id, name, email, phone, address, status, join_date")
+        && loadFile(connection, dir + "/borrow_records.tsv", "borrow_records",
+                    "id, member_id, book_id, borrow_date, due_date, return_date, status, fine_amount")
+        && run(connection, "SET UNIQUE_CHECKS = 1")
+        && run(connection, "SET FOREIGN_KEY_CHECKS = 1")
+        && run(connection, "ANALYZE TABLE books, members, borrow_records");
+
+    if (ok) {
+        MYSQL_RES* result = mysql_store_result(connection);
+        if (result) mysql_free_result(result);
+    }
+    mysql_close(connection);
+    return ok;
+}
+
+void usage() {
+    std::cerr << "Usage: generate_dataset [--books N] [--members N] [--loans N] [--years N]\n"
+              << "                        [--end-date YYYY-MM-DD] [--book-skew S] [--member-skew S]\n"
+              << "                        [--seed N] [--out DIR] [--load] [--truncate]\n"
+              << "                        [--host H] [--port P] [--user U] [--password P] [--database D]"
+              << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--load") { options.load = true; continue; }
+        if (arg == "--truncate") { options.truncate = true; continue; }
+        if (i + 1 >= argc) return false;
+
+        std::string value = argv[++i];
+        if (arg == "--books") options.books = std::stol(value);
+        else if (arg == "--members") options.members = std::stol(value);
+        else if (arg == "--loans") options.loans = std::stol(value);
+        else if (arg == "--years") options.years = std::stoi(value);
+        else if (arg == "--end-date") options.end_date = value;
+        else if (arg == "--book-skew") options.book_skew = std::stod(value);
+        else if (arg == "--member-skew") options.member_skew = std::stod(value);
+        else if (arg == "--seed") options.seed = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--out") options.out = value;
+        else if (arg == "--host") options.host = value;
+        else if (arg == "--port") options.port = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--user") options.user = value;
+        else if (arg == "--password") options.password = value;
+        else if (arg == "--database") options.database = value;
+        else return false;
+    }
+    return options.books > 0 && options.members > 0 && options.loans >= 0 && options.years > 0
+        && options.books < 2147483647L && options.members < 2147483647L;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            usage();
+            return 2;
+        }
+    } catch (const std::exception&) {
+        usage();
+        return 2;
+    }
+
+    long last_day = today();
+    if (!options.end_date.empty() && !parseDate(options.end_date, last_day)) {
+        std::cerr << "Invalid --end-date: " << options.end_date << std::endl;
+        return 2;
+    }
+    long first_day = last_day - options.years * 365L;
+
+    std::error_code ec;
+    std::filesystem::create_directories(options.out, ec);
+    if (ec) {
+        std::cerr << "Cannot create " << options.out << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    std::vector<int> outstanding_by_book(options.books, 0);
+    std::vector<int> first_loan_by_member(options.members, 0);
+    std::vector<int> overdue_by_member(options.members, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "Generating " << options.loans << " loans, " << options.books << " books, "
+              << options.members << " members into " << options.out << std::endl;
+
+    if (!generateLoans(options, first_day, last_day, outstanding_by_book, first_loan_by_member, overdue_by_member)
+        || !generateBooks(options, outstanding_by_book)
+        || !generateMembers(options, first_day, last_day, first_loan_by_member, overdue_by_member)) {
+        return 1;
+    }
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Generated dataset in " << seconds << "s" << std::endl;
+
+    if (options.load && !loadDataset(options)) {
+        return 1;
+    }
+    return 0;
+}